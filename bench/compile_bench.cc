@@ -0,0 +1,267 @@
+/*
+ * Compile-time benchmark harness.
+ *
+ * usage: compile_bench [--ycc=<path>] [--flags=<ycc options>] [--llc=<path>]
+ *                      [--runs=R] [--out=<file>] <file.java>...
+ *
+ * Compiles every file R times with `ycc --stats`, and reports for each file
+ * the median of every phase (lex, parse, semantic, IR generation, dump IR),
+ * the median end-to-end time of the process and the throughput in lines per
+ * second. With --llc, llc also compiles the IR of every run (ycc.ll, or
+ * ycc.bc with --flags=--emit-bc) and its time and that of both are added. Results are json, one file or phase per line, so two runs can be
+ * compared with diff. Run it from the directory that holds api/.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace
+{
+    struct Phase
+    {
+        std::vector<double> wallMs;
+        std::vector<double> cpuMs;
+        std::vector<long>   allocations;
+        long                rssKB = 0;
+    };
+
+    struct FileResult
+    {
+        std::string                         file;
+        long                                lines = 0;
+        long                                bytes = 0;
+        int                                 status = 0;
+        std::vector<double>                 wallMs;         // whole process
+        std::vector<double>                 llcMs;          // llc on its output, if asked for
+        std::vector<std::string>            phaseOrder;
+        std::map<std::string, Phase>        phases;
+        std::map<std::string, long>         counters;
+    };
+
+    template <typename T>
+    T median(std::vector<T> values)
+    {
+        if(values.empty())
+        {
+            return T();
+        }
+        std::sort(values.begin(), values.end());
+        return values[values.size() / 2];
+    }
+
+    std::string fixed(double value)
+    {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.3f", value);
+        return buffer;
+    }
+
+    // value of "key": in a line of the --stats output
+    bool field(const std::string &line, const std::string &key, std::string &value)
+    {
+        auto pos = line.find("\"" + key + "\":");
+        if(pos == std::string::npos)
+        {
+            return false;
+        }
+        pos = line.find_first_not_of(" ", pos + key.size() + 3);
+        auto end = line[pos] == '"' ? line.find('"', pos + 1) + 1 : line.find_first_of(",}", pos);
+        value = line.substr(pos, end - pos);
+        if(value.size() >= 2 && value.front() == '"')
+        {
+            value = value.substr(1, value.size() - 2);
+        }
+        return true;
+    }
+
+    // the --stats json of ycc has one phase and one counter per line
+    void readStats(const std::string &fileName, FileResult &result)
+    {
+        std::ifstream in(fileName);
+        std::string line;
+        bool counters = false;
+        while(std::getline(in, line))
+        {
+            std::string name, value;
+            if(line.find("\"counters\"") != std::string::npos)
+            {
+                counters = true;
+                continue;
+            }
+            if(counters)
+            {
+                auto begin = line.find('"');
+                auto end = line.find("\":", begin + 1);
+                if(begin != std::string::npos && end != std::string::npos)
+                {
+                    result.counters[line.substr(begin + 1, end - begin - 1)] = std::atol(line.c_str() + end + 2);
+                }
+                continue;
+            }
+            if(!field(line, "name", name))
+            {
+                continue;
+            }
+            if(result.phases.find(name) == result.phases.end())
+            {
+                result.phaseOrder.push_back(name);
+            }
+            auto &phase = result.phases[name];
+            if(field(line, "wall_ms", value))       phase.wallMs.push_back(std::atof(value.c_str()));
+            if(field(line, "cpu_ms", value))        phase.cpuMs.push_back(std::atof(value.c_str()));
+            if(field(line, "allocations", value))   phase.allocations.push_back(std::atol(value.c_str()));
+            if(field(line, "rss_kb", value))        phase.rssKB = std::max(phase.rssKB, std::atol(value.c_str()));
+        }
+    }
+
+    double elapsedMs(const std::string &command, int &status)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        status = std::system(command.c_str());
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(end - begin).count();
+    }
+
+    void measure(const std::string &ycc, const std::string &flags, const std::string &llc,
+                 const std::string &file, int runs, FileResult &result)
+    {
+        std::ifstream in(file, std::ios::in | std::ios::binary);
+        std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        result.file = file;
+        result.bytes = text.size();
+        result.lines = std::count(text.begin(), text.end(), '\n');
+
+        auto statsFile = "/tmp/compile_bench." + std::to_string(getpid()) + ".json";
+        auto command = ycc + " " + flags + " --stats=" + statsFile + " " + file + " > /dev/null 2>&1";
+        auto ir = flags.find("--emit-bc") != std::string::npos ? "ycc.bc" : "ycc.ll";
+        auto backend = llc + " " + ir + " -o /dev/null";
+        for(int run = 0; run < runs; run++)
+        {
+            int status;
+            result.wallMs.push_back(elapsedMs(command, status));
+            if(status == 0 && !llc.empty())
+            {
+                result.llcMs.push_back(elapsedMs(backend, status));
+            }
+            if(status != 0)
+            {
+                result.status = status;
+            }
+            readStats(statsFile, result);
+        }
+        std::remove(statsFile.c_str());
+    }
+
+    void report(std::ostream &out, const std::string &ycc, int runs, const std::vector<FileResult> &results)
+    {
+        out << "{\n  \"ycc\": \"" << ycc << "\",\n  \"runs\": " << runs << ",\n  \"files\": [";
+        for(size_t i = 0; i < results.size(); i++)
+        {
+            auto &result = results[i];
+            double wall = median(result.wallMs);
+            double compile = 0;
+            for(auto &phase : result.phases)
+            {
+                compile += median(phase.second.wallMs);
+            }
+            out << (i ? ",\n" : "\n")
+                << "    {\"file\": \"" << result.file << "\", \"status\": " << result.status
+                << ", \"lines\": " << result.lines << ", \"bytes\": " << result.bytes
+                << ", \"wall_ms\": " << fixed(wall)
+                << ", \"lines_per_sec\": " << fixed(wall > 0 ? result.lines * 1000.0 / wall : 0)
+                << ", \"compile_ms\": " << fixed(compile)
+                << ", \"compile_lines_per_sec\": " << fixed(compile > 0 ? result.lines * 1000.0 / compile : 0);
+            if(!result.llcMs.empty())
+            {
+                std::vector<double> both;
+                for(size_t run = 0; run < result.llcMs.size(); run++)
+                {
+                    both.push_back(result.wallMs[run] + result.llcMs[run]);
+                }
+                out << ", \"llc_ms\": " << fixed(median(result.llcMs))
+                    << ", \"ycc_llc_ms\": " << fixed(median(both));
+            }
+            out
+                << ",\n     \"phases\": [";
+            for(size_t p = 0; p < result.phaseOrder.size(); p++)
+            {
+                auto &phase = result.phases.at(result.phaseOrder[p]);
+                out << (p ? ",\n" : "\n")
+                    << "      {\"name\": \"" << result.phaseOrder[p] << "\""
+                    << ", \"wall_ms\": " << fixed(median(phase.wallMs))
+                    << ", \"cpu_ms\": " << fixed(median(phase.cpuMs))
+                    << ", \"rss_kb\": " << phase.rssKB
+                    << ", \"allocations\": " << median(phase.allocations) << "}";
+            }
+            out << "],\n     \"counters\": {";
+            bool first = true;
+            for(auto &counter : result.counters)
+            {
+                if(counter.first.compare(0, 10, "ast nodes.") == 0)
+                {
+                    continue;   // node kinds are too many for a summary
+                }
+                out << (first ? "" : ", ") << "\"" << counter.first << "\": " << counter.second;
+                first = false;
+            }
+            out << "}}";
+        }
+        out << "\n  ]\n}\n";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string ycc = "ycc", flags, llc, output;
+    int runs = 5;
+    std::vector<std::string> files;
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if(arg.compare(0, 6, "--ycc=") == 0)        ycc = arg.substr(6);
+        else if(arg.compare(0, 8, "--flags=") == 0) flags = arg.substr(8);
+        else if(arg.compare(0, 6, "--llc=") == 0)   llc = arg.substr(6);
+        else if(arg.compare(0, 7, "--runs=") == 0)  runs = std::max(1, std::atoi(arg.c_str() + 7));
+        else if(arg.compare(0, 6, "--out=") == 0)   output = arg.substr(6);
+        else if(arg[0] == '-')
+        {
+            std::cerr << "usage: compile_bench [--ycc=<path>] [--flags=<ycc options>] [--llc=<path>]"
+                      << " [--runs=R] [--out=<file>] <file.java>..." << std::endl;
+            return 1;
+        }
+        else files.push_back(arg);
+    }
+
+    std::vector<FileResult> results(files.size());
+    int status = 0;
+    for(size_t i = 0; i < files.size(); i++)
+    {
+        measure(ycc, flags, llc, files[i], runs, results[i]);
+        std::cerr << "compile_bench: " << files[i] << " " << results[i].lines << " lines, "
+                  << fixed(median(results[i].wallMs)) << " ms" << std::endl;
+        if(results[i].status != 0)
+        {
+            std::cerr << "compile_bench: ycc failed on " << files[i] << std::endl;
+            status = 1;
+        }
+    }
+
+    if(output.empty())
+    {
+        report(std::cout, ycc, runs, results);
+    }
+    else
+    {
+        std::ofstream out(output);
+        report(out, ycc, runs, results);
+    }
+    return status;
+}
@@ -0,0 +1,237 @@
+/*
+ * Synthetic corpus generator for the compiler benchmarks.
+ *
+ * usage: gen_corpus [--classes=N] [--methods=M] [--depth=D] [--locals=L]
+ *                   [--strings=S] [--comments=C] [--seed=X] [-o <file>]
+ *
+ * Emits a program of the java subset ycc accepts: N classes of M static
+ * methods, every method with L locals, expressions of depth D and loops;
+ * every class holds S string fields (the string pool) and every method is
+ * preceded by C lines of comments. The output only depends on the options.
+ */
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+
+namespace
+{
+    // xorshift64*, the same sequence on every platform
+    class Random
+    {
+      public:
+        explicit Random(uint64_t seed)
+            : state_(seed ? seed : 0x9e3779b97f4a7c15ULL)
+        {}
+
+        int next(int bound)
+        {
+            state_ ^= state_ >> 12;
+            state_ ^= state_ << 25;
+            state_ ^= state_ >> 27;
+            return (state_ * 0x2545f4914f6cdd1dULL >> 33) % bound;
+        }
+
+      private:
+        uint64_t state_;
+    };
+
+    struct Options
+    {
+        int classes = 4;
+        int methods = 8;
+        int depth = 3;
+        int locals = 8;
+        int strings = 16;
+        int comments = 2;
+        int seed = 1;
+        std::string output;
+    };
+
+    class Generator
+    {
+      public:
+        Generator(const Options &options)
+            : options_(options), random_(options.seed)
+        {}
+
+        void program(std::ostream &out)
+        {
+            out << "import io;\n\n";
+            for(int c = 0; c < options_.classes; c++)
+            {
+                classDecl(out, c);
+            }
+        }
+
+      private:
+        void comment(std::ostream &out, const std::string &indent, int id)
+        {
+            if(options_.comments <= 0)
+            {
+                return ;
+            }
+            out << indent << "/*\n";
+            for(int i = 0; i < options_.comments; i++)
+            {
+                out << indent << " * generated comment " << id << "." << i
+                    << ": lorem ipsum dolor sit amet, consectetur adipiscing elit\n";
+            }
+            out << indent << " */\n";
+            out << indent << "// " << id << " end of comment\n";
+        }
+
+        std::string literal(int c, int s)
+        {
+            std::ostringstream text;
+            text << "pool " << c << "." << s << ":";
+            int words = 4 + random_.next(12);
+            for(int i = 0; i < words; i++)
+            {
+                text << " w" << random_.next(1000);
+            }
+            if(random_.next(4) == 0)
+            {
+                text << "\\n\\t";
+            }
+            return text.str();
+        }
+
+        // leaves are the parameters, earlier locals and small constants
+        std::string expr(int depth, int locals)
+        {
+            if(depth <= 0)
+            {
+                int pick = random_.next(locals + 3);
+                if(pick < locals)
+                {
+                    return "v" + std::to_string(pick);
+                }
+                if(pick == locals)
+                {
+                    return "a";
+                }
+                if(pick == locals + 1)
+                {
+                    return "b";
+                }
+                return std::to_string(1 + random_.next(99));
+            }
+            static const char *ops[] = { " + ", " - ", " * ", " + ", " - " };
+            int op = random_.next(6);
+            if(op == 5)
+            {
+                // divide by a constant only, never by zero
+                return "(" + expr(depth - 1, locals) + " / " + std::to_string(2 + random_.next(7)) + ")";
+            }
+            return "(" + expr(depth - 1, locals) + ops[op] + expr(depth - 1, locals) + ")";
+        }
+
+        void method(std::ostream &out, int c, int m)
+        {
+            int locals = options_.locals > 2 ? options_.locals : 2;
+            comment(out, "    ", c * 1000 + m);
+            out << "    public static int m" << m << "(int a, int b)\n    {\n";
+            for(int i = 0; i < locals; i++)
+            {
+                out << "        int v" << i << " = " << expr(options_.depth, i) << ";\n";
+            }
+            out << "        int i;\n"
+                << "        for(i = 0; i < " << 2 + random_.next(30) << "; i++)\n        {\n"
+                << "            v0 = v0 + " << expr(options_.depth, locals) << ";\n"
+                << "        }\n"
+                << "        if(v1 > v0)\n        {\n"
+                << "            v0 = v1 - v0;\n"
+                << "        }\n        else\n        {\n"
+                << "            v1 = " << expr(options_.depth, locals) << ";\n"
+                << "        }\n"
+                << "        while(v0 > 1000)\n        {\n"
+                << "            v0 = v0 / 2;\n"
+                << "        }\n";
+            if(m > 0)
+            {
+                out << "        v1 = m" << random_.next(m) << "(v0, v1);\n";
+            }
+            out << "        return v0 + v1;\n    }\n\n";
+        }
+
+        void classDecl(std::ostream &out, int c)
+        {
+            comment(out, "", c);
+            out << "public class C" << c << "\n{\n";
+            out << "    public static int count" << c << " = " << c << ";\n";
+            for(int s = 0; s < options_.strings; s++)
+            {
+                out << "    private String s" << s << " = \"" << literal(c, s) << "\";\n";
+            }
+            out << "\n";
+            for(int m = 0; m < options_.methods; m++)
+            {
+                method(out, c, m);
+            }
+            if(c == 0)
+            {
+                out << "    public static void main(String [] args)\n    {\n"
+                    << "        int r = " << (options_.methods > 0 ? "m0(1, 2)" : "0") << ";\n"
+                    << "    }\n";
+            }
+            out << "}\n\n";
+        }
+
+      private:
+        const Options & options_;
+        Random          random_;
+    };
+
+    bool parseOptions(int argc, char **argv, Options &options)
+    {
+        std::map<std::string, int *> values = {
+            { "--classes", &options.classes }, { "--methods", &options.methods },
+            { "--depth", &options.depth },     { "--locals", &options.locals },
+            { "--strings", &options.strings }, { "--comments", &options.comments },
+            { "--seed", &options.seed }
+        };
+        for(int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if(arg == "-o" && i + 1 < argc)
+            {
+                options.output = argv[++i];
+                continue;
+            }
+            auto pos = arg.find('=');
+            auto iter = values.find(arg.substr(0, pos));
+            if(pos == std::string::npos || iter == values.end())
+            {
+                std::cerr << "gen_corpus: unknown option " << arg << std::endl;
+                return false;
+            }
+            *iter->second = std::atoi(arg.c_str() + pos + 1);
+        }
+        return true;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if(!parseOptions(argc, argv, options))
+    {
+        std::cerr << "usage: gen_corpus [--classes=N] [--methods=M] [--depth=D] [--locals=L]\n"
+                  << "                  [--strings=S] [--comments=C] [--seed=X] [-o <file>]" << std::endl;
+        return 1;
+    }
+
+    Generator generator(options);
+    if(options.output.empty())
+    {
+        generator.program(std::cout);
+        return 0;
+    }
+    std::ofstream out(options.output);
+    generator.program(out);
+    return out ? 0 : 1;
+}
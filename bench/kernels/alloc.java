@@ -0,0 +1,36 @@
+import io;
+
+class Cell
+{
+    int value;
+    Cell next;
+}
+
+// many small objects: lists built and walked again and again
+public class alloc
+{
+    public static void main(String [] args)
+    {
+        int round;
+        int i;
+        int total = 0;
+        for(round = 0; round < 20; round++)
+        {
+            Cell list = null;
+            for(i = 0; i < 100000; i++)
+            {
+                Cell cell = new Cell();
+                cell.value = i ^ round;
+                cell.next = list;
+                list = cell;
+            }
+            while(list != null)
+            {
+                total = (total + list.value) & 16777215;
+                list = list.next;
+            }
+        }
+        io.printInt(total);
+        io.print("");
+    }
+}
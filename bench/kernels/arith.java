@@ -0,0 +1,58 @@
+import io;
+
+// division, remainder and long arithmetic
+public class arith
+{
+    public static int collatz(long n)
+    {
+        int steps = 0;
+        while(n != 1)
+        {
+            if(n % 2 == 0)
+            {
+                n = n / 2;
+            }
+            else
+            {
+                n = 3 * n + 1;
+            }
+            steps++;
+        }
+        return steps;
+    }
+
+    public static int gcd(int a, int b)
+    {
+        int t;
+        while(b != 0)
+        {
+            t = a % b;
+            a = b;
+            b = t;
+        }
+        return a;
+    }
+
+    public static void main(String [] args)
+    {
+        int i;
+        int j;
+        int steps = 0;
+        int sum = 0;
+        for(i = 1; i < 300000; i++)
+        {
+            steps = steps + collatz(i);
+        }
+        for(i = 1; i < 2000; i++)
+        {
+            for(j = 1; j < 300; j++)
+            {
+                sum = sum + gcd(i * 7 + 3, j * 13 + 5);
+            }
+        }
+        io.printInt(steps);
+        io.print("");
+        io.printInt(sum);
+        io.print("");
+    }
+}
@@ -0,0 +1,20 @@
+import io;
+
+// call overhead: doubly recursive fibonacci
+public class fib
+{
+    public static int fib(int n)
+    {
+        if(n < 2)
+        {
+            return n;
+        }
+        return fib(n - 1) + fib(n - 2);
+    }
+
+    public static void main(String [] args)
+    {
+        io.printInt(fib(32));
+        io.print("");
+    }
+}
@@ -0,0 +1,25 @@
+import io;
+
+// double arithmetic: midpoint rule for the integral of 4 / (1 + x * x)
+public class float_loop
+{
+    public static double integrate(int steps)
+    {
+        double h = 1.0 / steps;
+        double sum = 0.0;
+        double x;
+        int i;
+        for(i = 0; i < steps; i++)
+        {
+            x = (i + 0.5) * h;
+            sum = sum + 4.0 / (1.0 + x * x);
+        }
+        return sum * h;
+    }
+
+    public static void main(String [] args)
+    {
+        io.printDouble(integrate(20000000));
+        io.print("");
+    }
+}
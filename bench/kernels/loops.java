@@ -0,0 +1,26 @@
+import io;
+
+// nested counted loops over int arithmetic
+public class loops
+{
+    public static void main(String [] args)
+    {
+        int i;
+        int j;
+        int k;
+        int sum = 0;
+        for(i = 0; i < 400; i++)
+        {
+            for(j = 0; j < 400; j++)
+            {
+                for(k = 0; k < 200; k++)
+                {
+                    sum = sum + (i ^ j) + k * 3;
+                    sum = sum & 1048575;
+                }
+            }
+        }
+        io.printInt(sum);
+        io.print("");
+    }
+}
@@ -0,0 +1,15 @@
+import io;
+
+// output bound: one io.printInt per line
+public class print_loop
+{
+    public static void main(String [] args)
+    {
+        int i;
+        for(i = 0; i < 300000; i++)
+        {
+            io.printInt(i * 7);
+            io.print("");
+        }
+    }
+}
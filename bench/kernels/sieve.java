@@ -0,0 +1,45 @@
+import io;
+
+// prime sieve and prefix sums over arrays, counted loops index by the length
+public class sieve
+{
+    public static void main(String [] args)
+    {
+        int n = 2000000;
+        boolean[] composite = new boolean[n];
+        int[] count = new int[n];
+        int i;
+        int j;
+        int round;
+        int total = 0;
+        for(round = 0; round < 5; round++)
+        {
+            for(i = 0; i < composite.length; i++)
+            {
+                composite[i] = false;
+            }
+            for(i = 2; i * i < n; i++)
+            {
+                if(!composite[i])
+                {
+                    for(j = i * i; j < n; j += i)
+                    {
+                        composite[j] = true;
+                    }
+                }
+            }
+            int primes = 0;
+            for(i = 2; i < count.length; i++)
+            {
+                if(!composite[i])
+                {
+                    primes++;
+                }
+                count[i] = primes;
+            }
+            total = total + count[n - 1] + round;
+        }
+        io.printInt(total);
+        io.print("");
+    }
+}
@@ -0,0 +1,60 @@
+import io;
+
+// a switch driven state machine over pseudo random input
+public class state_machine
+{
+    public static void main(String [] args)
+    {
+        int state = 0;
+        int seed = 12345;
+        int words = 0;
+        int numbers = 0;
+        int i;
+        for(i = 0; i < 20000000; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            int c = (seed >>> 16) & 7;
+            switch(state)
+            {
+            case 0:
+                if(c < 3)
+                {
+                    state = 1;
+                }
+                else if(c < 6)
+                {
+                    state = 2;
+                }
+                break;
+            case 1:
+                if(c >= 5)
+                {
+                    words++;
+                    state = 0;
+                }
+                break;
+            case 2:
+                if(c == 7)
+                {
+                    numbers++;
+                    state = 3;
+                }
+                else if(c < 2)
+                {
+                    state = 1;
+                }
+                break;
+            case 3:
+                state = c & 1;
+                break;
+            default:
+                state = 0;
+                break;
+            }
+        }
+        io.printInt(words);
+        io.print("");
+        io.printInt(numbers);
+        io.print("");
+    }
+}
@@ -0,0 +1,34 @@
+import io;
+
+class Vec
+{
+    double x;
+    double y;
+}
+
+// short-lived objects that never leave the method making them
+public class temps
+{
+    public static double length2(double x, double y)
+    {
+        Vec v = new Vec();
+        v.x = x;
+        v.y = y;
+        return v.x * v.x + v.y * v.y;
+    }
+
+    public static void main(String [] args)
+    {
+        int i;
+        double total = 0.0;
+        for(i = 0; i < 5000000; i++)
+        {
+            Vec step = new Vec();
+            step.x = i % 7;
+            step.y = i % 5;
+            total = total + length2(step.x, step.y) * 0.001;
+        }
+        io.printDouble(total);
+        io.print("");
+    }
+}
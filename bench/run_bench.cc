@@ -0,0 +1,255 @@
+/*
+ * Runtime benchmark harness for the code ycc generates.
+ *
+ * usage: run_bench [--ycc=<path>] [--llc=<path>] [--cc=<path>] [--llc-flags=<flags>]
+ *                  [--runs=R] [--work=<dir>] [--out=<file>] <kernel.java>...
+ *
+ * Every kernel is compiled with ycc, turned into an executable with llc and
+ * the C compiler, run R times and checked against <kernel>.expected next to
+ * the source: either the exact output or a line "fnv1a64 <hash> <bytes>" for
+ * long outputs. Results are json, one kernel per line, with the median and
+ * the fastest run. Run it from the directory that holds api/.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+namespace
+{
+    struct Options
+    {
+        std::string ycc = "ycc";
+        std::string llc = "llc";
+        std::string cc = "cc";
+        std::string llcFlags = "-O2";
+        std::string work = "bench/out/kernels";
+        std::string output;
+        int         runs = 5;
+    };
+
+    struct KernelResult
+    {
+        std::string             name;
+        std::string             status = "ok";  // ok, wrong, unchecked or the failed step
+        double                  compileMs = 0;
+        long                    irBytes = 0;
+        long                    binaryBytes = 0;
+        std::vector<double>     wallMs;
+        std::vector<double>     cpuMs;
+    };
+
+    template <typename T>
+    T median(std::vector<T> values)
+    {
+        if(values.empty())
+        {
+            return T();
+        }
+        std::sort(values.begin(), values.end());
+        return values[values.size() / 2];
+    }
+
+    std::string fixed(double value)
+    {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.3f", value);
+        return buffer;
+    }
+
+    std::string readFile(const std::string &fileName, bool &found)
+    {
+        std::ifstream in(fileName, std::ios::in | std::ios::binary);
+        found = bool(in);
+        return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+
+    long fileSize(const std::string &fileName)
+    {
+        struct stat st;
+        return stat(fileName.c_str(), &st) == 0 ? st.st_size : 0;
+    }
+
+    std::string fnv1a(const std::string &text)
+    {
+        unsigned long long hash = 0xcbf29ce484222325ULL;
+        for(unsigned char c : text)
+        {
+            hash = (hash ^ c) * 0x100000001b3ULL;
+        }
+        char buffer[24];
+        std::snprintf(buffer, sizeof(buffer), "%016llx", hash);
+        return buffer;
+    }
+
+    // user and system time of the finished children
+    double childCpuMs()
+    {
+        struct rusage usage;
+        getrusage(RUSAGE_CHILDREN, &usage);
+        return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0
+             + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+    }
+
+    bool run(const std::string &command)
+    {
+        return std::system(command.c_str()) == 0;
+    }
+
+    bool check(const std::string &output, const std::string &expectedFile, bool &checked)
+    {
+        bool found;
+        auto expected = readFile(expectedFile, found);
+        checked = found;
+        if(!found)
+        {
+            return true;
+        }
+        if(expected.compare(0, 8, "fnv1a64 ") == 0)
+        {
+            std::istringstream in(expected.substr(8));
+            std::string hash;
+            long bytes = -1;
+            in >> hash >> bytes;
+            return hash == fnv1a(output) && bytes == (long)output.size();
+        }
+        return expected == output;
+    }
+
+    void measure(const Options &options, const std::string &file, KernelResult &result)
+    {
+        auto base = file.substr(file.find_last_of('/') + 1);
+        result.name = base.substr(0, base.rfind(".java"));
+        auto prefix = options.work + "/" + result.name;
+        auto log = " > " + prefix + ".log 2>&1";
+
+        // ycc writes ycc.ll into the working directory
+        std::remove("ycc.ll");
+        auto begin = std::chrono::steady_clock::now();
+        bool compiled = run(options.ycc + " " + file + log);
+        auto end = std::chrono::steady_clock::now();
+        result.compileMs = std::chrono::duration<double, std::milli>(end - begin).count();
+        if(!compiled || std::rename("ycc.ll", (prefix + ".ll").c_str()) != 0)
+        {
+            result.status = "ycc failed";
+            return ;
+        }
+        result.irBytes = fileSize(prefix + ".ll");
+
+        if(!run(options.llc + " " + options.llcFlags + " -relocation-model=pic -filetype=obj "
+                 + prefix + ".ll -o " + prefix + ".o" + log))
+        {
+            result.status = "llc failed";
+            return ;
+        }
+        if(!run(options.cc + " " + prefix + ".o -o " + prefix + log))
+        {
+            result.status = "link failed";
+            return ;
+        }
+        result.binaryBytes = fileSize(prefix);
+
+        for(int i = 0; i < options.runs; i++)
+        {
+            double cpu = childCpuMs();
+            auto begin = std::chrono::steady_clock::now();
+            bool ok = run(prefix + " > " + prefix + ".out");
+            auto end = std::chrono::steady_clock::now();
+            result.wallMs.push_back(std::chrono::duration<double, std::milli>(end - begin).count());
+            result.cpuMs.push_back(childCpuMs() - cpu);
+            if(!ok)
+            {
+                result.status = "run failed";
+                return ;
+            }
+        }
+
+        bool found, checked;
+        auto output = readFile(prefix + ".out", found);
+        auto expected = file.substr(0, file.rfind(".java")) + ".expected";
+        if(!check(output, expected, checked))
+        {
+            result.status = "wrong";
+        }
+        else if(!checked)
+        {
+            result.status = "unchecked";
+        }
+    }
+
+    void report(std::ostream &out, const Options &options, const std::vector<KernelResult> &results)
+    {
+        out << "{\n  \"ycc\": \"" << options.ycc << "\",\n  \"llc_flags\": \"" << options.llcFlags
+            << "\",\n  \"runs\": " << options.runs << ",\n  \"kernels\": [";
+        for(size_t i = 0; i < results.size(); i++)
+        {
+            auto &result = results[i];
+            auto fastest = result.wallMs.empty() ? 0 : *std::min_element(result.wallMs.begin(), result.wallMs.end());
+            out << (i ? ",\n" : "\n")
+                << "    {\"kernel\": \"" << result.name << "\", \"status\": \"" << result.status << "\""
+                << ", \"compile_ms\": " << fixed(result.compileMs)
+                << ", \"ir_bytes\": " << result.irBytes
+                << ", \"binary_bytes\": " << result.binaryBytes
+                << ", \"run_ms\": " << fixed(median(result.wallMs))
+                << ", \"run_ms_min\": " << fixed(fastest)
+                << ", \"cpu_ms\": " << fixed(median(result.cpuMs)) << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    std::vector<std::string> files;
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if(arg.compare(0, 6, "--ycc=") == 0)            options.ycc = arg.substr(6);
+        else if(arg.compare(0, 6, "--llc=") == 0)       options.llc = arg.substr(6);
+        else if(arg.compare(0, 5, "--cc=") == 0)        options.cc = arg.substr(5);
+        else if(arg.compare(0, 12, "--llc-flags=") == 0) options.llcFlags = arg.substr(12);
+        else if(arg.compare(0, 7, "--work=") == 0)      options.work = arg.substr(7);
+        else if(arg.compare(0, 6, "--out=") == 0)       options.output = arg.substr(6);
+        else if(arg.compare(0, 7, "--runs=") == 0)      options.runs = std::max(1, std::atoi(arg.c_str() + 7));
+        else if(arg[0] == '-')
+        {
+            std::cerr << "usage: run_bench [--ycc=<path>] [--llc=<path>] [--cc=<path>] [--llc-flags=<flags>]\n"
+                      << "                 [--runs=R] [--work=<dir>] [--out=<file>] <kernel.java>..." << std::endl;
+            return 1;
+        }
+        else files.push_back(arg);
+    }
+
+    mkdir(options.work.c_str(), 0755);
+    std::vector<KernelResult> results(files.size());
+    int status = 0;
+    for(size_t i = 0; i < files.size(); i++)
+    {
+        measure(options, files[i], results[i]);
+        std::cerr << "run_bench: " << results[i].name << " " << results[i].status << ", "
+                  << fixed(median(results[i].wallMs)) << " ms" << std::endl;
+        if(results[i].status != "ok" && results[i].status != "unchecked")
+        {
+            status = 1;
+        }
+    }
+
+    if(options.output.empty())
+    {
+        report(std::cout, options, results);
+    }
+    else
+    {
+        std::ofstream out(options.output);
+        report(out, options, results);
+    }
+    return status;
+}
@@ -0,0 +1,347 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+#include "compile_cache.h"
+
+namespace ycc
+{
+    static bool readFile(const std::string &path, std::string &data)
+    {
+        std::ifstream in(path, std::ios::in | std::ios::binary);
+        if(!in)
+        {
+            return false;
+        }
+        std::ostringstream buffer;
+        buffer << in.rdbuf();
+        data = buffer.str();
+        return true;
+    }
+
+    static std::string toHex(uint64_t value)
+    {
+        char buffer[17];
+        std::snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long)value);
+        return buffer;
+    }
+
+    CompileCache::CompileCache(const std::string &dir, long maxBytes /* = 64M */)
+        : dir_(dir), maxBytes_(maxBytes), enabled_(true), stats_{0, 0, 0, 0}, pending_{0, 0, 0, 0}
+    {
+        // create every missing directory of the path
+        for(size_t pos = 1; pos <= dir_.size(); pos++)
+        {
+            if(pos == dir_.size() || dir_[pos] == '/')
+            {
+                mkdir(dir_.substr(0, pos).c_str(), 0755);
+            }
+        }
+        struct stat st;
+        if(stat(dir_.c_str(), &st) != 0 || !S_ISDIR(st.st_mode))
+        {
+            std::cerr << "ycc: warning: cache directory " << dir_
+                      << " is not available, cache disabled" << std::endl;
+            enabled_ = false;
+            return ;
+        }
+        loadStats();
+    }
+
+    // FNV-1a
+    uint64_t CompileCache::hash(const std::string &data, uint64_t seed /* = FNV offset basis */)
+    {
+        uint64_t h = seed;
+        for(unsigned char c : data)
+        {
+            h ^= c;
+            h *= 0x100000001b3ULL;
+        }
+        return h;
+    }
+
+    // names of the modules in "import name;" lines, the same api files the
+    // parser will load
+    std::vector<std::string> CompileCache::importedModules(const std::string &source)
+    {
+        std::vector<std::string> modules;
+        std::istringstream in(source);
+        std::string word;
+        while(in >> word)
+        {
+            if(word != "import")
+            {
+                continue;
+            }
+            std::string name;
+            if(!(in >> name))
+            {
+                break;
+            }
+            while(!name.empty() && !std::isalnum((unsigned char)name.back()) && name.back() != '_')
+            {
+                name.pop_back();
+            }
+            if(!name.empty())
+            {
+                modules.push_back(name);
+            }
+        }
+        return modules;
+    }
+
+    std::string CompileCache::key(const std::string &srcFileName, const std::string &salt,
+                                  const std::string &apiDir /* = "./api" */)
+    {
+        // two differently seeded 64 bit hashes make a 128 bit key
+        uint64_t h1 = hash(salt);
+        uint64_t h2 = hash(salt, 0x84222325cbf29ce4ULL);
+
+        // the diagnostics of an entry name the file as it was given
+        h1 = hash(srcFileName + "\n", h1);
+        h2 = hash(srcFileName + "\n", h2);
+
+        std::string source;
+        readFile(srcFileName, source);
+        h1 = hash(source, h1);
+        h2 = hash(source, h2);
+
+        for(auto name : importedModules(source))
+        {
+            // the backend links the .bc instead of the .vm if there is one
+            for(auto ext : {".ycc", ".vm", ".bc"})
+            {
+                std::string module;
+                readFile(apiDir + "/" + name + ext, module);
+                auto moduleHash = toHex(hash(module));
+                h1 = hash(name + ext + moduleHash, h1);
+                h2 = hash(name + ext + moduleHash, h2);
+            }
+        }
+        return toHex(h1) + toHex(h2);
+    }
+
+    std::string CompileCache::entryPath(const std::string &key) const
+    {
+        return dir_ + "/" + key + ".entry";
+    }
+
+    // entry file: "ycc-cache <status> <ir size> <diagnostics size> <warnings size> <report size>\n"
+    // ir diagnostics warnings report
+    bool CompileCache::lookup(const std::string &key, CacheEntry &entry)
+    {
+        if(!enabled_)
+        {
+            return false;
+        }
+
+        auto path = entryPath(key);
+        std::string data;
+        std::string magic;
+        size_t irSize = 0, diagSize = 0, warnSize = 0, reportSize = 0;
+        bool hit = readFile(path, data);
+        if(hit)
+        {
+            std::istringstream header(data.substr(0, data.find('\n')));
+            hit = (header >> magic >> entry.status >> irSize >> diagSize >> warnSize >> reportSize)
+                  && magic == "ycc-cache";
+        }
+        size_t begin = data.find('\n') + 1;
+        if(hit && begin + irSize + diagSize + warnSize + reportSize == data.size())
+        {
+            entry.ir = data.substr(begin, irSize);
+            entry.diagnostics = data.substr(begin + irSize, diagSize);
+            entry.warnings = data.substr(begin + irSize + diagSize, warnSize);
+            entry.report = data.substr(begin + irSize + diagSize + warnSize, reportSize);
+            utime(path.c_str(), nullptr);       // mark as recently used
+            pending_.hits++;
+        }
+        else
+        {
+            hit = false;
+            pending_.misses++;
+        }
+        saveStats();
+        return hit;
+    }
+
+    void CompileCache::store(const std::string &key, const CacheEntry &entry)
+    {
+        if(!enabled_)
+        {
+            return ;
+        }
+
+        // write aside and rename, so a concurrent reader never sees half an entry
+        auto path = entryPath(key);
+        auto tmpPath = path + ".tmp" + std::to_string(getpid());
+        std::ofstream out(tmpPath, std::ios::out | std::ios::binary);
+        out << "ycc-cache " << entry.status << " " << entry.ir.size() << " "
+            << entry.diagnostics.size() << " " << entry.warnings.size() << " " << entry.report.size() << "\n"
+            << entry.ir << entry.diagnostics << entry.warnings << entry.report;
+        out.close();
+        if(!out || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+        {
+            std::remove(tmpPath.c_str());
+            return ;
+        }
+        pending_.stores++;
+        evict();
+        saveStats();
+    }
+
+    // drop least recently used entries until the cache fits in maxBytes_
+    void CompileCache::evict()
+    {
+        struct File
+        {
+            std::string     path;
+            long            size;
+            time_t          usedAt;
+        };
+        std::vector<File> files;
+        long total = 0;
+
+        DIR *dir = opendir(dir_.c_str());
+        if(!dir)
+        {
+            return ;
+        }
+        while(auto ent = readdir(dir))
+        {
+            std::string name = ent->d_name;
+            if(name.size() < 6 || name.substr(name.size() - 6) != ".entry")
+            {
+                continue;
+            }
+            struct stat st;
+            auto path = dir_ + "/" + name;
+            if(stat(path.c_str(), &st) == 0)
+            {
+                files.push_back(File{path, (long)st.st_size, st.st_mtime});
+                total += st.st_size;
+            }
+        }
+        closedir(dir);
+
+        std::sort(files.begin(), files.end(), [](const File &a, const File &b)
+        {
+            return a.usedAt < b.usedAt;
+        });
+        for(auto &file : files)
+        {
+            if(total <= maxBytes_)
+            {
+                break;
+            }
+            if(std::remove(file.path.c_str()) == 0)
+            {
+                total -= file.size;
+                pending_.evictions++;
+            }
+        }
+    }
+
+    void CompileCache::loadStats()
+    {
+        stats_ = CacheStats{0, 0, 0, 0};
+        std::ifstream in(dir_ + "/stats");
+        std::string name;
+        long value;
+        while(in >> name >> value)
+        {
+            if(name == "hits")              stats_.hits = value;
+            else if(name == "misses")       stats_.misses = value;
+            else if(name == "stores")       stats_.stores = value;
+            else if(name == "evictions")    stats_.evictions = value;
+        }
+    }
+
+    // add the counts of this process to the saved ones; the lock keeps
+    // concurrent compilations from writing over each other's counts
+    void CompileCache::saveStats()
+    {
+        int lock = open((dir_ + "/stats.lock").c_str(), O_RDWR | O_CREAT, 0644);
+        if(lock < 0 || flock(lock, LOCK_EX) != 0)
+        {
+            if(lock >= 0)
+            {
+                close(lock);
+            }
+            return ;
+        }
+        loadStats();
+        stats_.hits += pending_.hits;
+        stats_.misses += pending_.misses;
+        stats_.stores += pending_.stores;
+        stats_.evictions += pending_.evictions;
+
+        auto path = dir_ + "/stats";
+        auto tmpPath = path + ".tmp" + std::to_string(getpid());
+        std::ofstream out(tmpPath);
+        out << "hits " << stats_.hits << "\n"
+            << "misses " << stats_.misses << "\n"
+            << "stores " << stats_.stores << "\n"
+            << "evictions " << stats_.evictions << "\n";
+        out.close();
+        if(out && std::rename(tmpPath.c_str(), path.c_str()) == 0)
+        {
+            pending_ = CacheStats{0, 0, 0, 0};
+        }
+        else
+        {
+            std::remove(tmpPath.c_str());
+        }
+        flock(lock, LOCK_UN);
+        close(lock);
+    }
+
+    StreamCapture::StreamCapture(std::ostream &stream)
+        : stream_(stream), target_(stream.rdbuf(this))
+    {
+    }
+
+    StreamCapture::~StreamCapture()
+    {
+        stream_.rdbuf(target_);
+    }
+
+    int StreamCapture::overflow(int c)
+    {
+        if(c == traits_type::eof())
+        {
+            return traits_type::not_eof(c);
+        }
+        text_ += traits_type::to_char_type(c);
+        return target_->sputc(traits_type::to_char_type(c));
+    }
+
+    std::streamsize StreamCapture::xsputn(const char *s, std::streamsize n)
+    {
+        text_.append(s, n);
+        return target_->sputn(s, n);
+    }
+
+    int StreamCapture::sync()
+    {
+        return target_->pubsync();
+    }
+
+    void CompileCache::dumpStats(std::ostream &out /* = std::cout */) const
+    {
+        long lookups = stats_.hits + stats_.misses;
+        out << "ycc cache " << dir_ << ":\n"
+            << "  hits       " << stats_.hits << "\n"
+            << "  misses     " << stats_.misses << "\n"
+            << "  hit rate   " << (lookups ? 100 * stats_.hits / lookups : 0) << "%\n"
+            << "  stores     " << stats_.stores << "\n"
+            << "  evictions  " << stats_.evictions << "\n";
+    }
+}
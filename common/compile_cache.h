@@ -0,0 +1,99 @@
+#ifndef COMPILE_CACHE_H_
+#define COMPILE_CACHE_H_
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace ycc
+{
+    // result of one compilation, what a cache hit gives back
+    struct CacheEntry
+    {
+        int                 status;         // exit status of the compilation
+        std::string         ir;             // generated IR, empty on error
+        std::string         diagnostics;    // reported warnings and errors
+        std::string         warnings;       // written to stderr, as an unusable profile
+        std::string         report;         // lines of the passes, as the loops --unroll changed
+    };
+
+    struct CacheStats
+    {
+        long                hits;
+        long                misses;
+        long                stores;
+        long                evictions;
+    };
+
+    /*
+     * On-disk compilation cache. An entry is keyed by a hash of the source
+     * file name and bytes, the hashes of the imported api modules and a
+     * salt (compiler version and options). Entries are evicted least recently used first
+     * when the cache grows over its size limit.
+     */
+    class CompileCache
+    {
+      public:
+        explicit            CompileCache(const std::string &dir, long maxBytes = 64L << 20);
+
+        static std::string  key(const std::string &srcFileName, const std::string &salt,
+                                const std::string &apiDir = "./api");
+        bool                lookup(const std::string &key, CacheEntry &entry);
+        void                store(const std::string &key, const CacheEntry &entry);
+        void                evict();
+
+        const CacheStats &  stats() const;
+        void                dumpStats(std::ostream &out = std::cout) const;
+
+        static uint64_t     hash(const std::string &data, uint64_t seed = 0xcbf29ce484222325ULL);
+        static std::vector<std::string> importedModules(const std::string &source);
+
+      private:
+        std::string         entryPath(const std::string &key) const;
+        void                loadStats();
+        void                saveStats();
+
+      private:
+        std::string         dir_;
+        long                maxBytes_;
+        bool                enabled_;
+        CacheStats          stats_;         // totals of every process, as last saved
+        CacheStats          pending_;       // counts of this process not saved yet
+    };
+
+    inline const CacheStats & CompileCache::stats() const
+    {
+        return stats_;
+    }
+
+    /*
+     * Keeps a copy of what is written to a stream while it is attached,
+     * so the warnings of a compilation can be stored with its result.
+     */
+    class StreamCapture : public std::streambuf
+    {
+      public:
+        explicit            StreamCapture(std::ostream &stream);
+                            ~StreamCapture();
+
+        const std::string & text() const;
+
+      protected:
+        int                 overflow(int c) override;
+        std::streamsize     xsputn(const char *s, std::streamsize n) override;
+        int                 sync() override;
+
+      private:
+        std::ostream &      stream_;
+        std::streambuf *    target_;
+        std::string         text_;
+    };
+
+    inline const std::string & StreamCapture::text() const
+    {
+        return text_;
+    }
+}
+
+#endif
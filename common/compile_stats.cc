@@ -0,0 +1,196 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+#include <sys/resource.h>
+#include "compile_stats.h"
+#include "trace.h"
+
+// count every allocation of the process, the phases report the differences;
+// only while a report is asked for, the counters are shared by all threads
+static std::atomic<bool> allocationCounting(false);
+static std::atomic<long> allocationCount(0);
+static std::atomic<long> allocationBytes(0);
+
+void *operator new(std::size_t size)
+{
+    if(allocationCounting.load(std::memory_order_relaxed))
+    {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        allocationBytes.fetch_add(size, std::memory_order_relaxed);
+    }
+    if(void *p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+namespace ycc
+{
+    static std::string fixed(double value)
+    {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.3f", value);
+        return buffer;
+    }
+
+    CompileStats * CompileStats::instance_ = nullptr;
+
+    CompileStats * CompileStats::getInstance()
+    {
+        if(instance_ == nullptr)
+        {
+            instance_ = new CompileStats();
+        }
+        return instance_;
+    }
+
+    void CompileStats::countAllocations(bool count)
+    {
+        allocationCounting.store(count, std::memory_order_relaxed);
+    }
+
+    long CompileStats::allocations()
+    {
+        return allocationCount.load(std::memory_order_relaxed);
+    }
+
+    long CompileStats::allocatedBytes()
+    {
+        return allocationBytes.load(std::memory_order_relaxed);
+    }
+
+    long CompileStats::peakRSS()
+    {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    CompileStats::Mark CompileStats::now()
+    {
+        using namespace std::chrono;
+        auto wall = duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+        auto cpu = 1000.0 * std::clock() / CLOCKS_PER_SEC;
+        return Mark{wall, cpu, peakRSS(), allocations(), allocatedBytes(),
+                    Tracer::enabled() ? Tracer::now() : -1};
+    }
+
+    void CompileStats::beginPhase(const std::string &name)
+    {
+        open_.push_back(std::make_pair(name, now()));
+    }
+
+    void CompileStats::endPhase()
+    {
+        if(open_.empty())
+        {
+            return ;
+        }
+        auto end = now();
+        auto &begin = open_.back().second;
+        phases_.push_back(PhaseStats{open_.back().first,
+                                     end.wallMs - begin.wallMs,
+                                     end.cpuMs - begin.cpuMs,
+                                     end.rssKB - begin.rssKB,
+                                     end.allocations - begin.allocations,
+                                     end.allocBytes - begin.allocBytes});
+        if(begin.traceUs >= 0 && end.traceUs >= 0)
+        {
+            Tracer::record("phase", open_.back().first, begin.traceUs, end.traceUs);
+        }
+        open_.pop_back();
+    }
+
+    void CompileStats::setCounter(const std::string &name, long value)
+    {
+        for(auto &counter : counters_)
+        {
+            if(counter.first == name)
+            {
+                counter.second = value;
+                return ;
+            }
+        }
+        counters_.push_back(std::make_pair(name, value));
+    }
+
+    void CompileStats::addCounter(const std::string &name, long value /* = 1 */)
+    {
+        for(auto &counter : counters_)
+        {
+            if(counter.first == name)
+            {
+                counter.second += value;
+                return ;
+            }
+        }
+        counters_.push_back(std::make_pair(name, value));
+    }
+
+    void CompileStats::report(const std::string &fileName, std::ostream &out /* = std::cout */) const
+    {
+        char line[160];
+        out << "ycc time report for " << fileName << ":\n";
+        std::snprintf(line, sizeof(line), "  %-16s %10s %10s %10s %10s %12s\n",
+                      "phase", "wall ms", "cpu ms", "rss +KB", "allocs", "alloc KB");
+        out << line;
+
+        PhaseStats total{"total", 0, 0, 0, 0, 0};
+        for(auto &phase : phases_)
+        {
+            std::snprintf(line, sizeof(line), "  %-16s %10.3f %10.3f %10ld %10ld %12ld\n",
+                          phase.name.c_str(), phase.wallMs, phase.cpuMs, phase.rssKB,
+                          phase.allocations, phase.allocBytes / 1024);
+            out << line;
+            total.wallMs += phase.wallMs;
+            total.cpuMs += phase.cpuMs;
+            total.rssKB += phase.rssKB;
+            total.allocations += phase.allocations;
+            total.allocBytes += phase.allocBytes;
+        }
+        std::snprintf(line, sizeof(line), "  %-16s %10.3f %10.3f %10ld %10ld %12ld\n",
+                      total.name.c_str(), total.wallMs, total.cpuMs, total.rssKB,
+                      total.allocations, total.allocBytes / 1024);
+        out << line;
+        out << "  peak rss " << peakRSS() << " KB\n";
+
+        out << "counters:\n";
+        for(auto &counter : counters_)
+        {
+            std::snprintf(line, sizeof(line), "  %-28s %12ld\n", counter.first.c_str(), counter.second);
+            out << line;
+        }
+    }
+
+    void CompileStats::reportJson(const std::string &fileName, std::ostream &out /* = std::cout */) const
+    {
+        out << "{\n  \"file\": " << jsonString(fileName) << ",\n  \"phases\": [";
+        for(size_t i = 0; i < phases_.size(); i++)
+        {
+            auto &phase = phases_[i];
+            out << (i ? ",\n" : "\n")
+                << "    {\"name\": " << jsonString(phase.name)
+                << ", \"wall_ms\": " << fixed(phase.wallMs)
+                << ", \"cpu_ms\": " << fixed(phase.cpuMs)
+                << ", \"rss_kb\": " << phase.rssKB
+                << ", \"allocations\": " << phase.allocations
+                << ", \"alloc_bytes\": " << phase.allocBytes << "}";
+        }
+        out << "\n  ],\n  \"peak_rss_kb\": " << peakRSS() << ",\n  \"counters\": {";
+        for(size_t i = 0; i < counters_.size(); i++)
+        {
+            out << (i ? ",\n" : "\n") << "    " << jsonString(counters_[i].first)
+                << ": " << counters_[i].second;
+        }
+        out << "\n  }\n}\n";
+    }
+}
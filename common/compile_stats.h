@@ -0,0 +1,74 @@
+#ifndef COMPILE_STATS_H_
+#define COMPILE_STATS_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace ycc
+{
+    // cost of one compiler phase
+    struct PhaseStats
+    {
+        std::string         name;
+        double              wallMs;
+        double              cpuMs;          // all threads of the process
+        long                rssKB;          // growth of the peak resident set
+        long                allocations;    // operator new calls
+        long                allocBytes;
+    };
+
+    /*
+     * Per-phase time and memory report of one compilation (--time-report,
+     * --stats). Phases are measured between beginPhase and endPhase, counters
+     * are set by whoever knows the number (tokens, AST nodes, symbols, IR).
+     * While tracing, every phase is a trace span too.
+     */
+    class CompileStats
+    {
+      public:
+        static CompileStats *   getInstance();
+
+        void                beginPhase(const std::string &name);
+        void                endPhase();
+        void                setCounter(const std::string &name, long value);
+        void                addCounter(const std::string &name, long value = 1);
+
+        const std::vector<PhaseStats> & phases() const;
+        void                report(const std::string &fileName, std::ostream &out = std::cout) const;
+        void                reportJson(const std::string &fileName, std::ostream &out = std::cout) const;
+
+        static void         countAllocations(bool count);
+        static long         allocations();
+        static long         allocatedBytes();
+        static long         peakRSS();      // KB
+
+      private:
+        CompileStats(){}
+
+        struct Mark
+        {
+            double          wallMs;
+            double          cpuMs;
+            long            rssKB;
+            long            allocations;
+            long            allocBytes;
+            long long       traceUs;        // -1 unless tracing
+        };
+        static Mark         now();
+
+      private:
+        std::vector<PhaseStats>                         phases_;
+        std::vector<std::pair<std::string, Mark>>       open_;      // nested phases
+        std::vector<std::pair<std::string, long>>       counters_;  // in insertion order
+
+        static CompileStats *   instance_;
+    };
+
+    inline const std::vector<PhaseStats> & CompileStats::phases() const
+    {
+        return phases_;
+    }
+}
+
+#endif
@@ -41,11 +41,11 @@ namespace ycc
         return instance_;
     }
 
-    void ExceptionHandler::report()
+    void ExceptionHandler::report(std::ostream &out /* = std::cout */)
     {
         for(auto e : exceptionList_)
         {
-            std::cout << e.toString() << std::endl;
+            out << e.toString() << std::endl;
         }
 
     }
@@ -1,6 +1,7 @@
 #ifndef ERROR_H_
 #define ERROR_H_
 
+#include <iostream>
 #include <string>
 #include <vector>
 #include "../lexer/token.h"
@@ -31,7 +32,7 @@ namespace ycc
     {
       public:
         static ExceptionHandler *   getInstance();
-        void                        report();
+        void                        report(std::ostream &out = std::cout);
         bool                        hasError() const;
         void                        add(Exception e);
         void                        add(const std::string &msg,
@@ -1,6 +1,9 @@
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include "symbol_table.h"
+#include "trace.h"
 
 
 using std::cout;
@@ -171,6 +174,61 @@ namespace ycc
         }
     }
 
+    /*
+     * The instance variables by alignment, largest first, so that no field
+     * needs padding before it. With hot, the most used fields come first
+     * and share the first cache line of an object, which may cost padding.
+     */
+    void ClassTable::layout(bool hot)
+    {
+        auto symbolTable = SymbolTable::getInstance();
+        std::vector<std::pair<std::string, int>> fields;
+        for(auto &line : variableTable_)
+        {
+            if(!line.second.check(SymbolTag::STATIC) && !line.second.check(SymbolTag::CLASS))
+            {
+                fields.push_back(std::make_pair(line.first, symbolTable->alignOf(line.second.getType())));
+            }
+        }
+        auto heat = [this](const std::string &name)
+        {
+            auto iter = heat_.find(name);
+            return iter == heat_.end() ? 0L : iter->second;
+        };
+        std::stable_sort(fields.begin(), fields.end(),
+            [&](const std::pair<std::string, int> &a, const std::pair<std::string, int> &b)
+            {
+                if(hot && heat(a.first) != heat(b.first))
+                {
+                    return heat(a.first) > heat(b.first);
+                }
+                return a.second > b.second;
+            });
+        fields_.clear();
+        for(auto &field : fields)
+        {
+            fields_.push_back(field.first);
+        }
+    }
+
+    // -1 if name is no instance variable of this class
+    int ClassTable::fieldIndex(const std::string &name) const
+    {
+        for(size_t i = 0; i < fields_.size(); i++)
+        {
+            if(fields_[i] == name)
+            {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    void ClassTable::addHeat(const std::string &name, long heat)
+    {
+        heat_[name] += heat;
+    }
+
 
     void ClassTable::dump()
     {
@@ -191,6 +249,7 @@ namespace ycc
     * SymbolTable
     ********************************************************/
     SymbolTable * SymbolTable::instance_ = nullptr;
+    thread_local SymbolTable::Scope SymbolTable::scope_;
 
     SymbolTable * SymbolTable::getInstance()
     {
@@ -201,10 +260,17 @@ namespace ycc
         return instance_;
     }
 
+    // start over with the built-in types only (compile server, when the api changed)
+    void SymbolTable::reset()
+    {
+        delete instance_;
+        instance_ = nullptr;
+    }
+
     SymbolTable::SymbolTable()
     {
-        currentClass_ = new ClassTable("global");
-        globalTable_ = currentClass_;
+        scope_.currentClass_ = new ClassTable("global");
+        globalTable_ = scope_.currentClass_;
 
         addType(TypeInfo::VOID);
         addType(TypeInfo::BOOLEAN);
@@ -271,6 +337,20 @@ namespace ycc
         {
             return "float";
         }
+        else if(typeInfoTable_[typeIndex] == TypeInfo::BOOLEAN)
+        {
+            return "i1";
+        }
+        else if(typeInfoTable_[typeIndex].isArray())
+        {
+            // java arrays: the length, then the elements
+            return "{ i32, [0 x " + getTypeIR(typeInfoTable_[typeIndex].arrayOf()) + "] }*";
+        }
+        else if(isClass(typeIndex))
+        {
+            // objects are references to the struct of their fields
+            return "%class." + typeInfoTable_[typeIndex].getName() + "*";
+        }
         else
         {
             typeIR = "i" + std::to_string(typeInfoTable_[typeIndex].getWidth()*8);
@@ -299,58 +379,99 @@ namespace ycc
 
 
     // class operations
+    bool SymbolTable::isClass(int typeIndex) const
+    {
+        return classesTable_.find(typeInfoTable_[typeIndex].getName()) != classesTable_.end();
+    }
+
+    // references are pointers, everything else is aligned to its width
+    int SymbolTable::alignOf(int typeIndex) const
+    {
+        auto &type = typeInfoTable_[typeIndex];
+        if(isClass(typeIndex) || type.arrayOf() >= 0)
+        {
+            return 8;
+        }
+        return type.getWidth() > 0 ? type.getWidth() : 1;
+    }
+
     void SymbolTable::addClass(const std::string &name, int modifier /*=0*/)
     {
         int type = addType(name);
         SymbolInfo info(type, modifier);
         info.setAttribute(SymbolTag::CLASS);
-        currentClass_->add(name, info);
+        scope_.currentClass_->add(name, info);
+
+        scope_.currentClass_ = new ClassTable(name, scope_.currentClass_);
+        classesTable_.insert(std::pair<std::string, ClassTable*>(name, scope_.currentClass_));
+    }
 
-        currentClass_ = new ClassTable(name, currentClass_);
-        classesTable_.insert(std::pair<std::string, ClassTable*>(name, currentClass_));
+    // table of a class by name, null if there is no such class
+    const ClassTable * SymbolTable::getClassTable(const std::string &name) const
+    {
+        auto iter = classesTable_.find(name);
+        return iter == classesTable_.end() ? nullptr : iter->second;
+    }
+
+    void SymbolTable::addFieldHeat(const std::string &className, const std::string &name, long heat)
+    {
+        auto iter = classesTable_.find(className);
+        if(iter != classesTable_.end())
+        {
+            iter->second->addHeat(name, heat);
+        }
+    }
+
+    // fields of every class, before any code uses them
+    void SymbolTable::layoutClasses(bool hot)
+    {
+        for(auto &line : classesTable_)
+        {
+            line.second->layout(hot);
+        }
     }
 
     // current class operations
     void SymbolTable::enterClass(const std::string &name)
     {
-        currentClass_ = classesTable_.find(name)->second;
+        scope_.currentClass_ = classesTable_.find(name)->second;
     }
 
     void SymbolTable::leaveClass()
     {
-        currentClass_ = currentClass_->prec();
+        scope_.currentClass_ = scope_.currentClass_->prec();
     }
 
     void SymbolTable::add(const std::string &name, MethodInfo info)
     {
         info.setFullName(getQualifier()+name);
-        currentClass_->add(name, info);
+        scope_.currentClass_->add(name, info);
     }
 
     bool SymbolTable::hasMethod(const std::string &name, bool searchUp) const
     {
-        return currentClass_->hasMethod(name, searchUp);
+        return scope_.currentClass_->hasMethod(name, searchUp);
     }
 
     const MethodInfo & SymbolTable::getMethodInfo(const std::string &name) const
     {
-        return currentClass_->getMethodInfo(name);
+        return scope_.currentClass_->getMethodInfo(name);
     }
 
     void SymbolTable::setMethodInfo(const std::string &name, const MethodInfo &info)
     {
-        currentClass_->setMethodInfo(name, info);
+        scope_.currentClass_->setMethodInfo(name, info);
     }
 
     // current table operations
     void SymbolTable::add(const std::string &name, SymbolInfo info)
     {
         // member variable
-        if(baseStack_.empty())
+        if(scope_.baseStack_.empty())
         {
             // class member
             info.setFullName(getQualifier()+name);
-            currentClass_->add(name, info);
+            scope_.currentClass_->add(name, info);
             if(info.check(SymbolTag::STATIC))
             {
                 addStatic(info.getFullName(), info);
@@ -359,9 +480,9 @@ namespace ycc
         }
 
         // local variable
-        info.setFullName(getQualifier(currentMethod_)+name);
-        subroutineTable_.push_back(name);
-        localInfoTable_.push_back(info);
+        info.setFullName(getQualifier(scope_.currentMethod_)+name);
+        scope_.subroutineTable_.push_back(name);
+        scope_.localInfoTable_.push_back(info);
         if(info.check(SymbolTag::STATIC))
         {
             addStatic(info.getFullName(), info);
@@ -370,48 +491,48 @@ namespace ycc
 
     bool SymbolTable::hasVariable(const std::string &name, bool searchUp) const
     {
-        for(int i = subroutineTable_.size()-1; i >= 0; i--)
+        for(int i = scope_.subroutineTable_.size()-1; i >= 0; i--)
         {
-            if(subroutineTable_[i] == name)
+            if(scope_.subroutineTable_[i] == name)
             {
                 return true;
             }
         }
-        return searchUp ? currentClass_->hasVariable(name, searchUp) : false;
+        return searchUp ? scope_.currentClass_->hasVariable(name, searchUp) : false;
     }
 
     const SymbolInfo &SymbolTable::getVariableInfo(const std::string &name) const
     {
-        for(int i = subroutineTable_.size()-1; i >= 0; i--)
+        for(int i = scope_.subroutineTable_.size()-1; i >= 0; i--)
         {
-            if(subroutineTable_[i] == name)
+            if(scope_.subroutineTable_[i] == name)
             {
-                return localInfoTable_[i];
+                return scope_.localInfoTable_[i];
             }
         }
-        return currentClass_->getVariableInfo(name);
+        return scope_.currentClass_->getVariableInfo(name);
     }
 
     void SymbolTable::setVariableInfo(const std::string &name, const SymbolInfo &info)
     {
-        for(int i = subroutineTable_.size()-1; i >= 0; i--)
+        for(int i = scope_.subroutineTable_.size()-1; i >= 0; i--)
         {
-            if(subroutineTable_[i] == name)
+            if(scope_.subroutineTable_[i] == name)
             {
-                localInfoTable_[i] = info;
+                scope_.localInfoTable_[i] = info;
                 return ;
             }
         }
 
-        currentClass_->setVariableInfo(name, info);
+        scope_.currentClass_->setVariableInfo(name, info);
     }
 
 
     void SymbolTable::enter(const std::string &methodName)
     {
-        baseStack_.clear();
-        baseStack_.push_back(0);
-        currentMethod_ = methodName;
+        scope_.baseStack_.clear();
+        scope_.baseStack_.push_back(0);
+        scope_.currentMethod_ = methodName;
 
         //cout << "enter new method " << methodName << ":\n"; // for debug
 
@@ -430,38 +551,38 @@ namespace ycc
 
     void SymbolTable::enter()
     {
-        if(baseStack_.empty())
+        if(scope_.baseStack_.empty())
         {
             return ;
         }
 
-        baseStack_.push_back(subroutineTable_.size());
+        scope_.baseStack_.push_back(scope_.subroutineTable_.size());
     }
 
     void SymbolTable::leave()
     {
-        if(baseStack_.empty())
+        if(scope_.baseStack_.empty())
         {
             return ;
         }
 
-        while(subroutineTable_.size() > baseStack_.back())
+        while(scope_.subroutineTable_.size() > scope_.baseStack_.back())
         {
             /*
-            cout << subroutineTable_.back() << " -> "
-                 << localInfoTable_.back().toString() << endl;
+            cout << scope_.subroutineTable_.back() << " -> "
+                 << scope_.localInfoTable_.back().toString() << endl;
             */
 
-            subroutineTable_.pop_back();
-            localInfoTable_.pop_back();
+            scope_.subroutineTable_.pop_back();
+            scope_.localInfoTable_.pop_back();
         }
 
-        baseStack_.pop_back();
+        scope_.baseStack_.pop_back();
         /*
-        if(baseStack_.empty())
+        if(scope_.baseStack_.empty())
         {
             cout << "---------------------------------" << endl;
-            cout << "exit " << currentMethod_ << endl << endl;
+            cout << "exit " << scope_.currentMethod_ << endl << endl;
         }
         */
     }
@@ -471,12 +592,20 @@ namespace ycc
 
     void SymbolTable::addStatic(const std::string &name, const SymbolInfo &info)
     {
+        std::lock_guard<std::mutex> lock(staticMutex_);
         staticTable_.insert(std::pair<std::string, SymbolInfo>(name, info));
     }
 
+    // value is an LLVM constant of the type of the static
+    void SymbolTable::setStaticValue(const std::string &name, const std::string &value)
+    {
+        std::lock_guard<std::mutex> lock(staticMutex_);
+        staticValues_[name] = value;
+    }
+
     std::string SymbolTable::getQualifier()
     {
-        auto table = currentClass_;
+        auto table = scope_.currentClass_;
         std::string qual = "";
         while(table->prec())
         {
@@ -517,7 +646,7 @@ namespace ycc
         int pos = 0;
         for(int i = 5; i < name.size(); i++)
         {
-            pos = pos * 10 + i - '0';
+            pos = pos * 10 + name[i] - '0';
         }
         return literalInfo_[pos];
     }
@@ -526,18 +655,58 @@ namespace ycc
 
 
 
+    void SymbolTable::addModule(const std::string &name, const std::string &ir)
+    {
+        moduleIR_[name] = ir;
+    }
+
+    bool SymbolTable::hasModule(const std::string &name) const
+    {
+        return moduleIR_.find(name) != moduleIR_.end();
+    }
+
+    // an instance method gets its object as this; api modules have no objects,
+    // their methods are called as Class.method()
+    bool SymbolTable::hasThis(const std::string &className, const MethodInfo &info) const
+    {
+        return !info.check(SymbolTag::STATIC) && !hasModule(className);
+    }
+
     void SymbolTable::addModuleName(const std::string &name)
     {
         apiList_.push_back(name);
     }
 
-    void SymbolTable::dumpIR(std::ostream &out /* = cout */)
+    // the functions a module exports, declared without their attributes
+    static std::string declarations(const std::string &ir)
     {
-        out << endl;
-        // TODO: type dump
-        for(auto line : classesTable_)
+        std::istringstream in(ir);
+        std::string line, out;
+        while(std::getline(in, line))
         {
+            if(line.compare(0, 7, "define ") == 0 && line.compare(7, 9, "internal ") != 0
+                && line.compare(7, 8, "private ") != 0)
+            {
+                out += "declare " + line.substr(7, line.rfind(')') - 6) + "\n";
+            }
+        }
+        return out;
+    }
 
+    void SymbolTable::dumpIR(std::ostream &out /* = cout */, bool linkApi /* = false */)
+    {
+        out << endl;
+        // the fields of the objects of every class
+        for(auto &line : classesTable_)
+        {
+            out << "%class." << line.first << " = type {";
+            auto fields = line.second->fields();
+            for(size_t i = 0; i < fields.size(); i++)
+            {
+                auto type = line.second->getVariableInfo(fields[i]).getType();
+                out << (i ? ", " : " ") << getTypeIR(type);
+            }
+            out << (fields.empty() ? "}" : " }") << endl;
         }
 
         // string literal dump
@@ -551,24 +720,25 @@ namespace ycc
         // static variable dump
         for(auto line : staticTable_)
         {
-            int wd = typeInfoTable_[line.second.getType()].getWidth();
-            out << "@" << line.first << " = internal global i"
-                << wd*8 << " 0, align " << wd << endl;
+            auto value = staticValues_.find(line.first);
+            out << "@" << line.first << " = internal global " << getTypeIR(line.second.getType()) << " "
+                << (value == staticValues_.end() ? "zeroinitializer" : value->second)
+                << ", align " << alignOf(line.second.getType()) << endl;
         }
         out << endl;
 
-        // api dump
-        for(auto apiName : apiList_)
+        // api dump, only declared if the backend links its bitcode
+        for(auto &apiName : apiList_)
         {
-            auto path = "./api/" + apiName + ".vm";
-            std::ifstream in;
-            in.open(path);
-            std::string line;
-            while(std::getline(in, line))
+            TraceSpan span("module", apiName);
+            if(linkApi && std::ifstream("./api/" + apiName + ".bc").good())
             {
-                out << line << endl;
+                out << declarations(moduleIR_[apiName]);
+            }
+            else
+            {
+                out << moduleIR_[apiName];
             }
-            in.close();
         }
     }
 
@@ -583,7 +753,7 @@ namespace ycc
         cout << endl;
 
         cout << "--------------global table-------------" << endl;
-        currentClass_->dump();
+        globalTable_->dump();
         cout << endl;
 
         cout << "we have " << classesTable_.size() << " class table here." << endl;
@@ -595,6 +765,17 @@ namespace ycc
         }
     }
 
+    // class, member, method, static and literal symbols
+    long SymbolTable::symbolCount() const
+    {
+        long count = globalTable_->size() + staticTable_.size() + literalList_.size();
+        for(auto table : classesTable_)
+        {
+            count += table.second->size();
+        }
+        return count;
+    }
+
 
 
 }
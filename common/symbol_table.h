@@ -6,6 +6,7 @@
 #include <vector>
 #include <bitset>
 #include <map>
+#include <mutex>
 
 
 namespace ycc
@@ -49,9 +50,10 @@ namespace ycc
     {
         return width_;
     }
+    // String is kept as the chars of a literal, it is no java array
     inline bool TypeInfo::isArray() const
     {
-        return arrayOf_ >= 0;
+        return arrayOf_ >= 0 && name_ != "String";
     }
     inline int TypeInfo::arrayOf() const
     {
@@ -187,9 +189,16 @@ namespace ycc
         const MethodInfo &  getMethodInfo(const std::string &name) const;
         void                setMethodInfo(const std::string &name, const MethodInfo &info);
 
+        // instance variables, in the order of the fields of an object
+        void                layout(bool hot);
+        const std::vector<std::string> & fields() const;
+        int                 fieldIndex(const std::string &name) const;
+        void                addHeat(const std::string &name, long heat);
+
         // get info
         ClassTable *        prec() const;
         const std::string & className() const;
+        long                size() const;
 
         void                dump(); // for debug
 
@@ -198,8 +207,15 @@ namespace ycc
         std::string                         name_;
         std::map<std::string, SymbolInfo>   variableTable_;
         std::map<std::string, MethodInfo>   methodTable_;
+        std::vector<std::string>            fields_;
+        std::map<std::string, long>         heat_;      // uses of fields, weighted by loop depth
     };
 
+    inline const std::vector<std::string> & ClassTable::fields() const
+    {
+        return fields_;
+    }
+
     inline ClassTable * ClassTable::prec() const
     {
         return prec_;
@@ -210,12 +226,18 @@ namespace ycc
         return name_;
     }
 
+    inline long ClassTable::size() const
+    {
+        return variableTable_.size() + methodTable_.size();
+    }
+
 
 
     class SymbolTable
     {
       public:
         static SymbolTable* getInstance();
+        static void         reset();
 
         // type operations
         int                 addType(const std::string &name, int wd = 0, int arrayOf = -1);
@@ -225,8 +247,13 @@ namespace ycc
         const TypeInfo &    getTypeInfo(int typeIndex) const;
         std::string         getTypeName(int typeIndex) const;
         std::string         getTypeIR(int typeIndex);
+        bool                isClass(int typeIndex) const;
+        int                 alignOf(int typeIndex) const;
 
         void                addClass(const std::string &name, int modifier = 0);
+        const ClassTable *  getClassTable(const std::string &name) const;
+        void                addFieldHeat(const std::string &className, const std::string &name, long heat);
+        void                layoutClasses(bool hot);
         // current classes operations
         void                enterClass(const std::string &name);
         void                leaveClass();
@@ -246,15 +273,20 @@ namespace ycc
 
         // symbol operations
         void                addStatic(const std::string &name, const SymbolInfo &info);
+        void                setStaticValue(const std::string &name, const std::string &value);
         std::string         getQualifier();
         std::string         getQualifier(const std::string &methodName);
         std::string         addLiteral(std::string literal);
         const SymbolInfo &  getLiteralInfo(const std::string &name);
 
         // API and IR
+        void                addModule(const std::string &apiName, const std::string &ir);
+        bool                hasModule(const std::string &apiName) const;
+        bool                hasThis(const std::string &className, const MethodInfo &info) const;
         void                addModuleName(const std::string &apiName);
-        void                dumpIR(std::ostream &out = std::cout);
+        void                dumpIR(std::ostream &out = std::cout, bool linkApi = false);
         void                dump(); // for debug
+        long                symbolCount() const;
 
       private:
         SymbolTable();
@@ -265,18 +297,27 @@ namespace ycc
 
         std::map<std::string, ClassTable*>  classesTable_;
         ClassTable *                        globalTable_;
-        ClassTable *                        currentClass_;
-        std::string                         currentMethod_;
 
-        std::vector<std::string>            subroutineTable_;
-        std::vector<SymbolInfo>             localInfoTable_;
-        std::vector<int>                    baseStack_;
+        // cursor of the current class/method scope, kept per thread so that
+        // method bodies can be checked and generated in parallel
+        struct Scope
+        {
+            ClassTable *                    currentClass_ = nullptr;
+            std::string                     currentMethod_;
+            std::vector<std::string>        subroutineTable_;
+            std::vector<SymbolInfo>         localInfoTable_;
+            std::vector<int>                baseStack_;
+        };
+        static thread_local Scope           scope_;
 
         std::map<std::string, SymbolInfo>   staticTable_;
+        std::map<std::string, std::string>  staticValues_;  // initial values, zero if none
+        std::mutex                          staticMutex_;
         std::vector<SymbolInfo>             literalInfo_;
         std::vector<std::string>            literalList_;
 
-        std::vector<std::string>            apiList_;
+        std::vector<std::string>            apiList_;      // modules imported by this file
+        std::map<std::string, std::string>  moduleIR_;     // loaded modules and their IR
 
         static SymbolTable *                instance_;
     };
@@ -0,0 +1,52 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "thread_pool.h"
+
+namespace ycc
+{
+    ThreadPool::ThreadPool(int jobs /* = 1 */)
+        : jobs_(jobs > 0 ? jobs : hardwareJobs())
+    {}
+
+    int ThreadPool::hardwareJobs()
+    {
+        int n = std::thread::hardware_concurrency();
+        return n > 0 ? n : 1;
+    }
+
+    void ThreadPool::run(int count, const std::function<void(int)> &job)
+    {
+        int workers = jobs_ < count ? jobs_ : count;
+        if(workers <= 1)
+        {
+            for(int i = 0; i < count; i++)
+            {
+                job(i);
+            }
+            return ;
+        }
+
+        // every worker takes the next unfinished index until none is left
+        std::atomic<int> next(0);
+        auto worker = [&]()
+        {
+            int i;
+            while((i = next++) < count)
+            {
+                job(i);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for(int i = 1; i < workers; i++)
+        {
+            threads.push_back(std::thread(worker));
+        }
+        worker();
+        for(auto &t : threads)
+        {
+            t.join();
+        }
+    }
+}
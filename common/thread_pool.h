@@ -0,0 +1,30 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <functional>
+
+namespace ycc
+{
+    class ThreadPool
+    {
+      public:
+        explicit            ThreadPool(int jobs = 1);
+
+        // run job(0) ... job(count-1), each index exactly once, and
+        // return when all of them are finished
+        void                run(int count, const std::function<void(int)> &job);
+        int                 jobs() const;
+
+        static int          hardwareJobs();
+
+      private:
+        int                 jobs_;
+    };
+
+    inline int ThreadPool::jobs() const
+    {
+        return jobs_;
+    }
+}
+
+#endif
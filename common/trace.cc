@@ -0,0 +1,99 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <vector>
+#include "trace.h"
+
+namespace ycc
+{
+    struct TraceEvent
+    {
+        const char *        category;
+        std::string         name;
+        long long           begin;
+        long long           duration;
+        int                 thread;
+    };
+
+    static std::mutex               eventMutex;
+    static std::vector<TraceEvent>  events;
+    static long long                origin = 0;
+    static std::atomic<int>         threadCount(0);
+
+    bool Tracer::enabled_ = false;
+
+    static int threadIndex()
+    {
+        static thread_local int index = ++threadCount;
+        return index;
+    }
+
+    std::string jsonString(const std::string &s)
+    {
+        std::string out = "\"";
+        for(unsigned char c : s)
+        {
+            if(c == '"' || c == '\\')
+            {
+                out += '\\';
+                out += c;
+            }
+            else if(c < 0x20)
+            {
+                char buffer[8];
+                std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                out += buffer;
+            }
+            else
+            {
+                out += c;
+            }
+        }
+        return out + "\"";
+    }
+
+    long long Tracer::now()
+    {
+        using namespace std::chrono;
+        return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    void Tracer::start()
+    {
+        std::lock_guard<std::mutex> lock(eventMutex);
+        events.clear();
+        origin = now();
+        enabled_ = true;
+    }
+
+    void Tracer::record(const char *category, const std::string &name,
+                        long long begin, long long end)
+    {
+        int thread = threadIndex();
+        std::lock_guard<std::mutex> lock(eventMutex);
+        events.push_back(TraceEvent{category, name, begin - origin, end - begin, thread});
+    }
+
+    bool Tracer::stop(const std::string &fileName)
+    {
+        std::lock_guard<std::mutex> lock(eventMutex);
+        enabled_ = false;
+
+        std::ofstream out(fileName);
+        out << "{\"traceEvents\":[\n"
+            << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+            << "\"args\":{\"name\":\"ycc\"}}";
+        for(auto &event : events)
+        {
+            out << ",\n{\"name\":" << jsonString(event.name)
+                << ",\"cat\":\"" << event.category << "\",\"ph\":\"X\""
+                << ",\"ts\":" << event.begin << ",\"dur\":" << event.duration
+                << ",\"pid\":1,\"tid\":" << event.thread << "}";
+        }
+        out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+        events.clear();
+        return bool(out);
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <string>
+
+namespace ycc
+{
+    // s quoted as a JSON string, for the trace and the --stats report
+    std::string             jsonString(const std::string &s);
+
+    /*
+     * Chrome trace-event recorder (--trace=<file>), the file loads into
+     * chrome://tracing or Perfetto. While tracing is off a span costs one
+     * test of a global flag: no clock read, no string built.
+     */
+    class Tracer
+    {
+      public:
+        static void         start();
+        static bool         stop(const std::string &fileName);
+        static bool         enabled();
+
+        // complete event of [begin, end) microseconds on this thread
+        static void         record(const char *category, const std::string &name,
+                                   long long begin, long long end);
+        static long long    now();
+
+      private:
+        static bool         enabled_;
+    };
+
+    inline bool Tracer::enabled()
+    {
+        return enabled_;
+    }
+
+    // span of the enclosing scope, named "scope.name" when scope is given
+    class TraceSpan
+    {
+      public:
+        TraceSpan(const char *category, const std::string &name);
+        TraceSpan(const char *category, const std::string &scope, const std::string &name);
+        ~TraceSpan();
+
+        TraceSpan(const TraceSpan &) = delete;
+        TraceSpan & operator=(const TraceSpan &) = delete;
+
+      private:
+        const char *        category_;
+        const std::string * scope_;
+        const std::string * name_;
+        long long           begin_;
+    };
+
+    inline TraceSpan::TraceSpan(const char *category, const std::string &name)
+        : TraceSpan(category, name, name)
+    {
+        scope_ = nullptr;
+    }
+
+    inline TraceSpan::TraceSpan(const char *category, const std::string &scope, const std::string &name)
+        : category_(category), scope_(&scope), name_(&name), begin_(-1)
+    {
+        if(Tracer::enabled())
+        {
+            begin_ = Tracer::now();
+        }
+    }
+
+    inline TraceSpan::~TraceSpan()
+    {
+        if(begin_ >= 0 && Tracer::enabled())
+        {
+            Tracer::record(category_, scope_ ? *scope_ + "." + *name_ : *name_,
+                           begin_, Tracer::now());
+        }
+    }
+}
+
+#endif
@@ -1,6 +1,12 @@
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include "../common/symbols.h"
+#include "../common/thread_pool.h"
+#include "../common/trace.h"
 #include "IRGenerator.h"
+#include "bitcode.h"
+#include "divide.h"
 
 using std::cout;
 using std::endl;
@@ -8,177 +14,839 @@ using std::endl;
 
 namespace ycc
 {
+    // llvm takes floating point constants exactly only in hex
+    static std::string realConstant(double value)
+    {
+        unsigned long long bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        char buffer[24];
+        std::snprintf(buffer, sizeof(buffer), "0x%016llX", bits);
+        return buffer;
+    }
+
+    static int bitsOf(const std::string &type)
+    {
+        if(type.size() < 2 || type[0] != 'i' || type.back() == '*')
+        {
+            return 0;
+        }
+        return std::atoi(type.c_str() + 1);
+    }
+
+    static bool isRealIR(const std::string &type)
+    {
+        return type == "double" || type == "float";
+    }
+
+    // value of a character literal, escapes are \XX in hex after the scanner
+    static long long charCode(const std::string &lexeme)
+    {
+        if(lexeme.size() == 3 && lexeme[0] == '\\')
+        {
+            return std::strtol(lexeme.c_str() + 1, nullptr, 16);
+        }
+        return lexeme.empty() ? 0 : (unsigned char)lexeme[0];
+    }
+
+    // arithmetic operator of a compound assignment
+    static TokenTag arithmeticOf(TokenTag op)
+    {
+        switch(op)
+        {
+        case TokenTag::ADD_ASSIGN:          return TokenTag::PLUS;
+        case TokenTag::SUB_ASSIGN:          return TokenTag::MINUS;
+        case TokenTag::MUL_ASSIGN:          return TokenTag::MULTIPLY;
+        case TokenTag::DIV_ASSIGN:          return TokenTag::DIVIDE;
+        case TokenTag::MOD_ASSIGN:          return TokenTag::MOD;
+        case TokenTag::AND_ASSIGN:          return TokenTag::AND;
+        case TokenTag::OR_ASSIGN:           return TokenTag::OR;
+        case TokenTag::XOR_ASSIGN:          return TokenTag::XOR;
+        case TokenTag::SHL_ASSIGN:          return TokenTag::SHL;
+        case TokenTag::SHR_ASSIGN:          return TokenTag::SHR;
+        case TokenTag::UNSIGNED_SHR_ASSIGN: return TokenTag::UNSIGNED_SHR;
+        default:
+            break;
+        }
+        return op;
+    }
+
+    // a divisor that can not trap: a real or a literal other than zero
+    static bool safeDivisor(ExprPtr expr, bool real)
+    {
+        if(real)
+        {
+            return true;
+        }
+        auto literal = dynamic_cast<IntExpr *>(expr);
+        if(!literal)
+        {
+            return false;
+        }
+        return literal->isChar ? charCode(literal->lexeme) != 0
+                               : literal->lexeme.find_first_of("123456789") != std::string::npos;
+    }
+
+    /*
+     * An expression that may be evaluated whether its value is needed or
+     * not: no calls, no assignments or increments, nothing that can trap.
+     * Both sides of such a ?: are evaluated and the result is a select.
+     */
+    static bool speculatable(ExprPtr expr)
+    {
+        if(dynamic_cast<IdentifierExpr *>(expr) || dynamic_cast<IntExpr *>(expr)
+            || dynamic_cast<RealExpr *>(expr) || dynamic_cast<BoolExpr *>(expr)
+            || dynamic_cast<NullExpr *>(expr) || dynamic_cast<StrExpr *>(expr))
+        {
+            return true;
+        }
+        if(auto qualified = dynamic_cast<QualifiedIdExpr *>(expr))
+        {
+            // a static of a class; a field or the length of an object is read
+            // through a reference that may be null
+            auto left = dynamic_cast<IdentifierExpr *>(qualified->left);
+            return left && SymbolTable::getInstance()->getClassTable(left->name) && speculatable(qualified->right);
+        }
+        if(auto unary = dynamic_cast<UnaryOpExpr *>(expr))
+        {
+            return unary->op != TokenTag::INCRE && unary->op != TokenTag::DECRE && speculatable(unary->expr);
+        }
+        if(auto binary = dynamic_cast<BinaryOpExpr *>(expr))
+        {
+            if(isAssignmentOperator(binary->op))
+            {
+                return false;
+            }
+            auto typeName = SymbolTable::getInstance()->getTypeName(binary->getType());
+            if((binary->op == TokenTag::DIVIDE || binary->op == TokenTag::MOD)
+                && !safeDivisor(binary->right, typeName == "double" || typeName == "float"))
+            {
+                return false;
+            }
+            return speculatable(binary->left) && speculatable(binary->right);
+        }
+        if(auto ternary = dynamic_cast<TernaryOpExpr *>(expr))
+        {
+            return speculatable(ternary->condition) && speculatable(ternary->thenValue)
+                && speculatable(ternary->elseValue);
+        }
+        return false;
+    }
+
+    static std::string compareOpcode(TokenTag op, bool real, bool isUnsigned)
+    {
+        switch(op)
+        {
+        case TokenTag::EQUAL:               return real ? "fcmp oeq" : "icmp eq";
+        case TokenTag::NOT_EQUAL:           return real ? "fcmp une" : "icmp ne";
+        case TokenTag::GREATER_THAN:        return real ? "fcmp ogt" : isUnsigned ? "icmp ugt" : "icmp sgt";
+        case TokenTag::LESS_THAN:           return real ? "fcmp olt" : isUnsigned ? "icmp ult" : "icmp slt";
+        case TokenTag::LESS_OR_EQUAL:       return real ? "fcmp ole" : isUnsigned ? "icmp ule" : "icmp sle";
+        case TokenTag::GREATER_OR_EQUAL:    return real ? "fcmp oge" : isUnsigned ? "icmp uge" : "icmp sge";
+        default:
+            break;
+        }
+        return "icmp eq";
+    }
+
+    /*
+     * The ycc runtime, written into the module when the code uses it.
+     * Objects and arrays are zeroed memory bumped off a region of the
+     * thread, a fresh region comes from calloc when one is used up. With
+     * no collector nothing is ever freed, so there are no free lists;
+     * blocks too big for a region go to calloc on their own.
+     */
+    static const char *runtime = R"(
+@ycc.outOfBoundsMessage = private unnamed_addr constant [80 x i8] c"java.lang.ArrayIndexOutOfBoundsException: Index %d out of bounds for length %d\0A\00", align 1
+@ycc.negativeSizeMessage = private unnamed_addr constant [42 x i8] c"java.lang.NegativeArraySizeException: %d\0A\00", align 1
+@ycc.outOfMemoryMessage = private unnamed_addr constant [28 x i8] c"java.lang.OutOfMemoryError\0A\00", align 1
+@ycc.region = internal thread_local global i8* null, align 8
+@ycc.regionEnd = internal thread_local global i8* null, align 8
+@stderr = external global i8*
+
+declare i32 @fprintf(i8*, i8*, ...)
+declare i8* @calloc(i64, i64)
+declare void @exit(i32)
+
+define internal void @ycc.outOfMemory() cold noreturn {
+  call void @ycc.flush()
+  %err = load i8*, i8** @stderr
+  %printed = call i32 (i8*, i8*, ...) @fprintf(i8* %err, i8* getelementptr inbounds ([28 x i8], [28 x i8]* @ycc.outOfMemoryMessage, i64 0, i64 0))
+  call void @exit(i32 1)
+  unreachable
+}
+
+; %bytes of zeroed memory, aligned to 8
+define internal i8* @ycc.alloc(i64 %bytes) {
+entry:
+  %rounded = add i64 %bytes, 7
+  %granules = and i64 %rounded, -8
+  %empty = icmp eq i64 %granules, 0
+  %size = select i1 %empty, i64 8, i64 %granules
+  %large = icmp ugt i64 %size, 16384
+  br i1 %large, label %heap, label %bump
+
+bump:
+  %top = load i8*, i8** @ycc.region
+  %end = load i8*, i8** @ycc.regionEnd
+  %next = getelementptr i8, i8* %top, i64 %size
+  %fits = icmp ule i8* %next, %end
+  br i1 %fits, label %bumped, label %refill
+
+bumped:
+  store i8* %next, i8** @ycc.region
+  ret i8* %top
+
+refill:
+  %region = call i8* @calloc(i64 1, i64 1048576)
+  %noRegion = icmp eq i8* %region, null
+  br i1 %noRegion, label %outOfMemory, label %refilled
+
+refilled:
+  %regionTop = getelementptr i8, i8* %region, i64 %size
+  %regionEnd = getelementptr i8, i8* %region, i64 1048576
+  store i8* %regionTop, i8** @ycc.region
+  store i8* %regionEnd, i8** @ycc.regionEnd
+  ret i8* %region
+
+heap:
+  %memory = call i8* @calloc(i64 1, i64 %size)
+  %failed = icmp eq i8* %memory, null
+  br i1 %failed, label %outOfMemory, label %done
+
+done:
+  ret i8* %memory
+
+outOfMemory:
+  call void @ycc.outOfMemory()
+  unreachable
+}
+
+define internal void @ycc.outOfBounds(i32 %index, i32 %length) cold noreturn {
+  call void @ycc.flush()
+  %err = load i8*, i8** @stderr
+  %printed = call i32 (i8*, i8*, ...) @fprintf(i8* %err, i8* getelementptr inbounds ([80 x i8], [80 x i8]* @ycc.outOfBoundsMessage, i64 0, i64 0), i32 %index, i32 %length)
+  call void @exit(i32 1)
+  unreachable
+}
+
+; zeroed memory for a header of %length and the elements, %bytes in all
+define internal i8* @ycc.newArray(i32 %length, i64 %bytes) {
+entry:
+  %negative = icmp slt i32 %length, 0
+  br i1 %negative, label %negativeSize, label %allocate
+
+negativeSize:
+  call void @ycc.flush()
+  %err = load i8*, i8** @stderr
+  %printed = call i32 (i8*, i8*, ...) @fprintf(i8* %err, i8* getelementptr inbounds ([42 x i8], [42 x i8]* @ycc.negativeSizeMessage, i64 0, i64 0), i32 %length)
+  call void @exit(i32 1)
+  unreachable
+
+allocate:
+  %memory = call i8* @ycc.alloc(i64 %bytes)
+  %header = bitcast i8* %memory to i32*
+  store i32 %length, i32* %header
+  ret i8* %memory
+}
+)";
+
+    static bool calls(const std::vector<IRFunction> &functions, const std::string &callee)
+    {
+        for(auto &function : functions)
+        {
+            for(auto &block : function.blocks)
+            {
+                for(auto &inst : block.insts)
+                {
+                    if(inst.op == IROp::CALL && inst.opcode == callee)
+                    {
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
     IRGenerator::IRGenerator(const std::string &filename)
-        : labelCount_(1),oneVistor_(true),fuzhi_(false),constant_(false),incre_(false),callRet_(false),call_value(false)
+        : IRGenerator()
+    {
+        filename_ = filename;
+    }
+
+    IRGenerator::IRGenerator()
+        : jobs_(1),bitcode_(false),linkApi_(false),methods_(nullptr),instructions_(0),bytes_(0),returnType_(0),isMain_(false),
+          declType_(0),qualifier_(nullptr),lvalue_(false),qualifying_(false)
     {
-    	output_.open(filename, std::ios::out);
         symbolTable_ = SymbolTable::getInstance();
-        symbolTable_->dumpIR(output_);
     }
 
-	void IRGenerator::gene(VecNodePtr ast)
-	{
+    void IRGenerator::setJobs(int jobs)
+    {
+        jobs_ = jobs;
+    }
+
+    void IRGenerator::setBitcode(bool bitcode)
+    {
+        bitcode_ = bitcode;
+    }
+
+    void IRGenerator::setLinkApi(bool linkApi)
+    {
+        linkApi_ = linkApi;
+    }
+
+    void IRGenerator::addRuntime(const std::string &ir)
+    {
+        runtimes_ += ir;
+    }
+
+    void IRGenerator::generate(VecNodePtr ast)
+    {
+        // collect method bodies class by class
+        VecMethodUnit methods;
+        methods_ = &methods;
         for(auto node : ast)
         {
             node->accept(this);
         }
-        output_ << endl;
-		output_.close();
+        methods_ = nullptr;
+
+        // every method is generated into its own function by its own generator
+        functions_.assign(methods.size(), IRFunction());
+        ThreadPool pool(jobs_);
+        pool.run(methods.size(), [&](int i)
+        {
+            IRGenerator worker;
+            functions_[i] = worker.geneMethod(methods[i]);
+        });
+    }
+
+    // module header, api IR and the generated functions to the output file,
+    // as text or as bitcode
+    void IRGenerator::write()
+    {
+        std::ofstream output(filename_, std::ios::out | std::ios::binary);
+        write(output);
+		output.close();
 	}
 
-	std::string IRGenerator::numeric(int typeIndex)
+    void IRGenerator::write(std::ostream &output)
     {
-    	return symbolTable_->getTypeIR(typeIndex);
+        std::ostringstream header;
+        symbolTable_->dumpIR(header, linkApi_);
+
+        std::string trailer;
+        if(calls(functions_, "@ycc.alloc") || calls(functions_, "@ycc.newArray") || calls(functions_, "@ycc.outOfBounds"))
+        {
+            // what the program printed goes out before the error
+            std::string flush = header.str().find("@io.flush()") != std::string::npos ? "  call void @io.flush()\n" : "";
+            // and the profile, a JIT does not run what main registered at exit
+            if(runtimes_.find("@ycc.writeProfile(") != std::string::npos)
+            {
+                flush += "  call void @ycc.writeProfile(i8* null)\n";
+            }
+            flush = "\ndefine internal void @ycc.flush() {\n" + flush + "  ret void\n}\n";
+            trailer = runtime + flush;
+        }
+        trailer += runtimes_;
+        instructions_ = 0;
+        for(auto &function : functions_)
+        {
+            instructions_ += function.size();
+        }
+
+        if(bitcode_)
+        {
+            std::string error;
+            std::ostringstream bitcode;
+            if(writeBitcode(header.str(), functions_, trailer, bitcode, error))
+            {
+                output << bitcode.str();
+                bytes_ = bitcode.str().size();
+                return ;
+            }
+            // llc, clang and the LLVM backend take text under any name
+            std::cerr << "ycc: warning: can not write bitcode, writing text instead: " << error << std::endl;
+        }
+        output << header.str();
+        bytes_ = header.str().size() + 1;
+        for(auto &function : functions_)
+        {
+            std::ostringstream body;
+            function.print(body);
+            output << body.str();
+            bytes_ += body.str().size();
+        }
+        output << trailer << endl;
+        bytes_ += trailer.size();
+    }
+
+    // indented lines of a body, except comments
+    long IRGenerator::countInstructions(const std::string &ir)
+    {
+        long count = 0;
+        size_t begin = 0;
+        while(begin < ir.size())
+        {
+            size_t end = ir.find('\n', begin);
+            if(end == std::string::npos)
+            {
+                end = ir.size();
+            }
+            size_t first = ir.find_first_not_of(" \t", begin);
+            if(first > begin && first < end && ir[first] != ';')
+            {
+                count++;
+            }
+            begin = end + 1;
+        }
+        return count;
+    }
+
+    IRFunction IRGenerator::geneMethod(const MethodUnit &unit)
+    {
+        TraceSpan span("codegen", unit.className, unit.method->name);
+        className_ = unit.className;
+        symbolTable_->enterClass(unit.className);
+        unit.method->accept(this);
+        symbolTable_->leaveClass();
+        return function_;
     }
 
 
 
 	// generator tools
-    void IRGenerator::writeMethod_begin(std::string name,MethodInfo mInfo)
-	{
+	std::string IRGenerator::typeIR(int typeIndex)
+    {
+    	return symbolTable_->getTypeIR(typeIndex);
+    }
+
+    bool IRGenerator::isReal(int typeIndex)
+    {
+        return isRealIR(typeIR(typeIndex));
+    }
+
+    IRValue IRGenerator::gene(ExprPtr expr)
+    {
+        value_ = IRValue{"i32", "undef"};
+        expr->accept(this);
+        return value_;
+    }
 
-        if(name != "main")
+    // the java conversion of a value of type from to type to
+    IRValue IRGenerator::convert(const IRValue &value, int from, int to)
+    {
+        auto type = typeIR(to);
+        if(value.type == type || type == "void")
+        {
+            return value;
+        }
+        if(value.name == "null")
+        {
+            return IRValue{type, "null"};
+        }
+        int fromBits = bitsOf(value.type);
+        int toBits = bitsOf(type);
+        bool isUnsigned = fromBits == 1 || symbolTable_->getTypeName(from) == "char";
+        if(fromBits && toBits)
+        {
+            if(toBits == 1)
+            {
+                return builder_.cmp("icmp ne", value, IRValue{value.type, "0"});
+            }
+            if(value.isConstant() && fromBits > 1)
+            {
+                return IRValue{type, value.name};
+            }
+            if(toBits > fromBits)
+            {
+                return builder_.cast(isUnsigned ? "zext" : "sext", value, type);
+            }
+            return builder_.cast("trunc", value, type);
+        }
+        if(fromBits && isRealIR(type))
         {
-            name = mInfo.getFullName();
+            if(value.isConstant() && fromBits > 1)
+            {
+                double real = std::strtod(value.name.c_str(), nullptr);
+                return IRValue{type, realConstant(type == "float" ? (double)(float)real : real)};
+            }
+            return builder_.cast(isUnsigned ? "uitofp" : "sitofp", value, type);
         }
+        if(isRealIR(value.type) && toBits)
+        {
+            return builder_.cast("fptosi", value, type);
+        }
+        if(isRealIR(value.type) && isRealIR(type))
+        {
+            return builder_.cast(type == "double" ? "fpext" : "fptrunc", value, type);
+        }
+        return value;
+    }
 
-		output_<<endl;
-		output_<<"define "<<numeric(mInfo.getType())<<" @"<<name<<"(";
-        if(name != "main")
+    // an expression as an i1 for branches
+    IRValue IRGenerator::condition(ExprPtr expr)
+    {
+        auto value = gene(expr);
+        if(value.type == "i1")
         {
-    		for(int i = 0;i<mInfo.parameters_.size();i++){
-    			output_<<" "<<numeric(mInfo.paramTypes_[i])<<" "<<"%"<<mInfo.parameters_[i];
-    			if(i<mInfo.parameters_.size()-1){
-    				output_<<",";
-    			}
-    		}
+            return value;
         }
-	    output_<<") {"<<endl;
-	}
+        if(isRealIR(value.type))
+        {
+            return builder_.cmp("fcmp une", value, IRValue{value.type, realConstant(0)});
+        }
+        return builder_.cmp("icmp ne", value, IRValue{value.type, "0"});
+    }
 
-	void IRGenerator::writeMethod_end(MethodInfo mInfo)
-	{
-		output_<<"\tret "<<numeric(mInfo.getType())<<endl;
-		output_<<"}"<<endl;
-	}
+    // jump on the value of a condition; && || and ! only jump, they are never materialized
+    void IRGenerator::branch(ExprPtr expr, const std::string &thenLabel, const std::string &elseLabel)
+    {
+        auto binary = dynamic_cast<BinaryOpExpr *>(expr);
+        if(binary && isLogicOperator(binary->op))
+        {
+            bool isAnd = binary->op == TokenTag::LOGIC_AND;
+            auto rhsLabel = builder_.newLabel(isAnd ? "and.rhs" : "or.rhs");
+            branch(binary->left, isAnd ? rhsLabel : thenLabel, isAnd ? elseLabel : rhsLabel);
+            builder_.setBlock(rhsLabel);
+            branch(binary->right, thenLabel, elseLabel);
+            return ;
+        }
+        auto unary = dynamic_cast<UnaryOpExpr *>(expr);
+        if(unary && unary->op == TokenTag::NOT && unary->expr->getType() == symbolTable_->getTypeIndex("boolean"))
+        {
+            branch(unary->expr, elseLabel, thenLabel);
+            return ;
+        }
+        builder_.condBr(condition(expr), thenLabel, elseLabel);
+    }
 
-    void IRGenerator::writeAlloca(std::string name,int type)
-	{
-        int wd = symbolTable_->getTypeInfo(type).getWidth();
-    	output_<<"\t%"<<name<<" = alloca "<<numeric(type)<<", align " << wd <<endl;
-	}
+    // the storage of a variable: its stack slot or the global of a static
+    IRValue IRGenerator::address(ExprPtr expr, int &type)
+    {
+        lvalue_ = true;
+        lvalueType_ = symbolTable_->getTypeIndex("int");
+        auto value = gene(expr);
+        lvalue_ = false;
+        type = lvalueType_;
+        return value;
+    }
 
-    void IRGenerator::writeStore(int type,std::string oneName,std::string twoName)
-	{
-        auto info = symbolTable_->getVariableInfo(twoName);
-        int wd = symbolTable_->getTypeInfo(type).getWidth();
+    // the address of a field of an object, empty if the class has no such instance field
+    IRValue IRGenerator::field(const ClassTable *table, const IRValue &object, const std::string &name, int &type)
+    {
+        auto index = table ? table->fieldIndex(name) : -1;
+        if(index < 0)
+        {
+            return IRValue();
+        }
+        type = table->getVariableInfo(name).getType();
+        auto structType = object.type.substr(0, object.type.size() - 1);
+        return builder_.gep(structType, object, {IRValue{"i32", "0"}, IRValue{"i32", std::to_string(index)}},
+                            typeIR(type) + "*");
+    }
 
-    	output_<<"\tstore "<<numeric(type)<<" %"<<oneName<<", "<<numeric(type)<<"* ";
-        if(info.check(SymbolTag::STATIC))
+    IRValue IRGenerator::arithmetic(TokenTag op, IRValue lhs, IRValue rhs, int type)
+    {
+        bool real = isReal(type);
+        std::string opcode;
+        switch(op)
         {
-            output_ << "@" << info.getFullName() << ", align " << wd << endl;
+        case TokenTag::PLUS:        opcode = real ? "fadd" : "add";     break;
+        case TokenTag::MINUS:       opcode = real ? "fsub" : "sub";     break;
+        case TokenTag::MULTIPLY:    opcode = real ? "fmul" : "mul";     break;
+        case TokenTag::DIVIDE:
+        case TokenTag::MOD:
+        {
+            IRValue result;
+            if(!real && rhs.isConstant()
+               && divideByConstant(builder_, op == TokenTag::MOD, lhs, std::atoll(rhs.name.c_str()), result))
+            {
+                return result;
+            }
+            opcode = op == TokenTag::MOD ? (real ? "frem" : "srem") : (real ? "fdiv" : "sdiv");
+            break;
         }
-        else
+        case TokenTag::AND:         opcode = "and";                     break;
+        case TokenTag::OR:          opcode = "or";                      break;
+        case TokenTag::XOR:         opcode = "xor";                     break;
+        case TokenTag::SHL:
+        case TokenTag::SHR:
+        case TokenTag::UNSIGNED_SHR:
         {
-            output_ << "%" << twoName << ", align " << wd << endl;
+            // java only takes the low bits of the shift count
+            int mask = bitsOf(lhs.type) - 1;
+            if(rhs.isConstant())
+            {
+                rhs.name = std::to_string(std::atoll(rhs.name.c_str()) & mask);
+            }
+            else
+            {
+                rhs = builder_.binary("and", rhs, IRValue{rhs.type, std::to_string(mask)});
+            }
+            opcode = op == TokenTag::SHL ? "shl" : op == TokenTag::SHR ? "ashr" : "lshr";
+            break;
         }
-	}
+        default:
+            opcode = "add";
+            break;
+        }
+        return builder_.binary(opcode, lhs, rhs);
+    }
 
-	void IRGenerator::writeStore_value(int type,std::string oneName_value,std::string twoName)
-	{
-		auto info = symbolTable_->getVariableInfo(twoName);
-        int wd = symbolTable_->getTypeInfo(type).getWidth();
+    // a literal, maybe negated, as a constant of type; false for anything else
+    bool IRGenerator::constant(ExprPtr expr, int type, std::string &value)
+    {
+        auto unary = dynamic_cast<UnaryOpExpr *>(expr);
+        bool negative = unary && unary->op == TokenTag::MINUS;
+        auto literal = negative ? unary->expr : expr;
+        bool number = dynamic_cast<IntExpr *>(literal) || dynamic_cast<RealExpr *>(literal);
+        if(negative && !number)
+        {
+            return false;
+        }
+        auto typeName = typeIR(type);
+        if(number && isRealIR(typeName))
+        {
+            double real = std::strtod(gene(literal).name.c_str(), nullptr);
+            if(dynamic_cast<RealExpr *>(literal))
+            {
+                real = std::strtod(static_cast<RealExpr *>(literal)->lexeme.c_str(), nullptr);
+            }
+            real = negative ? -real : real;
+            value = realConstant(typeName == "float" ? (double)(float)real : real);
+            return true;
+        }
+        if(number)
+        {
+            // an integer literal for an integer type
+            if(!dynamic_cast<IntExpr *>(literal) || bitsOf(typeName) < 8)
+            {
+                return false;
+            }
+            auto name = gene(literal).name;
+            value = negative ? (name[0] == '-' ? name.substr(1) : "-" + name) : name;
+            return true;
+        }
+        if(dynamic_cast<NullExpr *>(literal) && typeName.back() == '*')
+        {
+            value = "null";
+            return true;
+        }
+        if((dynamic_cast<BoolExpr *>(literal) || dynamic_cast<StrExpr *>(literal)) && literal->getType() == type)
+        {
+            value = gene(literal).name;
+            return true;
+        }
+        return false;
+    }
 
-    	output_<<"\tstore "<<numeric(type)<<" "<<oneName_value<<", "<<numeric(type)<<"* ";
-        if(info.check(SymbolTag::STATIC))
+    IRValue IRGenerator::arrayLength(const IRValue &array)
+    {
+        auto structType = array.type.substr(0, array.type.size() - 1);
+        auto slot = builder_.gep(structType, array, {IRValue{"i32", "0"}, IRValue{"i32", "0"}}, "i32*");
+        return builder_.load("i32", slot);
+    }
+
+    // an array of sizes[dim] elements, each an array of the next size
+    IRValue IRGenerator::newArray(int type, const std::vector<IRValue> &sizes, size_t dim)
+    {
+        auto arrayType = typeIR(type);
+        auto structType = arrayType.substr(0, arrayType.size() - 1);
+        auto elemType = symbolTable_->getTypeInfo(type).arrayOf();
+        auto elemIR = typeIR(elemType);
+
+        // sizes of the header and of an element, whatever the target
+        auto header = "ptrtoint ([0 x " + elemIR + "]* getelementptr (" + structType + ", "
+                    + arrayType + " null, i32 0, i32 1) to i64)";
+        auto elemSize = "ptrtoint (" + elemIR + "* getelementptr (" + elemIR + ", "
+                      + elemIR + "* null, i32 1) to i64)";
+        auto length = sizes[dim];
+        auto count = length.isConstant() ? IRValue{"i64", length.name} : builder_.cast("sext", length, "i64");
+        auto bytes = builder_.binary("add", builder_.binary("mul", count, IRValue{"i64", elemSize}),
+                                     IRValue{"i64", header});
+        auto memory = builder_.call("i8*", "@ycc.newArray", {length, bytes});
+        auto array = builder_.cast("bitcast", memory, arrayType);
+        if(dim + 1 == sizes.size())
         {
-            output_ << "@" << info.getFullName() << ", align " << wd << endl;
+            return array;
         }
-        else
+
+        auto counter = builder_.allocate("i32", "dim");
+        auto condLabel = builder_.newLabel("new.cond");
+        auto bodyLabel = builder_.newLabel("new.body");
+        auto endLabel = builder_.newLabel("new.end");
+        builder_.store(IRValue{"i32", "0"}, counter);
+        builder_.setBlock(condLabel);
+        auto i = builder_.load("i32", counter);
+        builder_.condBr(builder_.cmp("icmp slt", i, length), bodyLabel, endLabel);
+        builder_.setBlock(bodyLabel);
+        auto sub = newArray(elemType, sizes, dim + 1);
+        auto slot = builder_.gep(structType, array, {IRValue{"i32", "0"}, IRValue{"i32", "1"}, i}, elemIR + "*");
+        builder_.store(sub, slot);
+        builder_.store(builder_.binary("add", i, IRValue{"i32", "1"}), counter);
+        builder_.br(condLabel);
+        builder_.setBlock(endLabel);
+        return array;
+    }
+
+    // address of a[i] after the java bounds check
+    IRValue IRGenerator::element(IndexExpr *node, int &type)
+    {
+        auto lvalue = lvalue_;
+        lvalue_ = false;
+        auto array = gene(node->left);
+        auto index = convert(gene(node->index), node->index->getType(), symbolTable_->getTypeIndex("int"));
+        lvalue_ = lvalue;
+        type = symbolTable_->getTypeInfo(node->left->getType()).arrayOf();
+
+        // one unsigned compare also catches negative indexes
+        auto length = arrayLength(array);
+        auto okLabel = builder_.newLabel("bounds.ok");
+        auto failLabel = builder_.newLabel("bounds.fail");
+        builder_.condBr(builder_.cmp("icmp ult", index, length), okLabel, failLabel);
+        builder_.setBlock(failLabel);
+        builder_.call("void", "@ycc.outOfBounds", {index, length});
+        builder_.unreachable();
+        builder_.setBlock(okLabel);
+
+        auto arrayName = dynamic_cast<IdentifierExpr *>(node->left);
+        auto indexName = dynamic_cast<IdentifierExpr *>(node->index);
+        for(auto loop = rangeLoops_.rbegin(); arrayName && indexName && loop != rangeLoops_.rend(); ++loop)
         {
-            output_ << "%" << twoName << ", align " << wd << endl;
+            if(loop->array == arrayName->name && loop->index == indexName->name)
+            {
+                loop->checks.push_back(failLabel);
+                break;
+            }
         }
-	}
 
-	void IRGenerator::writeLoad(int labelCount,int type,std::string name)
-	{
-        auto info = symbolTable_->getVariableInfo(name);
-        int wd = symbolTable_->getTypeInfo(info.getType()).getWidth();
-		output_<<"\t%"<<labelCount<<" = load "<< numeric(type) <<", "
-               <<numeric(type)<<"* ";
-        if(info.check(SymbolTag::STATIC))
+        auto structType = array.type.substr(0, array.type.size() - 1);
+        return builder_.gep(structType, array, {IRValue{"i32", "0"}, IRValue{"i32", "1"}, index},
+                            typeIR(type) + "*");
+    }
+
+    /*
+     * for(i = 0; i < a.length; i++) where i is an int local and a a local
+     * array; only the body can assign them, which generating it finds out.
+     */
+    bool IRGenerator::rangeLoop(ForStmt *node, RangeLoop &loop)
+    {
+        auto init = dynamic_cast<BinaryOpExpr *>(node->init);
+        auto cond = dynamic_cast<BinaryOpExpr *>(node->condition);
+        if(!init || init->op != TokenTag::ASSIGN || !cond || cond->op != TokenTag::LESS_THAN)
         {
-            output_ << "@" << info.getFullName() << ", align " << wd << endl;
+            return false;
         }
-        else
+        auto index = dynamic_cast<IdentifierExpr *>(init->left);
+        auto start = dynamic_cast<IntExpr *>(init->right);
+        auto bound = dynamic_cast<IdentifierExpr *>(cond->left);
+        auto length = dynamic_cast<QualifiedIdExpr *>(cond->right);
+        if(!index || !start || start->isChar || start->lexeme.size() > 9
+            || start->lexeme.find_first_not_of("0123456789") != std::string::npos
+            || !bound || bound->name != index->name || !length)
         {
-            output_ << "%" << name << ", align " << wd << endl;
+            return false;
+        }
+        auto array = dynamic_cast<IdentifierExpr *>(length->left);
+        auto member = dynamic_cast<IdentifierExpr *>(length->right);
+        if(!array || !member || member->name != "length")
+        {
+            return false;
         }
-	}
 
-    void IRGenerator::writeLabel(int count)
-	{
-		output_<<""<<endl;
-    	output_<<"; <label>:"<<count<<endl;
-	}
+        auto increment = dynamic_cast<UnaryOpExpr *>(node->update);
+        auto addition = dynamic_cast<BinaryOpExpr *>(node->update);
+        auto step = increment ? dynamic_cast<IdentifierExpr *>(increment->expr)
+                  : addition ? dynamic_cast<IdentifierExpr *>(addition->left) : nullptr;
+        auto one = addition ? dynamic_cast<IntExpr *>(addition->right) : nullptr;
+        if(!step || step->name != index->name
+            || (increment && increment->op != TokenTag::INCRE)
+            || (addition && (addition->op != TokenTag::ADD_ASSIGN || !one || one->isChar || one->lexeme != "1")))
+        {
+            return false;
+        }
 
-    void IRGenerator::writeJump(int Label)
-	{
-		output_<<"\tbr label %"<<Label<<endl;
-    	//TODO: writeJump
-	}
-    void IRGenerator::writeCJump(int C,int thenLabel,int elseLabel)
-	{
-    	output_<<"\tbr i1 %"<<C<<", label %"<<thenLabel<<", label %"<<elseLabel<<endl;
-	}
+        bool indexLocal = false, arrayLocal = false;
+        for(auto &local : locals_)
+        {
+            indexLocal = indexLocal || (local.name == index->name && symbolTable_->getTypeName(local.type) == "int");
+            arrayLocal = arrayLocal || local.name == array->name;
+        }
+        if(!indexLocal || !arrayLocal)
+        {
+            return false;
+        }
+        loop = RangeLoop{index->name, array->name, false, {}};
+        return true;
+    }
 
-	void IRGenerator::writeCall(int labelCount,std::string name,MethodInfo mInfo)
-	{
-		if(labelCount == 0){
-			output_<<"\tcall "<<numeric(mInfo.getType())<<" @"<<name<<"(";
+    // a bounds check that can not fail jumps straight on, its compare and fail block go
+    void IRGenerator::dropCheck(const std::string &failLabel)
+    {
+        auto &blocks = function_.blocks;
+        for(auto block = blocks.begin(); block != blocks.end(); ++block)
+        {
+            auto &insts = block->insts;
+            if(!block->terminated() || insts.back().op != IROp::CONDBR || insts.back().operands[2].name != failLabel)
+            {
+                continue;
+            }
+            auto okLabel = insts.back().operands[1].name;
+            auto inRange = insts.back().operands[0].name;
+            insts.pop_back();
+            // the compare, the length and its address are only used by the check
+            if(!insts.empty() && insts.back().result == inRange)
+            {
+                auto length = insts.back().operands[1].name;
+                insts.pop_back();
+                if(!insts.empty() && insts.back().result == length)
+                {
+                    auto slot = insts.back().operands[0].name;
+                    insts.pop_back();
+                    if(!insts.empty() && insts.back().result == slot)
+                    {
+                        insts.pop_back();
+                    }
+                }
+            }
+            insts.push_back(IRInst{IROp::BR, "", "void", "", {IRValue{"label", okLabel}}});
+            break;
+        }
+        for(auto block = blocks.begin(); block != blocks.end(); ++block)
+        {
+            if(block->label == failLabel)
+            {
+                blocks.erase(block);
+                break;
+            }
+        }
+    }
 
-		}
-		else
-		{
-			output_<<"\t%"<<labelCount<<" = call "<<numeric(mInfo.getType())<<" @"<<name<<"(";
+    void IRGenerator::enterScope()
+    {
+        symbolTable_->enter();
+        localBase_.push_back(locals_.size());
+    }
 
-		}
-	}
+    void IRGenerator::leaveScope()
+    {
+        locals_.resize(localBase_.back());
+        localBase_.pop_back();
+        symbolTable_->leave();
+    }
 
-	void IRGenerator::writeBinaryOp(int labelCount,std::string op,int type,std::string lCount,std::string rCount,int model)
-	{
-		switch(model)
-		{
-			case 1:
-				output_<<"\t%"<<labelCount<<" = "<<op<<" "<<numeric(type)<<" %"<<lCount<<", %"<<rCount<<endl;
-				break;
-
-			case 2:
-				output_<<"\t%"<<labelCount<<" = "<<op<<" "<<numeric(type)<<" %"<<lCount<<", "<<rCount<<endl;
-				break;
-
-			case 3:
-				output_<<"\t%"<<labelCount<<" = "<<op<<" "<<numeric(type)<<" "<<lCount<<", %"<<rCount<<endl;
-				break;
-
-			case 4:
-				output_<<"\t%"<<labelCount<<" = "<<op<<" "<<numeric(type)<<" "<<lCount<<", "<<rCount<<endl;
-				break;
-
-			default:
-				break;
-		}
-	}
 
 
     void IRGenerator::visit(ASTNode *node)
     {
-        output_ << "you should not visit here in ASTNode" << endl;
+        cout << "you should not visit here in ASTNode" << endl;
     }
 
     void IRGenerator::visit(Stmt *node)
     {
-        output_ << "you should not visit here in Stmt" << endl;
+        cout << "you should not visit here in Stmt" << endl;
     }
 
     void IRGenerator::visit(EmptyStmt *node)
@@ -188,644 +856,698 @@ namespace ycc
 
     void IRGenerator::visit(ClassStmt *node)
     {
-
+        TraceSpan span("codegen", node->name);
+        auto outerName = className_;
+        className_ = node->name;
         symbolTable_->enterClass(node->name);
         node->body->accept(this);
         symbolTable_->leaveClass();
-
+        className_ = outerName;
     }
 
     void IRGenerator::visit(MethodDeclStmt *node)
     {
+        if(methods_)
+        {
+            methods_->push_back(MethodUnit{className_, node});
+            return ;
+        }
 
-        // TODO: parameter
         symbolTable_->enter(node->name);
-
         auto mInfo = symbolTable_->getMethodInfo(node->name);
 
-        writeMethod_begin(node->name,mInfo);
-        labelCount_ = 1;
-
-		oneVistor_ = true;
-
-        node->body->accept(this);     //oneVistor
-
-        oneVistor_ = false;
+        // the entry point returns the exit status to the C runtime
+        isMain_ = node->name == "main";
+        returnType_ = mInfo.getType();
+        function_ = IRFunction();
+        function_.name = isMain_ ? "@main" : "@" + mInfo.getFullName();
+        function_.returnType = isMain_ ? "i32" : typeIR(returnType_);
+        builder_.reset(&function_);
+        locals_.clear();
+        localBase_.clear();
+
+        // an instance method gets its object first, fields are read through it
+        this_ = IRValue();
+        if(!isMain_ && symbolTable_->hasThis(className_, mInfo))
+        {
+            this_ = IRValue{typeIR(symbolTable_->getTypeIndex(className_)), builder_.newName("this")};
+            function_.params.push_back(this_);
+        }
 
+        // parameters live in stack slots like every other local
+        for(size_t i = 0; !isMain_ && i < mInfo.parameters_.size(); i++)
+        {
+            auto &name = mInfo.parameters_[i];
+            IRValue param{typeIR(mInfo.paramTypes_[i]), builder_.newName(name)};
+            function_.params.push_back(param);
+            auto slot = builder_.allocate(param.type, name);
+            builder_.store(param, slot);
+            locals_.push_back(Local{name, slot, mInfo.paramTypes_[i]});
+        }
 
-        node->body->accept(this);              //twoVistor
+        safeChecks_.clear();
+        node->body->accept(this);
 
-        oneVistor_ = true;
-        if(symbolTable_->getTypeName(mInfo.getType())=="void")
-		{
-        	writeMethod_end(mInfo);
-		}
-		else
-		{
-			output_<<"}"<<endl;
-		}
+        if(!builder_.terminated())
+        {
+            if(isMain_)
+            {
+                builder_.ret(IRValue{"i32", "0"});
+            }
+            else if(function_.returnType == "void")
+            {
+                builder_.retVoid();
+            }
+            else
+            {
+                builder_.ret(IRValue{function_.returnType, "zeroinitializer"});
+            }
+        }
+        // blocks go only now, the builder is done with the function
+        for(auto &check : safeChecks_)
+        {
+            dropCheck(check);
+        }
         symbolTable_->leave();
     }
 
-    void IRGenerator::visit(PrimaryStmt *node)       //Primary
-    {
-    	auto typeIndex = symbolTable_->getTypeIndex(node->type);
-		info = new SymbolInfo(typeIndex, node->flags);
-    	if(oneVistor_)
-    	{
-		    if(info->check(SymbolTag::STATIC))         //  if primary static variable
-		    {
-
-			}
-			else
-			{
-				for(auto v : node->decls)
-		    	{
-		    		v->setType(symbolTable_->getTypeIndex(node->type));
-		        	v->accept(this);
-		    	}
-			}
-		}
-		else
-		{
-		    for(auto v : node->decls)
-		    {
-		        v->accept(this);
-		    }
-		}
+    void IRGenerator::visit(PrimaryStmt *node)
+    {
+        if(methods_)
+        {
+            // member variables, statics are emitted by SymbolTable::dumpIR with
+            // the value of a literal initializer
+            auto type = symbolTable_->getTypeIndex(node->type);
+            for(auto v : node->decls)
+            {
+                auto decl = static_cast<VariableDeclExpr *>(v);
+                std::string value;
+                if(node->flags.test(SymbolTag::STATIC) && decl->initValue && constant(decl->initValue, type, value))
+                {
+                    auto info = symbolTable_->getVariableInfo(decl->name);
+                    symbolTable_->setStaticValue(info.getFullName(), value);
+                }
+            }
+            return ;
+        }
+        declType_ = symbolTable_->getTypeIndex(node->type);
+        declFlags_ = node->flags;
+        for(auto v : node->decls)
+        {
+            v->accept(this);
+        }
     }
 
     void IRGenerator::visit(BlockStmt *node)
     {
-		if(oneVistor_)
-		{
-			for(auto stmt : node->statements)
-        	{
-            	stmt->accept(this);
-        	}
-		}
-		else
-		{
-			symbolTable_->enter();
-	        for(auto stmt : node->statements)
-	        {
-	            stmt->accept(this);
-	        }
-
-	        symbolTable_->leave();
-		}
-
+        enterScope();
+        for(auto stmt : node->statements)
+        {
+            stmt->accept(this);
+        }
+        leaveScope();
     }
 
     void IRGenerator::visit(IfStmt *node)
     {
-    	if(oneVistor_)
-    	{
-    		node->condition->accept(this);
-	        node->thenBody->accept(this);
-	        if(node->elseBody)
-	        {
-	            node->elseBody->accept(this);
-	        }
-		}
-        else
-		{
-        	node->condition->accept(this);
-	        int  thenLabel ;
-	        int  elseLabel ;
-	        int  endLabel  ;
-	        if(node->elseBody)
-			{
-	        	thenLabel = labelCount_;
-	        	elseLabel = labelCount_+1;
-	        	endLabel = labelCount_+2;
-	        	writeCJump(labelCount_-1,thenLabel,elseLabel);  //CJump;
-	        	labelCount_ = labelCount_+3;
-			}
-	        else
-			{
-	        	thenLabel = labelCount_;
-	        	endLabel = labelCount_+1;
-	        	writeCJump(labelCount_-1,thenLabel,endLabel);  //CJump;
-	        	labelCount_ = labelCount_+2;
-			}
-
-	        writeLabel(thenLabel);
-	        node->thenBody->accept(this);
-	        writeJump(endLabel);
-	        if(node->elseBody)
-	        {
-	        	writeLabel(elseLabel);
-	            node->elseBody->accept(this);
-	            writeJump(endLabel);
-	        }
-	        writeLabel(endLabel);
-		}
-
+        auto thenLabel = builder_.newLabel("if.then");
+        auto elseLabel = node->elseBody ? builder_.newLabel("if.else") : "";
+        auto endLabel = builder_.newLabel("if.end");
+        branch(node->condition, thenLabel, node->elseBody ? elseLabel : endLabel);
+
+        builder_.setBlock(thenLabel);
+        node->thenBody->accept(this);
+        if(node->elseBody)
+        {
+            if(!builder_.terminated())
+            {
+                builder_.br(endLabel);
+            }
+            builder_.setBlock(elseLabel);
+            node->elseBody->accept(this);
+        }
+        builder_.setBlock(endLabel);
     }
 
     void IRGenerator::visit(ForStmt *node)
     {
-    	if(oneVistor_)
-    	{
-    		node->init->accept(this);
-        	node->condition->accept(this);
-        	node->update->accept(this);
-        	node->body->accept(this);
-		}
-    	else
-		{
-
-
-	    	int conditionLabel =labelCount_++;
-	    	int bodyLabel = labelCount_++;
-	        int updateLabel = labelCount_++;
-	        int endLabel = labelCount_++;
-
-            continueStack_.push_back(updateLabel);
-            breakStack_.push_back(endLabel);
-            //cout << "push break label: " << breakStack_.back() << endl;
-
-	        node->init->accept(this);
-	        writeJump(conditionLabel);
-
-	        writeLabel(conditionLabel);
-	        node->condition->accept(this);
-
-	        writeCJump(labelCount_-1,bodyLabel,endLabel);
-
-	        writeLabel(bodyLabel);
-	        node->body->accept(this);
+        if(node->init)
+        {
+            gene(node->init);
+        }
+        auto condLabel = builder_.newLabel("for.cond");
+        auto bodyLabel = builder_.newLabel("for.body");
+        auto updateLabel = builder_.newLabel("for.inc");
+        auto endLabel = builder_.newLabel("for.end");
 
-	        writeJump(updateLabel);
+        builder_.setBlock(condLabel);
+        if(node->condition)
+        {
+            branch(node->condition, bodyLabel, endLabel);
+        }
 
-	        writeLabel(updateLabel);
-	        node->update->accept(this);
-	        writeJump(conditionLabel);
-	        writeLabel(endLabel);
+        builder_.setBlock(bodyLabel);
+        continueStack_.push_back(updateLabel);
+        breakStack_.push_back(endLabel);
+        RangeLoop loop;
+        bool ranged = rangeLoop(node, loop);
+        if(ranged)
+        {
+            rangeLoops_.push_back(loop);
+        }
+        node->body->accept(this);
+        if(ranged)
+        {
+            // 0 <= i < a.length holds in the body, unless it assigns i or a
+            loop = rangeLoops_.back();
+            rangeLoops_.pop_back();
+            if(!loop.assigned)
+            {
+                safeChecks_.insert(safeChecks_.end(), loop.checks.begin(), loop.checks.end());
+            }
+        }
+        continueStack_.pop_back();
+        breakStack_.pop_back();
 
-			continueStack_.pop_back();
-            breakStack_.pop_back();
-    	}
+        builder_.setBlock(updateLabel);
+        if(node->update)
+        {
+            gene(node->update);
+        }
+        builder_.br(condLabel);
+        builder_.setBlock(endLabel);
     }
 
     void IRGenerator::visit(WhileStmt *node)
     {
-    	if(oneVistor_)
-    	{
-    		node->condition->accept(this);
-        	node->body->accept(this);
-		}
-    	else
-    	{
-    		int conditionLabel = labelCount_++;
-	    	int bodyLabel = labelCount_++;
-	    	int endLabel = labelCount_++;
-
-	    	continueStack_.push_back(conditionLabel);
-	    	breakStack_.push_back(endLabel);
-
-	    	writeJump(conditionLabel);
-
-	    	writeLabel(conditionLabel);
-	        node->condition->accept(this);
-	        writeCJump(labelCount_-1,bodyLabel,endLabel);  //CJump;
-
-	        writeLabel(bodyLabel);
-	        node->body->accept(this);
-	        writeJump(conditionLabel);
+        auto condLabel = builder_.newLabel("while.cond");
+        auto bodyLabel = builder_.newLabel("while.body");
+        auto endLabel = builder_.newLabel("while.end");
 
-	        writeLabel(endLabel);
+        builder_.setBlock(condLabel);
+        branch(node->condition, bodyLabel, endLabel);
 
-	        continueStack_.pop_back();
-	        breakStack_.pop_back();
-		}
+        builder_.setBlock(bodyLabel);
+        continueStack_.push_back(condLabel);
+        breakStack_.push_back(endLabel);
+        node->body->accept(this);
+        continueStack_.pop_back();
+        breakStack_.pop_back();
 
+        if(!builder_.terminated())
+        {
+            builder_.br(condLabel);
+        }
+        builder_.setBlock(endLabel);
     }
 
     void IRGenerator::visit(DoStmt *node)
     {
-    	if(oneVistor_){
-    		node->body->accept(this);
-        	node->condition->accept(this);
-		}
-    	else
-    	{
-	    	int bodyLabel = labelCount_++;
-	    	int conditionLabel = labelCount_++;
-	    	int endLabel = labelCount_++;
-
-	    	continueStack_.push_back(conditionLabel);
-	    	breakStack_.push_back(endLabel);
-
-	    	writeJump(bodyLabel);
-
-	    	writeLabel(bodyLabel);
-	    	node->body->accept(this);
-	    	writeJump(conditionLabel);
+        auto bodyLabel = builder_.newLabel("do.body");
+        auto condLabel = builder_.newLabel("do.cond");
+        auto endLabel = builder_.newLabel("do.end");
 
-	    	writeLabel(conditionLabel);
-	        node->condition->accept(this);
-	        writeCJump(labelCount_-1,bodyLabel,endLabel);  //CJump;
-
-	        writeLabel(endLabel);
-
-	        continueStack_.pop_back();
-	        breakStack_.pop_back();
-		}
+        builder_.setBlock(bodyLabel);
+        continueStack_.push_back(condLabel);
+        breakStack_.push_back(endLabel);
+        node->body->accept(this);
+        continueStack_.pop_back();
+        breakStack_.pop_back();
 
+        builder_.setBlock(condLabel);
+        branch(node->condition, bodyLabel, endLabel);
+        builder_.setBlock(endLabel);
     }
 
+    // cases fall through to the next one unless they break
     void IRGenerator::visit(SwitchStmt *node)
     {
-       	if(oneVistor_){
-        	node->flag->accept(this);
-	        for(auto c : node->cases)
-	        {
-	            c->accept(this);
-	        }
-	        if(!node->defaultBody.empty())
-	        {
-	            for(auto v : node->defaultBody)
-	            {
-	                v->accept(this);
-	            }
-	        }
-		}
+        auto intType = symbolTable_->getTypeIndex("int");
+        auto flag = convert(gene(node->flag), node->flag->getType(), intType);
+        auto endLabel = builder_.newLabel("sw.end");
+        auto defaultLabel = node->defaultBody.empty() ? endLabel : builder_.newLabel("sw.default");
+
+        std::vector<std::pair<std::string, std::string>> cases;
+        for(auto c : node->cases)
+        {
+            auto label = static_cast<CaseStmt *>(c)->label;
+            cases.push_back(std::make_pair(gene(label).name, builder_.newLabel("sw.case")));
+        }
+        builder_.switchOn(flag, defaultLabel, cases);
 
+        breakStack_.push_back(endLabel);
+        for(size_t i = 0; i < node->cases.size(); i++)
+        {
+            builder_.setBlock(cases[i].second);
+            node->cases[i]->accept(this);
+        }
+        if(!node->defaultBody.empty())
+        {
+            builder_.setBlock(defaultLabel);
+            for(auto stmt : node->defaultBody)
+            {
+                stmt->accept(this);
+            }
+        }
+        breakStack_.pop_back();
+        builder_.setBlock(endLabel);
     }
 
     void IRGenerator::visit(CaseStmt *node)
     {
-		if(oneVistor_)
-		{
-
-	        node->label->accept(this);
-	        for(auto v : node->statements)
-	        {
-	            v->accept(this);
-	        }
-		}
+        for(auto stmt : node->statements)
+        {
+            stmt->accept(this);
+        }
     }
 
     void IRGenerator::visit(ReturnStmt *node)
     {
-    	if(oneVistor_){
-    		if(node->returnValue)
-        	{
-            	node->returnValue->accept(this);
-        	}
-		}
-		else{
-			ret_ = false;
-	        if(node->returnValue)
-	        {
-	            node->returnValue->accept(this);
-	        }
-	        if(ret_)
-			{
-	        	output_<<"\tret "<<numeric(node->returnValue->getType())<<" "<<ret_value<<endl;
-			}
-			else
-			{
-				output_<<"\tret "<<numeric(node->returnValue->getType())<<" "<<labelCount_-1<<"%"<<endl;
-			}
-			ret_ = false;
-		}
-
+        IRValue value;
+        if(node->returnValue)
+        {
+            value = convert(gene(node->returnValue), node->returnValue->getType(), returnType_);
+        }
+        if(isMain_)
+        {
+            builder_.ret(IRValue{"i32", "0"});
+        }
+        else if(node->returnValue && function_.returnType != "void")
+        {
+            builder_.ret(value);
+        }
+        else
+        {
+            builder_.retVoid();
+        }
     }
 
     void IRGenerator::visit(BreakStmt *node)
     {
-    	if(!oneVistor_){
-			writeJump(breakStack_.back());
-    	}
+        if(!breakStack_.empty())
+        {
+            builder_.br(breakStack_.back());
+        }
 	}
 
     void IRGenerator::visit(ContinueStmt *node)
     {
-    	if(!oneVistor_){
-    		writeJump(continueStack_.back());
-		}
+        if(!continueStack_.empty())
+        {
+            builder_.br(continueStack_.back());
+        }
     }
 
     void IRGenerator::visit(Expr *node)
     {
-        output_ << "you should not visit here in Expr" << endl;
+        cout << "you should not visit here in Expr" << endl;
     }
 
     void IRGenerator::visit(VariableDeclExpr *node)
     {
-        if(oneVistor_){
-	    //	writeAlloca(node->name,info->getType());   //alloca
-	    	writeAlloca(node->name,node->getType());
-		}
-		else
-		{
-			if(symbolTable_->hasVariable(node->name,false))
-			{
-
-			}
-			else
-			{
-				symbolTable_->add(node->name, *info);
-			}
-
-			if(node->initValue)
-	        {
-	        	callRet_ = true;
-	        	constant_ = false ;
-	            node->initValue->accept(this);
-	            if(constant_)
-				{
-	            	writeStore_value(info->getType(),constant_value,node->name);
-					constant_ = true;
-				}
-				else
-				{
-					auto initCount = labelCount_-1;
-	            	writeStore(info->getType(),std::to_string(initCount),node->name);   //store
-				}
-				callRet_ = false;
-	        }
-		}
+        SymbolInfo info(declType_, declFlags_);
+        symbolTable_->add(node->name, info);
+
+        IRValue slot;
+        if(info.check(SymbolTag::STATIC))
+        {
+            auto global = symbolTable_->getVariableInfo(node->name);
+            slot = IRValue{typeIR(declType_) + "*", "@" + global.getFullName()};
+        }
+        else
+        {
+            slot = builder_.allocate(typeIR(declType_), node->name);
+        }
+        locals_.push_back(Local{node->name, slot, declType_});
+
+        if(node->initValue)
+        {
+            auto type = declType_;
+            builder_.store(convert(gene(node->initValue), node->initValue->getType(), type), slot);
+        }
     }
 
     void IRGenerator::visit(IdentifierExpr *node)
     {
-		if(!oneVistor_)
-		{
-			if(symbolTable_->hasVariable(node->name))
-			{
-        		auto nodeInfo = symbolTable_->getVariableInfo(node->name);
-				node->setType(nodeInfo.getType());  //��������
-			}
-
-			if(fuzhi_)
-			{
-				fuzhi_name = node->name;
-			}
-			else if(incre_)
-			{
-				writeLoad(labelCount_,node->getType(),node->name);   //Load
-				labelCount_++;
-				output_<<"\t%"<<labelCount_<<" = add nsw "<<numeric(node->getType())<<" %"<<labelCount_-1<<", 1"<<endl;
-				labelCount_++;
-				writeStore(node->getType(),std::to_string(labelCount_-1),node->name);
-
-			}
-			else
-			{
-				writeLoad(labelCount_,node->getType(),node->name);    //load
-				labelCount_++;
-
-				auto nodeInfo = symbolTable_->getVariableInfo(node->name);
-				node->setType(nodeInfo.getType());  //��������
-
+        // a class name qualifies, except as a member of an object or class
+        if(qualifying_ && !qualifier_)
+        {
+            qualifier_ = symbolTable_->getClassTable(node->name);
+            if(qualifier_)
+            {
+                return ;
+            }
+        }
 
-			}
-		}
+        auto table = qualifier_;
+        auto object = object_;
+        qualifier_ = nullptr;
+        object_ = IRValue();
+        IRValue slot{"i32*", "null"};
+        int type = symbolTable_->getTypeIndex("int");
+        bool found = false;
+        if(table && !object.name.empty())
+        {
+            slot = field(table, object, node->name, type);
+            found = !slot.name.empty();
+        }
+        for(auto local = locals_.rbegin(); !table && local != locals_.rend(); ++local)
+        {
+            if(local->name == node->name)
+            {
+                slot = local->address;
+                type = local->type;
+                found = true;
+                break;
+            }
+        }
+        if(!found && !table && !this_.name.empty())
+        {
+            // a field of this, unless a local hides it
+            slot = field(symbolTable_->getClassTable(className_), this_, node->name, type);
+            found = !slot.name.empty();
+        }
+        if(!found && (table ? table->hasVariable(node->name, false) : symbolTable_->hasVariable(node->name)))
+        {
+            auto info = table ? table->getVariableInfo(node->name) : symbolTable_->getVariableInfo(node->name);
+            type = info.getType();
+            slot = IRValue{typeIR(type) + "*", "@" + info.getFullName()};
+        }
 
+        if(lvalue_)
+        {
+            lvalueType_ = type;
+            value_ = slot;
+            for(auto &loop : rangeLoops_)
+            {
+                loop.assigned = loop.assigned || loop.index == node->name || loop.array == node->name;
+            }
+        }
+        else
+        {
+            value_ = builder_.load(typeIR(type), slot);
+        }
     }
 
     void IRGenerator::visit(NewExpr *node)
     {
-		if(oneVistor_)
-		{
-
-        	node->constructor->accept(this);
-		}
+        // new Type[n][m]: all sizes first, then the arrays
+        std::vector<IRValue> sizes;
+        auto expr = node->constructor;
+        while(auto index = dynamic_cast<IndexExpr *>(expr))
+        {
+            sizes.insert(sizes.begin(), IRValue());
+            expr = index->left;
+        }
+        expr = node->constructor;
+        for(size_t i = sizes.size(); i > 0; i--)
+        {
+            auto index = static_cast<IndexExpr *>(expr);
+            sizes[i - 1] = convert(gene(index->index), index->index->getType(), symbolTable_->getTypeIndex("int"));
+            expr = index->left;
+        }
+        if(sizes.empty())
+        {
+            // new Class(): zeroed fields are the default values, there are no constructors yet
+            auto objectType = typeIR(node->getType());
+            auto structType = objectType.substr(0, objectType.size() - 1);
+            auto size = "ptrtoint (" + objectType + " getelementptr (" + structType + ", "
+                      + objectType + " null, i32 1) to i64)";
+            auto memory = builder_.call("i8*", "@ycc.alloc", {IRValue{"i64", size}});
+            value_ = builder_.cast("bitcast", memory, objectType);
+            return ;
+        }
+        value_ = newArray(node->getType(), sizes, 0);
     }
 
     void IRGenerator::visit(IndexExpr *node)
     {
-		if(oneVistor_)
-		{
-
-        	node->left->accept(this);
-        	node->index->accept(this);
-		}
+        auto lvalue = lvalue_;
+        int type;
+        auto slot = element(node, type);
+        if(lvalue)
+        {
+            lvalueType_ = type;
+            value_ = slot;
+        }
+        else
+        {
+            value_ = builder_.load(typeIR(type), slot);
+        }
     }
 
     void IRGenerator::visit(CallExpr *node)
     {
-    	if(!oneVistor_)
-		{
-			call_value = true;
-			auto mInfo = symbolTable_->getMethodInfo(node->callee);
-	    	if(callRet_)
-			{
-				writeCall(labelCount_,node->callee,mInfo);
-	        	labelCount_++;
-			}
-			else
-			{
-				writeCall(0,node->callee,mInfo);
-			}
-			call_index = 0;
-			call_name = node->callee;
-	        for(auto v : node->arguments)
-	        {
-	            v->accept(this);
-	            call_index++;
-	        }
-	       	output_<<") "<<endl;
-			constant_ = false;
-			call_value = false;
-		}
-    }
-
-    void IRGenerator::visit(QualifiedIdExpr *node)     //  .
-    {
-		if(oneVistor_)
-		{
-       		node->left->accept(this);
-        	node->right->accept(this);
-        	auto rt = node->right->getType();
-        	node->setType(rt);
-    	}
+        auto table = qualifier_;
+        auto object = object_;
+        qualifier_ = nullptr;
+        object_ = IRValue();
+        bool found = table ? table->hasMethod(node->callee, false) : symbolTable_->hasMethod(node->callee);
+        if(!found)
+        {
+            value_ = IRValue{"i32", "undef"};
+            return ;
+        }
+        auto mInfo = table ? table->getMethodInfo(node->callee) : symbolTable_->getMethodInfo(node->callee);
+
+        // object.method() passes the object, method() in an instance method this
+        std::vector<IRValue> args;
+        if(symbolTable_->hasThis(table ? table->className() : className_, mInfo))
+        {
+            auto receiver = table ? object : this_;
+            if(receiver.name.empty())
+            {
+                // a static reference, reported by the semantic check
+                value_ = IRValue{"i32", "undef"};
+                return ;
+            }
+            args.push_back(receiver);
+        }
+        for(size_t i = 0; i < node->arguments.size() && i < mInfo.paramTypes_.size(); i++)
+        {
+            auto arg = node->arguments[i];
+            args.push_back(convert(gene(arg), arg->getType(), mInfo.paramTypes_[i]));
+        }
+        value_ = builder_.call(typeIR(mInfo.getType()), "@" + mInfo.getFullName(), args);
     }
 
-    void IRGenerator::visit(IntExpr *node)
+    // Class.method(...), Class.field and object.field: the class is the qualifier
+    // of the right, an object on the left its object
+    void IRGenerator::visit(QualifiedIdExpr *node)
     {
-        node->setType(symbolTable_->getTypeIndex("int"));
-        if(!oneVistor_){
-
-        	if(call_value){
-        		auto mInfo = symbolTable_->getMethodInfo(call_name);
+        auto lvalue = lvalue_;
+        lvalue_ = false;
+        qualifying_ = true;
+        auto left = gene(node->left);
+        qualifying_ = false;
+        if(!qualifier_)
+        {
+            auto type = node->left->getType();
+            if(symbolTable_->getTypeInfo(type).isArray())
+            {
+                // array.length
+                value_ = arrayLength(left);
+                lvalue_ = lvalue;
+                return ;
+            }
+            qualifier_ = symbolTable_->getClassTable(symbolTable_->getTypeName(type));
+            object_ = left;
+        }
+        lvalue_ = lvalue;
+        node->right->accept(this);
+    }
 
-        		output_<<numeric(mInfo.paramTypes_[call_index])<<" "<<node->lexeme;
-			}
-			else if(!ret_){
-				ret_ = true;
-				ret_value = node->lexeme;
-			}
-			constant_ = true;
-    		constant_value = node->lexeme;
-		}
+    void IRGenerator::visit(IntExpr *node)
+    {
+        if(node->isChar)
+        {
+            value_ = IRValue{typeIR(node->getType()), std::to_string(charCode(node->lexeme))};
+            return ;
+        }
+        std::string digits;
+        for(auto c : node->lexeme)
+        {
+            if(c != '_' && c != 'l' && c != 'L')
+            {
+                digits += c;
+            }
+        }
+        auto value = std::strtoull(digits.c_str(), nullptr, 0);
+        value_ = IRValue{typeIR(node->getType()), std::to_string((long long)value)};
     }
 
     void IRGenerator::visit(RealExpr *node)
     {
-    	node->setType(symbolTable_->getTypeIndex("double"));
-        if(!oneVistor_){
-        	if(call_value){
-        		auto mInfo = symbolTable_->getMethodInfo(call_name);
-
-        		output_<<numeric(mInfo.paramTypes_[call_index])<<" "<<node->lexeme;
-			}
-			else
-			{
-				constant_ = true;
-        		constant_value = node->lexeme;
-			}
-		}
+        auto type = typeIR(node->getType());
+        double value = std::strtod(node->lexeme.c_str(), nullptr);
+        value_ = IRValue{type, realConstant(type == "float" ? (double)(float)value : value)};
     }
 
     void IRGenerator::visit(BoolExpr *node)
     {
-        node->setType(symbolTable_->getTypeIndex("boolean"));
-        if(!oneVistor_)
-		{
-        	if(node->value)
-			{
-        		constant_ = true;
-        		constant_value = "1";
-			}
-			else
-			{
-				constant_ = true;
-        		constant_value = "0";
-			}
-		}
+        value_ = IRValue{"i1", node->value ? "true" : "false"};
     }
 
     void IRGenerator::visit(NullExpr *node)
     {
-
-        //TODO:
+        value_ = IRValue{"i8*", "null"};
     }
 
     void IRGenerator::visit(StrExpr *node)
     {
-        // TODO: string literal
-        node->setType(symbolTable_->getTypeIndex("String"));
+        auto size = std::to_string(symbolTable_->getLiteralInfo(node->value).getArraySize());
+        auto array = "[" + size + " x i8]";
+        value_ = IRValue{"i8*", "getelementptr inbounds (" + array + ", " + array + "* @"
+                                + node->value + ", i64 0, i64 0)"};
     }
 
     void IRGenerator::visit(ArrayExpr *node)
     {
-
-        for(auto elem : node->elems)
+        auto type = node->getType();
+        auto elemType = symbolTable_->getTypeInfo(type).arrayOf();
+        auto count = IRValue{"i32", std::to_string(node->elems.size())};
+        auto array = newArray(type, {count}, 0);
+        auto structType = array.type.substr(0, array.type.size() - 1);
+        for(size_t i = 0; i < node->elems.size(); i++)
         {
-            elem->accept(this);
+            auto elem = node->elems[i];
+            auto value = convert(gene(elem), elem->getType(), elemType);
+            auto slot = builder_.gep(structType, array, {IRValue{"i32", "0"}, IRValue{"i32", "1"},
+                                     IRValue{"i32", std::to_string(i)}}, value.type + "*");
+            builder_.store(value, slot);
         }
-
+        value_ = array;
     }
 
     void IRGenerator::visit(UnaryOpExpr *node)
     {
+        if(node->op == TokenTag::INCRE || node->op == TokenTag::DECRE)
+        {
+            int type;
+            auto slot = address(node->expr, type);
+            auto old = builder_.load(typeIR(type), slot);
+            IRValue one{old.type, isReal(type) ? realConstant(1) : "1"};
+            auto updated = arithmetic(node->op == TokenTag::INCRE ? TokenTag::PLUS : TokenTag::MINUS,
+                                      old, one, type);
+            builder_.store(updated, slot);
+            value_ = node->isPrefix ? updated : old;
+            return ;
+        }
 
-        auto et = node->expr->getType();
-        incre_ = false;
-        if(!oneVistor_)
-		{
-        	if(tokenDesc(node->op) == "incre"){
-        		incre_ = true;
-			}
-		}
-        node->expr->accept(this);
-        incre_ = false;
+        auto value = gene(node->expr);
+        switch(node->op)
+        {
+        case TokenTag::MINUS:
+            if(value.isConstant() && bitsOf(value.type) > 1)
+            {
+                // a negative literal stays a constant, x / -3 is then a division by a constant too
+                int unused = 64 - bitsOf(value.type);
+                auto negated = 0ULL - (unsigned long long)std::strtoll(value.name.c_str(), nullptr, 10);
+                value_ = IRValue{value.type, std::to_string((long long)(negated << unused) >> unused)};
+                break;
+            }
+            value_ = isRealIR(value.type)
+                   ? builder_.binary("fsub", IRValue{value.type, realConstant(-0.0)}, value)
+                   : builder_.binary("sub", IRValue{value.type, "0"}, value);
+            break;
+        case TokenTag::NOT:
+            value_ = builder_.binary("xor", value, IRValue{value.type, value.type == "i1" ? "true" : "1"});
+            break;
+        case TokenTag::TILDE:
+            value_ = builder_.binary("xor", value, IRValue{value.type, "-1"});
+            break;
+        default:
+            value_ = value;
+            break;
+        }
     }
 
     void IRGenerator::visit(BinaryOpExpr *node)
     {
-        if(!oneVistor_){
-        	std::string op_name = tokenDesc(node->op);
-	      	if(isAssignmentOperator(node->op))
-			{         //��ֵ������
-
-				fuzhi_ = false;
-				constant_ = false;
-				callRet_ = true;
-	        	node->right->accept(this);
-	        	auto rCount = labelCount_-1;
-	        	auto rt = node->right->getType();      // ����������
-	        	fuzhi_ = true;
-	        	node->left->accept(this);
-	        	auto lt = node->left->getType();       //����������
-
-	        	node->setType(lt);
-	        	if(constant_){    //ֱ�Ӹ�ֵ����
-	        		writeStore_value(lt,constant_value,fuzhi_name);       //store_value
-				}
-				else{
-					writeStore(lt,std::to_string(rCount),fuzhi_name);          //store
-				}
-
-
-	        	fuzhi_ = false;
-	        	constant_ = false;
-	        	callRet_ = false;
-			}
-			else
-			{
-				constant_=false;
-				std::string lcon,rcon;
-
-				node->left->accept(this);
-
-				if(constant_){
-					lcon = constant_value;
-					constant_=false;
-				}
-				auto lCount = labelCount_-1;
-	        	auto lt = node->left->getType();
-
-	        	node->right->accept(this);
-
-	        	if(constant_){
-					rcon = constant_value;
-					constant_=false;
-				}
-	        	auto rCount = labelCount_-1;
-	        	auto rt = node->right->getType();
-	        	node->setType(lt);
-
-	        	if(lcon.empty()&& rcon.empty())
-                {
-	        		writeBinaryOp(labelCount_,change_Op(node->op),lt,std::to_string(lCount),std::to_string(rCount),1);
-				}
-				else if(lcon.empty()&& !rcon.empty())
-	        	{
-	        		writeBinaryOp(labelCount_,change_Op(node->op),lt,std::to_string(lCount),rcon,2);
-				}
-				else if(!lcon.empty()&& rcon.empty())
-				{
-					writeBinaryOp(labelCount_,change_Op(node->op),lt,lcon,std::to_string(rCount),3);
-				}
-				else
-				{
-					writeBinaryOp(labelCount_,change_Op(node->op),lt,lcon,rcon,4);
-				}
-				labelCount_++;
-			}
-		}
-    }
+        if(isAssignmentOperator(node->op))
+        {
+            int type;
+            auto slot = address(node->left, type);
+            auto value = convert(gene(node->right), node->right->getType(), type);
+            if(node->op != TokenTag::ASSIGN)
+            {
+                auto current = builder_.load(typeIR(type), slot);
+                value = arithmetic(arithmeticOf(node->op), current, value, type);
+            }
+            builder_.store(value, slot);
+            value_ = value;
+            return ;
+        }
 
-    void IRGenerator::visit(TernaryOpExpr *node)
-    {
+        auto lt = node->left->getType();
+        auto rt = node->right->getType();
+        if(isLogicOperator(node->op))
+        {
+            // a right side without effects is evaluated anyway, that needs no jump
+            if(speculatable(node->right))
+            {
+                auto lhs = condition(node->left);
+                auto rhs = condition(node->right);
+                value_ = builder_.binary(node->op == TokenTag::LOGIC_AND ? "and" : "or", lhs, rhs);
+                return ;
+            }
+            auto trueLabel = builder_.newLabel("logic.true");
+            auto falseLabel = builder_.newLabel("logic.false");
+            auto endLabel = builder_.newLabel("logic.end");
+            branch(node, trueLabel, falseLabel);
+            builder_.setBlock(trueLabel);
+            builder_.br(endLabel);
+            builder_.setBlock(falseLabel);
+            builder_.setBlock(endLabel);
+            value_ = builder_.phi("i1", {IRValue{"i1", "true"}, IRValue{"label", trueLabel},
+                                         IRValue{"i1", "false"}, IRValue{"label", falseLabel}});
+            return ;
+        }
 
+        auto lhs = gene(node->left);
+        auto rhs = gene(node->right);
+        if(isCompareOperator(node->op))
+        {
+            auto type = lt > rt ? lt : rt;
+            lhs = convert(lhs, lt, type);
+            rhs = convert(rhs, rt, type);
+            bool isUnsigned = lhs.type == "i1" || symbolTable_->getTypeName(type) == "char";
+            value_ = builder_.cmp(compareOpcode(node->op, isRealIR(lhs.type), isUnsigned), lhs, rhs);
+            return ;
+        }
 
-        node->condition->accept(this);
+        auto type = node->getType();
+        value_ = arithmetic(node->op, convert(lhs, lt, type), convert(rhs, rt, type), type);
+    }
 
-        node->thenValue->accept(this);
+    void IRGenerator::visit(TernaryOpExpr *node)
+    {
+        auto type = node->getType();
+        if(speculatable(node->thenValue) && speculatable(node->elseValue))
+        {
+            auto cond = condition(node->condition);
+            auto thenValue = convert(gene(node->thenValue), node->thenValue->getType(), type);
+            auto elseValue = convert(gene(node->elseValue), node->elseValue->getType(), type);
+            value_ = builder_.select(cond, thenValue, elseValue);
+            return ;
+        }
 
-        int thenType =node->thenValue->getType();
+        auto thenLabel = builder_.newLabel("cond.then");
+        auto elseLabel = builder_.newLabel("cond.else");
+        auto endLabel = builder_.newLabel("cond.end");
+        branch(node->condition, thenLabel, elseLabel);
 
-        node->elseValue->accept(this);
+        builder_.setBlock(thenLabel);
+        auto thenValue = convert(gene(node->thenValue), node->thenValue->getType(), type);
+        auto thenEnd = builder_.currentLabel();
+        builder_.br(endLabel);
 
-        int elseType = node->elseValue->getType();
+        builder_.setBlock(elseLabel);
+        auto elseValue = convert(gene(node->elseValue), node->elseValue->getType(), type);
+        auto elseEnd = builder_.currentLabel();
 
-		node->setType(thenType);
+        builder_.setBlock(endLabel);
+        value_ = builder_.phi(thenValue.type, {thenValue, IRValue{"label", thenEnd},
+                                               elseValue, IRValue{"label", elseEnd}});
     }
 }
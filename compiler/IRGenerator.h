@@ -3,7 +3,9 @@
 
 #include "../parser/vistor.h"
 #include "../parser/ast.hpp"
+#include "ir.h"
 #include <fstream>
+#include <sstream>
 
 namespace ycc
 {
@@ -13,9 +15,23 @@ namespace ycc
         IRGenerator(const std::string &name);
         ~IRGenerator() = default;
 
-        void gene(VecNodePtr ast);
+        void generate(VecNodePtr ast);
+        void write();
+        void write(std::ostream &output);
+        void setJobs(int jobs);
+        void setBitcode(bool bitcode);
+        void setLinkApi(bool linkApi);
+        void addRuntime(const std::string &ir);
+
+        long instructions() const;
+        long bytes() const;
+        std::vector<IRFunction> & functions();
+        static long countInstructions(const std::string &ir);
 
     private:
+        IRGenerator();
+        IRFunction geneMethod(const MethodUnit &unit);
+
         void visit(ASTNode *node);
         void visit(Stmt *node);
         void visit(EmptyStmt *node);
@@ -51,45 +67,93 @@ namespace ycc
         void visit(TernaryOpExpr *node);
 
         // generator tools
-        void writeMethod_begin(std::string name,MethodInfo mInfo);
-        void writeMethod_end(MethodInfo mInfo);
-        void writeAlloca(std::string Name,int Type);
-        void writeStore(int type,std::string oneName,std::string twoName);        // twoName->oneName
-        void writeStore_value(int type,std::string oneName_value,std::string twoName);
-        
-        
-        void writeLoad(int labelCount,int Type,std::string Name);                //Name->labelCount
-        void writeLabel(int count);
-        void writeJump(int Label);
-        void writeCJump(int C,int thenLabel,int elseLabel);
-        void writeCall(int labelCount,std::string name,MethodInfo mInfo);
-        void writeBinaryOp(int labelCount,std::string op,int type,std::string lCount,std::string rCount,int model);
-        
+        std::string         typeIR(int typeIndex);
+        bool                isReal(int typeIndex);
+        IRValue             gene(ExprPtr expr);
+        IRValue             convert(const IRValue &value, int from, int to);
+        IRValue             condition(ExprPtr expr);
+        void                branch(ExprPtr expr, const std::string &thenLabel, const std::string &elseLabel);
+        IRValue             address(ExprPtr expr, int &type);
+        IRValue             field(const ClassTable *table, const IRValue &object, const std::string &name, int &type);
+        IRValue             arithmetic(TokenTag op, IRValue lhs, IRValue rhs, int type);
+        void                enterScope();
+        void                leaveScope();
+        bool                constant(ExprPtr expr, int type, std::string &value);
+
+        // arrays
+        IRValue             arrayLength(const IRValue &array);
+        IRValue             newArray(int type, const std::vector<IRValue> &sizes, size_t dim);
+        IRValue             element(IndexExpr *node, int &type);
+
+        // for(i = 0; i < a.length; i++) whose body assigns neither i nor a needs
+        // no bounds check of a[i] in the body; the checks go when the body is done
+        struct RangeLoop
+        {
+            std::string                 index;
+            std::string                 array;
+            bool                        assigned;
+            std::vector<std::string>    checks;     // fail labels of the checks of a[i]
+        };
+        bool                rangeLoop(ForStmt *node, RangeLoop &loop);
+        void                dropCheck(const std::string &failLabel);
+
+        // a local variable or parameter and its stack slot
+        struct Local
+        {
+            std::string     name;
+            IRValue         address;
+            int             type;
+        };
 
     private:
-    	std::ofstream 		output_;
-    	SymbolInfo      	*info;
+        std::string         filename_;
+        int                 jobs_;
+        bool                bitcode_;       // write LLVM bitcode instead of text
+        bool                linkApi_;       // declare the api modules the backend links
+        std::string         runtimes_;      // IR of the passes, the profile counters
+        VecMethodUnit *     methods_;       // not null while collecting method bodies
+        std::string         className_;
+        std::vector<IRFunction>     functions_;     // every method, in source order
+        long                instructions_;
+        long                bytes_;
+
         SymbolTable *       symbolTable_;
-        int                 labelCount_;
-        bool				oneVistor_;
-        int					primaryType;
-        bool 				fuzhi_;
-        std::string			fuzhi_name;
-        std::string	    	numeric(int typeIndex);
-        bool 				constant_;
-        std::string			constant_value;
-        bool				incre_;
-        bool				callRet_;
-        bool				call_value;
-        int 				call_index;
-        std::string 		call_name;
-        
-        bool				ret_;
-        std::string			ret_value;
-
-        std::vector<int>    breakStack_;
-        std::vector<int>    continueStack_;
+        IRFunction          function_;      // the method being generated
+        IRBuilder           builder_;
+        int                 returnType_;
+        bool                isMain_;
+        IRValue             value_;         // value of the last expression
+        int                 declType_;      // type of the declarations being generated
+        SymbolFlag          declFlags_;
+        const ClassTable *  qualifier_;     // class named on the left of a '.'
+        IRValue             object_;        // object on the left of a '.', if any
+        IRValue             this_;          // object of an instance method
+        bool                lvalue_;        // generate the address of a variable, not its value
+        int                 lvalueType_;
+        bool                qualifying_;    // looking for the class on the left of a '.'
+
+        std::vector<Local>          locals_;
+        std::vector<size_t>         localBase_;
+        std::vector<std::string>    breakStack_;
+        std::vector<std::string>    continueStack_;
+        std::vector<RangeLoop>      rangeLoops_;
+        std::vector<std::string>    safeChecks_;    // bounds checks to drop from the function
     };
+
+    inline long IRGenerator::instructions() const
+    {
+        return instructions_;
+    }
+
+    inline long IRGenerator::bytes() const
+    {
+        return bytes_;
+    }
+
+    inline std::vector<IRFunction> & IRGenerator::functions()
+    {
+        return functions_;
+    }
 }
 
 #endif
@@ -0,0 +1,2275 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include "bitcode.h"
+
+namespace ycc
+{
+    namespace
+    {
+        // block ids, record codes and operand encodings of llvm/Bitcode/LLVMBitCodes.h
+        enum : unsigned
+        {
+            MODULE_BLOCK = 8, PARAMATTR_BLOCK = 9, PARAMATTR_GROUP_BLOCK = 10, CONSTANTS_BLOCK = 11,
+            FUNCTION_BLOCK = 12, VALUE_SYMTAB_BLOCK = 14, METADATA_BLOCK = 15, METADATA_ATTACHMENT_BLOCK = 16,
+            TYPE_BLOCK = 17, METADATA_KIND_BLOCK = 22, STRTAB_BLOCK = 23
+        };
+
+        enum : unsigned
+        {
+            MODULE_VERSION = 1, MODULE_TRIPLE = 2, MODULE_DATALAYOUT = 3, MODULE_GLOBALVAR = 7,
+            MODULE_FUNCTION = 8,
+            PARAMATTR_ENTRY = 2, PARAMATTR_GROUP_ENTRY = 3,
+            TYPE_NUMENTRY = 1, TYPE_VOID = 2, TYPE_FLOAT = 3, TYPE_DOUBLE = 4, TYPE_LABEL = 5,
+            TYPE_OPAQUE = 6, TYPE_INTEGER = 7, TYPE_POINTER = 8, TYPE_ARRAY = 11, TYPE_STRUCT_ANON = 18,
+            TYPE_STRUCT_NAME = 19, TYPE_STRUCT_NAMED = 20, TYPE_FUNCTION = 21,
+            CST_SETTYPE = 1, CST_NULL = 2, CST_UNDEF = 3, CST_INTEGER = 4, CST_WIDE_INTEGER = 5,
+            CST_FLOAT = 6, CST_AGGREGATE = 7, CST_STRING = 8, CST_CE_CAST = 11, CST_CE_GEP = 12,
+            CST_CE_INBOUNDS_GEP = 20,
+            INST_DECLAREBLOCKS = 1, INST_BINOP = 2, INST_CAST = 3, INST_RET = 10, INST_BR = 11,
+            INST_SWITCH = 12, INST_UNREACHABLE = 15, INST_PHI = 16, INST_ALLOCA = 19, INST_LOAD = 20,
+            INST_CMP2 = 28, INST_VSELECT = 29, INST_CALL = 34, INST_GEP = 43, INST_STORE = 44,
+            INST_UNOP = 56,
+            VST_ENTRY = 1, VST_BBENTRY = 2, STRTAB_BLOB = 1,
+            METADATA_STRING_OLD = 1, METADATA_VALUE = 2, METADATA_NODE = 3, METADATA_KIND = 6,
+            METADATA_ATTACHMENT = 11
+        };
+
+        // call flags: tail, musttail and the function type given explicitly
+        const unsigned CALL_TAIL = 1 << 0;
+        const unsigned CALL_MUSTTAIL = 1 << 14;
+        const unsigned CALL_EXPLICIT_TYPE = 1 << 15;
+        const uint64_t FUNCTION_INDEX = 0xFFFFFFFF;
+
+        const std::map<std::string, unsigned> linkages{
+            {"external", 0}, {"appending", 2}, {"internal", 3}, {"extern_weak", 7}, {"common", 8},
+            {"private", 9}, {"available_externally", 12}, {"weak", 16}, {"weak_odr", 17},
+            {"linkonce", 18}, {"linkonce_odr", 19}};
+
+        const std::map<std::string, unsigned> attributeKinds{
+            {"alwaysinline", 2}, {"inlinehint", 4}, {"noalias", 9}, {"nocapture", 11}, {"noinline", 14},
+            {"noreturn", 17}, {"nounwind", 18}, {"readnone", 20}, {"readonly", 21}, {"signext", 24},
+            {"zeroext", 34}, {"cold", 36}, {"optnone", 37}, {"nonnull", 39}, {"argmemonly", 45},
+            {"norecurse", 48}, {"writeonly", 52}, {"speculatable", 53}, {"willreturn", 61},
+            {"nofree", 62}, {"noundef", 68}};
+
+        const std::map<std::string, unsigned> binaryOpcodes{
+            {"add", 0}, {"sub", 1}, {"mul", 2}, {"udiv", 3}, {"sdiv", 4}, {"urem", 5}, {"srem", 6},
+            {"shl", 7}, {"lshr", 8}, {"ashr", 9}, {"and", 10}, {"or", 11}, {"xor", 12},
+            {"fadd", 0}, {"fsub", 1}, {"fmul", 2}, {"fdiv", 4}, {"frem", 6}};
+
+        const std::map<std::string, unsigned> castOpcodes{
+            {"trunc", 0}, {"zext", 1}, {"sext", 2}, {"fptoui", 3}, {"fptosi", 4}, {"uitofp", 5},
+            {"sitofp", 6}, {"fptrunc", 7}, {"fpext", 8}, {"ptrtoint", 9}, {"inttoptr", 10},
+            {"bitcast", 11}};
+
+        const std::map<std::string, unsigned> predicates{
+            {"false", 0}, {"oeq", 1}, {"ogt", 2}, {"oge", 3}, {"olt", 4}, {"ole", 5}, {"one", 6},
+            {"ord", 7}, {"uno", 8}, {"ueq", 9}, {"ugt", 10}, {"uge", 11}, {"ult", 12}, {"ule", 13},
+            {"une", 14}, {"true", 15}};
+
+        const std::map<std::string, unsigned> integerPredicates{
+            {"eq", 32}, {"ne", 33}, {"ugt", 34}, {"uge", 35}, {"ult", 36}, {"ule", 37}, {"sgt", 38},
+            {"sge", 39}, {"slt", 40}, {"sle", 41}};
+
+        // bits written from the least significant up, into little endian 32 bit words
+        class Bitstream
+        {
+          public:
+            Bitstream()
+                : buffer_(0),used_(0),width_(2)
+            {
+            }
+
+            void emit(uint64_t value, int bits)
+            {
+                buffer_ |= value << used_;
+                used_ += bits;
+                if(used_ >= 32)
+                {
+                    words_.push_back(uint32_t(buffer_));
+                    buffer_ >>= 32;
+                    used_ -= 32;
+                }
+            }
+
+            void emitVBR(uint64_t value, int bits)
+            {
+                const uint64_t more = uint64_t(1) << (bits - 1);
+                while(value >= more)
+                {
+                    emit((value & (more - 1)) | more, bits);
+                    value >>= bits - 1;
+                }
+                emit(value, bits);
+            }
+
+            void align()
+            {
+                if(used_ > 0)
+                {
+                    emit(0, 32 - used_);
+                }
+            }
+
+            // ENTER_SUBBLOCK, its length is filled in at its END_BLOCK
+            void enterBlock(unsigned id, int width)
+            {
+                emit(1, width_);
+                emitVBR(id, 8);
+                emitVBR(width, 4);
+                align();
+                blocks_.push_back(std::make_pair(width_, words_.size()));
+                emit(0, 32);
+                width_ = width;
+            }
+
+            void endBlock()
+            {
+                emit(0, width_);
+                align();
+                auto block = blocks_.back();
+                blocks_.pop_back();
+                words_[block.second] = uint32_t(words_.size() - block.second - 1);
+                width_ = block.first;
+            }
+
+            // UNABBREV_RECORD
+            void record(unsigned code, const std::vector<uint64_t> &operands)
+            {
+                emit(3, width_);
+                emitVBR(code, 6);
+                emitVBR(operands.size(), 6);
+                for(auto operand : operands)
+                {
+                    emitVBR(operand, 6);
+                }
+            }
+
+            void record(unsigned code, const std::string &chars)
+            {
+                emit(3, width_);
+                emitVBR(code, 6);
+                emitVBR(chars.size(), 6);
+                for(unsigned char c : chars)
+                {
+                    emitVBR(c, 6);
+                }
+            }
+
+            // a value or block id and its name
+            void record(unsigned code, uint64_t id, const std::string &chars)
+            {
+                emit(3, width_);
+                emitVBR(code, 6);
+                emitVBR(chars.size() + 1, 6);
+                emitVBR(id, 6);
+                for(unsigned char c : chars)
+                {
+                    emitVBR(c, 6);
+                }
+            }
+
+            // a record of the code and a blob, through an abbreviation defined for it
+            void blob(unsigned code, const std::string &bytes)
+            {
+                emit(2, width_);
+                emitVBR(2, 5);
+                emit(1, 1);
+                emitVBR(code, 8);
+                emit(0, 1);
+                emit(5, 3);
+
+                emit(4, width_);
+                emitVBR(bytes.size(), 6);
+                align();
+                for(unsigned char byte : bytes)
+                {
+                    emit(byte, 8);
+                }
+                align();
+            }
+
+            void write(std::ostream &out) const
+            {
+                std::string bytes(words_.size() * 4, '\0');
+                for(size_t i = 0; i < words_.size(); i++)
+                {
+                    for(int b = 0; b < 4; b++)
+                    {
+                        bytes[i * 4 + b] = char(words_[i] >> (8 * b));
+                    }
+                }
+                out.write(bytes.data(), bytes.size());
+            }
+
+          private:
+            std::vector<uint32_t>               words_;
+            uint64_t                            buffer_;
+            int                                 used_;
+            int                                 width_;
+            std::vector<std::pair<int, size_t>> blocks_;   // width and length word of the outer blocks
+        };
+
+        struct Type
+        {
+            enum Kind { VOID, FLOAT, DOUBLE, LABEL, INTEGER, POINTER, ARRAY, STRUCT, FUNCTION };
+
+            Kind                kind;
+            unsigned            width;      // of an integer
+            uint64_t            count;      // of an array
+            bool                varargs;
+            bool                packed;
+            bool                defined;    // a named struct with a body
+            std::string         name;       // of a named struct
+            std::vector<Type *> elements;   // pointee, element, fields, or result and parameters
+            int                 id;
+        };
+
+        // one Type per distinct type, so types compare by address
+        class Types
+        {
+          public:
+            Type *primitive(Type::Kind kind)
+            {
+                return intern(std::to_string(kind), make(kind));
+            }
+
+            Type *integer(unsigned width)
+            {
+                auto type = make(Type::INTEGER);
+                type.width = width;
+                return intern("i" + std::to_string(width), type);
+            }
+
+            Type *pointer(Type *pointee)
+            {
+                auto type = make(Type::POINTER);
+                type.elements.push_back(pointee);
+                return intern(key(type), type);
+            }
+
+            Type *array(uint64_t count, Type *element)
+            {
+                auto type = make(Type::ARRAY);
+                type.count = count;
+                type.elements.push_back(element);
+                return intern(key(type) + "x" + std::to_string(count), type);
+            }
+
+            Type *literal(const std::vector<Type *> &fields, bool packed)
+            {
+                auto type = make(Type::STRUCT);
+                type.elements = fields;
+                type.packed = packed;
+                return intern(key(type) + (packed ? "p" : ""), type);
+            }
+
+            Type *function(Type *result, const std::vector<Type *> &params, bool varargs)
+            {
+                auto type = make(Type::FUNCTION);
+                type.elements.push_back(result);
+                type.elements.insert(type.elements.end(), params.begin(), params.end());
+                type.varargs = varargs;
+                return intern(key(type) + (varargs ? "v" : ""), type);
+            }
+
+            Type *named(const std::string &name)
+            {
+                auto type = make(Type::STRUCT);
+                type.name = name;
+                return intern("%" + name, type);
+            }
+
+            const std::vector<Type *> &all() const
+            {
+                return all_;
+            }
+
+          private:
+            static Type make(Type::Kind kind)
+            {
+                return Type{kind, 0, 0, false, false, false, "", {}, -1};
+            }
+
+            static std::string key(const Type &type)
+            {
+                std::string key = std::to_string(type.kind) + "(";
+                for(auto element : type.elements)
+                {
+                    key += std::to_string(reinterpret_cast<uintptr_t>(element)) + ",";
+                }
+                return key + ")";
+            }
+
+            Type *intern(const std::string &key, const Type &type)
+            {
+                auto &slot = types_[key];
+                if(!slot)
+                {
+                    slot.reset(new Type(type));
+                    all_.push_back(slot.get());
+                }
+                return slot.get();
+            }
+
+          private:
+            std::map<std::string, std::unique_ptr<Type>>    types_;
+            std::vector<Type *>                             all_;
+        };
+
+        struct Constant
+        {
+            enum Kind { INTEGER, FLOAT, NUL, UNDEF, STRING, AGGREGATE, GLOBAL, GEP, CAST };
+
+            Kind                    kind;
+            Type *                  type;
+            uint64_t                bits;       // an integer sign extended to 64 bits, or a float
+            std::string             text;       // bytes of a string, name of a global
+            Type *                  source;     // element type of a gep
+            unsigned                opcode;     // of a cast, 1 for an inbounds gep
+            std::vector<Constant *> operands;
+            unsigned                id;
+        };
+
+        // the constants of the module or of a function, operands before their users
+        class Constants
+        {
+          public:
+            Constant *get(const Constant &constant)
+            {
+                if(constant.kind == Constant::INTEGER)
+                {
+                    return integer(constant.type, constant.bits);
+                }
+                std::string key = std::to_string(constant.kind) + " "
+                                + std::to_string(reinterpret_cast<uintptr_t>(constant.type)) + " "
+                                + std::to_string(constant.bits) + " "
+                                + std::to_string(reinterpret_cast<uintptr_t>(constant.source)) + " "
+                                + std::to_string(constant.opcode) + " ";
+                for(auto operand : constant.operands)
+                {
+                    key += std::to_string(reinterpret_cast<uintptr_t>(operand)) + ",";
+                }
+                key += " " + constant.text;
+                auto &slot = constants_[key];
+                if(!slot)
+                {
+                    slot.reset(new Constant(constant));
+                    all_.push_back(slot.get());
+                }
+                return slot.get();
+            }
+
+            // an integer sign extended to 64 bits, the most common constant, without building a key
+            Constant *integer(Type *type, uint64_t bits)
+            {
+                auto &slot = integers_[std::make_pair(type, bits)];
+                if(!slot)
+                {
+                    slot.reset(new Constant{Constant::INTEGER, type, bits, "", nullptr, 0, {}, 0});
+                    all_.push_back(slot.get());
+                }
+                return slot.get();
+            }
+
+            // the constant written as text, null until the caller sets it
+            Constant *&written(Type *type, const std::string &text)
+            {
+                return written_[std::make_pair(type, text)];
+            }
+
+            const std::vector<Constant *> &all() const
+            {
+                return all_;
+            }
+
+          private:
+            std::map<std::string, std::unique_ptr<Constant>>    constants_;
+            std::vector<Constant *>                             all_;
+            std::map<std::pair<Type *, uint64_t>, std::unique_ptr<Constant>> integers_;
+            std::map<std::pair<Type *, std::string>, Constant *> written_;
+        };
+
+        struct Operand
+        {
+            Type *          type;
+            std::string     local;      // an argument or instruction, if not a constant
+            Constant *      constant;
+        };
+
+        struct Inst
+        {
+            unsigned                    code;
+            unsigned                    opcode;     // of a binop or cast, a predicate, call flags
+            unsigned                    flags;      // nuw, nsw and exact, or inbounds
+            unsigned                    align;      // log2 + 1, 0 if not given
+            unsigned                    attributes; // of a call
+            Type *                      type;       // result, allocated, loaded, gep source or called type
+            std::string                 result;
+            std::vector<Operand>        operands;
+            std::vector<std::string>    labels;
+            std::vector<Constant *>     weights;    // i32 branch weights of a profile, one per label
+        };
+
+        struct Function
+        {
+            std::string                 name;
+            Type *                      type;
+            unsigned                    linkage;
+            unsigned                    attributes;
+            unsigned                    unnamed;
+            bool                        definition;
+            std::vector<std::string>    params;
+            std::vector<std::string>    blocks;
+            std::vector<Inst>           insts;
+            Constants                   constants;
+        };
+
+        struct Global
+        {
+            std::string     name;
+            Type *          type;
+            Constant *      init;       // null if external
+            bool            constant;
+            unsigned        linkage;
+            unsigned        align;
+            unsigned        threadLocal;
+            unsigned        unnamed;
+        };
+
+        // attribute kinds by index: FUNCTION_INDEX, 0 the result, i + 1 parameter i
+        typedef std::map<uint64_t, std::vector<unsigned>> AttributeList;
+
+        class Attributes
+        {
+          public:
+            // 0 for no attributes, else 1 + the entry of the list
+            unsigned get(const AttributeList &list)
+            {
+                if(list.empty())
+                {
+                    return 0;
+                }
+                auto &entry = lists_[list];
+                if(entry == 0)
+                {
+                    std::vector<unsigned> groups;
+                    for(auto &attributes : list)
+                    {
+                        auto &group = groups_[attributes];
+                        if(group == 0)
+                        {
+                            groupOrder_.push_back(attributes);
+                            group = groupOrder_.size();
+                        }
+                        groups.push_back(group);
+                    }
+                    entries_.push_back(groups);
+                    entry = entries_.size();
+                }
+                return entry;
+            }
+
+            void write(Bitstream &stream) const
+            {
+                if(entries_.empty())
+                {
+                    return ;
+                }
+                stream.enterBlock(PARAMATTR_GROUP_BLOCK, 3);
+                for(size_t i = 0; i < groupOrder_.size(); i++)
+                {
+                    std::vector<uint64_t> record{i + 1, groupOrder_[i].first};
+                    for(auto kind : groupOrder_[i].second)
+                    {
+                        record.push_back(0);
+                        record.push_back(kind);
+                    }
+                    stream.record(PARAMATTR_GROUP_ENTRY, record);
+                }
+                stream.endBlock();
+                stream.enterBlock(PARAMATTR_BLOCK, 3);
+                for(auto &entry : entries_)
+                {
+                    stream.record(PARAMATTR_ENTRY, std::vector<uint64_t>(entry.begin(), entry.end()));
+                }
+                stream.endBlock();
+            }
+
+          private:
+            std::map<AttributeList, unsigned>                           lists_;
+            std::vector<std::vector<unsigned>>                          entries_;
+            std::map<std::pair<uint64_t, std::vector<unsigned>>, unsigned> groups_;
+            std::vector<std::pair<uint64_t, std::vector<unsigned>>>    groupOrder_;
+        };
+
+        struct Token
+        {
+            enum Kind { END, WORD, LOCAL, GLOBAL, LABEL, NUMBER, STRING, QUOTED, PUNCT };
+
+            Kind            kind;
+            std::string     text;
+        };
+
+        static bool nameChar(char c)
+        {
+            return std::isalnum((unsigned char)c) || c == '.' || c == '_' || c == '$' || c == '-';
+        }
+
+        static int hexDigit(char c)
+        {
+            return std::isdigit((unsigned char)c) ? c - '0' : std::tolower((unsigned char)c) - 'a' + 10;
+        }
+
+        // the module: named types, globals, functions and their bodies, read from text or taken from the IR
+        class Reader
+        {
+          public:
+            Reader()
+                : text_(nullptr),module_(nullptr),pos_(0),line_(1)
+            {
+            }
+
+            void read(const std::string &text)
+            {
+                text_ = &text;
+                module_ = &text;
+                pos_ = 0;
+                line_ = 1;
+                scan();
+                while(token_.kind != Token::END)
+                {
+                    if(token_.kind == Token::LOCAL)
+                    {
+                        namedType();
+                    }
+                    else if(token_.kind == Token::GLOBAL)
+                    {
+                        global();
+                    }
+                    else if(accept("define"))
+                    {
+                        function(true);
+                    }
+                    else if(accept("declare"))
+                    {
+                        function(false);
+                    }
+                    else if(accept("target"))
+                    {
+                        bool isTriple = accept("triple");
+                        if(!isTriple)
+                        {
+                            expect("datalayout");
+                        }
+                        expect("=");
+                        (isTriple ? triple : dataLayout) = take(Token::QUOTED);
+                    }
+                    else if(accept("source_filename"))
+                    {
+                        expect("=");
+                        take(Token::QUOTED);
+                    }
+                    else
+                    {
+                        fail("unexpected '" + token_.text + "'");
+                    }
+                }
+            }
+
+            // a function ycc generated, without printing and reading it
+            void add(const IRFunction &source)
+            {
+                std::unique_ptr<Function> function(new Function());
+                function->name = globalName(source.name);
+                function->linkage = 0;
+                function->attributes = 0;
+                function->unnamed = 0;
+                function->definition = true;
+                std::vector<Type *> params;
+                for(auto &param : source.params)
+                {
+                    params.push_back(typeOf(param.type));
+                    function->params.push_back(localName(param.name));
+                }
+                function->type = types.function(typeOf(source.returnType), params, false);
+                function->insts.reserve(source.size());
+                for(auto &block : source.blocks)
+                {
+                    function->blocks.push_back(block.label);
+                    for(auto &inst : block.insts)
+                    {
+                        function->insts.push_back(instruction(inst, function->constants));
+                    }
+                }
+                functions.push_back(std::move(function));
+            }
+
+          public:
+            Types                                   types;
+            Attributes                              attributes;
+            Constants                               constants;      // of the module
+            std::vector<Global>                     globals;
+            std::vector<std::unique_ptr<Function>>  functions;
+            std::string                             triple;
+            std::string                             dataLayout;
+
+          private:
+            [[noreturn]] void fail(const std::string &message) const
+            {
+                if(text_ != module_)
+                {
+                    throw std::runtime_error("'" + *text_ + "': " + message);
+                }
+                throw std::runtime_error("line " + std::to_string(line_) + ": " + message);
+            }
+
+            void scan()
+            {
+                auto &text = *text_;
+                while(pos_ < text.size())
+                {
+                    char c = text[pos_];
+                    if(c == ';')
+                    {
+                        while(pos_ < text.size() && text[pos_] != '\n')
+                        {
+                            pos_++;
+                        }
+                    }
+                    else if(std::isspace((unsigned char)c))
+                    {
+                        line_ += c == '\n';
+                        pos_++;
+                    }
+                    else
+                    {
+                        break;
+                    }
+                }
+                token_.text.clear();
+                if(pos_ >= text.size())
+                {
+                    token_.kind = Token::END;
+                    return ;
+                }
+
+                char c = text[pos_];
+                size_t begin = pos_;
+                if(c == '%' || c == '@')
+                {
+                    token_.kind = c == '%' ? Token::LOCAL : Token::GLOBAL;
+                    pos_++;
+                    if(pos_ < text.size() && text[pos_] == '"')
+                    {
+                        token_.text = quoted();
+                        return ;
+                    }
+                    while(pos_ < text.size() && nameChar(text[pos_]))
+                    {
+                        pos_++;
+                    }
+                    token_.text = text.substr(begin + 1, pos_ - begin - 1);
+                }
+                else if(c == '"' || (c == 'c' && pos_ + 1 < text.size() && text[pos_ + 1] == '"'))
+                {
+                    token_.kind = c == '"' ? Token::QUOTED : Token::STRING;
+                    pos_ += c == 'c';
+                    token_.text = quoted();
+                }
+                else if(std::isdigit((unsigned char)c)
+                        || (c == '-' && pos_ + 1 < text.size() && std::isdigit((unsigned char)text[pos_ + 1])))
+                {
+                    token_.kind = Token::NUMBER;
+                    pos_++;
+                    bool hex = text.compare(begin, 2, "0x") == 0;
+                    while(pos_ < text.size())
+                    {
+                        char d = text[pos_];
+                        bool exponent = !hex && (d == '+' || d == '-') && (text[pos_ - 1] == 'e' || text[pos_ - 1] == 'E');
+                        if(!std::isalnum((unsigned char)d) && d != '.' && !exponent)
+                        {
+                            break;
+                        }
+                        pos_++;
+                    }
+                    token_.text = text.substr(begin, pos_ - begin);
+                }
+                else if(std::isalpha((unsigned char)c) || c == '_' || c == '.')
+                {
+                    while(pos_ < text.size() && nameChar(text[pos_]))
+                    {
+                        pos_++;
+                    }
+                    token_.text = text.substr(begin, pos_ - begin);
+                    token_.kind = Token::WORD;
+                    if(pos_ < text.size() && text[pos_] == ':')
+                    {
+                        token_.kind = Token::LABEL;
+                        pos_++;
+                    }
+                }
+                else if(text.compare(pos_, 3, "...") == 0)
+                {
+                    token_.kind = Token::PUNCT;
+                    token_.text = "...";
+                    pos_ += 3;
+                }
+                else
+                {
+                    token_.kind = Token::PUNCT;
+                    token_.text = std::string(1, c);
+                    pos_++;
+                }
+            }
+
+            // the bytes of "...", with \\ and \XX escapes
+            std::string quoted()
+            {
+                auto &text = *text_;
+                std::string bytes;
+                pos_++;
+                while(pos_ < text.size() && text[pos_] != '"')
+                {
+                    if(text[pos_] == '\\' && pos_ + 2 < text.size() && text[pos_ + 1] != '\\')
+                    {
+                        bytes += char(hexDigit(text[pos_ + 1]) * 16 + hexDigit(text[pos_ + 2]));
+                        pos_ += 3;
+                    }
+                    else
+                    {
+                        bytes += text[pos_];
+                        pos_ += text[pos_] == '\\' ? 2 : 1;
+                    }
+                }
+                if(pos_ >= text.size())
+                {
+                    fail("unterminated string");
+                }
+                pos_++;
+                return bytes;
+            }
+
+            bool is(const char *text) const
+            {
+                return (token_.kind == Token::WORD || token_.kind == Token::PUNCT) && token_.text == text;
+            }
+
+            bool accept(const char *text)
+            {
+                if(!is(text))
+                {
+                    return false;
+                }
+                scan();
+                return true;
+            }
+
+            void expect(const char *text)
+            {
+                if(!accept(text))
+                {
+                    fail(std::string("expected '") + text + "' before '" + token_.text + "'");
+                }
+            }
+
+            std::string take(Token::Kind kind)
+            {
+                if(token_.kind != kind)
+                {
+                    fail("unexpected '" + token_.text + "'");
+                }
+                auto text = token_.text;
+                scan();
+                return text;
+            }
+
+            uint64_t number()
+            {
+                auto text = take(Token::NUMBER);
+                return text[0] == '-' ? uint64_t(std::strtoll(text.c_str(), nullptr, 10))
+                                      : std::strtoull(text.c_str(), nullptr, 10);
+            }
+
+            // log2 of ", align n", plus one
+            unsigned alignment()
+            {
+                auto align = number();
+                unsigned log = 0;
+                while((uint64_t(1) << log) < align)
+                {
+                    log++;
+                }
+                return log + 1;
+            }
+
+            // attribute words, added to the list at index
+            void attributeWords(AttributeList &list, uint64_t index)
+            {
+                while(token_.kind == Token::WORD)
+                {
+                    auto kind = attributeKinds.find(token_.text);
+                    if(kind == attributeKinds.end())
+                    {
+                        break;
+                    }
+                    list[index].push_back(kind->second);
+                    scan();
+                }
+            }
+
+            Type *type()
+            {
+                Type *type = nullptr;
+                if(token_.kind == Token::LOCAL)
+                {
+                    type = types.named(take(Token::LOCAL));
+                }
+                else if(accept("["))
+                {
+                    auto count = number();
+                    expect("x");
+                    auto element = this->type();
+                    expect("]");
+                    type = types.array(count, element);
+                }
+                else if(is("{") || is("<"))
+                {
+                    type = types.literal(fields(), false);
+                    if(accept(">"))
+                    {
+                        type = types.literal(type->elements, true);
+                    }
+                }
+                else
+                {
+                    auto word = take(Token::WORD);
+                    if(word == "void")
+                    {
+                        type = types.primitive(Type::VOID);
+                    }
+                    else if(word == "float")
+                    {
+                        type = types.primitive(Type::FLOAT);
+                    }
+                    else if(word == "double")
+                    {
+                        type = types.primitive(Type::DOUBLE);
+                    }
+                    else if(word == "label")
+                    {
+                        type = types.primitive(Type::LABEL);
+                    }
+                    else if(word.size() > 1 && word[0] == 'i' && std::isdigit((unsigned char)word[1]))
+                    {
+                        type = types.integer(std::atoi(word.c_str() + 1));
+                    }
+                    else
+                    {
+                        fail("unknown type '" + word + "'");
+                    }
+                }
+
+                while(true)
+                {
+                    if(accept("*"))
+                    {
+                        type = types.pointer(type);
+                    }
+                    else if(accept("("))
+                    {
+                        std::vector<Type *> params;
+                        bool varargs = false;
+                        while(!accept(")"))
+                        {
+                            if(accept("..."))
+                            {
+                                varargs = true;
+                            }
+                            else
+                            {
+                                params.push_back(this->type());
+                            }
+                            accept(",");
+                        }
+                        type = types.function(type, params, varargs);
+                    }
+                    else
+                    {
+                        return type;
+                    }
+                }
+            }
+
+            // { t, t }, or <{ t, t }> leaving the '>'
+            std::vector<Type *> fields()
+            {
+                accept("<");
+                expect("{");
+                std::vector<Type *> fields;
+                while(!accept("}"))
+                {
+                    fields.push_back(type());
+                    accept(",");
+                }
+                return fields;
+            }
+
+            void namedType()
+            {
+                auto type = types.named(take(Token::LOCAL));
+                expect("=");
+                expect("type");
+                if(!accept("opaque"))
+                {
+                    bool packed = is("<");
+                    type->elements = fields();
+                    type->packed = packed && accept(">");
+                    type->defined = true;
+                }
+            }
+
+            Constant *constant(Type *type, Constants &pool)
+            {
+                Constant constant{Constant::INTEGER, type, 0, "", nullptr, 0, {}, 0};
+                if(token_.kind == Token::NUMBER)
+                {
+                    auto text = token_.text;
+                    if(type->kind == Type::INTEGER)
+                    {
+                        constant.bits = number();
+                        if(type->width < 64)
+                        {
+                            int unused = 64 - type->width;
+                            constant.bits = uint64_t(int64_t(constant.bits << unused) >> unused);
+                        }
+                        return pool.get(constant);
+                    }
+                    scan();
+                    constant.kind = Constant::FLOAT;
+                    double value;
+                    uint64_t bits;
+                    if(text.compare(0, 2, "0x") == 0)
+                    {
+                        if(!std::isxdigit((unsigned char)text[2]))
+                        {
+                            fail("unsupported float " + text);
+                        }
+                        bits = std::strtoull(text.c_str() + 2, nullptr, 16);
+                        std::memcpy(&value, &bits, sizeof(value));
+                    }
+                    else
+                    {
+                        value = std::strtod(text.c_str(), nullptr);
+                        std::memcpy(&bits, &value, sizeof(bits));
+                    }
+                    if(type->kind == Type::FLOAT)
+                    {
+                        float narrow = float(value);
+                        uint32_t narrowBits;
+                        std::memcpy(&narrowBits, &narrow, sizeof(narrowBits));
+                        bits = narrowBits;
+                    }
+                    else if(type->kind != Type::DOUBLE)
+                    {
+                        fail("float constant of a type that is not float or double");
+                    }
+                    constant.bits = bits;
+                    return pool.get(constant);
+                }
+                if(token_.kind == Token::GLOBAL)
+                {
+                    constant.kind = Constant::GLOBAL;
+                    constant.text = take(Token::GLOBAL);
+                    return pool.get(constant);
+                }
+                if(token_.kind == Token::STRING)
+                {
+                    constant.kind = Constant::STRING;
+                    constant.text = take(Token::STRING);
+                    return pool.get(constant);
+                }
+                if(is("[") || is("{") || is("<"))
+                {
+                    bool packed = accept("<");
+                    const char *close = is("[") ? "]" : "}";
+                    scan();
+                    constant.kind = Constant::AGGREGATE;
+                    while(!accept(close))
+                    {
+                        auto elementType = this->type();
+                        constant.operands.push_back(this->constant(elementType, pool));
+                        accept(",");
+                    }
+                    if(packed)
+                    {
+                        expect(">");
+                    }
+                    return pool.get(constant);
+                }
+
+                auto word = take(Token::WORD);
+                if(word == "true" || word == "false")
+                {
+                    constant.bits = word == "true" ? ~uint64_t(0) : 0;
+                }
+                else if(word == "null" || word == "zeroinitializer")
+                {
+                    constant.kind = Constant::NUL;
+                }
+                else if(word == "undef" || word == "poison")
+                {
+                    constant.kind = Constant::UNDEF;
+                }
+                else if(word == "getelementptr")
+                {
+                    constant.kind = Constant::GEP;
+                    constant.opcode = accept("inbounds");
+                    expect("(");
+                    constant.source = this->type();
+                    while(accept(","))
+                    {
+                        auto operandType = this->type();
+                        constant.operands.push_back(this->constant(operandType, pool));
+                    }
+                    expect(")");
+                }
+                else if(castOpcodes.count(word))
+                {
+                    constant.kind = Constant::CAST;
+                    constant.opcode = castOpcodes.at(word);
+                    expect("(");
+                    auto operandType = this->type();
+                    constant.operands.push_back(this->constant(operandType, pool));
+                    expect("to");
+                    this->type();
+                    expect(")");
+                }
+                else
+                {
+                    fail("unsupported constant '" + word + "'");
+                }
+                return pool.get(constant);
+            }
+
+            Operand value(Type *type, Constants &pool)
+            {
+                if(token_.kind == Token::LOCAL)
+                {
+                    return Operand{type, take(Token::LOCAL), nullptr};
+                }
+                return Operand{type, "", constant(type, pool)};
+            }
+
+            Operand typedValue(Constants &pool)
+            {
+                auto type = this->type();
+                return value(type, pool);
+            }
+
+            std::string label()
+            {
+                expect("label");
+                return take(Token::LOCAL);
+            }
+
+            // @name = [linkage] [thread_local] [unnamed_addr] global|constant type [init] [, align n]
+            void global()
+            {
+                Global global{take(Token::GLOBAL), nullptr, nullptr, false, 0, 0, 0, 0};
+                expect("=");
+                bool external = false;
+                while(token_.kind == Token::WORD)
+                {
+                    auto linkage = linkages.find(token_.text);
+                    if(linkage != linkages.end())
+                    {
+                        global.linkage = linkage->second;
+                        external = token_.text == "external" || token_.text == "extern_weak";
+                    }
+                    else if(is("thread_local"))
+                    {
+                        global.threadLocal = 1;
+                    }
+                    else if(is("unnamed_addr") || is("local_unnamed_addr"))
+                    {
+                        global.unnamed = is("unnamed_addr") ? 1 : 2;
+                    }
+                    else if(is("dso_local"))
+                    {
+                    }
+                    else
+                    {
+                        break;
+                    }
+                    scan();
+                }
+                if(!accept("global"))
+                {
+                    expect("constant");
+                    global.constant = true;
+                }
+                global.type = type();
+                if(!external)
+                {
+                    global.init = constant(global.type, constants);
+                }
+                while(accept(","))
+                {
+                    expect("align");
+                    global.align = alignment();
+                }
+                globals.push_back(global);
+            }
+
+            // define|declare [linkage] [attributes] type @name(params) [attributes] [{ body }]
+            void function(bool definition)
+            {
+                std::unique_ptr<Function> function(new Function());
+                function->definition = definition;
+                function->linkage = 0;
+                function->unnamed = 0;
+                AttributeList list;
+                while(token_.kind == Token::WORD && (linkages.count(token_.text) || is("dso_local")))
+                {
+                    function->linkage = linkages.count(token_.text) ? linkages.at(token_.text) : 0;
+                    scan();
+                }
+                attributeWords(list, 0);
+                auto result = type();
+                function->name = take(Token::GLOBAL);
+
+                expect("(");
+                std::vector<Type *> params;
+                bool varargs = false;
+                while(!accept(")"))
+                {
+                    if(accept("..."))
+                    {
+                        varargs = true;
+                    }
+                    else
+                    {
+                        params.push_back(type());
+                        attributeWords(list, params.size());
+                        function->params.push_back(token_.kind == Token::LOCAL ? take(Token::LOCAL) : "");
+                    }
+                    accept(",");
+                }
+                function->type = types.function(result, params, varargs);
+                attributeWords(list, FUNCTION_INDEX);
+                while(is("unnamed_addr") || is("local_unnamed_addr"))
+                {
+                    function->unnamed = is("unnamed_addr") ? 1 : 2;
+                    scan();
+                    attributeWords(list, FUNCTION_INDEX);
+                }
+                function->attributes = attributes.get(list);
+                if(definition)
+                {
+                    body(*function);
+                }
+                functions.push_back(std::move(function));
+            }
+
+            void body(Function &function)
+            {
+                expect("{");
+                while(!accept("}"))
+                {
+                    if(token_.kind == Token::LABEL)
+                    {
+                        function.blocks.push_back(take(Token::LABEL));
+                        continue;
+                    }
+                    if(function.blocks.empty())
+                    {
+                        function.blocks.push_back("");
+                    }
+                    instruction(function);
+                }
+            }
+
+            void instruction(Function &function)
+            {
+                auto &pool = function.constants;
+                Inst inst{0, 0, 0, 0, 0, nullptr, "", {}, {}};
+                if(token_.kind == Token::LOCAL)
+                {
+                    inst.result = take(Token::LOCAL);
+                    expect("=");
+                }
+                unsigned tail = 0;
+                if(accept("tail"))
+                {
+                    tail = CALL_TAIL;
+                }
+                else if(accept("musttail"))
+                {
+                    tail = CALL_TAIL | CALL_MUSTTAIL;
+                }
+                auto opcode = take(Token::WORD);
+
+                if(binaryOpcodes.count(opcode))
+                {
+                    inst.code = INST_BINOP;
+                    inst.opcode = binaryOpcodes.at(opcode);
+                    while(is("nuw") || is("nsw") || is("exact"))
+                    {
+                        inst.flags |= is("nsw") ? 2 : 1;
+                        scan();
+                    }
+                    inst.type = type();
+                    inst.operands.push_back(value(inst.type, pool));
+                    expect(",");
+                    inst.operands.push_back(value(inst.type, pool));
+                }
+                else if(opcode == "fneg")
+                {
+                    inst.code = INST_UNOP;
+                    inst.operands.push_back(typedValue(pool));
+                    inst.type = inst.operands[0].type;
+                }
+                else if(castOpcodes.count(opcode))
+                {
+                    inst.code = INST_CAST;
+                    inst.opcode = castOpcodes.at(opcode);
+                    inst.operands.push_back(typedValue(pool));
+                    expect("to");
+                    inst.type = type();
+                }
+                else if(opcode == "icmp" || opcode == "fcmp")
+                {
+                    inst.code = INST_CMP2;
+                    auto &table = opcode == "icmp" ? integerPredicates : predicates;
+                    auto predicate = table.find(take(Token::WORD));
+                    if(predicate == table.end())
+                    {
+                        fail("unknown predicate");
+                    }
+                    inst.opcode = predicate->second;
+                    auto operandType = type();
+                    inst.operands.push_back(value(operandType, pool));
+                    expect(",");
+                    inst.operands.push_back(value(operandType, pool));
+                }
+                else if(opcode == "select")
+                {
+                    inst.code = INST_VSELECT;
+                    for(int i = 0; i < 3; i++)
+                    {
+                        inst.operands.push_back(typedValue(pool));
+                        if(i < 2)
+                        {
+                            expect(",");
+                        }
+                    }
+                }
+                else if(opcode == "phi")
+                {
+                    inst.code = INST_PHI;
+                    inst.type = type();
+                    do
+                    {
+                        expect("[");
+                        inst.operands.push_back(value(inst.type, pool));
+                        expect(",");
+                        inst.labels.push_back(take(Token::LOCAL));
+                        expect("]");
+                    } while(accept(","));
+                }
+                else if(opcode == "alloca")
+                {
+                    inst.code = INST_ALLOCA;
+                    inst.type = type();
+                    while(accept(","))
+                    {
+                        if(accept("align"))
+                        {
+                            inst.align = alignment();
+                        }
+                        else
+                        {
+                            inst.operands.push_back(typedValue(pool));
+                        }
+                    }
+                    if(inst.operands.empty())
+                    {
+                        auto i32 = types.integer(32);
+                        inst.operands.push_back(Operand{i32, "", pool.get(Constant{Constant::INTEGER, i32, 1, "", nullptr, 0, {}, 0})});
+                    }
+                }
+                else if(opcode == "load")
+                {
+                    inst.code = INST_LOAD;
+                    inst.type = type();
+                    expect(",");
+                    inst.operands.push_back(typedValue(pool));
+                    while(accept(","))
+                    {
+                        expect("align");
+                        inst.align = alignment();
+                    }
+                }
+                else if(opcode == "store")
+                {
+                    inst.code = INST_STORE;
+                    inst.operands.push_back(typedValue(pool));
+                    expect(",");
+                    inst.operands.push_back(typedValue(pool));
+                    while(accept(","))
+                    {
+                        expect("align");
+                        inst.align = alignment();
+                    }
+                }
+                else if(opcode == "getelementptr")
+                {
+                    inst.code = INST_GEP;
+                    inst.flags = accept("inbounds");
+                    inst.type = type();
+                    while(accept(","))
+                    {
+                        inst.operands.push_back(typedValue(pool));
+                    }
+                }
+                else if(opcode == "call")
+                {
+                    inst.code = INST_CALL;
+                    inst.opcode = tail | CALL_EXPLICIT_TYPE;
+                    AttributeList list;
+                    attributeWords(list, 0);
+                    auto called = type();
+                    auto callee = value(nullptr, pool);
+                    std::vector<Type *> params;
+                    expect("(");
+                    std::vector<Operand> args;
+                    while(!accept(")"))
+                    {
+                        auto argType = type();
+                        attributeWords(list, args.size() + 1);
+                        args.push_back(value(argType, pool));
+                        params.push_back(argType);
+                        accept(",");
+                    }
+                    inst.type = called->kind == Type::FUNCTION ? called : types.function(called, params, false);
+                    callee.type = types.pointer(inst.type);
+                    inst.operands.push_back(callee);
+                    inst.operands.insert(inst.operands.end(), args.begin(), args.end());
+                    attributeWords(list, FUNCTION_INDEX);
+                    inst.attributes = attributes.get(list);
+                }
+                else if(opcode == "ret")
+                {
+                    inst.code = INST_RET;
+                    if(!accept("void"))
+                    {
+                        inst.operands.push_back(typedValue(pool));
+                    }
+                }
+                else if(opcode == "br")
+                {
+                    inst.code = INST_BR;
+                    if(is("label"))
+                    {
+                        inst.labels.push_back(label());
+                    }
+                    else
+                    {
+                        inst.operands.push_back(typedValue(pool));
+                        expect(",");
+                        inst.labels.push_back(label());
+                        expect(",");
+                        inst.labels.push_back(label());
+                    }
+                }
+                else if(opcode == "switch")
+                {
+                    inst.code = INST_SWITCH;
+                    inst.type = type();
+                    inst.operands.push_back(value(inst.type, pool));
+                    expect(",");
+                    inst.labels.push_back(label());
+                    expect("[");
+                    while(!accept("]"))
+                    {
+                        auto caseType = type();
+                        inst.operands.push_back(value(caseType, pool));
+                        expect(",");
+                        inst.labels.push_back(label());
+                    }
+                }
+                else if(opcode == "unreachable")
+                {
+                    inst.code = INST_UNREACHABLE;
+                }
+                else
+                {
+                    fail("unsupported instruction '" + opcode + "'");
+                }
+                function.insts.push_back(std::move(inst));
+            }
+
+            // a type or value of the IR, parsed on its own as if it were the module
+            template<typename Parse>
+            auto within(const std::string &text, Parse parse) -> decltype(parse())
+            {
+                auto pos = pos_;
+                auto token = token_;
+                text_ = &text;
+                pos_ = 0;
+                scan();
+                auto result = parse();
+                if(token_.kind != Token::END)
+                {
+                    fail("unexpected '" + token_.text + "'");
+                }
+                text_ = module_;
+                pos_ = pos;
+                token_ = token;
+                return result;
+            }
+
+            Type *typeOf(const std::string &text)
+            {
+                auto &type = typeNames_[text];
+                if(!type)
+                {
+                    type = within(text, [this]() { return this->type(); });
+                }
+                return type;
+            }
+
+            std::string localName(const std::string &name)
+            {
+                if(name.size() > 1 && name[0] == '%' && name[1] != '"')
+                {
+                    return name.substr(1);
+                }
+                return within(name, [this]() { return take(Token::LOCAL); });
+            }
+
+            std::string globalName(const std::string &name)
+            {
+                if(name.size() > 1 && name[0] == '@' && name[1] != '"')
+                {
+                    return name.substr(1);
+                }
+                return within(name, [this]() { return take(Token::GLOBAL); });
+            }
+
+            // decimal integers directly, other constants parsed once per function
+            Operand operandOf(const IRValue &value, Type *type, Constants &pool)
+            {
+                auto &name = value.name;
+                if(!name.empty() && name[0] == '%')
+                {
+                    return Operand{type, localName(name), nullptr};
+                }
+                bool negative = !name.empty() && name[0] == '-';
+                if(type->kind == Type::INTEGER && type->width <= 64 && name.size() > size_t(negative)
+                   && name.find_first_not_of("0123456789", negative) == std::string::npos)
+                {
+                    uint64_t bits = negative ? uint64_t(std::strtoll(name.c_str(), nullptr, 10))
+                                             : std::strtoull(name.c_str(), nullptr, 10);
+                    if(type->width < 64)
+                    {
+                        int unused = 64 - type->width;
+                        bits = uint64_t(int64_t(bits << unused) >> unused);
+                    }
+                    return Operand{type, "", pool.integer(type, bits)};
+                }
+                auto &constant = pool.written(type, name);
+                if(!constant)
+                {
+                    constant = within(name, [&]() { return this->constant(type, pool); });
+                }
+                return Operand{type, "", constant};
+            }
+
+            Operand typedOperand(const IRValue &value, Constants &pool)
+            {
+                return operandOf(value, typeOf(value.type), pool);
+            }
+
+            // what instruction() reads from the text IRInst::print writes
+            Inst instruction(const IRInst &source, Constants &pool)
+            {
+                Inst inst{0, 0, 0, 0, 0, nullptr, "", {}, {}};
+                if(!source.result.empty())
+                {
+                    inst.result = localName(source.result);
+                }
+                auto &operands = source.operands;
+                inst.operands.reserve(operands.size() + 1);
+                switch(source.op)
+                {
+                case IROp::ALLOCA:
+                {
+                    inst.code = INST_ALLOCA;
+                    inst.type = typeOf(source.type);
+                    auto i32 = types.integer(32);
+                    inst.operands.push_back(Operand{i32, "", pool.integer(i32, 1)});
+                    break;
+                }
+                case IROp::LOAD:
+                    inst.code = INST_LOAD;
+                    inst.type = typeOf(source.type);
+                    inst.operands.push_back(typedOperand(operands[0], pool));
+                    break;
+                case IROp::STORE:
+                    inst.code = INST_STORE;
+                    inst.operands.push_back(typedOperand(operands[0], pool));
+                    inst.operands.push_back(typedOperand(operands[1], pool));
+                    break;
+                case IROp::BINARY:
+                case IROp::CMP:
+                {
+                    // the opcode, then flags or the predicate
+                    auto space = std::min(source.opcode.find(' '), source.opcode.size());
+                    auto first = source.opcode.substr(0, space);
+                    auto rest = source.opcode.substr(std::min(space + 1, source.opcode.size()));
+                    inst.operands.push_back(typedOperand(operands[0], pool));
+                    inst.operands.push_back(operandOf(operands[1], inst.operands[0].type, pool));
+                    if(source.op == IROp::CMP)
+                    {
+                        inst.code = INST_CMP2;
+                        auto &table = first == "icmp" ? integerPredicates : predicates;
+                        auto predicate = table.find(rest);
+                        if(predicate == table.end())
+                        {
+                            throw std::runtime_error("unknown comparison '" + source.opcode + "'");
+                        }
+                        inst.opcode = predicate->second;
+                        break;
+                    }
+                    inst.code = INST_BINOP;
+                    auto opcode = binaryOpcodes.find(first);
+                    if(opcode == binaryOpcodes.end())
+                    {
+                        throw std::runtime_error("unsupported instruction '" + source.opcode + "'");
+                    }
+                    inst.opcode = opcode->second;
+                    inst.flags = (rest.find("nsw") != std::string::npos ? 2 : 0)
+                               | (rest.find("nuw") != std::string::npos || rest.find("exact") != std::string::npos ? 1 : 0);
+                    break;
+                }
+                case IROp::CAST:
+                {
+                    inst.code = INST_CAST;
+                    auto opcode = castOpcodes.find(source.opcode);
+                    if(opcode == castOpcodes.end())
+                    {
+                        throw std::runtime_error("unsupported instruction '" + source.opcode + "'");
+                    }
+                    inst.opcode = opcode->second;
+                    inst.operands.push_back(typedOperand(operands[0], pool));
+                    inst.type = typeOf(source.type);
+                    break;
+                }
+                case IROp::CALL:
+                {
+                    inst.code = INST_CALL;
+                    inst.opcode = CALL_EXPLICIT_TYPE | (source.tail == IRTail::TAIL ? CALL_TAIL
+                                                     : source.tail == IRTail::MUSTTAIL ? CALL_TAIL | CALL_MUSTTAIL : 0);
+                    std::vector<Type *> params;
+                    inst.operands.push_back(Operand{nullptr, "", nullptr});
+                    for(auto &operand : operands)
+                    {
+                        inst.operands.push_back(typedOperand(operand, pool));
+                        params.push_back(inst.operands.back().type);
+                    }
+                    auto called = typeOf(source.type);
+                    inst.type = called->kind == Type::FUNCTION ? called : types.function(called, params, false);
+                    inst.operands[0] = operandOf(IRValue{"", source.opcode}, types.pointer(inst.type), pool);
+                    break;
+                }
+                case IROp::GEP:
+                    inst.code = INST_GEP;
+                    inst.flags = 1;
+                    inst.type = typeOf(source.type);
+                    for(auto &operand : operands)
+                    {
+                        inst.operands.push_back(typedOperand(operand, pool));
+                    }
+                    break;
+                case IROp::PHI:
+                    inst.code = INST_PHI;
+                    inst.type = typeOf(source.type);
+                    for(size_t i = 0; i + 1 < operands.size(); i += 2)
+                    {
+                        inst.operands.push_back(operandOf(operands[i], inst.type, pool));
+                        inst.labels.push_back(operands[i + 1].name);
+                    }
+                    break;
+                case IROp::SELECT:
+                    inst.code = INST_VSELECT;
+                    for(auto &operand : operands)
+                    {
+                        inst.operands.push_back(typedOperand(operand, pool));
+                    }
+                    break;
+                case IROp::BR:
+                    inst.code = INST_BR;
+                    inst.labels.push_back(operands[0].name);
+                    break;
+                case IROp::CONDBR:
+                    inst.code = INST_BR;
+                    inst.operands.push_back(typedOperand(operands[0], pool));
+                    inst.labels.push_back(operands[1].name);
+                    inst.labels.push_back(operands[2].name);
+                    break;
+                case IROp::SWITCH:
+                    inst.code = INST_SWITCH;
+                    inst.operands.push_back(typedOperand(operands[0], pool));
+                    inst.type = inst.operands[0].type;
+                    inst.labels.push_back(operands[1].name);
+                    for(size_t i = 2; i + 1 < operands.size(); i += 2)
+                    {
+                        inst.operands.push_back(typedOperand(operands[i], pool));
+                        inst.labels.push_back(operands[i + 1].name);
+                    }
+                    break;
+                case IROp::RET:
+                    inst.code = INST_RET;
+                    if(!operands.empty())
+                    {
+                        inst.operands.push_back(typedOperand(operands[0], pool));
+                    }
+                    break;
+                case IROp::UNREACHABLE:
+                    inst.code = INST_UNREACHABLE;
+                    break;
+                }
+                if(!source.weights.empty() && source.weights.size() == inst.labels.size())
+                {
+                    auto i32 = types.integer(32);
+                    for(auto weight : source.weights)
+                    {
+                        inst.weights.push_back(pool.integer(i32, uint64_t(int64_t(int32_t(weight)))));
+                    }
+                }
+                return inst;
+            }
+
+          private:
+            const std::string *     text_;
+            const std::string *     module_;    // the text read, text_ is a type or value of the IR while parsing one
+            size_t                  pos_;
+            int                     line_;
+            Token                   token_;
+            std::unordered_map<std::string, Type *> typeNames_;
+        };
+
+        static uint64_t signRotated(uint64_t value)
+        {
+            return int64_t(value) >= 0 ? value << 1 : ((0 - value) << 1) | 1;
+        }
+
+        // records of what was read, ids of types and values as the reader of LLVM 14 numbers them
+        class Writer
+        {
+          public:
+            explicit Writer(Reader &module)
+                : module_(module)
+            {
+            }
+
+            void write(std::ostream &out)
+            {
+                stream_.emit('B', 8);
+                stream_.emit('C', 8);
+                stream_.emit(0x0, 4);
+                stream_.emit(0xC, 4);
+                stream_.emit(0xE, 4);
+                stream_.emit(0xD, 4);
+
+                stream_.enterBlock(MODULE_BLOCK, 3);
+                stream_.record(MODULE_VERSION, std::vector<uint64_t>{2});
+                module_.attributes.write(stream_);
+                types();
+                if(!module_.triple.empty())
+                {
+                    stream_.record(MODULE_TRIPLE, module_.triple);
+                }
+                if(!module_.dataLayout.empty())
+                {
+                    stream_.record(MODULE_DATALAYOUT, module_.dataLayout);
+                }
+                globals();
+                constants(module_.constants);
+                metadataKinds();
+                for(auto &function : module_.functions)
+                {
+                    if(function->definition)
+                    {
+                        body(*function);
+                    }
+                }
+                stream_.endBlock();
+
+                stream_.enterBlock(STRTAB_BLOCK, 3);
+                stream_.blob(STRTAB_BLOB, strtab_);
+                stream_.endBlock();
+                stream_.write(out);
+            }
+
+          private:
+            // subtypes first, a named struct may be referred to before it
+            void enumerate(Type *type)
+            {
+                if(type->id != -1)
+                {
+                    return ;
+                }
+                if(!type->name.empty())
+                {
+                    type->id = -2;
+                }
+                for(auto element : type->elements)
+                {
+                    enumerate(element);
+                }
+                type->id = order_.size();
+                order_.push_back(type);
+            }
+
+            void types()
+            {
+                for(auto type : module_.types.all())
+                {
+                    enumerate(type);
+                }
+                stream_.enterBlock(TYPE_BLOCK, 4);
+                stream_.record(TYPE_NUMENTRY, std::vector<uint64_t>{order_.size()});
+                for(auto type : order_)
+                {
+                    std::vector<uint64_t> record;
+                    for(auto element : type->elements)
+                    {
+                        record.push_back(element->id);
+                    }
+                    switch(type->kind)
+                    {
+                    case Type::VOID:    stream_.record(TYPE_VOID, record);      break;
+                    case Type::FLOAT:   stream_.record(TYPE_FLOAT, record);     break;
+                    case Type::DOUBLE:  stream_.record(TYPE_DOUBLE, record);    break;
+                    case Type::LABEL:   stream_.record(TYPE_LABEL, record);     break;
+                    case Type::INTEGER:
+                        stream_.record(TYPE_INTEGER, std::vector<uint64_t>{type->width});
+                        break;
+                    case Type::POINTER:
+                        record.push_back(0);
+                        stream_.record(TYPE_POINTER, record);
+                        break;
+                    case Type::ARRAY:
+                        record.insert(record.begin(), type->count);
+                        stream_.record(TYPE_ARRAY, record);
+                        break;
+                    case Type::STRUCT:
+                        record.insert(record.begin(), type->packed);
+                        if(type->name.empty())
+                        {
+                            stream_.record(TYPE_STRUCT_ANON, record);
+                            break;
+                        }
+                        stream_.record(TYPE_STRUCT_NAME, type->name);
+                        if(type->defined)
+                        {
+                            stream_.record(TYPE_STRUCT_NAMED, record);
+                        }
+                        else
+                        {
+                            stream_.record(TYPE_OPAQUE, std::vector<uint64_t>{0});
+                        }
+                        break;
+                    case Type::FUNCTION:
+                        record.insert(record.begin(), type->varargs);
+                        stream_.record(TYPE_FUNCTION, record);
+                        break;
+                    }
+                }
+                stream_.endBlock();
+            }
+
+            uint64_t name(const std::string &name)
+            {
+                auto offset = strtab_.size();
+                strtab_ += name;
+                return offset;
+            }
+
+            // globals then functions, in the order of the text, get the first value ids
+            void globals()
+            {
+                unsigned next = 0;
+                for(auto &global : module_.globals)
+                {
+                    ids_[global.name] = next++;
+                }
+                for(auto &function : module_.functions)
+                {
+                    ids_[function->name] = next++;
+                }
+                for(auto constant : module_.constants.all())
+                {
+                    if(constant->kind != Constant::GLOBAL)
+                    {
+                        constant->id = next++;
+                    }
+                }
+                values_ = next;
+
+                for(auto &global : module_.globals)
+                {
+                    std::vector<uint64_t> record{
+                        name(global.name), global.name.size(), uint64_t(global.type->id),
+                        uint64_t(2 | global.constant), global.init ? id(global.init) + 1 : 0,
+                        global.linkage, global.align, 0, 0, global.threadLocal, global.unnamed,
+                        0, 0, 0, 0, 0};
+                    stream_.record(MODULE_GLOBALVAR, record);
+                }
+                for(auto &function : module_.functions)
+                {
+                    std::vector<uint64_t> record{
+                        name(function->name), function->name.size(), uint64_t(function->type->id), 0,
+                        !function->definition, function->linkage, function->attributes, 0, 0, 0, 0,
+                        function->unnamed, 0, 0, 0, 0, 0, 0};
+                    stream_.record(MODULE_FUNCTION, record);
+                }
+            }
+
+            unsigned id(const Constant *constant) const
+            {
+                if(constant->kind != Constant::GLOBAL)
+                {
+                    return constant->id;
+                }
+                auto iter = ids_.find(constant->text);
+                if(iter == ids_.end())
+                {
+                    throw std::runtime_error("unknown global @" + constant->text);
+                }
+                return iter->second;
+            }
+
+            void constants(const Constants &pool)
+            {
+                bool any = false;
+                for(auto constant : pool.all())
+                {
+                    any = any || constant->kind != Constant::GLOBAL;
+                }
+                if(!any)
+                {
+                    return ;
+                }
+
+                stream_.enterBlock(CONSTANTS_BLOCK, 4);
+                Type *current = nullptr;
+                for(auto constant : pool.all())
+                {
+                    if(constant->kind == Constant::GLOBAL)
+                    {
+                        continue;
+                    }
+                    if(constant->type != current)
+                    {
+                        current = constant->type;
+                        stream_.record(CST_SETTYPE, std::vector<uint64_t>{uint64_t(current->id)});
+                    }
+                    std::vector<uint64_t> record;
+                    switch(constant->kind)
+                    {
+                    case Constant::INTEGER:
+                        record.push_back(signRotated(constant->bits));
+                        if(constant->type->width <= 64)
+                        {
+                            stream_.record(CST_INTEGER, record);
+                            break;
+                        }
+                        record.push_back(signRotated(int64_t(constant->bits) < 0 ? ~uint64_t(0) : 0));
+                        stream_.record(CST_WIDE_INTEGER, record);
+                        break;
+                    case Constant::FLOAT:
+                        stream_.record(CST_FLOAT, std::vector<uint64_t>{constant->bits});
+                        break;
+                    case Constant::NUL:
+                        stream_.record(CST_NULL, record);
+                        break;
+                    case Constant::UNDEF:
+                        stream_.record(CST_UNDEF, record);
+                        break;
+                    case Constant::STRING:
+                        if(constant->text.empty())
+                        {
+                            stream_.record(CST_NULL, record);
+                            break;
+                        }
+                        record.assign((const unsigned char *)constant->text.data(),
+                                      (const unsigned char *)constant->text.data() + constant->text.size());
+                        stream_.record(CST_STRING, record);
+                        break;
+                    case Constant::AGGREGATE:
+                        for(auto operand : constant->operands)
+                        {
+                            record.push_back(id(operand));
+                        }
+                        stream_.record(CST_AGGREGATE, record);
+                        break;
+                    case Constant::GEP:
+                        record.push_back(constant->source->id);
+                        for(auto operand : constant->operands)
+                        {
+                            record.push_back(operand->type->id);
+                            record.push_back(id(operand));
+                        }
+                        stream_.record(constant->opcode ? CST_CE_INBOUNDS_GEP : CST_CE_GEP, record);
+                        break;
+                    case Constant::CAST:
+                        record.push_back(constant->opcode);
+                        record.push_back(constant->operands[0]->type->id);
+                        record.push_back(id(constant->operands[0]));
+                        stream_.record(CST_CE_CAST, record);
+                        break;
+                    case Constant::GLOBAL:
+                        break;
+                    }
+                }
+                stream_.endBlock();
+            }
+
+            unsigned id(const Operand &operand) const
+            {
+                if(operand.constant)
+                {
+                    return id(operand.constant);
+                }
+                auto iter = locals_.find(operand.local);
+                if(iter == locals_.end())
+                {
+                    throw std::runtime_error("unknown value %" + operand.local);
+                }
+                return iter->second;
+            }
+
+            // relative to the next instruction, with the type when defined later
+            void push(std::vector<uint64_t> &record, const Operand &operand, bool typed = false)
+            {
+                unsigned value = id(operand);
+                record.push_back(uint32_t(next_ - value));
+                if(typed && value >= next_)
+                {
+                    record.push_back(operand.type->id);
+                }
+            }
+
+            uint64_t block(const std::string &label) const
+            {
+                auto iter = blocks_.find(label);
+                if(iter == blocks_.end())
+                {
+                    throw std::runtime_error("unknown label %" + label);
+                }
+                return iter->second;
+            }
+
+            void body(Function &function)
+            {
+                locals_.clear();
+                blocks_.clear();
+                for(size_t b = 0; b < function.blocks.size(); b++)
+                {
+                    blocks_[function.blocks[b]] = b;
+                }
+                next_ = values_;
+                for(auto &param : function.params)
+                {
+                    locals_[param] = next_++;
+                }
+                for(auto constant : function.constants.all())
+                {
+                    if(constant->kind != Constant::GLOBAL)
+                    {
+                        constant->id = next_++;
+                    }
+                }
+                unsigned first = next_;
+                for(auto &inst : function.insts)
+                {
+                    if(!inst.result.empty())
+                    {
+                        locals_[inst.result] = next_++;
+                    }
+                }
+                next_ = first;
+
+                stream_.enterBlock(FUNCTION_BLOCK, 4);
+                stream_.record(INST_DECLAREBLOCKS, std::vector<uint64_t>{function.blocks.size()});
+                constants(function.constants);
+                auto weighted = weights(function);
+                for(auto &inst : function.insts)
+                {
+                    instruction(inst);
+                    if(!inst.result.empty())
+                    {
+                        next_++;
+                    }
+                }
+                if(!weighted.empty())
+                {
+                    stream_.enterBlock(METADATA_ATTACHMENT_BLOCK, 3);
+                    for(auto &attachment : weighted)
+                    {
+                        stream_.record(METADATA_ATTACHMENT, std::vector<uint64_t>{attachment.first, 0, attachment.second});
+                    }
+                    stream_.endBlock();
+                }
+                symbols(function);
+                stream_.endBlock();
+            }
+
+            // !prof, kind 0 of the attachments, if a branch has weights
+            void metadataKinds()
+            {
+                for(auto &function : module_.functions)
+                {
+                    for(auto &inst : function->insts)
+                    {
+                        if(!inst.weights.empty())
+                        {
+                            stream_.enterBlock(METADATA_KIND_BLOCK, 3);
+                            stream_.record(METADATA_KIND, std::vector<uint64_t>{0, 'p', 'r', 'o', 'f'});
+                            stream_.endBlock();
+                            return ;
+                        }
+                    }
+                }
+            }
+
+            /*
+             * !{!"branch_weights", i32 ...} of every weighted branch of the
+             * function, numbered from 0 as the module has no metadata: the
+             * string, then the weights and the node of each branch. The
+             * instructions and their nodes are returned for the attachments.
+             */
+            std::vector<std::pair<uint64_t, uint64_t>> weights(const Function &function)
+            {
+                std::vector<std::pair<uint64_t, uint64_t>> weighted;
+                std::unordered_map<const Constant *, uint64_t> values;
+                uint64_t next = 0;
+                for(size_t i = 0; i < function.insts.size(); i++)
+                {
+                    auto &inst = function.insts[i];
+                    if(inst.weights.empty())
+                    {
+                        continue;
+                    }
+                    if(weighted.empty())
+                    {
+                        stream_.enterBlock(METADATA_BLOCK, 3);
+                        stream_.record(METADATA_STRING_OLD, std::string("branch_weights"));
+                        next = 1;
+                    }
+                    // ids of the node plus one, 0 is null
+                    std::vector<uint64_t> node{1};
+                    for(auto weight : inst.weights)
+                    {
+                        auto value = values.find(weight);
+                        if(value == values.end())
+                        {
+                            stream_.record(METADATA_VALUE, std::vector<uint64_t>{static_cast<uint64_t>(weight->type->id), weight->id});
+                            value = values.insert(std::make_pair(weight, next++)).first;
+                        }
+                        node.push_back(value->second + 1);
+                    }
+                    stream_.record(METADATA_NODE, node);
+                    weighted.push_back(std::make_pair(i, next++));
+                }
+                if(!weighted.empty())
+                {
+                    stream_.endBlock();
+                }
+                return weighted;
+            }
+
+            void instruction(const Inst &inst)
+            {
+                auto &record = record_;
+                record.clear();
+                auto &operands = inst.operands;
+                switch(inst.code)
+                {
+                case INST_BINOP:
+                    push(record, operands[0], true);
+                    push(record, operands[1]);
+                    record.push_back(inst.opcode);
+                    if(inst.flags)
+                    {
+                        record.push_back(inst.flags);
+                    }
+                    break;
+                case INST_UNOP:
+                    push(record, operands[0], true);
+                    record.push_back(0);
+                    break;
+                case INST_CAST:
+                    push(record, operands[0], true);
+                    record.push_back(inst.type->id);
+                    record.push_back(inst.opcode);
+                    break;
+                case INST_CMP2:
+                    push(record, operands[0], true);
+                    push(record, operands[1]);
+                    record.push_back(inst.opcode);
+                    break;
+                case INST_VSELECT:
+                    push(record, operands[1], true);
+                    push(record, operands[2]);
+                    push(record, operands[0], true);
+                    break;
+                case INST_PHI:
+                    record.push_back(inst.type->id);
+                    for(size_t i = 0; i < operands.size(); i++)
+                    {
+                        record.push_back(signRotated(uint64_t(int64_t(next_) - int64_t(id(operands[i])))));
+                        record.push_back(block(inst.labels[i]));
+                    }
+                    break;
+                case INST_ALLOCA:
+                    record.push_back(inst.type->id);
+                    record.push_back(operands[0].type->id);
+                    record.push_back(id(operands[0]));
+                    record.push_back((inst.align & 31) | (inst.align >> 5) << 8 | 1 << 6);
+                    break;
+                case INST_LOAD:
+                    push(record, operands[0], true);
+                    record.push_back(inst.type->id);
+                    record.push_back(inst.align);
+                    record.push_back(0);
+                    break;
+                case INST_STORE:
+                    push(record, operands[1], true);
+                    push(record, operands[0], true);
+                    record.push_back(inst.align);
+                    record.push_back(0);
+                    break;
+                case INST_GEP:
+                    record.push_back(inst.flags);
+                    record.push_back(inst.type->id);
+                    for(auto &operand : operands)
+                    {
+                        push(record, operand, true);
+                    }
+                    break;
+                case INST_CALL:
+                {
+                    record.push_back(inst.attributes);
+                    record.push_back(inst.opcode);
+                    record.push_back(inst.type->id);
+                    push(record, operands[0], true);
+                    size_t fixed = inst.type->elements.size() - 1;
+                    for(size_t i = 1; i < operands.size(); i++)
+                    {
+                        push(record, operands[i], i > fixed);
+                    }
+                    break;
+                }
+                case INST_RET:
+                    if(!operands.empty())
+                    {
+                        push(record, operands[0], true);
+                    }
+                    break;
+                case INST_BR:
+                    record.push_back(block(inst.labels[0]));
+                    if(!operands.empty())
+                    {
+                        record.push_back(block(inst.labels[1]));
+                        push(record, operands[0]);
+                    }
+                    break;
+                case INST_SWITCH:
+                    record.push_back(inst.type->id);
+                    push(record, operands[0]);
+                    record.push_back(block(inst.labels[0]));
+                    for(size_t i = 1; i < operands.size(); i++)
+                    {
+                        record.push_back(id(operands[i]));
+                        record.push_back(block(inst.labels[i]));
+                    }
+                    break;
+                }
+                stream_.record(inst.code, record);
+            }
+
+            // names of the arguments, instructions and blocks; numbered ones have none
+            void symbols(const Function &function)
+            {
+                auto named = [](const std::string &name)
+                {
+                    return !name.empty() && name.find_first_not_of("0123456789") != std::string::npos;
+                };
+                stream_.enterBlock(VALUE_SYMTAB_BLOCK, 4);
+                for(auto &local : locals_)
+                {
+                    if(named(local.first))
+                    {
+                        stream_.record(VST_ENTRY, local.second, local.first);
+                    }
+                }
+                for(size_t b = 0; b < function.blocks.size(); b++)
+                {
+                    if(named(function.blocks[b]))
+                    {
+                        stream_.record(VST_BBENTRY, b, function.blocks[b]);
+                    }
+                }
+                stream_.endBlock();
+            }
+
+          private:
+            Reader &                            module_;
+            Bitstream                           stream_;
+            std::vector<Type *>                 order_;
+            std::string                         strtab_;
+            std::unordered_map<std::string, unsigned>   ids_;       // globals and functions
+            unsigned                                    values_;    // module values, where those of a function start
+            std::unordered_map<std::string, unsigned>   locals_;
+            std::unordered_map<std::string, uint64_t>   blocks_;
+            std::vector<uint64_t>                       record_;    // of the instruction written, kept for its storage
+            unsigned                            next_;      // id of the next instruction
+        };
+    }
+
+    bool writeBitcode(const std::string &header, const std::vector<IRFunction> &functions,
+                      const std::string &trailer, std::ostream &out, std::string &error)
+    {
+        try
+        {
+            Reader reader;
+            reader.read(header);
+            for(auto &function : functions)
+            {
+                reader.add(function);
+            }
+            reader.read(trailer);
+            Writer writer(reader);
+            writer.write(out);
+            return true;
+        }
+        catch(const std::exception &e)
+        {
+            error = e.what();
+            return false;
+        }
+    }
+}
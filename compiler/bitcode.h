@@ -0,0 +1,29 @@
+#ifndef BITCODE_H_
+#define BITCODE_H_
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "ir.h"
+
+namespace ycc
+{
+    /*
+     * LLVM bitcode without LLVM. The functions ycc generated are taken as
+     * they are; the header before them and the runtime after them, which
+     * exist only as text (declarations, api IR), are read back. Types,
+     * constants and instructions are written in the bitstream format of
+     * LLVM 14, the same records llvm-as writes, so llc and clang skip
+     * parsing the text. Blocks are module, attributes, types, constants,
+     * function bodies with their block and value names, and the string
+     * table; metadata only for the branch weights of a profile, and no use
+     * list or symbol table block, which readers do not need.
+     */
+
+    // the module write() of IRGenerator prints; false, with the reason in error,
+    // if it has something the writer does not know
+    bool writeBitcode(const std::string &header, const std::vector<IRFunction> &functions,
+                      const std::string &trailer, std::ostream &out, std::string &error);
+}
+
+#endif
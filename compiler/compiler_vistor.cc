@@ -1,6 +1,8 @@
 #include <iostream>
 #include "compiler_vistor.h"
 #include "../common/symbols.h"
+#include "../common/thread_pool.h"
+#include "../common/trace.h"
 
 using std::cout;
 using std::endl;
@@ -9,20 +11,74 @@ namespace ycc
 {
 
     CompilerVistor::CompilerVistor()
-        : errorFlag_(false),variableFlag_(false),initVariable_(true),call_value(false)
+        : errorFlag_(false),jobs_(1),methods_(nullptr),worker_(false),
+          variableFlag_(false),initVariable_(true),call_value(false),callInfo_(nullptr),
+          call_index(0),qualifier_(nullptr),qualifying_(false),classQualified_(false),staticMethod_(false),
+          arrayType_(-1),loopDepth_(0)
     {
         symbolTable_ = SymbolTable::getInstance();
     }
 
+    void CompilerVistor::setJobs(int jobs)
+    {
+        jobs_ = jobs;
+    }
+
     bool CompilerVistor::check(VecNodePtr ast)
     {
+        // class level first, so every member is declared before any method
+        // body is checked; method bodies are collected on the way
+        VecMethodUnit methods;
+        methods_ = &methods;
         for(auto node : ast)
         {
             node->accept(this);
         }
+        methods_ = nullptr;
+
+        // method bodies only share read-only symbols, check them in parallel
+        std::vector<CompilerVistor> workers(methods.size());
+        ThreadPool pool(jobs_);
+        pool.run(methods.size(), [&](int i)
+        {
+            workers[i].checkMethod(methods[i]);
+        });
+
+        // merge in source order, so the result does not depend on jobs
+        for(auto &worker : workers)
+        {
+            for(auto &e : worker.errors_)
+            {
+                ExceptionHandler::getInstance()->add(e);
+                errorFlag_ = true;
+            }
+            for(auto node : worker.literals_)
+            {
+                node->value = symbolTable_->addLiteral(node->value);
+            }
+            for(auto &use : worker.fieldHeat_)
+            {
+                fieldHeat_[use.first] += use.second;
+            }
+        }
+        for(auto &use : fieldHeat_)
+        {
+            symbolTable_->addFieldHeat(use.first.first->className(), use.first.second, use.second);
+        }
         return errorFlag_;
     }
 
+    void CompilerVistor::checkMethod(const MethodUnit &unit)
+    {
+        TraceSpan span("semantic", unit.className, unit.method->name);
+        worker_ = true;
+        className_ = unit.className;
+        symbolTable_->enterClass(unit.className);
+        staticMethod_ = !symbolTable_->hasThis(className_, symbolTable_->getMethodInfo(unit.method->name));
+        unit.method->accept(this);
+        symbolTable_->leaveClass();
+    }
+
     // tool for semantic check
     bool CompilerVistor::numeric(int typeIndex)
     {
@@ -38,6 +94,18 @@ namespace ycc
         return false;
     }
 
+    bool CompilerVistor::integral(int typeIndex)
+    {
+        auto type = symbolTable_->getTypeInfo(typeIndex);
+        return numeric(typeIndex) && !(type == TypeInfo::FLOAT) && !(type == TypeInfo::DOUBLE);
+    }
+
+    // objects and arrays, whose variables may hold null
+    bool CompilerVistor::reference(int typeIndex)
+    {
+        return symbolTable_->isClass(typeIndex) || symbolTable_->getTypeInfo(typeIndex).isArray();
+    }
+
     int CompilerVistor::maxType(int type1, int type2)
     {
         return type1 > type2 ? type1 : type2;
@@ -45,7 +113,14 @@ namespace ycc
 
     void CompilerVistor::errorReport(const std::string &msg, const TokenLocation &loc, ErrorType errorType)
     {
-        ExceptionHandler::getInstance()->add(msg, loc, errorType);
+        if(worker_)
+        {
+            errors_.push_back(Exception(msg, loc, errorType));
+        }
+        else
+        {
+            ExceptionHandler::getInstance()->add(msg, loc, errorType);
+        }
         errorFlag_ = true;
     }
 
@@ -69,13 +144,22 @@ namespace ycc
 
     void CompilerVistor::visit(ClassStmt *node)
     {
+        TraceSpan span("semantic", node->name);
+        auto outerName = className_;
+        className_ = node->name;
         symbolTable_->enterClass(node->name);
         node->body->accept(this);
         symbolTable_->leaveClass();
+        className_ = outerName;
     }
 
     void CompilerVistor::visit(MethodDeclStmt *node)
     {
+        if(methods_)
+        {
+            methods_->push_back(MethodUnit{className_, node});
+            return ;
+        }
         symbolTable_->enter(node->name);
         node->body->accept(this);
         symbolTable_->leave();
@@ -113,22 +197,38 @@ namespace ycc
 
     void CompilerVistor::visit(ForStmt *node)
     {
-        node->init->accept(this);
-        node->condition->accept(this);
-        node->update->accept(this);
+        // every part of the header is optional
+        if(node->init)
+        {
+            node->init->accept(this);
+        }
+        loopDepth_++;
+        if(node->condition)
+        {
+            node->condition->accept(this);
+        }
+        if(node->update)
+        {
+            node->update->accept(this);
+        }
         node->body->accept(this);
+        loopDepth_--;
     }
 
     void CompilerVistor::visit(WhileStmt *node)
     {
+        loopDepth_++;
         node->condition->accept(this);
         node->body->accept(this);
+        loopDepth_--;
     }
 
     void CompilerVistor::visit(DoStmt *node)
     {
+        loopDepth_++;
         node->body->accept(this);
         node->condition->accept(this);
+        loopDepth_--;
     }
 
     void CompilerVistor::visit(SwitchStmt *node)
@@ -188,7 +288,8 @@ namespace ycc
 		}
 		else
 		{
-			if(!node->initValue)
+			// member variables have default values
+			if(!node->initValue && !info->check(SymbolTag::MEMBER))
 			{
 				info->setAttribute(SymbolTag::UNDEFINED);
 			}
@@ -207,11 +308,59 @@ namespace ycc
 
     void CompilerVistor::visit(IdentifierExpr *node)
     {
+        // a class name qualifies, except as a member of an object or class
+        if(qualifying_ && !qualifier_)
+        {
+            qualifier_ = symbolTable_->getClassTable(node->name);
+            if(qualifier_)
+            {
+                return ;
+            }
+        }
+        if(qualifier_)
+        {
+            // Class.field
+            auto table = qualifier_;
+            qualifier_ = nullptr;
+            if(table->hasVariable(node->name, false))
+            {
+                auto &info = table->getVariableInfo(node->name);
+                if(classQualified_ && !info.check(SymbolTag::STATIC) && !info.check(SymbolTag::CLASS))
+                {
+                    std::string error_msg = "Cannot make a static reference to the non-static field " + node->name;
+                    errorReport(error_msg, node->getLocation(), ErrorType::ERROR);
+                }
+                node->setType(info.getType());
+                variableFlag_ = true;
+                variableName_ = "";
+                // a use in a loop counts as many, for the hot field layout
+                long heat = 1;
+                for(int i = 0; i < loopDepth_ && i < 6; i++)
+                {
+                    heat *= 8;
+                }
+                fieldHeat_[std::make_pair(table, node->name)] += heat;
+            }
+            else
+            {
+                std::string error_msg = node->name + " cannot be resolved or is not a field of " + table->className();
+                errorReport(error_msg, node->getLocation(), ErrorType::ERROR);
+            }
+            return ;
+        }
 
         if(symbolTable_->hasVariable(node->name))
 		{
         	auto nodeInfo = symbolTable_->getVariableInfo(node->name);
         	variableFlag_ = true;
+            // a field of the class, not a local, is read through this
+            auto table = symbolTable_->getClassTable(className_);
+            if(staticMethod_ && table && !symbolTable_->hasVariable(node->name, false) && table->hasVariable(node->name, false)
+               && !nodeInfo.check(SymbolTag::STATIC) && !nodeInfo.check(SymbolTag::CLASS))
+            {
+                std::string error_msg = "Cannot make a static reference to the non-static field " + node->name;
+                errorReport(error_msg, node->getLocation(), ErrorType::ERROR);
+            }
         	if(nodeInfo.check(SymbolTag::UNDEFINED) && initVariable_)
 			{
         		node->setType(symbolTable_->getTypeIndex("void"));
@@ -233,51 +382,179 @@ namespace ycc
 
     void CompilerVistor::visit(NewExpr *node)
     {
-        // TODO: check constructor
-        node->constructor->accept(this);
+        // new Type[n][m]: the parser made the array type, the sizes are integers
+        std::string dims;
+        auto expr = node->constructor;
+        auto outerValue = call_value;
+        call_value = false;
+        while(auto index = dynamic_cast<IndexExpr *>(expr))
+        {
+            index->index->accept(this);
+            if(!integral(index->index->getType()))
+            {
+                std::string error_msg = "Type mismatch: cannot convert from "+symbolTable_->getTypeName(index->index->getType())+" to int";
+                errorReport(error_msg, index->index->getLocation(), ErrorType::ERROR);
+            }
+            dims += "[]";
+            expr = index->left;
+        }
+        call_value = outerValue;
+        if(dims.empty())
+        {
+            // new Class(): there are no constructors yet, the fields get their default values
+            auto call = dynamic_cast<CallExpr *>(node->constructor);
+            auto table = call ? symbolTable_->getClassTable(call->callee) : nullptr;
+            if(!table || !symbolTable_->hasType(call->callee))
+            {
+                std::string error_msg = (call ? call->callee : "new") + " cannot be resolved to a type";
+                errorReport(error_msg, node->getLocation(), ErrorType::ERROR);
+                node->setType(symbolTable_->getTypeIndex("void"));
+                return ;
+            }
+            if(!call->arguments.empty())
+            {
+                std::string error_msg = "The constructor " + call->callee + "() is not applicable for the arguments";
+                errorReport(error_msg, node->getLocation(), ErrorType::ERROR);
+            }
+            node->setType(symbolTable_->getTypeIndex(call->callee));
+            variableFlag_ = false;
+            return ;
+        }
+
+        auto base = dynamic_cast<IdentifierExpr *>(expr);
+        if(!base || !symbolTable_->hasType(base->name + dims))
+        {
+            std::string error_msg = (base ? base->name : "new") + " cannot be resolved to a type";
+            errorReport(error_msg, node->getLocation(), ErrorType::ERROR);
+            node->setType(symbolTable_->getTypeIndex("void"));
+            return ;
+        }
+        node->setType(symbolTable_->getTypeIndex(base->name + dims));
+        variableFlag_ = false;
     }
 
     void CompilerVistor::visit(IndexExpr *node)
     {
-        // TODO: check index can be an integer
+        auto outerValue = call_value;
+        call_value = false;
         node->left->accept(this);
         node->index->accept(this);
+        call_value = outerValue;
+
+        auto lt = node->left->getType();
+        auto it = node->index->getType();
+        if(!symbolTable_->getTypeInfo(lt).isArray())
+        {
+            std::string error_msg = "The type of the expression must be an array type but it resolved to "+symbolTable_->getTypeName(lt);
+            errorReport(error_msg, node->getLocation(), ErrorType::ERROR);
+            node->setType(symbolTable_->getTypeIndex("void"));
+            return ;
+        }
+        if(!integral(it))
+        {
+            std::string error_msg = "Type mismatch: cannot convert from "+symbolTable_->getTypeName(it)+" to int";
+            errorReport(error_msg, node->index->getLocation(), ErrorType::ERROR);
+        }
+        // an element is a variable, but not the array variable itself
+        node->setType(symbolTable_->getTypeInfo(lt).arrayOf());
+        variableFlag_ = true;
+        variableName_ = "";
     }
 
     void CompilerVistor::visit(CallExpr *node)
     {
-    	call_value = true;
-    	call_name = node->callee;
-        call_index = 0;
+        // Class.method() is looked up in Class, method() in the current class
+        auto table = qualifier_;
+        qualifier_ = nullptr;
+        const MethodInfo *mInfo = nullptr;
+        if(table ? table->hasMethod(node->callee, false) : symbolTable_->hasMethod(node->callee))
+        {
+            mInfo = table ? &table->getMethodInfo(node->callee) : &symbolTable_->getMethodInfo(node->callee);
+        }
+        else
+        {
+            std::string error_msg = "The method " + node->callee + " is undefined";
+            errorReport(error_msg, node->getLocation(), ErrorType::ERROR);
+        }
+        // an instance method needs an object, or this
+        if(mInfo && symbolTable_->hasThis(table ? table->className() : className_, *mInfo)
+           && (table ? classQualified_ : staticMethod_))
+        {
+            std::string error_msg = "Cannot make a static reference to the non-static method " + node->callee;
+            errorReport(error_msg, node->getLocation(), ErrorType::ERROR);
+        }
 
+        // arguments may be calls themselves
+        auto outerValue = call_value;
+        auto outerInfo = callInfo_;
+        auto outerIndex = call_index;
+    	call_value = mInfo != nullptr;
+    	callInfo_ = mInfo;
+        call_index = 0;
         for(auto v : node->arguments)
         {
             v->accept(this);
             call_index++;
         }
-        MethodInfo mInfo = symbolTable_->getMethodInfo(node->callee);
-        node->setType(mInfo.getType());
+        call_value = outerValue;
+        callInfo_ = outerInfo;
+        call_index = outerIndex;
 
-        call_value = false;
+        if(!mInfo)
+        {
+            node->setType(symbolTable_->getTypeIndex("void"));
+            return ;
+        }
+        if(node->arguments.size() != mInfo->parameters_.size())
+        {
+            std::string error_msg = "The method " + node->callee + " is not applicable for the arguments";
+            errorReport(error_msg, node->getLocation(), ErrorType::ERROR);
+        }
+        node->setType(mInfo->getType());
     }
 
     void CompilerVistor::visit(QualifiedIdExpr *node)     //  .
     {
-        // TODO: check left is the qualifier of right
+        // Class.method(), Class.field, object.field and the length of an array
+        qualifying_ = true;
         node->left->accept(this);
+        qualifying_ = false;
+        classQualified_ = qualifier_ != nullptr;
+        auto member = dynamic_cast<IdentifierExpr *>(node->right);
+        if(!qualifier_ && symbolTable_->getTypeInfo(node->left->getType()).isArray()
+            && member && member->name == "length")
+        {
+            node->right->setType(symbolTable_->getTypeIndex("int"));
+            node->setType(symbolTable_->getTypeIndex("int"));
+            variableFlag_ = false;
+            return ;
+        }
+        if(!qualifier_ && symbolTable_->isClass(node->left->getType()))
+        {
+            qualifier_ = symbolTable_->getClassTable(symbolTable_->getTypeName(node->left->getType()));
+        }
+        if(!qualifier_)
+        {
+            std::string error_msg = "Only a class name or an object can qualify a member here";
+            errorReport(error_msg, node->getLocation(), ErrorType::ERROR);
+            node->setType(symbolTable_->getTypeIndex("void"));
+            return ;
+        }
         node->right->accept(this);
+        qualifier_ = nullptr;
         auto rt = node->right->getType();
         node->setType(rt);
     }
 
     void CompilerVistor::visit(IntExpr *node)
     {
-        node->setType(symbolTable_->getTypeIndex("int"));
+        auto suffix = node->lexeme.empty() ? ' ' : node->lexeme.back();
+        node->setType(symbolTable_->getTypeIndex(node->isChar ? "char" : (suffix == 'L' || suffix == 'l') ? "long" : "int"));
         if(call_value)
         {
-        	MethodInfo mInfo = symbolTable_->getMethodInfo(call_name);
+        	const MethodInfo &mInfo = *callInfo_;
         	if(call_index<mInfo.parameters_.size()){
-        		if(mInfo.paramTypes_[call_index]!=node->getType()){
+        		if(maxType(mInfo.paramTypes_[call_index],node->getType())!=mInfo.paramTypes_[call_index]){
         			std::string error_msg = "Type mismatch: cannot convert from "+symbolTable_->getTypeName(node->getType())+" to "+symbolTable_->getTypeName(mInfo.paramTypes_[call_index]);
 					errorReport(error_msg,node->getLocation(),ErrorType::ERROR);
 				}
@@ -291,7 +568,7 @@ namespace ycc
         node->setType(symbolTable_->getTypeIndex("double"));
         if(call_value)
         {
-        	MethodInfo mInfo = symbolTable_->getMethodInfo(call_name);
+        	const MethodInfo &mInfo = *callInfo_;
         	if(call_index<mInfo.parameters_.size()){
         		if(mInfo.paramTypes_[call_index]!=node->getType()){
         			std::string error_msg = "Type mismatch: cannot convert from "+symbolTable_->getTypeName(node->getType())+" to "+symbolTable_->getTypeName(mInfo.paramTypes_[call_index]);
@@ -313,23 +590,54 @@ namespace ycc
 
     void CompilerVistor::visit(StrExpr *node)
     {
-        node->value = symbolTable_->addLiteral(node->value);
+        if(worker_)
+        {
+            literals_.push_back(node);
+        }
+        else
+        {
+            node->value = symbolTable_->addLiteral(node->value);
+        }
         node->setType(symbolTable_->getTypeIndex("String"));
     }
 
+    // {a, b, ...} initializes a declared array, nested ones its sub-arrays
     void CompilerVistor::visit(ArrayExpr *node)
     {
+        auto type = arrayType_ >= 0 ? arrayType_ : info->getType();
+        node->setType(type);
+        if(!symbolTable_->getTypeInfo(type).isArray())
+        {
+            std::string error_msg = "Type mismatch: cannot convert from an array initializer to "+symbolTable_->getTypeName(type);
+            errorReport(error_msg, node->getLocation(), ErrorType::ERROR);
+            return ;
+        }
+
+        auto elemType = symbolTable_->getTypeInfo(type).arrayOf();
+        auto outerValue = call_value;
+        call_value = false;
         for(auto elem : node->elems)
         {
+            arrayType_ = elemType;
             elem->accept(this);
+            arrayType_ = -1;
+            auto et = elem->getType();
+            if(!(numeric(et) && numeric(elemType) && maxType(et, elemType) == elemType) && et != elemType)
+            {
+                std::string error_msg = "Type mismatch: cannot convert from "+symbolTable_->getTypeName(et)+" to "+symbolTable_->getTypeName(elemType);
+                errorReport(error_msg, elem->getLocation(), ErrorType::ERROR);
+            }
         }
+        call_value = outerValue;
     }
 
     void CompilerVistor::visit(UnaryOpExpr *node)
     {
         node->expr->accept(this);
         auto et = node->expr->getType();
-        if(!numeric(et))
+        auto type = symbolTable_->getTypeInfo(et);
+        node->setType(et);
+        if(!numeric(et) && !(node->op == TokenTag::NOT && type == TypeInfo::BOOLEAN))
 		{
         	std::string error_msg = "Type mismatch: cannot convert from "+symbolTable_->getTypeName(et)+" to int";
 			errorReport(error_msg,node->getLocation(),ErrorType::ERROR);
@@ -356,14 +664,17 @@ namespace ycc
 			}
 			else
 			{
-				if(numeric(rt))
+				if((numeric(rt) && numeric(lt)) || rt == lt || (reference(lt) && dynamic_cast<NullExpr *>(node->right)))
 				{
 					if(maxType(lt,rt) == lt)
 					{
 			        	node->setType(maxType(lt,rt));
-			        	SymbolInfo sInfo = symbolTable_->getVariableInfo(variableName_);     //��ֵ֮���ѱ�������Ϊ�Ѿ���ֵ
-			        	sInfo.setAttribute(SymbolTag::UNDEFINED,0);
-                        symbolTable_->setVariableInfo(variableName_, sInfo);
+			        	SymbolInfo sInfo = variableName_.empty() ? SymbolInfo::NONE : symbolTable_->getVariableInfo(variableName_);     //��ֵ֮���ѱ�������Ϊ�Ѿ���ֵ
+                        if(sInfo.check(SymbolTag::UNDEFINED))
+                        {
+                            sInfo.setAttribute(SymbolTag::UNDEFINED,0);
+                            symbolTable_->setVariableInfo(variableName_, sInfo);
+                        }
 					}
 					else
 					{
@@ -386,7 +697,10 @@ namespace ycc
         	auto lt = node->left->getType();     //����������
         	node->right->accept(this);
         	auto rt = node->right->getType();      // ����������
-        	if(numeric(lt)&&numeric(rt))
+        	bool equality = node->op == TokenTag::EQUAL || node->op == TokenTag::NOT_EQUAL;
+        	bool references = (reference(lt) || dynamic_cast<NullExpr *>(node->left))
+        	               && (reference(rt) || dynamic_cast<NullExpr *>(node->right));
+        	if((numeric(lt)&&numeric(rt)) || (equality && references && (lt == rt || !reference(lt) || !reference(rt))))
         	{
         		node->setType(symbolTable_->getTypeIndex("boolean"));   //Type -> bool
 			}
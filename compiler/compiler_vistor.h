@@ -16,6 +16,7 @@ namespace ycc
         ~CompilerVistor() = default;
 
         bool check(VecNodePtr ast);
+        void setJobs(int jobs);
 
     private:
         void visit(ASTNode *node);
@@ -52,8 +53,12 @@ namespace ycc
         void visit(BinaryOpExpr *node);
         void visit(TernaryOpExpr *node);
 
+        void checkMethod(const MethodUnit &unit);
+
         void errorReport(const std::string &msg, const TokenLocation &loc, ErrorType tag);
         bool numeric(int typeIndex);
+        bool integral(int typeIndex);
+        bool reference(int typeIndex);
         int  maxType(int type1, int type2);
 
     private:
@@ -62,6 +67,15 @@ namespace ycc
         SymbolInfo      *info;
         bool            errorFlag_;
 
+        // parallel checking of method bodies
+        int                         jobs_;
+        std::string                 className_;
+        VecMethodUnit *             methods_;       // not null while collecting method bodies
+        bool                        worker_;        // checking one method body on a worker thread
+        std::vector<Exception>      errors_;        // errors found by a worker, merged in source order
+        std::vector<StrExpr*>       literals_;      // literals found by a worker, registered in source order
+        std::map<std::pair<const ClassTable *, std::string>, long>  fieldHeat_;    // uses of fields, by loop depth
+
     private:
     	bool 			variableFlag_;
     	bool 			initVariable_;
@@ -69,8 +83,15 @@ namespace ycc
     	std::string		variableName_;
 
     	bool			call_value;
-    	std::string 	call_name;
+    	const MethodInfo *	callInfo_;      // method whose arguments are being checked
     	int 			call_index;
+
+    	const ClassTable *	qualifier_;     // class named on the left of a '.', or the class of the object there
+    	bool			qualifying_;
+    	bool			classQualified_;    // the left of the '.' names a class, not an object
+    	bool			staticMethod_;  // the method being checked has no this
+    	int			arrayType_;     // type of a nested array initializer, -1 outside
+    	int			loopDepth_;
     };
 
 }
@@ -0,0 +1,601 @@
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <unordered_set>
+#include "counted_loops.h"
+
+namespace ycc
+{
+    CountedLoops::CountedLoops(int factor)
+        : factor_(factor),inductionVariables_(0),reduced_(0),unrolled_(0)
+    {
+    }
+
+    void CountedLoops::run(std::vector<IRFunction> &functions)
+    {
+        for(auto &function : functions)
+        {
+            optimize(function);
+        }
+    }
+
+    // an integer literal
+    static bool integer(const IRValue &value, long long &result)
+    {
+        if(value.name.empty() || value.type.size() < 2 || value.type[0] != 'i' || value.type == "i1")
+        {
+            return false;
+        }
+        char *end = nullptr;
+        result = std::strtoll(value.name.c_str(), &end, 10);
+        return end && *end == '\0' && end != value.name.c_str();
+    }
+
+    // value as a literal of an integer type, wrapped to its width
+    static std::string wrap(unsigned long long value, const std::string &type)
+    {
+        int bits = std::atoi(type.c_str() + 1);
+        if(bits > 0 && bits < 64)
+        {
+            value &= (1ULL << bits) - 1;
+            if(value >> (bits - 1))
+            {
+                value |= ~0ULL << bits;
+            }
+        }
+        return std::to_string((long long)value);
+    }
+
+    static size_t find(const IRFunction &function, const std::string &label)
+    {
+        for(size_t b = 0; b < function.blocks.size(); b++)
+        {
+            if(function.blocks[b].label == label)
+            {
+                return b;
+            }
+        }
+        return function.blocks.size();
+    }
+
+    static void removeDead(IRFunction &function, const std::set<std::pair<size_t, size_t>> &dead)
+    {
+        for(auto iter = dead.rbegin(); iter != dead.rend(); ++iter)
+        {
+            auto &insts = function.blocks[iter->first].insts;
+            insts.erase(insts.begin() + iter->second);
+        }
+    }
+
+    static void insertBeforeTerminator(IRBlock &block, std::vector<IRInst> &insts)
+    {
+        block.insts.insert(block.insts.end() - 1, insts.begin(), insts.end());
+    }
+
+    void CountedLoops::optimize(IRFunction &function)
+    {
+        if(function.blocks.size() < 2)
+        {
+            return ;
+        }
+        slots_.clear();
+        for(auto &inst : function.blocks[0].insts)
+        {
+            if(inst.op == IROp::ALLOCA)
+            {
+                slots_.insert(inst.result);
+            }
+        }
+        for(auto &block : function.blocks)
+        {
+            for(auto &inst : block.insts)
+            {
+                for(size_t i = 0; i < inst.operands.size(); i++)
+                {
+                    bool address = (inst.op == IROp::LOAD && i == 0) || (inst.op == IROp::STORE && i == 1);
+                    if(!address)
+                    {
+                        slots_.erase(inst.operands[i].name);
+                    }
+                }
+            }
+        }
+        if(slots_.empty())
+        {
+            return ;
+        }
+
+        // phis and products change no edge, the tree holds until unrolling
+        DominatorTree tree(function);
+        std::vector<Counted> loops;
+        for(auto &loop : tree.loops())
+        {
+            Counted counted{"", "", "", std::vector<Induction>(), 0, false};
+            if(!promote(function, tree, loop, counted))
+            {
+                continue;
+            }
+            rename(function);
+            counted.reduced = reduce(function, loop, counted);
+            rename(function);
+            loops.push_back(counted);
+        }
+        for(auto &counted : loops)
+        {
+            counted.unrolled = factor_ > 1 && unroll(function, counted);
+            inductionVariables_ += counted.inductions.size();
+            reduced_ += counted.reduced;
+            unrolled_ += counted.unrolled;
+
+            std::string line = function.name + " " + counted.header + ":";
+            for(auto &induction : counted.inductions)
+            {
+                line += " " + induction.slot;
+            }
+            if(counted.reduced)
+            {
+                line += ", " + std::to_string(counted.reduced) + " strength reduced";
+            }
+            if(counted.unrolled)
+            {
+                line += ", unrolled " + std::to_string(factor_) + " times";
+            }
+            report_.push_back(line);
+        }
+    }
+
+    void CountedLoops::rename(IRFunction &function)
+    {
+        if(renamed_.empty())
+        {
+            return ;
+        }
+        for(auto &block : function.blocks)
+        {
+            for(auto &inst : block.insts)
+            {
+                for(auto &operand : inst.operands)
+                {
+                    if(operand.isConstant() || operand.type == "label")
+                    {
+                        continue;
+                    }
+                    auto iter = renamed_.find(operand.name);
+                    if(iter != renamed_.end())
+                    {
+                        operand.name = iter->second;
+                    }
+                }
+            }
+        }
+        renamed_.clear();
+    }
+
+    bool CountedLoops::promote(IRFunction &function, const DominatorTree &tree, const NaturalLoop &loop,
+                               Counted &counted)
+    {
+        // one edge into the header from outside the loop, one back edge
+        long preheader = -1;
+        long latch = -1;
+        for(auto pred : tree.preds(loop.header))
+        {
+            auto &edge = loop.body[pred] ? latch : preheader;
+            if(edge >= 0)
+            {
+                return false;
+            }
+            edge = pred;
+        }
+        if(preheader < 0 || latch < 0)
+        {
+            return false;
+        }
+        counted.header = function.blocks[loop.header].label;
+        counted.preheader = function.blocks[preheader].label;
+        counted.latch = function.blocks[latch].label;
+
+        typedef std::pair<size_t, size_t> Place;   // block, instruction
+        std::unordered_map<std::string, Place> defs;
+        std::map<std::string, std::vector<Place>> stores;
+        for(auto b : loop.blocks)
+        {
+            auto &insts = function.blocks[b].insts;
+            for(size_t i = 0; i < insts.size(); i++)
+            {
+                if(!insts[i].result.empty())
+                {
+                    defs[insts[i].result] = Place(b, i);
+                }
+                if(insts[i].op == IROp::STORE && slots_.count(insts[i].operands[1].name))
+                {
+                    stores[insts[i].operands[1].name].push_back(Place(b, i));
+                }
+            }
+        }
+
+        std::set<Place> dead;
+        std::vector<IRInst> inits;
+        std::vector<IRInst> phis;
+        for(auto &entry : stores)
+        {
+            if(entry.second.size() != 1)
+            {
+                continue;
+            }
+            auto store = entry.second[0];
+            auto &value = function.blocks[store.first].insts[store.second].operands[0];
+            auto def = defs.find(value.name);
+            if(value.isConstant() || def == defs.end())
+            {
+                continue;
+            }
+            // counter + step, step + counter or counter - step
+            auto &add = function.blocks[def->second.first].insts[def->second.second];
+            long long step = 0;
+            if(add.op != IROp::BINARY || (add.opcode != "add" && add.opcode != "sub"))
+            {
+                continue;
+            }
+            size_t counter = integer(add.operands[1], step) ? 0 : 1;
+            if(!integer(add.operands[1 - counter], step) || (add.opcode == "sub" && counter != 0))
+            {
+                continue;
+            }
+            step = add.opcode == "sub" ? -step : step;
+            if(step == 0 || !tree.dominates(store.first, latch))
+            {
+                continue;
+            }
+
+            // blocks that run after the store in the same iteration
+            std::vector<bool> after(function.blocks.size(), false);
+            std::vector<size_t> work(tree.succs(store.first));
+            while(!work.empty())
+            {
+                auto b = work.back();
+                work.pop_back();
+                if(!loop.body[b] || b == loop.header || after[b])
+                {
+                    continue;
+                }
+                after[b] = true;
+                work.insert(work.end(), tree.succs(b).begin(), tree.succs(b).end());
+            }
+            // stored more than once per iteration, from an inner loop
+            if(after[store.first])
+            {
+                continue;
+            }
+
+            // a load reads the value at the top of the iteration or the one stored
+            std::vector<std::pair<Place, bool>> loads;
+            bool known = true;
+            bool counts = false;
+            for(auto b : loop.blocks)
+            {
+                auto &insts = function.blocks[b].insts;
+                for(size_t i = 0; i < insts.size(); i++)
+                {
+                    if(insts[i].op != IROp::LOAD || insts[i].operands[0].name != entry.first)
+                    {
+                        continue;
+                    }
+                    bool stored = b == store.first ? i > store.second : after[b];
+                    known = known && (!after[b] || tree.dominates(store.first, b));
+                    counts = counts || (!stored && insts[i].result == add.operands[counter].name);
+                    loads.push_back(std::make_pair(Place(b, i), stored));
+                }
+            }
+            if(!known || !counts)
+            {
+                continue;
+            }
+
+            auto &pointer = function.blocks[store.first].insts[store.second].operands[1];
+            Induction induction{entry.first, value.type, value.name + ".iv", value.name + ".init", value.name, step};
+            for(auto &load : loads)
+            {
+                auto &inst = function.blocks[load.first.first].insts[load.first.second];
+                renamed_[inst.result] = load.second ? induction.next : induction.phi;
+                dead.insert(load.first);
+            }
+            inits.push_back(IRInst{IROp::LOAD, induction.init, induction.type, "", {pointer}});
+            phis.push_back(IRInst{IROp::PHI, induction.phi, induction.type, "",
+                                  {IRValue{induction.type, induction.init}, IRValue{"label", counted.preheader},
+                                   IRValue{induction.type, induction.next}, IRValue{"label", counted.latch}}});
+            counted.inductions.push_back(induction);
+        }
+        if(counted.inductions.empty())
+        {
+            return false;
+        }
+        removeDead(function, dead);
+        insertBeforeTerminator(function.blocks[preheader], inits);
+        auto &header = function.blocks[loop.header].insts;
+        header.insert(header.begin(), phis.begin(), phis.end());
+        return true;
+    }
+
+    long CountedLoops::reduce(IRFunction &function, const NaturalLoop &loop, const Counted &counted)
+    {
+        std::unordered_set<std::string> defined;
+        for(auto b : loop.blocks)
+        {
+            for(auto &inst : function.blocks[b].insts)
+            {
+                if(!inst.result.empty())
+                {
+                    defined.insert(inst.result);
+                }
+            }
+        }
+
+        std::set<std::pair<size_t, size_t>> dead;
+        std::vector<IRInst> inits;
+        std::vector<IRInst> phis;
+        std::vector<IRInst> steps;
+        for(auto b : loop.blocks)
+        {
+            auto &insts = function.blocks[b].insts;
+            for(size_t i = 0; i < insts.size(); i++)
+            {
+                auto &inst = insts[i];
+                if(inst.op != IROp::BINARY || (inst.opcode != "mul" && inst.opcode != "shl"))
+                {
+                    continue;
+                }
+                const Induction *induction = nullptr;
+                size_t counter = 0;
+                for(auto &candidate : counted.inductions)
+                {
+                    for(size_t k = 0; k < 2 && !induction; k++)
+                    {
+                        if(inst.operands[k].name == candidate.phi && (k == 0 || inst.opcode == "mul"))
+                        {
+                            induction = &candidate;
+                            counter = k;
+                        }
+                    }
+                }
+                if(!induction || inst.type != induction->type)
+                {
+                    continue;
+                }
+                auto &factor = inst.operands[1 - counter];
+                long long constant = 0;
+                bool literal = integer(factor, constant);
+                if((factor.isConstant() && !literal) || defined.count(factor.name)
+                   || (inst.opcode == "shl" && (!literal || constant < 0 || constant >= 64)))
+                {
+                    continue;
+                }
+
+                // the product at the top of the loop, then what it grows by per iteration
+                IRInst init = inst;
+                init.result = inst.result + ".init";
+                init.operands[counter].name = induction->init;
+                inits.push_back(init);
+                IRValue step{inst.type, ""};
+                if(inst.opcode == "shl")
+                {
+                    step.name = wrap((unsigned long long)induction->step << constant, inst.type);
+                }
+                else if(literal)
+                {
+                    step.name = wrap((unsigned long long)induction->step * (unsigned long long)constant, inst.type);
+                }
+                else
+                {
+                    step.name = inst.result + ".step";
+                    inits.push_back(IRInst{IROp::BINARY, step.name, inst.type, "mul",
+                                           {factor, IRValue{inst.type, std::to_string(induction->step)}}});
+                }
+                auto phi = inst.result + ".iv";
+                auto next = inst.result + ".next";
+                phis.push_back(IRInst{IROp::PHI, phi, inst.type, "",
+                                      {IRValue{inst.type, init.result}, IRValue{"label", counted.preheader},
+                                       IRValue{inst.type, next}, IRValue{"label", counted.latch}}});
+                steps.push_back(IRInst{IROp::BINARY, next, inst.type, "add", {IRValue{inst.type, phi}, step}});
+                renamed_[inst.result] = phi;
+                dead.insert(std::make_pair(b, i));
+            }
+        }
+        if(dead.empty())
+        {
+            return 0;
+        }
+        removeDead(function, dead);
+        insertBeforeTerminator(function.blocks[find(function, counted.preheader)], inits);
+        insertBeforeTerminator(function.blocks[find(function, counted.latch)], steps);
+        auto &header = function.blocks[loop.header].insts;
+        header.insert(header.begin(), phis.begin(), phis.end());
+        return dead.size();
+    }
+
+    bool CountedLoops::unroll(IRFunction &function, const Counted &counted)
+    {
+        auto h = find(function, counted.header);
+        auto l = find(function, counted.latch);
+        auto p = find(function, counted.preheader);
+        if(h == l)
+        {
+            return false;
+        }
+        auto &header = function.blocks[h];
+        auto &body = function.blocks[l];
+        auto &branch = header.insts.back();
+        if(branch.op != IROp::CONDBR || branch.operands[1].name != body.label
+           || branch.operands[2].name == header.label || body.insts.back().op != IROp::BR)
+        {
+            return false;
+        }
+        // the body is entered from the header only
+        for(auto &block : function.blocks)
+        {
+            for(auto &label : block.successors())
+            {
+                if(label == body.label && block.label != header.label)
+                {
+                    return false;
+                }
+            }
+        }
+
+        // the counter against a bound from outside the loop
+        std::unordered_set<std::string> defined;
+        size_t size = 0;
+        for(auto block : {&header, &body})
+        {
+            for(auto &inst : block->insts)
+            {
+                if(!inst.result.empty())
+                {
+                    defined.insert(inst.result);
+                }
+                if(block == &header && (inst.op == IROp::STORE || inst.op == IROp::CALL))
+                {
+                    return false;
+                }
+                size += inst.op != IROp::PHI && !inst.isTerminator();
+            }
+        }
+        auto cmp = std::find_if(header.insts.begin(), header.insts.end(), [&](const IRInst &inst)
+        {
+            return inst.result == branch.operands[0].name;
+        });
+        if(cmp == header.insts.end() || cmp->op != IROp::CMP || (size - 1) * factor_ > 256)
+        {
+            return false;
+        }
+        auto &opcode = cmp->opcode;
+        bool sign = opcode == "icmp slt" || opcode == "icmp sle";
+        if(!sign && opcode != "icmp ult" && opcode != "icmp ule")
+        {
+            return false;
+        }
+        auto &bound = cmp->operands[1];
+        auto induction = std::find_if(counted.inductions.begin(), counted.inductions.end(), [&](const Induction &iv)
+        {
+            return iv.phi == cmp->operands[0].name;
+        });
+        if(induction == counted.inductions.end() || induction->step <= 0 || induction->type == "i64"
+           || defined.count(bound.name))
+        {
+            return false;
+        }
+        // the compare has no other use, the copies leave it out
+        bool compareUsed = false;
+        for(auto block : {&header, &body})
+        {
+            for(auto &inst : block->insts)
+            {
+                for(auto &operand : inst.operands)
+                {
+                    compareUsed = compareUsed || (&inst != &branch && operand.name == cmp->result);
+                }
+            }
+        }
+
+        // the copies of the body, each starting from the values the one before left
+        std::unordered_map<std::string, std::string> values;
+        auto value = [&](const std::string &name) -> const std::string &
+        {
+            auto iter = values.find(name);
+            return iter == values.end() ? name : iter->second;
+        };
+        std::vector<const IRInst *> phis;
+        for(auto &inst : header.insts)
+        {
+            if(inst.op == IROp::PHI)
+            {
+                phis.push_back(&inst);
+                values[inst.result] = inst.result + ".u0";
+            }
+        }
+        auto unrolled = header.label + ".unrolled";
+        std::vector<IRBlock> added(1, IRBlock{unrolled, std::vector<IRInst>()});
+        for(int k = 1; k <= factor_; k++)
+        {
+            auto suffix = ".u" + std::to_string(k);
+            IRBlock copy{body.label + suffix, std::vector<IRInst>()};
+            for(auto block : {&header, &body})
+            {
+                for(auto &inst : block->insts)
+                {
+                    if(inst.op == IROp::PHI || inst.isTerminator() || (&inst == &*cmp && !compareUsed))
+                    {
+                        continue;
+                    }
+                    copy.insts.push_back(inst);
+                    auto &clone = copy.insts.back();
+                    for(auto &operand : clone.operands)
+                    {
+                        if(operand.type != "label")
+                        {
+                            operand.name = value(operand.name);
+                        }
+                    }
+                    if(!clone.result.empty())
+                    {
+                        clone.result += suffix;
+                        values[inst.result] = clone.result;
+                    }
+                }
+            }
+            std::vector<std::string> next;
+            for(auto phi : phis)
+            {
+                next.push_back(value(phi->operands[phi->operands[1].name == body.label ? 0 : 2].name));
+            }
+            for(size_t i = 0; i < phis.size(); i++)
+            {
+                values[phis[i]->result] = next[i];
+            }
+            auto target = k == factor_ ? unrolled : body.label + ".u" + std::to_string(k + 1);
+            copy.insts.push_back(IRInst{IROp::BR, "", "void", "", {IRValue{"label", target}}});
+            added.push_back(copy);
+        }
+
+        // the new header: its phis, and whether factor iterations are left
+        auto &top = added[0].insts;
+        for(auto phi : phis)
+        {
+            size_t outside = phi->operands[1].name == body.label ? 2 : 0;
+            top.push_back(IRInst{IROp::PHI, phi->result + ".u0", phi->type, "",
+                                 {phi->operands[outside], IRValue{"label", counted.preheader},
+                                  IRValue{phi->type, value(phi->result)}, IRValue{"label", added.back().label}}});
+        }
+        auto ext = sign ? "sext" : "zext";
+        auto name = "%" + header.label;
+        top.push_back(IRInst{IROp::CAST, name + ".wide", "i64", ext, {IRValue{induction->type, induction->phi + ".u0"}}});
+        top.push_back(IRInst{IROp::BINARY, name + ".last", "i64", "add",
+                             {IRValue{"i64", name + ".wide"}, IRValue{"i64", std::to_string(induction->step * (factor_ - 1))}}});
+        top.push_back(IRInst{IROp::CAST, name + ".bound", "i64", ext, {bound}});
+        top.push_back(IRInst{IROp::CMP, name + ".guard", "i1", opcode,
+                             {IRValue{"i64", name + ".last"}, IRValue{"i64", name + ".bound"}}});
+        top.push_back(IRInst{IROp::CONDBR, "", "void", "",
+                             {IRValue{"i1", name + ".guard"}, IRValue{"label", added[1].label},
+                              IRValue{"label", header.label}}});
+
+        // the loop itself runs what is left, entered from the new header
+        for(auto &inst : header.insts)
+        {
+            if(inst.op != IROp::PHI)
+            {
+                break;
+            }
+            size_t outside = inst.operands[1].name == body.label ? 2 : 0;
+            inst.operands[outside].name = inst.result + ".u0";
+            inst.operands[outside + 1].name = unrolled;
+        }
+        for(auto &operand : function.blocks[p].insts.back().operands)
+        {
+            if(operand.type == "label" && operand.name == header.label)
+            {
+                operand.name = unrolled;
+            }
+        }
+        function.blocks.insert(function.blocks.begin() + h, added.begin(), added.end());
+        return true;
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef COUNTED_LOOPS_H_
+#define COUNTED_LOOPS_H_
+
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ir.h"
+#include "dominators.h"
+
+namespace ycc
+{
+    /*
+     * Counted loops of every method. The generator keeps the counter of a
+     * loop in a stack slot; a slot the loop stores once, with its value at
+     * the top of the loop plus a constant, in a block every iteration runs,
+     * becomes a phi in the header and its loads in the loop go. The slot is
+     * still stored, code after the loop reads it. A multiply or shift of
+     * such a counter by a constant or a value from outside the loop becomes
+     * a phi of its own that the latch adds the step to.
+     *
+     * With a factor above one, a loop of a header and one block that
+     * compares its counter with a bound from outside the loop is unrolled:
+     * a copy of it runs the body factor times per test while that many
+     * iterations are left, the loop itself runs the rest.
+     */
+    class CountedLoops
+    {
+      public:
+        explicit CountedLoops(int factor);
+
+        void                run(std::vector<IRFunction> &functions);
+        long                inductionVariables() const;
+        long                reduced() const;
+        long                unrolled() const;
+        const std::vector<std::string> &    report() const;     // one line per loop changed
+
+      private:
+        struct Induction
+        {
+            std::string     slot;
+            std::string     type;
+            std::string     phi;        // value at the top of an iteration
+            std::string     init;       // loaded in the preheader
+            std::string     next;       // stored by the iteration
+            long long       step;
+        };
+        struct Counted
+        {
+            std::string     header;
+            std::string     preheader;
+            std::string     latch;
+            std::vector<Induction>  inductions;
+            long            reduced;
+            bool            unrolled;
+        };
+
+        void                optimize(IRFunction &function);
+        bool                promote(IRFunction &function, const DominatorTree &tree, const NaturalLoop &loop,
+                                    Counted &counted);
+        long                reduce(IRFunction &function, const NaturalLoop &loop, const Counted &counted);
+        bool                unroll(IRFunction &function, const Counted &counted);
+        void                rename(IRFunction &function);
+
+      private:
+        int                                                 factor_;
+        long                                                inductionVariables_;
+        long                                                reduced_;
+        long                                                unrolled_;
+        std::vector<std::string>                            report_;
+        std::set<std::string>                               slots_;
+        std::unordered_map<std::string, std::string>        renamed_;   // loads and products gone, by name
+    };
+
+    inline long CountedLoops::inductionVariables() const
+    {
+        return inductionVariables_;
+    }
+
+    inline long CountedLoops::reduced() const
+    {
+        return reduced_;
+    }
+
+    inline long CountedLoops::unrolled() const
+    {
+        return unrolled_;
+    }
+
+    inline const std::vector<std::string> & CountedLoops::report() const
+    {
+        return report_;
+    }
+}
+
+#endif
@@ -8,7 +8,11 @@ using std::endl;
 namespace ycc
 {
     DepthVistor::DepthVistor()
-        : level(0)
+        : level(0), kinds_(nullptr)
+    {}
+
+    DepthVistor::DepthVistor(std::map<std::string, long> *kinds)
+        : level(0), kinds_(kinds)
     {}
 
     void DepthVistor::upgrade()
@@ -23,6 +27,15 @@ namespace ycc
 
     void DepthVistor::println(const std::string &msg, bool end)
     {
+        if(kinds_)
+        {
+            // every node prints its "<<kind>>" line once
+            if(msg.compare(0, 2, "<<") == 0)
+            {
+                (*kinds_)[msg.substr(2, msg.find(">>") - 2)]++;
+            }
+            return ;
+        }
         for(int i = 0; i < level-1; i++) cout << "│   ";
         if(end)
         {
@@ -38,6 +51,14 @@ namespace ycc
 
     void DepthVistor::visit(VecNodePtr ast)
     {
+        if(kinds_)
+        {
+            for(auto node : ast)
+            {
+                node->accept(this);
+            }
+            return ;
+        }
         cout << "<<AST>>" << endl;
         for(auto node : ast)
         {
@@ -1,6 +1,7 @@
 #ifndef DEPTH_VISTOR_H_
 #define DEPTH_VISTOR_H_
 
+#include <map>
 #include "../parser/vistor.h"
 #include "../parser/ast.hpp"
 
@@ -10,6 +11,7 @@ namespace ycc
     {
     public:
         DepthVistor();
+        explicit DepthVistor(std::map<std::string, long> *kinds);  // count nodes, print nothing
         ~DepthVistor() = default;
 
         virtual void visit(VecNodePtr ast);
@@ -53,6 +55,7 @@ namespace ycc
         void            degrade();
 
         int             level;
+        std::map<std::string, long> *   kinds_;
     };
 }
 
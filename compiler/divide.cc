@@ -0,0 +1,147 @@
+#include <cstdint>
+#include <type_traits>
+#include "divide.h"
+
+namespace ycc
+{
+    // the magic number of a divisor d, 2 <= |d|, for U of as many bits as the dividend
+    template<typename U>
+    static void magic(long long divisor, long long &multiplier, int &shift)
+    {
+        const int bits = sizeof(U) * 8;
+        const U two = U(1) << (bits - 1);
+        U d = U(divisor);
+        U ad = divisor < 0 ? U(0) - d : d;
+        U t = two + (d >> (bits - 1));
+        U anc = t - 1 - t % ad;         // |d| times the largest quotient, less one
+        int p = bits - 1;
+        U q1 = two / anc;
+        U r1 = two - q1 * anc;
+        U q2 = two / ad;
+        U r2 = two - q2 * ad;
+        U delta;
+        do
+        {
+            p++;
+            q1 = U(2 * q1);
+            r1 = U(2 * r1);
+            if(r1 >= anc)
+            {
+                q1++;
+                r1 -= anc;
+            }
+            q2 = U(2 * q2);
+            r2 = U(2 * r2);
+            if(r2 >= ad)
+            {
+                q2++;
+                r2 -= ad;
+            }
+            delta = ad - r2;
+        } while(q1 < delta || (q1 == delta && r1 == 0));
+
+        U m = q2 + 1;
+        if(divisor < 0)
+        {
+            m = U(0) - m;
+        }
+        multiplier = (typename std::make_signed<U>::type)m;
+        shift = p - bits;
+    }
+
+    static unsigned long long magnitude(long long divisor)
+    {
+        return divisor < 0 ? 0ULL - (unsigned long long)divisor : (unsigned long long)divisor;
+    }
+
+    bool divisionMagic(long long divisor, int bits, long long &multiplier, int &shift)
+    {
+        auto ad = magnitude(divisor);
+        if(ad < 2 || (ad & (ad - 1)) == 0)
+        {
+            return false;
+        }
+        if(bits == 32)
+        {
+            magic<uint32_t>(divisor, multiplier, shift);
+        }
+        else
+        {
+            magic<uint64_t>(divisor, multiplier, shift);
+        }
+        return true;
+    }
+
+    bool divideByConstant(IRBuilder &builder, bool remainder, const IRValue &dividend,
+                          long long divisor, IRValue &result)
+    {
+        int bits = dividend.type == "i32" ? 32 : dividend.type == "i64" ? 64 : 0;
+        if(bits == 0 || divisor == 0)
+        {
+            return false;
+        }
+        auto constant = [&](long long value)
+        {
+            return IRValue{dividend.type, std::to_string(value)};
+        };
+        if(divisor == 1 || divisor == -1)
+        {
+            result = remainder ? constant(0)
+                   : divisor == 1 ? dividend : builder.binary("sub", constant(0), dividend);
+            return true;
+        }
+
+        auto ad = magnitude(divisor);
+        IRValue quotient;
+        long long multiplier;
+        int shift;
+        if(!divisionMagic(divisor, bits, multiplier, shift))
+        {
+            // a negative dividend gets |d| - 1 added, then the shift rounds toward zero
+            int k = 0;
+            while((1ULL << k) != ad)
+            {
+                k++;
+            }
+            auto sign = k == 1 ? dividend : builder.binary("ashr", dividend, constant(k - 1));
+            auto bias = builder.binary("lshr", sign, constant(bits - k));
+            auto biased = builder.binary("add", dividend, bias);
+            if(remainder)
+            {
+                auto multiple = builder.binary("and", biased, constant((long long)(0ULL - ad)));
+                result = builder.binary("sub", dividend, multiple);
+                return true;
+            }
+            quotient = builder.binary("ashr", biased, constant(k));
+            result = divisor < 0 ? builder.binary("sub", constant(0), quotient) : quotient;
+            return true;
+        }
+
+        // the high half of the product in twice the bits, the dividend added or
+        // taken off when the multiplier had to wrap to the other sign
+        auto wide = bits == 32 ? "i64" : "i128";
+        auto product = builder.binary("mul", builder.cast("sext", dividend, wide),
+                                      IRValue{wide, std::to_string(multiplier)});
+        if((divisor > 0 && multiplier < 0) || (divisor < 0 && multiplier > 0))
+        {
+            auto high = builder.cast("trunc", builder.binary("ashr", product, IRValue{wide, std::to_string(bits)}),
+                                     dividend.type);
+            quotient = builder.binary(divisor > 0 ? "add" : "sub", high, dividend);
+            if(shift > 0)
+            {
+                quotient = builder.binary("ashr", quotient, constant(shift));
+            }
+        }
+        else
+        {
+            quotient = builder.cast("trunc",
+                                    builder.binary("ashr", product, IRValue{wide, std::to_string(bits + shift)}),
+                                    dividend.type);
+        }
+        // one more for a negative quotient, it rounded toward minus infinity
+        quotient = builder.binary("add", quotient, builder.binary("lshr", quotient, constant(bits - 1)));
+        result = remainder ? builder.binary("sub", dividend, builder.binary("mul", quotient, constant(divisor)))
+                           : quotient;
+        return true;
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef DIVIDE_H_
+#define DIVIDE_H_
+
+#include <string>
+#include "ir.h"
+
+namespace ycc
+{
+    /*
+     * Division and remainder of an int or a long by a constant without
+     * sdiv and srem, which take tens of cycles. A power of two is a shift,
+     * with the divisor less one added to a negative dividend first so the
+     * quotient rounds toward zero as in java; any other divisor is a
+     * multiply by its magic number, keeping the high half, and a shift
+     * (Hacker's Delight, chapter 10). The remainder is the dividend less
+     * the quotient times the divisor. A divisor of -1 is a negation, so
+     * the smallest value divided by it wraps as in java instead of
+     * trapping. A divisor of 0 is left to sdiv and srem.
+     */
+
+    // false if divisor is 0, 1, -1 or a power of two, which need no magic number
+    bool divisionMagic(long long divisor, int bits, long long &multiplier, int &shift);
+
+    // false if the division is left as it is: not i32 or i64, or divisor 0
+    bool divideByConstant(IRBuilder &builder, bool remainder, const IRValue &dividend,
+                          long long divisor, IRValue &result);
+}
+
+#endif
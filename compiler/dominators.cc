@@ -0,0 +1,183 @@
+#include <algorithm>
+#include "dominators.h"
+
+namespace ycc
+{
+    DominatorTree::DominatorTree(const IRFunction &function)
+    {
+        auto count = function.blocks.size();
+        for(size_t b = 0; b < count; b++)
+        {
+            index_[function.blocks[b].label] = b;
+        }
+        preds_.assign(count, std::vector<size_t>());
+        succs_.assign(count, std::vector<size_t>());
+        for(size_t b = 0; b < count; b++)
+        {
+            for(auto &label : function.blocks[b].successors())
+            {
+                auto next = index_[label];
+                succs_[b].push_back(next);
+                preds_[next].push_back(b);
+            }
+        }
+
+        // postorder without recursion: a block is done after all its successors
+        std::vector<bool> visited(count, false);
+        std::vector<std::pair<size_t, size_t>> stack;
+        if(count)
+        {
+            stack.push_back(std::make_pair(0, 0));
+            visited[0] = true;
+        }
+        while(!stack.empty())
+        {
+            auto &top = stack.back();
+            if(top.second < succs_[top.first].size())
+            {
+                auto next = succs_[top.first][top.second++];
+                if(!visited[next])
+                {
+                    visited[next] = true;
+                    stack.push_back(std::make_pair(next, 0));
+                }
+                continue;
+            }
+            order_.push_back(top.first);
+            stack.pop_back();
+        }
+        std::reverse(order_.begin(), order_.end());
+        number_.assign(count, count);
+        for(size_t i = 0; i < order_.size(); i++)
+        {
+            number_[order_[i]] = i;
+        }
+
+        idom_.assign(count, -1);
+        if(!count)
+        {
+            return ;
+        }
+        idom_[0] = 0;
+        auto intersect = [&](size_t a, size_t b)
+        {
+            while(a != b)
+            {
+                while(number_[a] > number_[b])
+                {
+                    a = idom_[a];
+                }
+                while(number_[b] > number_[a])
+                {
+                    b = idom_[b];
+                }
+            }
+            return a;
+        };
+        bool changed = true;
+        while(changed)
+        {
+            changed = false;
+            for(size_t i = 1; i < order_.size(); i++)
+            {
+                auto b = order_[i];
+                long dom = -1;
+                for(auto pred : preds_[b])
+                {
+                    if(idom_[pred] < 0)
+                    {
+                        continue;
+                    }
+                    dom = dom < 0 ? pred : intersect(pred, dom);
+                }
+                if(dom != idom_[b])
+                {
+                    idom_[b] = dom;
+                    changed = true;
+                }
+            }
+        }
+        idom_[0] = -1;
+
+        children_.assign(count, std::vector<size_t>());
+        for(auto b : order_)
+        {
+            if(idom_[b] >= 0)
+            {
+                children_[idom_[b]].push_back(b);
+            }
+        }
+    }
+
+    size_t DominatorTree::block(const std::string &label) const
+    {
+        return index_.find(label)->second;
+    }
+
+    bool DominatorTree::reached(size_t block) const
+    {
+        return number_[block] < order_.size();
+    }
+
+    bool DominatorTree::dominates(size_t a, size_t b) const
+    {
+        if(!reached(a) || !reached(b))
+        {
+            return false;
+        }
+        long at = b;
+        while(at >= 0 && (size_t)at != a)
+        {
+            at = idom_[at];
+        }
+        return at >= 0;
+    }
+
+    std::vector<NaturalLoop> DominatorTree::loops() const
+    {
+        std::vector<NaturalLoop> loops;
+        for(auto header : order_)
+        {
+            std::vector<size_t> work;
+            for(auto pred : preds_[header])
+            {
+                if(dominates(header, pred))
+                {
+                    work.push_back(pred);
+                }
+            }
+            if(work.empty())
+            {
+                continue;
+            }
+            NaturalLoop loop{header, std::vector<bool>(number_.size(), false), std::vector<size_t>()};
+            loop.body[header] = true;
+            while(!work.empty())
+            {
+                auto b = work.back();
+                work.pop_back();
+                if(loop.body[b])
+                {
+                    continue;
+                }
+                loop.body[b] = true;
+                for(auto pred : preds_[b])
+                {
+                    if(reached(pred) && !loop.body[pred])
+                    {
+                        work.push_back(pred);
+                    }
+                }
+            }
+            for(auto b : order_)
+            {
+                if(loop.body[b])
+                {
+                    loop.blocks.push_back(b);
+                }
+            }
+            loops.push_back(std::move(loop));
+        }
+        return loops;
+    }
+}
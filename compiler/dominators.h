@@ -0,0 +1,79 @@
+#ifndef DOMINATORS_H_
+#define DOMINATORS_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "ir.h"
+
+namespace ycc
+{
+    /*
+     * A loop found from its back edges: the header and every block that
+     * reaches one of them without passing the header.
+     */
+    struct NaturalLoop
+    {
+        size_t                  header;
+        std::vector<bool>       body;       // by block
+        std::vector<size_t>     blocks;     // reverse postorder
+    };
+
+    /*
+     * Dominator tree of the blocks of a function, by the iterative
+     * algorithm of Cooper, Harvey and Kennedy. Blocks are numbered by
+     * their place in function.blocks; blocks the entry does not reach
+     * have no dominator and are not in the tree.
+     */
+    class DominatorTree
+    {
+      public:
+        explicit DominatorTree(const IRFunction &function);
+
+        size_t                                  block(const std::string &label) const;
+        const std::vector<size_t> &             order() const;      // reverse postorder
+        const std::vector<size_t> &             preds(size_t block) const;
+        const std::vector<size_t> &             succs(size_t block) const;
+        const std::vector<size_t> &             children(size_t block) const;
+        long                                    idom(size_t block) const;   // -1 for the entry
+        bool                                    reached(size_t block) const;
+        bool                                    dominates(size_t a, size_t b) const;
+        std::vector<NaturalLoop>                loops() const;      // by header, outer first
+
+      private:
+        std::map<std::string, size_t>           index_;
+        std::vector<size_t>                     order_;
+        std::vector<size_t>                     number_;    // place in order_
+        std::vector<std::vector<size_t>>        preds_;
+        std::vector<std::vector<size_t>>        succs_;
+        std::vector<std::vector<size_t>>        children_;
+        std::vector<long>                       idom_;
+    };
+
+    inline const std::vector<size_t> & DominatorTree::order() const
+    {
+        return order_;
+    }
+
+    inline const std::vector<size_t> & DominatorTree::preds(size_t block) const
+    {
+        return preds_[block];
+    }
+
+    inline const std::vector<size_t> & DominatorTree::succs(size_t block) const
+    {
+        return succs_[block];
+    }
+
+    inline const std::vector<size_t> & DominatorTree::children(size_t block) const
+    {
+        return children_[block];
+    }
+
+    inline long DominatorTree::idom(size_t block) const
+    {
+        return idom_[block];
+    }
+}
+
+#endif
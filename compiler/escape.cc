@@ -0,0 +1,284 @@
+#include "escape.h"
+
+namespace ycc
+{
+    EscapeAnalysis::EscapeAnalysis()
+        : allocations_(0),onStack_(0)
+    {
+    }
+
+    void EscapeAnalysis::run(std::vector<IRFunction> &functions)
+    {
+        for(auto &function : functions)
+        {
+            analyze(function);
+        }
+    }
+
+    const std::string & EscapeAnalysis::find(const std::string &name)
+    {
+        auto iter = parent_.find(name);
+        if(iter == parent_.end())
+        {
+            iter = parent_.insert(std::make_pair(name, name)).first;
+        }
+        if(iter->second != name)
+        {
+            iter->second = find(iter->second);
+        }
+        return iter->second;
+    }
+
+    void EscapeAnalysis::unite(const std::string &a, const std::string &b)
+    {
+        auto rootA = find(a);
+        auto rootB = find(b);
+        if(rootA != rootB)
+        {
+            parent_[rootA] = rootB;
+        }
+    }
+
+    void EscapeAnalysis::escape(const IRValue &value)
+    {
+        if(!value.isConstant())
+        {
+            escaped_.insert(value.name);
+        }
+    }
+
+    void EscapeAnalysis::analyze(IRFunction &function)
+    {
+        parent_.clear();
+        slots_.clear();
+        escaped_.clear();
+        if(function.blocks.empty())
+        {
+            return ;
+        }
+
+        // stack slots whose address is only loaded from and stored to
+        for(auto &inst : function.blocks[0].insts)
+        {
+            if(inst.op == IROp::ALLOCA)
+            {
+                slots_.insert(inst.result);
+            }
+        }
+        for(auto &block : function.blocks)
+        {
+            for(auto &inst : block.insts)
+            {
+                for(size_t i = 0; i < inst.operands.size(); i++)
+                {
+                    bool address = (inst.op == IROp::LOAD && i == 0) || (inst.op == IROp::STORE && i == 1);
+                    if(!address)
+                    {
+                        slots_.erase(inst.operands[i].name);
+                    }
+                }
+            }
+        }
+
+        // values that may hold the same object
+        for(auto &block : function.blocks)
+        {
+            for(auto &inst : block.insts)
+            {
+                auto &ops = inst.operands;
+                switch(inst.op)
+                {
+                case IROp::LOAD:
+                    if(slots_.count(ops[0].name))
+                    {
+                        unite(inst.result, ops[0].name);
+                    }
+                    break;
+                case IROp::STORE:
+                    if(!ops[0].isConstant() && slots_.count(ops[1].name))
+                    {
+                        unite(ops[0].name, ops[1].name);
+                    }
+                    else
+                    {
+                        escape(ops[0]);
+                    }
+                    break;
+                case IROp::CAST:
+                    if(inst.opcode == "bitcast" && !ops[0].isConstant())
+                    {
+                        unite(inst.result, ops[0].name);
+                    }
+                    else
+                    {
+                        escape(ops[0]);
+                    }
+                    break;
+                case IROp::GEP:
+                    if(!ops[0].isConstant())
+                    {
+                        unite(inst.result, ops[0].name);
+                    }
+                    break;
+                case IROp::PHI:
+                    for(size_t i = 0; i < ops.size(); i += 2)
+                    {
+                        if(!ops[i].isConstant())
+                        {
+                            unite(inst.result, ops[i].name);
+                        }
+                    }
+                    break;
+                case IROp::SELECT:
+                    for(size_t i = 1; i < ops.size(); i++)
+                    {
+                        if(!ops[i].isConstant())
+                        {
+                            unite(inst.result, ops[i].name);
+                        }
+                    }
+                    break;
+                case IROp::CALL:
+                case IROp::RET:
+                    for(auto &operand : ops)
+                    {
+                        escape(operand);
+                    }
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+        std::set<std::string> escaped;
+        for(auto &name : escaped_)
+        {
+            escaped.insert(find(name));
+        }
+
+        // new Class() is a call of @ycc.alloc and the cast of the memory
+        std::vector<std::pair<size_t, size_t>> sites;
+        for(size_t b = 0; b < function.blocks.size(); b++)
+        {
+            auto &insts = function.blocks[b].insts;
+            for(size_t i = 0; i + 1 < insts.size(); i++)
+            {
+                auto &call = insts[i];
+                auto &cast = insts[i + 1];
+                if(call.op != IROp::CALL || call.opcode != "@ycc.alloc" || cast.op != IROp::CAST
+                    || cast.opcode != "bitcast" || cast.operands[0].name != call.result)
+                {
+                    continue;
+                }
+                allocations_++;
+                if(!escaped.count(find(cast.result)) && !live(function, b, i + 1, cast.result))
+                {
+                    sites.push_back(std::make_pair(b, i));
+                }
+            }
+        }
+
+        // from the back, so the places of the sites before stay where they are
+        std::vector<IRInst> allocas;
+        for(auto site = sites.rbegin(); site != sites.rend(); ++site)
+        {
+            auto &insts = function.blocks[site->first].insts;
+            auto cast = insts[site->second + 1];
+            auto structType = cast.type.substr(0, cast.type.size() - 1);
+            allocas.insert(allocas.begin(), IRInst{IROp::ALLOCA, cast.result, structType, "", {}});
+            // the fields of every new object start zeroed
+            insts[site->second] = IRInst{IROp::STORE, "", "void", "",
+                                         {IRValue{structType, "zeroinitializer"}, IRValue{cast.type, cast.result}}};
+            insts.erase(insts.begin() + site->second + 1);
+            onStack_++;
+        }
+        auto &entry = function.blocks[0].insts;
+        size_t at = 0;
+        while(at < entry.size() && entry[at].op == IROp::ALLOCA)
+        {
+            at++;
+        }
+        entry.insert(entry.begin() + at, allocas.begin(), allocas.end());
+    }
+
+    /*
+     * Is a value of the group of object live right after instruction index
+     * of block, besides object itself, so that it may hold an older object
+     * of the same new. Slots of the group count as variables: a store
+     * defines one, a load uses it. Phis use their values at their block.
+     */
+    bool EscapeAnalysis::live(const IRFunction &function, size_t block, size_t index,
+                              const std::string &object)
+    {
+        auto root = find(object);
+        auto member = [&](const IRValue &value)
+        {
+            return !value.isConstant() && value.name != object && parent_.count(value.name)
+                && find(value.name) == root;
+        };
+        // backwards through one instruction
+        auto step = [&](const IRInst &inst, std::set<std::string> &names)
+        {
+            bool slotStore = inst.op == IROp::STORE && slots_.count(inst.operands[1].name);
+            if(!inst.result.empty())
+            {
+                names.erase(inst.result);
+            }
+            if(slotStore)
+            {
+                names.erase(inst.operands[1].name);
+            }
+            for(size_t i = 0; i < inst.operands.size(); i++)
+            {
+                if(!(slotStore && i == 1) && inst.operands[i].type != "label" && member(inst.operands[i]))
+                {
+                    names.insert(inst.operands[i].name);
+                }
+            }
+        };
+
+        std::map<std::string, size_t> labels;
+        for(size_t b = 0; b < function.blocks.size(); b++)
+        {
+            labels[function.blocks[b].label] = b;
+        }
+        std::vector<std::set<std::string>> liveIn(function.blocks.size());
+        bool changed = true;
+        while(changed)
+        {
+            changed = false;
+            for(size_t b = function.blocks.size(); b > 0; b--)
+            {
+                auto &current = function.blocks[b - 1];
+                std::set<std::string> names;
+                for(auto &label : current.successors())
+                {
+                    auto &in = liveIn[labels[label]];
+                    names.insert(in.begin(), in.end());
+                }
+                for(size_t i = current.insts.size(); i > 0; i--)
+                {
+                    step(current.insts[i - 1], names);
+                }
+                if(names != liveIn[b - 1])
+                {
+                    liveIn[b - 1] = names;
+                    changed = true;
+                }
+            }
+        }
+
+        auto &current = function.blocks[block];
+        std::set<std::string> names;
+        for(auto &label : current.successors())
+        {
+            auto &in = liveIn[labels[label]];
+            names.insert(in.begin(), in.end());
+        }
+        for(size_t i = current.insts.size(); i > index + 1; i--)
+        {
+            step(current.insts[i - 1], names);
+        }
+        return !names.empty();
+    }
+}
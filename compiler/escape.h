@@ -0,0 +1,58 @@
+#ifndef ESCAPE_H_
+#define ESCAPE_H_
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "ir.h"
+
+namespace ycc
+{
+    /*
+     * Escape analysis of the objects of new, method by method, after the
+     * inliner. Values that may hold the same object are put together: the
+     * object, its casts and field addresses, phis and selects of them and
+     * the stack slots of locals with the values loaded from them. A group
+     * escapes if one of its values is stored anywhere but in such a slot,
+     * passed to a call or returned. An object of a group that does not
+     * escape lives in a stack slot of its own; a new in a loop reuses the
+     * slot, so the older object must be dead when the next one is made.
+     */
+    class EscapeAnalysis
+    {
+      public:
+        EscapeAnalysis();
+
+        void                run(std::vector<IRFunction> &functions);
+        long                allocations() const;
+        long                onStack() const;
+
+      private:
+        void                analyze(IRFunction &function);
+        const std::string & find(const std::string &name);
+        void                unite(const std::string &a, const std::string &b);
+        void                escape(const IRValue &value);
+        bool                live(const IRFunction &function, size_t block, size_t index,
+                                 const std::string &object);
+
+      private:
+        long                                    allocations_;
+        long                                    onStack_;
+        std::map<std::string, std::string>      parent_;    // groups of values, by name
+        std::set<std::string>                   slots_;     // allocas only loaded and stored
+        std::set<std::string>                   escaped_;   // values that escape
+    };
+
+    inline long EscapeAnalysis::allocations() const
+    {
+        return allocations_;
+    }
+
+    inline long EscapeAnalysis::onStack() const
+    {
+        return onStack_;
+    }
+}
+
+#endif
@@ -0,0 +1,257 @@
+#include <algorithm>
+#include "gvn.h"
+
+namespace ycc
+{
+    ValueNumbering::ValueNumbering()
+        : redundantValues_(0),redundantLoads_(0)
+    {
+    }
+
+    void ValueNumbering::run(std::vector<IRFunction> &functions)
+    {
+        for(auto &function : functions)
+        {
+            number(function);
+        }
+    }
+
+    const std::string & ValueNumbering::resolve(const std::string &name)
+    {
+        if(replaced_.empty())
+        {
+            return name;
+        }
+        auto iter = replaced_.find(name);
+        return iter == replaced_.end() ? name : iter->second;
+    }
+
+    static bool commutative(const std::string &opcode)
+    {
+        return opcode == "add" || opcode == "mul" || opcode == "and" || opcode == "or" || opcode == "xor"
+            || opcode == "fadd" || opcode == "fmul" || opcode == "icmp eq" || opcode == "icmp ne"
+            || opcode == "fcmp oeq" || opcode == "fcmp une";
+    }
+
+    // i32, double, i8*: what one store writes and one load reads
+    static bool scalar(const std::string &type)
+    {
+        return !type.empty() && (type.back() == '*' || type[0] == 'i' || type == "double" || type == "float");
+    }
+
+    std::string ValueNumbering::key(const IRInst &inst) const
+    {
+        auto &ops = inst.operands;
+        std::string key;
+        key.reserve(64);
+        key += std::to_string((int)inst.op);
+        key += " ";
+        key += inst.opcode;
+        key += " ";
+        key += inst.type;
+        // the operands of a commutative opcode in the order of their names
+        bool swap = ops.size() == 2 && commutative(inst.opcode) && ops[1].name < ops[0].name;
+        for(size_t i = 0; i < ops.size(); i++)
+        {
+            auto &operand = ops[swap ? ops.size() - 1 - i : i];
+            key += ", ";
+            key += operand.type;
+            key += " ";
+            key += operand.name;
+        }
+        return key;
+    }
+
+    // a store of type to memory that is not a slot; an empty type is a call
+    void ValueNumbering::forget(Loads &loads, const std::string &type)
+    {
+        for(auto iter = loads.begin(); iter != loads.end(); )
+        {
+            if(!slots_.count(iter->first) && (type.empty() || !scalar(type) || iter->second.type == type))
+            {
+                iter = loads.erase(iter);
+            }
+            else
+            {
+                ++iter;
+            }
+        }
+    }
+
+    void ValueNumbering::number(IRFunction &function)
+    {
+        if(function.blocks.empty())
+        {
+            return ;
+        }
+        slots_.clear();
+        replaced_.clear();
+        values_.clear();
+        undo_.clear();
+        dead_.assign(function.blocks.size(), std::vector<bool>());
+        for(size_t b = 0; b < function.blocks.size(); b++)
+        {
+            dead_[b].assign(function.blocks[b].insts.size(), false);
+        }
+
+        // stack slots whose address is only loaded from and stored to
+        for(auto &inst : function.blocks[0].insts)
+        {
+            if(inst.op == IROp::ALLOCA)
+            {
+                slots_.insert(inst.result);
+            }
+        }
+        for(auto &block : function.blocks)
+        {
+            for(auto &inst : block.insts)
+            {
+                for(size_t i = 0; i < inst.operands.size(); i++)
+                {
+                    bool address = (inst.op == IROp::LOAD && i == 0) || (inst.op == IROp::STORE && i == 1);
+                    if(!address)
+                    {
+                        slots_.erase(inst.operands[i].name);
+                    }
+                }
+            }
+        }
+
+        // down the dominator tree; the values a block numbered are dropped when it is left
+        struct Frame
+        {
+            size_t          block;
+            size_t          undo;
+            size_t          child;
+            Loads           loads;
+        };
+        DominatorTree tree(function);
+        std::vector<Frame> stack;
+        stack.push_back(Frame{0, 0, 0, Loads()});
+        visit(function, 0, stack.back().loads);
+        while(!stack.empty())
+        {
+            auto &top = stack.back();
+            auto &children = tree.children(top.block);
+            if(top.child == children.size())
+            {
+                for(auto i = undo_.size(); i > top.undo; i--)
+                {
+                    values_.erase(undo_[i - 1]);
+                }
+                undo_.resize(top.undo);
+                stack.pop_back();
+                continue;
+            }
+            auto child = children[top.child++];
+            auto &preds = tree.preds(child);
+            Loads loads;
+            if(preds.size() == 1 && preds[0] == top.block)
+            {
+                loads = top.loads;
+            }
+            stack.push_back(Frame{child, undo_.size(), 0, Loads()});
+            stack.back().loads.swap(loads);
+            visit(function, child, stack.back().loads);
+        }
+
+        // uses the walk has not seen yet, phis on back edges mostly
+        for(size_t b = 0; b < function.blocks.size(); b++)
+        {
+            auto &insts = function.blocks[b].insts;
+            for(auto &inst : insts)
+            {
+                for(auto &operand : inst.operands)
+                {
+                    if(operand.type != "label")
+                    {
+                        operand.name = resolve(operand.name);
+                    }
+                }
+            }
+            size_t kept = 0;
+            for(size_t i = 0; i < insts.size(); i++)
+            {
+                if(!dead_[b][i])
+                {
+                    if(kept != i)
+                    {
+                        insts[kept] = std::move(insts[i]);
+                    }
+                    kept++;
+                }
+            }
+            insts.erase(insts.begin() + kept, insts.end());
+        }
+    }
+
+    void ValueNumbering::visit(IRFunction &function, size_t block, Loads &loads)
+    {
+        auto &insts = function.blocks[block].insts;
+        for(size_t i = 0; i < insts.size(); i++)
+        {
+            auto &inst = insts[i];
+            for(auto &operand : inst.operands)
+            {
+                if(!operand.isConstant() && operand.type != "label")
+                {
+                    operand.name = resolve(operand.name);
+                }
+            }
+            auto &ops = inst.operands;
+            switch(inst.op)
+            {
+            case IROp::LOAD:
+            {
+                auto known = loads.find(ops[0].name);
+                if(known != loads.end() && known->second.type == inst.type)
+                {
+                    replaced_[inst.result] = known->second.value;
+                    dead_[block][i] = true;
+                    redundantLoads_++;
+                }
+                else
+                {
+                    loads[ops[0].name] = Load{inst.type, inst.result};
+                }
+                break;
+            }
+            case IROp::STORE:
+                if(slots_.count(ops[1].name))
+                {
+                    loads.erase(ops[1].name);
+                }
+                else
+                {
+                    forget(loads, ops[0].type);
+                }
+                loads[ops[1].name] = Load{ops[0].type, ops[0].name};
+                break;
+            case IROp::CALL:
+                forget(loads, "");
+                break;
+            case IROp::BINARY:
+            case IROp::CMP:
+            case IROp::CAST:
+            case IROp::GEP:
+            case IROp::SELECT:
+            {
+                auto entry = values_.insert(std::make_pair(key(inst), inst.result));
+                if(!entry.second)
+                {
+                    replaced_[inst.result] = entry.first->second;
+                    dead_[block][i] = true;
+                    redundantValues_++;
+                }
+                else
+                {
+                    undo_.push_back(entry.first);
+                }
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    }
+}
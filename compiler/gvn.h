@@ -0,0 +1,68 @@
+#ifndef GVN_H_
+#define GVN_H_
+
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ir.h"
+#include "dominators.h"
+
+namespace ycc
+{
+    /*
+     * Global value numbering of every method over its dominator tree. An
+     * arithmetic, compare, cast, gep or select whose opcode and operands
+     * match one in a dominating block is replaced by it. Loads are kept
+     * per pointer, with the value stored there last, and go down the tree
+     * only into blocks whose single predecessor is their parent. A store
+     * to a stack slot only touches that slot; any other store forgets the
+     * loads of its type from memory that is not a slot, a call forgets all
+     * of them.
+     */
+    class ValueNumbering
+    {
+      public:
+        ValueNumbering();
+
+        void                run(std::vector<IRFunction> &functions);
+        long                redundantValues() const;
+        long                redundantLoads() const;
+
+      private:
+        struct Load
+        {
+            std::string     type;
+            std::string     value;
+        };
+        typedef std::map<std::string, Load> Loads;     // by pointer
+
+        void                number(IRFunction &function);
+        void                visit(IRFunction &function, size_t block, Loads &loads);
+        const std::string & resolve(const std::string &name);
+        std::string         key(const IRInst &inst) const;
+        void                forget(Loads &loads, const std::string &type);
+
+      private:
+        long                                                redundantValues_;
+        long                                                redundantLoads_;
+        std::set<std::string>                               slots_;
+        std::unordered_map<std::string, std::string>        replaced_;  // redundant value to its number
+        std::map<std::string, std::string>                  values_;    // key to value, in scope
+        std::vector<std::map<std::string, std::string>::iterator>   undo_;     // values entered, innermost last
+        std::vector<std::vector<bool>>                      dead_;
+    };
+
+    inline long ValueNumbering::redundantValues() const
+    {
+        return redundantValues_;
+    }
+
+    inline long ValueNumbering::redundantLoads() const
+    {
+        return redundantLoads_;
+    }
+}
+
+#endif
@@ -0,0 +1,271 @@
+#include "inliner.h"
+
+namespace ycc
+{
+    Inliner::Inliner(int threshold)
+        : threshold_(threshold),inlined_(0),calls_(0),coldCalls_(0),profile_(nullptr),serial_(0),functions_(nullptr)
+    {
+    }
+
+    void Inliner::setProfile(Profile *profile)
+    {
+        profile_ = profile;
+    }
+
+    long Inliner::cost(const IRFunction &function)
+    {
+        long count = 0;
+        for(auto &block : function.blocks)
+        {
+            for(auto &inst : block.insts)
+            {
+                count += inst.op != IROp::ALLOCA;
+            }
+        }
+        return count;
+    }
+
+    void Inliner::run(std::vector<IRFunction> &functions)
+    {
+        functions_ = &functions;
+        index_.clear();
+        for(size_t i = 0; i < functions.size(); i++)
+        {
+            index_[functions[i].name] = i;
+        }
+
+        // call graph
+        callees_.assign(functions.size(), std::vector<size_t>());
+        for(size_t i = 0; i < functions.size(); i++)
+        {
+            for(auto &block : functions[i].blocks)
+            {
+                for(auto &inst : block.insts)
+                {
+                    auto iter = inst.op == IROp::CALL ? index_.find(inst.opcode) : index_.end();
+                    if(iter != index_.end())
+                    {
+                        callees_[i].push_back(iter->second);
+                    }
+                }
+            }
+        }
+        recursive_.assign(functions.size(), false);
+        for(size_t i = 0; i < functions.size(); i++)
+        {
+            std::vector<bool> visited(functions.size(), false);
+            recursive_[i] = reaches(i, i, visited);
+        }
+
+        // callees before callers
+        std::vector<bool> visited(functions.size(), false);
+        std::vector<size_t> postorder;
+        for(size_t i = 0; i < functions.size(); i++)
+        {
+            order(i, visited, postorder);
+        }
+
+        costs_.assign(functions.size(), 0);
+        for(auto f : postorder)
+        {
+            auto &caller = functions[f];
+            for(size_t b = 0; b < caller.blocks.size(); b++)
+            {
+                for(size_t i = 0; i < caller.blocks[b].insts.size(); i++)
+                {
+                    size_t callee;
+                    if(!candidate(f, caller.blocks[b].label, caller.blocks[b].insts[i], callee))
+                    {
+                        continue;
+                    }
+                    expand(caller, b, i, functions[callee]);
+                    inlined_++;
+                    // go on with the rest of the block, after the callee
+                    b += functions[callee].blocks.size() + 1;
+                    i = -1;
+                }
+            }
+            costs_[f] = cost(caller);
+        }
+    }
+
+    // is there a path of calls from a callee of `from` to `to`
+    bool Inliner::reaches(size_t from, size_t to, std::vector<bool> &visited) const
+    {
+        for(auto callee : callees_[from])
+        {
+            if(callee == to)
+            {
+                return true;
+            }
+            if(!visited[callee])
+            {
+                visited[callee] = true;
+                if(reaches(callee, to, visited))
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void Inliner::order(size_t function, std::vector<bool> &visited, std::vector<size_t> &postorder)
+    {
+        if(visited[function])
+        {
+            return ;
+        }
+        visited[function] = true;
+        for(auto callee : callees_[function])
+        {
+            order(callee, visited, postorder);
+        }
+        postorder.push_back(function);
+    }
+
+    bool Inliner::candidate(size_t caller, const std::string &block, const IRInst &inst, size_t &callee)
+    {
+        if(inst.op != IROp::CALL)
+        {
+            return false;
+        }
+        auto iter = index_.find(inst.opcode);
+        if(iter == index_.end())
+        {
+            return false;       // the io runtime
+        }
+        calls_++;
+        callee = iter->second;
+        long count = profile_ ? profile_->count((*functions_)[caller].name, block) : -1;
+        long threshold = profile_ && profile_->hot(count) ? threshold_ * 4 : threshold_;
+        if(callee == caller || recursive_[callee] || costs_[callee] > threshold)
+        {
+            return false;
+        }
+        // a method that never returns keeps its call
+        for(auto &b : (*functions_)[callee].blocks)
+        {
+            if(b.terminated() && b.insts.back().op == IROp::RET)
+            {
+                coldCalls_ += count == 0;
+                return count != 0;
+            }
+        }
+        return false;
+    }
+
+    // names of the callee get the suffix of the expansion, parameters are the arguments
+    IRValue Inliner::rename(const IRValue &value, const std::string &suffix,
+                            const std::map<std::string, IRValue> &args) const
+    {
+        if(value.type == "label")
+        {
+            return IRValue{value.type, value.name + suffix};
+        }
+        if(value.name.empty() || value.name[0] != '%')
+        {
+            return value;
+        }
+        auto iter = args.find(value.name);
+        if(iter != args.end())
+        {
+            return iter->second;
+        }
+        return IRValue{value.type, value.name + suffix};
+    }
+
+    /*
+     * The block of the call is split after the call: its head jumps to the
+     * copy of the callee, every return of the copy jumps to the rest, which
+     * starts with a phi of the returned values in place of the call.
+     */
+    void Inliner::expand(IRFunction &caller, size_t block, size_t index, const IRFunction &callee)
+    {
+        auto suffix = ".i" + std::to_string(serial_++);
+        auto call = caller.blocks[block].insts[index];
+        std::map<std::string, IRValue> args;
+        for(size_t i = 0; i < callee.params.size() && i < call.operands.size(); i++)
+        {
+            args[callee.params[i].name] = call.operands[i];
+        }
+
+        IRBlock rest{"ret" + suffix, {}};
+        auto &head = caller.blocks[block];
+        rest.insts.assign(head.insts.begin() + index + 1, head.insts.end());
+        head.insts.resize(index);
+        head.insts.push_back(IRInst{IROp::BR, "", "void", "", {IRValue{"label", callee.blocks[0].label + suffix}}});
+
+        // the successors of the call's block now come from the rest
+        for(auto &b : caller.blocks)
+        {
+            for(auto &inst : b.insts)
+            {
+                if(inst.op != IROp::PHI)
+                {
+                    continue;
+                }
+                for(size_t i = 1; i < inst.operands.size(); i += 2)
+                {
+                    if(inst.operands[i].name == head.label)
+                    {
+                        inst.operands[i].name = rest.label;
+                    }
+                }
+            }
+        }
+
+        std::vector<IRInst> allocas;
+        std::vector<IRBlock> copy;
+        IRInst result{IROp::PHI, call.result, call.type, "", {}};
+        for(auto &b : callee.blocks)
+        {
+            copy.push_back(IRBlock{b.label + suffix, {}});
+            for(auto &inst : b.insts)
+            {
+                IRInst clone{inst.op, inst.result.empty() ? "" : inst.result + suffix, inst.type, inst.opcode, {},
+                             inst.tail, inst.weights};
+                for(auto &operand : inst.operands)
+                {
+                    clone.operands.push_back(rename(operand, suffix, args));
+                }
+                if(inst.op == IROp::ALLOCA)
+                {
+                    allocas.push_back(clone);
+                }
+                else if(inst.op == IROp::RET)
+                {
+                    if(!clone.operands.empty())
+                    {
+                        result.operands.push_back(clone.operands[0]);
+                        result.operands.push_back(IRValue{"label", copy.back().label});
+                    }
+                    copy.back().insts.push_back(IRInst{IROp::BR, "", "void", "", {IRValue{"label", rest.label}}});
+                }
+                else
+                {
+                    copy.back().insts.push_back(clone);
+                }
+            }
+        }
+        if(!call.result.empty())
+        {
+            rest.insts.insert(rest.insts.begin(), result);
+        }
+        copy.push_back(rest);
+        if(profile_)
+        {
+            profile_->inlined(caller.name, head.label, rest.label, callee, suffix);
+        }
+        caller.blocks.insert(caller.blocks.begin() + block + 1, copy.begin(), copy.end());
+
+        // stack slots stay in the entry block, out of any loop
+        auto &entry = caller.blocks[0].insts;
+        size_t at = 0;
+        while(at < entry.size() && entry[at].op == IROp::ALLOCA)
+        {
+            at++;
+        }
+        entry.insert(entry.begin() + at, allocas.begin(), allocas.end());
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef INLINER_H_
+#define INLINER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "ir.h"
+#include "profile.h"
+
+namespace ycc
+{
+    /*
+     * Inline expansion of small methods on the IR of the whole program.
+     * Methods are expanded bottom-up, so a callee is as small as it gets
+     * before its callers look at it; methods on a call cycle are never
+     * expanded. The cost of a method is the number of its instructions
+     * without the allocas, which move to the entry block of the caller.
+     * With a profile a call that never ran is kept, a hot one expands
+     * methods up to four times the threshold.
+     */
+    class Inliner
+    {
+      public:
+        explicit Inliner(int threshold);
+
+        void                setProfile(Profile *profile);
+        void                run(std::vector<IRFunction> &functions);
+        long                inlined() const;
+        long                calls() const;      // calls of methods of the program
+        long                coldCalls() const;  // kept as the profile never saw them run
+
+        static long         cost(const IRFunction &function);
+
+      private:
+        void                order(size_t function, std::vector<bool> &visited, std::vector<size_t> &postorder);
+        bool                reaches(size_t from, size_t to, std::vector<bool> &visited) const;
+        bool                candidate(size_t caller, const std::string &block, const IRInst &inst, size_t &callee);
+        void                expand(IRFunction &caller, size_t block, size_t index, const IRFunction &callee);
+        IRValue             rename(const IRValue &value, const std::string &suffix,
+                                   const std::map<std::string, IRValue> &args) const;
+
+      private:
+        int                                     threshold_;
+        long                                    inlined_;
+        long                                    calls_;
+        long                                    coldCalls_;
+        Profile *                               profile_;       // block counts, null without a profile
+        int                                     serial_;        // suffix of the names of an expansion
+        std::vector<IRFunction> *               functions_;
+        std::map<std::string, size_t>           index_;         // @name to function
+        std::vector<std::vector<size_t>>        callees_;
+        std::vector<bool>                       recursive_;
+        std::vector<long>                       costs_;
+    };
+
+    inline long Inliner::inlined() const
+    {
+        return inlined_;
+    }
+
+    inline long Inliner::calls() const
+    {
+        return calls_;
+    }
+
+    inline long Inliner::coldCalls() const
+    {
+        return coldCalls_;
+    }
+}
+
+#endif
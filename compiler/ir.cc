@@ -0,0 +1,376 @@
+#include "ir.h"
+
+namespace ycc
+{
+    bool IRValue::isConstant() const
+    {
+        return name.empty() || (name[0] != '%' && name[0] != '@');
+    }
+
+    bool IRInst::isTerminator() const
+    {
+        switch(op)
+        {
+        case IROp::BR:
+        case IROp::CONDBR:
+        case IROp::SWITCH:
+        case IROp::RET:
+        case IROp::UNREACHABLE:
+            return true;
+        default:
+            break;
+        }
+        return false;
+    }
+
+    static void printLabel(std::ostream &out, const IRValue &label)
+    {
+        out << "label %" << label.name;
+    }
+
+    static void printTyped(std::ostream &out, const IRValue &value)
+    {
+        out << value.type << " " << value.name;
+    }
+
+    void IRInst::print(std::ostream &out) const
+    {
+        out << "  ";
+        if(!result.empty())
+        {
+            out << result << " = ";
+        }
+        switch(op)
+        {
+        case IROp::ALLOCA:
+            out << "alloca " << type;
+            break;
+        case IROp::LOAD:
+            out << "load " << type << ", ";
+            printTyped(out, operands[0]);
+            break;
+        case IROp::STORE:
+            out << "store ";
+            printTyped(out, operands[0]);
+            out << ", ";
+            printTyped(out, operands[1]);
+            break;
+        case IROp::BINARY:
+        case IROp::CMP:
+            out << opcode << " ";
+            printTyped(out, operands[0]);
+            out << ", " << operands[1].name;
+            break;
+        case IROp::CAST:
+            out << opcode << " ";
+            printTyped(out, operands[0]);
+            out << " to " << type;
+            break;
+        case IROp::CALL:
+            out << (tail == IRTail::TAIL ? "tail " : tail == IRTail::MUSTTAIL ? "musttail " : "");
+            out << "call " << type << " " << opcode << "(";
+            for(size_t i = 0; i < operands.size(); i++)
+            {
+                out << (i ? ", " : "");
+                printTyped(out, operands[i]);
+            }
+            out << ")";
+            break;
+        case IROp::GEP:
+            out << "getelementptr inbounds " << type;
+            for(auto &operand : operands)
+            {
+                out << ", ";
+                printTyped(out, operand);
+            }
+            break;
+        case IROp::PHI:
+            out << "phi " << type;
+            for(size_t i = 0; i + 1 < operands.size(); i += 2)
+            {
+                out << (i ? ", [ " : " [ ") << operands[i].name << ", %" << operands[i + 1].name << " ]";
+            }
+            break;
+        case IROp::SELECT:
+            out << "select ";
+            printTyped(out, operands[0]);
+            out << ", ";
+            printTyped(out, operands[1]);
+            out << ", ";
+            printTyped(out, operands[2]);
+            break;
+        case IROp::BR:
+            out << "br ";
+            printLabel(out, operands[0]);
+            break;
+        case IROp::CONDBR:
+            out << "br ";
+            printTyped(out, operands[0]);
+            out << ", ";
+            printLabel(out, operands[1]);
+            out << ", ";
+            printLabel(out, operands[2]);
+            break;
+        case IROp::SWITCH:
+            out << "switch ";
+            printTyped(out, operands[0]);
+            out << ", ";
+            printLabel(out, operands[1]);
+            out << " [";
+            for(size_t i = 2; i + 1 < operands.size(); i += 2)
+            {
+                out << " ";
+                printTyped(out, operands[i]);
+                out << ", ";
+                printLabel(out, operands[i + 1]);
+            }
+            out << " ]";
+            break;
+        case IROp::RET:
+            out << "ret ";
+            if(operands.empty())
+            {
+                out << "void";
+            }
+            else
+            {
+                printTyped(out, operands[0]);
+            }
+            break;
+        case IROp::UNREACHABLE:
+            out << "unreachable";
+            break;
+        }
+        // a weight per label, unless a pass changed the labels since
+        size_t labels = op == IROp::CONDBR ? 2 : op == IROp::SWITCH ? operands.size() / 2 : 0;
+        if(!weights.empty() && weights.size() == labels)
+        {
+            out << ", !prof !{!\"branch_weights\"";
+            for(auto weight : weights)
+            {
+                out << ", i32 " << weight;
+            }
+            out << "}";
+        }
+        out << "\n";
+    }
+
+    bool IRBlock::terminated() const
+    {
+        return !insts.empty() && insts.back().isTerminator();
+    }
+
+    std::vector<std::string> IRBlock::successors() const
+    {
+        std::vector<std::string> labels;
+        if(!terminated())
+        {
+            return labels;
+        }
+        for(auto &operand : insts.back().operands)
+        {
+            if(operand.type == "label")
+            {
+                labels.push_back(operand.name);
+            }
+        }
+        return labels;
+    }
+
+    long IRFunction::size() const
+    {
+        long count = 0;
+        for(auto &block : blocks)
+        {
+            count += block.insts.size();
+        }
+        return count;
+    }
+
+    void IRFunction::print(std::ostream &out) const
+    {
+        out << "\ndefine " << returnType << " " << name << "(";
+        for(size_t i = 0; i < params.size(); i++)
+        {
+            out << (i ? ", " : "");
+            printTyped(out, params[i]);
+        }
+        out << ") {\n";
+        for(size_t i = 0; i < blocks.size(); i++)
+        {
+            out << (i ? "\n" : "") << blocks[i].label << ":\n";
+            for(auto &inst : blocks[i].insts)
+            {
+                inst.print(out);
+            }
+        }
+        out << "}\n";
+    }
+
+
+
+    IRBuilder::IRBuilder(IRFunction *function /* = nullptr */)
+    {
+        reset(function);
+    }
+
+    void IRBuilder::reset(IRFunction *function)
+    {
+        function_ = function;
+        current_ = 0;
+        allocaEnd_ = 0;
+        temps_ = 0;
+        labels_ = 0;
+        names_.clear();
+        names_.push_back(std::make_pair(std::string("entry"), 0));  // the entry block
+        if(function_ && function_->blocks.empty())
+        {
+            function_->blocks.push_back(IRBlock{"entry", {}});
+        }
+    }
+
+    std::string IRBuilder::newTemp()
+    {
+        return "%t." + std::to_string(temps_++);
+    }
+
+    std::string IRBuilder::newLabel(const std::string &kind)
+    {
+        return kind + "." + std::to_string(labels_++);
+    }
+
+    // a java name made unique in the function: x.addr, x.addr.1, ...
+    std::string IRBuilder::newName(const std::string &name)
+    {
+        for(auto &used : names_)
+        {
+            if(used.first == name)
+            {
+                return "%" + name + "." + std::to_string(++used.second);
+            }
+        }
+        names_.push_back(std::make_pair(name, 0));
+        return "%" + name;
+    }
+
+    void IRBuilder::setBlock(const std::string &label)
+    {
+        if(!terminated())
+        {
+            br(label);
+        }
+        function_->blocks.push_back(IRBlock{label, {}});
+        current_ = function_->blocks.size() - 1;
+    }
+
+    IRInst & IRBuilder::append(IRInst inst)
+    {
+        // code after a jump or a return is dead, it gets a block of its own
+        if(terminated())
+        {
+            function_->blocks.push_back(IRBlock{newLabel("dead"), {}});
+            current_ = function_->blocks.size() - 1;
+        }
+        auto &insts = function_->blocks[current_].insts;
+        insts.push_back(std::move(inst));
+        return insts.back();
+    }
+
+    IRValue IRBuilder::allocate(const std::string &type, const std::string &name)
+    {
+        IRInst inst{IROp::ALLOCA, newName(name + ".addr"), type, "", {}};
+        auto &insts = function_->blocks[0].insts;
+        insts.insert(insts.begin() + allocaEnd_++, inst);
+        return IRValue{type + "*", inst.result};
+    }
+
+    IRValue IRBuilder::load(const std::string &type, const IRValue &pointer)
+    {
+        return IRValue{type, append(IRInst{IROp::LOAD, newTemp(), type, "", {pointer}}).result};
+    }
+
+    void IRBuilder::store(const IRValue &value, const IRValue &pointer)
+    {
+        append(IRInst{IROp::STORE, "", "void", "", {value, pointer}});
+    }
+
+    IRValue IRBuilder::binary(const std::string &opcode, const IRValue &lhs, const IRValue &rhs)
+    {
+        return IRValue{lhs.type, append(IRInst{IROp::BINARY, newTemp(), lhs.type, opcode, {lhs, rhs}}).result};
+    }
+
+    IRValue IRBuilder::cmp(const std::string &opcode, const IRValue &lhs, const IRValue &rhs)
+    {
+        return IRValue{"i1", append(IRInst{IROp::CMP, newTemp(), "i1", opcode, {lhs, rhs}}).result};
+    }
+
+    IRValue IRBuilder::cast(const std::string &opcode, const IRValue &value, const std::string &type)
+    {
+        return IRValue{type, append(IRInst{IROp::CAST, newTemp(), type, opcode, {value}}).result};
+    }
+
+    IRValue IRBuilder::call(const std::string &type, const std::string &callee,
+                            const std::vector<IRValue> &args)
+    {
+        auto result = type == "void" ? "" : newTemp();
+        append(IRInst{IROp::CALL, result, type, callee, args});
+        return IRValue{type, result};
+    }
+
+    IRValue IRBuilder::phi(const std::string &type, const std::vector<IRValue> &incoming)
+    {
+        return IRValue{type, append(IRInst{IROp::PHI, newTemp(), type, "", incoming}).result};
+    }
+
+    IRValue IRBuilder::select(const IRValue &cond, const IRValue &thenValue, const IRValue &elseValue)
+    {
+        return IRValue{thenValue.type,
+                       append(IRInst{IROp::SELECT, newTemp(), thenValue.type, "", {cond, thenValue, elseValue}}).result};
+    }
+
+    IRValue IRBuilder::gep(const std::string &type, const IRValue &pointer,
+                           const std::vector<IRValue> &indices, const std::string &resultType)
+    {
+        IRInst inst{IROp::GEP, newTemp(), type, "", {pointer}};
+        inst.operands.insert(inst.operands.end(), indices.begin(), indices.end());
+        return IRValue{resultType, append(inst).result};
+    }
+
+    void IRBuilder::br(const std::string &label)
+    {
+        append(IRInst{IROp::BR, "", "void", "", {IRValue{"label", label}}});
+    }
+
+    void IRBuilder::condBr(const IRValue &cond, const std::string &thenLabel, const std::string &elseLabel)
+    {
+        append(IRInst{IROp::CONDBR, "", "void", "",
+                      {cond, IRValue{"label", thenLabel}, IRValue{"label", elseLabel}}});
+    }
+
+    void IRBuilder::switchOn(const IRValue &value, const std::string &defaultLabel,
+                             const std::vector<std::pair<std::string, std::string>> &cases)
+    {
+        IRInst inst{IROp::SWITCH, "", "void", "", {value, IRValue{"label", defaultLabel}}};
+        for(auto &c : cases)
+        {
+            inst.operands.push_back(IRValue{value.type, c.first});
+            inst.operands.push_back(IRValue{"label", c.second});
+        }
+        append(inst);
+    }
+
+    void IRBuilder::ret(const IRValue &value)
+    {
+        append(IRInst{IROp::RET, "", "void", "", {value}});
+    }
+
+    void IRBuilder::retVoid()
+    {
+        append(IRInst{IROp::RET, "", "void", "", {}});
+    }
+
+    void IRBuilder::unreachable()
+    {
+        append(IRInst{IROp::UNREACHABLE, "", "void", "", {}});
+    }
+}
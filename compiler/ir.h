@@ -0,0 +1,147 @@
+#ifndef IR_H_
+#define IR_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace ycc
+{
+    /*
+     * In-memory IR of the generated methods. IRGenerator builds it from the
+     * AST, optimization passes rewrite it and print() writes it as LLVM
+     * assembly. Values are kept in the form they are printed: %t.3, @C.n,
+     * 42, true; the names the generator makes always hold a '.', so they
+     * never clash with java identifiers.
+     */
+    struct IRValue
+    {
+        std::string             type;       // i32, double, i8*, label
+        std::string             name;
+
+        bool                    isConstant() const;
+    };
+
+    enum class IROp
+    {
+        ALLOCA,     LOAD,       STORE,      BINARY,     CMP,
+        CAST,       CALL,       GEP,        PHI,        SELECT,
+        // terminators
+        BR,         CONDBR,     SWITCH,     RET,        UNREACHABLE
+    };
+
+    // how a call may reuse the frame of its caller; musttail needs the same prototype
+    enum class IRTail
+    {
+        NONE,       TAIL,       MUSTTAIL
+    };
+
+    /*
+     * operands by opcode:
+     *   load       pointer                 store   value, pointer
+     *   binary     lhs, rhs                cmp     lhs, rhs
+     *   cast       value                   call    arguments
+     *   gep        pointer, indices        phi     value, label, ...
+     *   select     condition, then, else   br      label
+     *   condbr     condition, then, else   switch  value, default, case, label, ...
+     *   ret        [value]
+     * weights, from a profile, are those of the successors of a condbr or
+     * switch in the order of its labels; empty without one.
+     */
+    struct IRInst
+    {
+        IROp                    op;
+        std::string             result;     // empty if the instruction has no value
+        std::string             type;       // result type; allocated, loaded or indexed type
+        std::string             opcode;     // add, icmp slt, sext, callee of a call
+        std::vector<IRValue>    operands;
+        IRTail                  tail;       // of a call
+        std::vector<unsigned>   weights;    // branch weights of a condbr or switch
+
+        bool                    isTerminator() const;
+        void                    print(std::ostream &out) const;
+    };
+
+    struct IRBlock
+    {
+        std::string             label;
+        std::vector<IRInst>     insts;
+
+        bool                    terminated() const;
+        std::vector<std::string> successors() const;    // labels of the terminator
+    };
+
+    struct IRFunction
+    {
+        std::string             name;       // @C.m
+        std::string             returnType;
+        std::vector<IRValue>    params;
+        std::vector<IRBlock>    blocks;     // blocks[0] is the entry block
+
+        long                    size() const;   // instructions
+        void                    print(std::ostream &out) const;
+    };
+
+    /*
+     * Appends instructions to the current block of a function and names the
+     * temporaries and blocks. Allocas always go to the entry block.
+     */
+    class IRBuilder
+    {
+      public:
+        explicit IRBuilder(IRFunction *function = nullptr);
+
+        void                    reset(IRFunction *function);
+        std::string             newTemp();
+        std::string             newLabel(const std::string &kind);
+        std::string             newName(const std::string &name);
+
+        // start a block, falling through from the current one
+        void                    setBlock(const std::string &label);
+        const std::string &     currentLabel() const;
+        bool                    terminated() const;
+
+        IRValue                 allocate(const std::string &type, const std::string &name);
+        IRValue                 load(const std::string &type, const IRValue &pointer);
+        void                    store(const IRValue &value, const IRValue &pointer);
+        IRValue                 binary(const std::string &opcode, const IRValue &lhs, const IRValue &rhs);
+        IRValue                 cmp(const std::string &opcode, const IRValue &lhs, const IRValue &rhs);
+        IRValue                 cast(const std::string &opcode, const IRValue &value, const std::string &type);
+        IRValue                 call(const std::string &type, const std::string &callee,
+                                     const std::vector<IRValue> &args);
+        IRValue                 phi(const std::string &type, const std::vector<IRValue> &incoming);
+        IRValue                 select(const IRValue &cond, const IRValue &thenValue, const IRValue &elseValue);
+        IRValue                 gep(const std::string &type, const IRValue &pointer,
+                                    const std::vector<IRValue> &indices, const std::string &resultType);
+        void                    br(const std::string &label);
+        void                    condBr(const IRValue &cond, const std::string &thenLabel,
+                                       const std::string &elseLabel);
+        void                    switchOn(const IRValue &value, const std::string &defaultLabel,
+                                         const std::vector<std::pair<std::string, std::string>> &cases);
+        void                    ret(const IRValue &value);
+        void                    retVoid();
+        void                    unreachable();
+
+        IRInst &                append(IRInst inst);
+
+      private:
+        IRFunction *            function_;
+        size_t                  current_;       // index of the current block
+        size_t                  allocaEnd_;     // allocas at the head of the entry block
+        int                     temps_;
+        int                     labels_;
+        std::vector<std::pair<std::string, int>>    names_;
+    };
+
+    inline const std::string & IRBuilder::currentLabel() const
+    {
+        return function_->blocks[current_].label;
+    }
+
+    inline bool IRBuilder::terminated() const
+    {
+        return function_->blocks[current_].terminated();
+    }
+}
+
+#endif
@@ -0,0 +1,274 @@
+#include <chrono>
+#include "jit.h"
+#include "native_backend.h"
+
+#ifdef YCC_LLVM
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ObjectTransformLayer.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Target/TargetMachine.h>
+#endif
+
+namespace ycc
+{
+#ifdef YCC_LLVM
+    using namespace llvm;
+    using namespace llvm::orc;
+
+    struct Jit::State
+    {
+        std::unique_ptr<LLJIT>              jit;
+        LLLazyJIT *                         lazyJit = nullptr;
+        std::unique_ptr<TargetMachine>      machine;        // of the passes
+        JITTargetAddress                    main = 0;
+        long                                methods = 0;
+        long                                compileUs = 0;
+        int                                 compiling = 0;  // modules between IR and object
+        std::chrono::steady_clock::time_point   begin;
+    };
+
+    static std::string take(Error error)
+    {
+        return toString(std::move(error));
+    }
+
+    // default<On>, the pipeline clang -On runs
+    static void optimize(Module &module, TargetMachine *machine, int optLevel)
+    {
+        LoopAnalysisManager loops;
+        FunctionAnalysisManager functions;
+        CGSCCAnalysisManager sccs;
+        ModuleAnalysisManager modules;
+        PassBuilder builder(machine);
+        builder.registerModuleAnalyses(modules);
+        builder.registerCGSCCAnalyses(sccs);
+        builder.registerFunctionAnalyses(functions);
+        builder.registerLoopAnalyses(loops);
+        builder.crossRegisterProxies(loops, functions, sccs, modules);
+
+        auto level = optLevel == 0 ? OptimizationLevel::O0
+                   : optLevel == 1 ? OptimizationLevel::O1
+                   : optLevel == 2 ? OptimizationLevel::O2 : OptimizationLevel::O3;
+        auto passes = optLevel == 0 ? builder.buildO0DefaultPipeline(level)
+                                    : builder.buildPerModuleDefaultPipeline(level);
+        passes.run(module, modules);
+    }
+
+    Jit::Jit(int optLevel, bool lazy)
+        : optLevel_(optLevel),lazy_(lazy),state_(new State())
+    {
+    }
+
+    Jit::~Jit()
+    {
+    }
+
+    // the host, its cpu included, as the code runs here
+    bool Jit::add(const std::string &module, std::string &error)
+    {
+        InitializeNativeTarget();
+        InitializeNativeTargetAsmPrinter();
+
+        auto host = JITTargetMachineBuilder::detectHost();
+        if(!host)
+        {
+            error = take(host.takeError());
+            return false;
+        }
+        host->setCodeGenOptLevel(optLevel_ < 0 ? CodeGenOpt::Default
+                               : optLevel_ == 0 ? CodeGenOpt::None
+                               : optLevel_ == 1 ? CodeGenOpt::Less
+                               : optLevel_ == 2 ? CodeGenOpt::Default : CodeGenOpt::Aggressive);
+        auto machine = host->createTargetMachine();
+        if(!machine)
+        {
+            error = take(machine.takeError());
+            return false;
+        }
+        state_->machine = std::move(*machine);
+
+        if(lazy_)
+        {
+            auto jit = LLLazyJITBuilder().setJITTargetMachineBuilder(*host).create();
+            if(!jit)
+            {
+                error = take(jit.takeError());
+                return false;
+            }
+            state_->lazyJit = jit->get();
+            state_->jit = std::move(*jit);
+        }
+        else
+        {
+            auto jit = LLJITBuilder().setJITTargetMachineBuilder(*host).create();
+            if(!jit)
+            {
+                error = take(jit.takeError());
+                return false;
+            }
+            state_->jit = std::move(*jit);
+        }
+        auto &jit = *state_->jit;
+
+        // printf, calloc, write and the rest of the C library ycc is linked with
+        auto process = DynamicLibrarySearchGenerator::GetForCurrentProcess(jit.getDataLayout().getGlobalPrefix());
+        if(!process)
+        {
+            error = take(process.takeError());
+            return false;
+        }
+        jit.getMainJITDylib().addGenerator(std::move(*process));
+
+        // every module, the whole one or a method of it, is timed from its IR to its object
+        auto state = state_.get();
+        int optLevel = optLevel_;
+        jit.getIRTransformLayer().setTransform(
+            [state, optLevel](ThreadSafeModule module, MaterializationResponsibility &) -> Expected<ThreadSafeModule>
+            {
+                if(state->compiling++ == 0)
+                {
+                    state->begin = std::chrono::steady_clock::now();
+                }
+                module.withModuleDo([state, optLevel](Module &m)
+                {
+                    for(auto &function : m)
+                    {
+                        // not the constructor and destructor calls ORC adds
+                        auto name = function.getName();
+                        state->methods += !function.isDeclaration()
+                                       && (!name.startswith("__") || name.startswith("__orc_lcl."));
+                    }
+                    if(optLevel >= 0)
+                    {
+                        optimize(m, state->machine.get(), optLevel);
+                    }
+                });
+                return std::move(module);
+            });
+        jit.getObjTransformLayer().setTransform(
+            [state](std::unique_ptr<MemoryBuffer> object) -> Expected<std::unique_ptr<MemoryBuffer>>
+            {
+                if(state->compiling > 0 && --state->compiling == 0)
+                {
+                    auto elapsed = std::chrono::steady_clock::now() - state->begin;
+                    state->compileUs += std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+                }
+                return std::move(object);
+            });
+
+        auto context = std::make_unique<LLVMContext>();
+        SMDiagnostic diagnostic;
+        auto parsed = parseIR(MemoryBufferRef(module, "ycc"), diagnostic, *context);
+        if(!parsed)
+        {
+            error = diagnostic.getMessage().str();
+            return false;
+        }
+        parsed->setDataLayout(jit.getDataLayout());
+        parsed->setTargetTriple(jit.getTargetTriple().str());
+        if(!NativeBackend::linkApi(wrap(parsed.get()), error))
+        {
+            return false;
+        }
+
+        ThreadSafeModule threadSafe(std::move(parsed), std::move(context));
+        auto added = lazy_ ? state_->lazyJit->addLazyIRModule(std::move(threadSafe))
+                           : jit.addIRModule(std::move(threadSafe));
+        if(added)
+        {
+            error = take(std::move(added));
+            return false;
+        }
+        return true;
+    }
+
+    // all of the module, or lazily the stubs of its methods
+    bool Jit::compile(std::string &error)
+    {
+        auto main = state_->jit->lookup("main");
+        if(!main)
+        {
+            error = take(main.takeError());
+            return false;
+        }
+        state_->main = main->getAddress();
+        return true;
+    }
+
+    // the constructors of io, main and the destructors, which flush the output
+    bool Jit::run(int &status, std::string &error)
+    {
+        auto &jit = *state_->jit;
+        if(auto failure = jit.initialize(jit.getMainJITDylib()))
+        {
+            error = take(std::move(failure));
+            return false;
+        }
+        auto main = reinterpret_cast<int (*)()>(static_cast<uintptr_t>(state_->main));
+        status = main();
+        if(auto failure = jit.deinitialize(jit.getMainJITDylib()))
+        {
+            error = take(std::move(failure));
+            return false;
+        }
+        return true;
+    }
+
+    long Jit::methodsCompiled() const
+    {
+        return state_->methods;
+    }
+
+    long Jit::compileMicroseconds() const
+    {
+        return state_->compileUs;
+    }
+#else
+    static const char *unavailable = "ycc was built without LLVM, make LLVM=1 links it";
+
+    struct Jit::State
+    {
+    };
+
+    Jit::Jit(int optLevel, bool lazy)
+        : optLevel_(optLevel),lazy_(lazy),state_(new State())
+    {
+    }
+
+    Jit::~Jit()
+    {
+    }
+
+    bool Jit::add(const std::string &, std::string &error)
+    {
+        error = unavailable;
+        return false;
+    }
+
+    bool Jit::compile(std::string &error)
+    {
+        error = unavailable;
+        return false;
+    }
+
+    bool Jit::run(int &, std::string &error)
+    {
+        error = unavailable;
+        return false;
+    }
+
+    long Jit::methodsCompiled() const
+    {
+        return 0;
+    }
+
+    long Jit::compileMicroseconds() const
+    {
+        return 0;
+    }
+#endif
+}
@@ -0,0 +1,44 @@
+#ifndef JIT_H_
+#define JIT_H_
+
+#include <memory>
+#include <string>
+
+namespace ycc
+{
+    /*
+     * Runs the module in the ycc process instead of writing a file. The
+     * module, as IRGenerator writes it, is handed to an LLVM ORC JIT for
+     * the host, optimized at -O<n> if given, and its main is called after
+     * the constructors of the io runtime and followed by its destructors.
+     * Lazily, only the stubs are made up front and every method is compiled
+     * when it is first called. Needs ycc built with make LLVM=1, otherwise
+     * every step fails saying so.
+     */
+    class Jit
+    {
+      public:
+        Jit(int optLevel, bool lazy);
+        ~Jit();
+
+        bool                add(const std::string &module, std::string &error);
+        bool                compile(std::string &error);
+        bool                run(int &status, std::string &error);
+
+        long                methodsCompiled() const;
+        long                compileMicroseconds() const;    // optimization and code generation
+
+      private:
+        Jit(const Jit &) = delete;
+        Jit &operator=(const Jit &) = delete;
+
+      private:
+        struct State;
+
+        int                         optLevel_;      // -1 without -O<n>
+        bool                        lazy_;
+        std::unique_ptr<State>      state_;         // the LLVM side
+    };
+}
+
+#endif
@@ -0,0 +1,459 @@
+#include <algorithm>
+#include "licm.h"
+
+namespace ycc
+{
+    LoopInvariantMotion::LoopInvariantMotion()
+        : preheadersAdded_(0),instructionsHoisted_(0)
+    {
+    }
+
+    void LoopInvariantMotion::run(std::vector<IRFunction> &functions)
+    {
+        for(auto &function : functions)
+        {
+            optimize(function);
+        }
+    }
+
+    // i32, double, i8*: what one store writes and one load reads
+    static bool scalar(const std::string &type)
+    {
+        return !type.empty() && (type.back() == '*' || type[0] == 'i' || type == "double" || type == "float");
+    }
+
+    // io and the runtime never write memory the program can read
+    static bool writesMemory(const IRInst &call)
+    {
+        return call.opcode.compare(0, 4, "@io.") != 0 && call.opcode.compare(0, 5, "@ycc.") != 0;
+    }
+
+    static bool mayTrap(const IRInst &inst)
+    {
+        if(inst.opcode != "sdiv" && inst.opcode != "srem" && inst.opcode != "udiv" && inst.opcode != "urem")
+        {
+            return false;
+        }
+        auto &divisor = inst.operands[1];
+        return !divisor.isConstant() || divisor.name == "0" || divisor.name == "-1";
+    }
+
+    // two gep paths reach the same memory unless a constant index tells them apart
+    static bool overlap(const std::vector<std::string> &a, const std::vector<std::string> &b)
+    {
+        if(a[0] != b[0])
+        {
+            return false;
+        }
+        for(size_t i = 1; i < a.size() && i < b.size(); i++)
+        {
+            if(a[i] != b[i] && a[i] != "*" && b[i] != "*")
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void LoopInvariantMotion::optimize(IRFunction &function)
+    {
+        if(function.blocks.size() < 2)
+        {
+            return ;
+        }
+        slots_.clear();
+        bases_.clear();
+        paths_.clear();
+        added_.clear();
+        for(auto &inst : function.blocks[0].insts)
+        {
+            if(inst.op == IROp::ALLOCA)
+            {
+                slots_.insert(inst.result);
+            }
+        }
+        for(auto &block : function.blocks)
+        {
+            for(auto &inst : block.insts)
+            {
+                for(size_t i = 0; i < inst.operands.size(); i++)
+                {
+                    bool address = (inst.op == IROp::LOAD && i == 0) || (inst.op == IROp::STORE && i == 1);
+                    if(!address)
+                    {
+                        slots_.erase(inst.operands[i].name);
+                    }
+                }
+                if(inst.op == IROp::ALLOCA)
+                {
+                    bases_[inst.result] = "";
+                }
+                else if(inst.op == IROp::GEP)
+                {
+                    auto &path = paths_[inst.result];
+                    path.push_back(inst.type);
+                    bool field = true;
+                    for(size_t i = 1; i < inst.operands.size(); i++)
+                    {
+                        auto &index = inst.operands[i];
+                        path.push_back(index.isConstant() ? index.name : "*");
+                        field = field && index.isConstant();
+                    }
+                    if(field)
+                    {
+                        bases_[inst.result] = inst.operands[0].name;
+                    }
+                }
+            }
+        }
+
+        DominatorTree tree(function);
+        auto loops = tree.loops();
+        if(loops.empty())
+        {
+            return ;
+        }
+        if(addPreheaders(function, tree, loops))
+        {
+            tree = DominatorTree(function);
+            loops = tree.loops();
+        }
+        // inner loops first, what they hoist may then leave the outer one too
+        std::stable_sort(loops.begin(), loops.end(), [](const NaturalLoop &a, const NaturalLoop &b)
+        {
+            return a.blocks.size() < b.blocks.size();
+        });
+        for(auto &loop : loops)
+        {
+            auto pre = preheader(function, tree, loop);
+            if(pre >= 0)
+            {
+                hoist(function, tree, loop, pre);
+            }
+        }
+        removeEmpty(function);
+    }
+
+    // the block outside the loop that jumps to its header, if it is the only one
+    long LoopInvariantMotion::preheader(const IRFunction &function, const DominatorTree &tree,
+                                        const NaturalLoop &loop) const
+    {
+        long outside = -1;
+        for(auto pred : tree.preds(loop.header))
+        {
+            if(loop.body[pred])
+            {
+                continue;
+            }
+            if(outside >= 0 && (size_t)outside != pred)
+            {
+                return -1;
+            }
+            outside = pred;
+        }
+        if(outside < 0 || function.blocks[outside].insts.back().op != IROp::BR)
+        {
+            return -1;
+        }
+        return outside;
+    }
+
+    // false if every loop has its preheader already
+    bool LoopInvariantMotion::addPreheaders(IRFunction &function, const DominatorTree &tree,
+                                            const std::vector<NaturalLoop> &loops)
+    {
+        std::vector<std::vector<IRBlock>> added(function.blocks.size());
+        for(auto &loop : loops)
+        {
+            auto &header = function.blocks[loop.header];
+            if(loop.header == 0 || preheader(function, tree, loop) >= 0)
+            {
+                continue;
+            }
+            std::vector<size_t> outside;
+            for(auto pred : tree.preds(loop.header))
+            {
+                if(!loop.body[pred] && std::find(outside.begin(), outside.end(), pred) == outside.end())
+                {
+                    outside.push_back(pred);
+                }
+            }
+            bool phis = !header.insts.empty() && header.insts[0].op == IROp::PHI;
+            auto label = header.label + ".preheader";
+            auto taken = std::any_of(function.blocks.begin(), function.blocks.end(), [&](const IRBlock &block)
+            {
+                return block.label == label;
+            });
+            if(outside.empty() || (phis && outside.size() > 1) || taken)
+            {
+                continue;
+            }
+            for(auto pred : outside)
+            {
+                auto &branch = function.blocks[pred].insts.back();
+                for(auto &operand : branch.operands)
+                {
+                    if(operand.type == "label" && operand.name == header.label)
+                    {
+                        operand.name = label;
+                    }
+                }
+            }
+            for(auto &inst : header.insts)
+            {
+                if(inst.op != IROp::PHI)
+                {
+                    break;
+                }
+                for(auto &operand : inst.operands)
+                {
+                    if(operand.type == "label" && operand.name == function.blocks[outside[0]].label)
+                    {
+                        operand.name = label;
+                    }
+                }
+            }
+            IRInst branch{IROp::BR, "", "", "br", {IRValue{"label", header.label}}};
+            added[loop.header].push_back(IRBlock{label, {branch}});
+            added_.push_back(label);
+        }
+
+        if(added_.empty())
+        {
+            return false;
+        }
+        std::vector<IRBlock> blocks;
+        blocks.reserve(function.blocks.size() + added_.size());
+        for(size_t b = 0; b < function.blocks.size(); b++)
+        {
+            for(auto &block : added[b])
+            {
+                blocks.push_back(std::move(block));
+            }
+            blocks.push_back(std::move(function.blocks[b]));
+        }
+        function.blocks.swap(blocks);
+        return true;
+    }
+
+    void LoopInvariantMotion::removeEmpty(IRFunction &function)
+    {
+        for(auto &label : added_)
+        {
+            auto at = std::find_if(function.blocks.begin(), function.blocks.end(), [&](const IRBlock &block)
+            {
+                return block.label == label;
+            });
+            if(at->insts.size() > 1)
+            {
+                preheadersAdded_++;
+                continue;
+            }
+            auto header = at->insts[0].operands[0].name;
+            std::string pred;
+            for(auto &block : function.blocks)
+            {
+                for(auto &operand : block.insts.back().operands)
+                {
+                    if(operand.type == "label" && operand.name == label)
+                    {
+                        operand.name = header;
+                        pred = block.label;
+                    }
+                }
+            }
+            for(auto &block : function.blocks)
+            {
+                if(block.label != header)
+                {
+                    continue;
+                }
+                for(auto &inst : block.insts)
+                {
+                    for(auto &operand : inst.operands)
+                    {
+                        if(inst.op == IROp::PHI && operand.type == "label" && operand.name == label)
+                        {
+                            operand.name = pred;
+                        }
+                    }
+                }
+            }
+            function.blocks.erase(at);
+        }
+    }
+
+    bool LoopInvariantMotion::invariant(const IRInst &inst, const std::unordered_set<std::string> &defined) const
+    {
+        for(auto &operand : inst.operands)
+        {
+            if(!operand.isConstant() && defined.count(operand.name))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // a pointer that can be read whether or not the loop runs
+    bool LoopInvariantMotion::valid(const std::string &pointer) const
+    {
+        if(pointer[0] == '@' || slots_.count(pointer))
+        {
+            return true;
+        }
+        auto base = bases_.find(pointer);
+        return base != bases_.end() && (base->second.empty() || valid(base->second));
+    }
+
+    const std::vector<std::string> * LoopInvariantMotion::path(const std::string &pointer) const
+    {
+        auto iter = paths_.find(pointer);
+        return iter == paths_.end() ? nullptr : &iter->second;
+    }
+
+    void LoopInvariantMotion::hoist(IRFunction &function, const DominatorTree &tree, const NaturalLoop &loop,
+                                    size_t preheader)
+    {
+        std::unordered_set<std::string> defined;
+        std::set<std::string> storedSlots;
+        std::set<std::string> storedStatics;
+        std::vector<Store> stores;      // to memory that is neither a slot nor a static
+        bool storesAll = false;
+        bool calls = false;
+        std::vector<size_t> leaving;    // exits and latches
+        for(auto b : loop.blocks)
+        {
+            for(auto &inst : function.blocks[b].insts)
+            {
+                if(!inst.result.empty())
+                {
+                    defined.insert(inst.result);
+                }
+                if(inst.op == IROp::STORE)
+                {
+                    auto &pointer = inst.operands[1].name;
+                    if(slots_.count(pointer))
+                    {
+                        storedSlots.insert(pointer);
+                    }
+                    else if(pointer[0] == '@')
+                    {
+                        storedStatics.insert(pointer);
+                    }
+                    else if(scalar(inst.operands[0].type))
+                    {
+                        stores.push_back(Store{inst.operands[0].type, path(pointer)});
+                    }
+                    else
+                    {
+                        storesAll = true;
+                    }
+                }
+                else if(inst.op == IROp::CALL && writesMemory(inst))
+                {
+                    calls = true;
+                }
+            }
+            for(auto next : tree.succs(b))
+            {
+                if(!loop.body[next] || next == loop.header)
+                {
+                    leaving.push_back(b);
+                    break;
+                }
+            }
+        }
+
+        // blocks that run each time the loop is entered and the pointers they read or write
+        std::vector<bool> always(function.blocks.size(), true);
+        std::unordered_set<std::string> touched;
+        for(auto b : loop.blocks)
+        {
+            for(auto exit : leaving)
+            {
+                always[b] = always[b] && tree.dominates(b, exit);
+            }
+            for(auto &inst : function.blocks[b].insts)
+            {
+                if(always[b] && (inst.op == IROp::LOAD || inst.op == IROp::STORE))
+                {
+                    touched.insert(inst.operands[inst.op == IROp::LOAD ? 0 : 1].name);
+                }
+            }
+        }
+        auto clobbered = [&](const IRInst &load)
+        {
+            auto path = this->path(load.operands[0].name);
+            for(auto &store : stores)
+            {
+                if(store.type == load.type && (!path || !store.path || overlap(*path, *store.path)))
+                {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        std::vector<IRInst> hoisted;
+        for(auto b : loop.blocks)
+        {
+            auto &insts = function.blocks[b].insts;
+            size_t kept = 0;
+            for(size_t i = 0; i < insts.size(); i++)
+            {
+                auto &inst = insts[i];
+                bool movable = false;
+                switch(inst.op)
+                {
+                case IROp::BINARY:
+                    movable = !mayTrap(inst);
+                    break;
+                case IROp::CMP:
+                case IROp::CAST:
+                case IROp::GEP:
+                case IROp::SELECT:
+                    movable = true;
+                    break;
+                case IROp::LOAD:
+                {
+                    auto &pointer = inst.operands[0].name;
+                    if(slots_.count(pointer))
+                    {
+                        movable = !storedSlots.count(pointer);
+                    }
+                    else if(pointer[0] == '@')
+                    {
+                        movable = !calls && !storedStatics.count(pointer);
+                    }
+                    else
+                    {
+                        movable = !calls && !storesAll && !clobbered(inst);
+                    }
+                    movable = movable && (always[b] || touched.count(pointer) || valid(pointer));
+                    break;
+                }
+                default:
+                    break;
+                }
+                if(movable && invariant(inst, defined))
+                {
+                    defined.erase(inst.result);
+                    hoisted.push_back(std::move(inst));
+                    continue;
+                }
+                if(kept != i)
+                {
+                    insts[kept] = std::move(inst);
+                }
+                kept++;
+            }
+            insts.erase(insts.begin() + kept, insts.end());
+        }
+
+        auto &insts = function.blocks[preheader].insts;
+        insts.insert(insts.end() - 1, std::make_move_iterator(hoisted.begin()),
+                     std::make_move_iterator(hoisted.end()));
+        instructionsHoisted_ += hoisted.size();
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef LICM_H_
+#define LICM_H_
+
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "ir.h"
+#include "dominators.h"
+
+namespace ycc
+{
+    /*
+     * Loop invariant code motion for every method. The natural loops are
+     * found from the back edges of the dominator tree; each gets a
+     * preheader, a block that is the only way into its header from
+     * outside, unless one is there already. Innermost loops first, an
+     * arithmetic, compare, cast, gep or select whose operands are all
+     * defined outside the loop moves to the preheader, and so does a load
+     * the loop never writes to: a slot it does not store, a static it does
+     * not store and no method it calls may store, other memory when no
+     * store in the loop has its type and a gep path that may overlap, so
+     * the length of an array stays put while its elements are written.
+     * Such a load is only moved when the pointer is known to be valid or
+     * is read every time the loop is entered, so a loop that runs zero
+     * times never reads through a null object. Preheaders nothing was
+     * moved to are taken out again.
+     */
+    class LoopInvariantMotion
+    {
+      public:
+        LoopInvariantMotion();
+
+        void                run(std::vector<IRFunction> &functions);
+        long                preheadersAdded() const;
+        long                instructionsHoisted() const;
+
+      private:
+        struct Store
+        {
+            std::string                 type;
+            const std::vector<std::string> *path;     // null if not through a gep
+        };
+
+        void                optimize(IRFunction &function);
+        bool                addPreheaders(IRFunction &function, const DominatorTree &tree,
+                                          const std::vector<NaturalLoop> &loops);
+        void                removeEmpty(IRFunction &function);
+        long                preheader(const IRFunction &function, const DominatorTree &tree,
+                                      const NaturalLoop &loop) const;
+        void                hoist(IRFunction &function, const DominatorTree &tree, const NaturalLoop &loop,
+                                  size_t preheader);
+        bool                invariant(const IRInst &inst, const std::unordered_set<std::string> &defined) const;
+        bool                valid(const std::string &pointer) const;
+        const std::vector<std::string> *path(const std::string &pointer) const;
+
+      private:
+        long                                                preheadersAdded_;
+        long                                                instructionsHoisted_;
+        std::set<std::string>                               slots_;
+        std::unordered_map<std::string, std::string>        bases_;     // allocas and field geps to their base
+        std::unordered_map<std::string, std::vector<std::string>>   paths_;    // geps: indexed type, indices
+        std::vector<std::string>                            added_;     // labels of new preheaders
+    };
+
+    inline long LoopInvariantMotion::preheadersAdded() const
+    {
+        return preheadersAdded_;
+    }
+
+    inline long LoopInvariantMotion::instructionsHoisted() const
+    {
+        return instructionsHoisted_;
+    }
+}
+
+#endif
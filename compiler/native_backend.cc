@@ -0,0 +1,237 @@
+#include <sys/wait.h>
+#include <unistd.h>
+#include <set>
+#include <vector>
+#include "native_backend.h"
+
+#ifdef YCC_LLVM
+#include <llvm-c/Core.h>
+#include <llvm-c/Error.h>
+#include <llvm-c/IRReader.h>
+#include <llvm-c/Linker.h>
+#include <llvm-c/Target.h>
+#include <llvm-c/TargetMachine.h>
+#include <llvm-c/Transforms/PassBuilder.h>
+#endif
+
+namespace ycc
+{
+#ifdef YCC_LLVM
+    // the message of LLVM, which the caller has to free
+    static std::string take(char *message)
+    {
+        std::string text = message ? message : "";
+        LLVMDisposeMessage(message);
+        return text;
+    }
+
+    NativeBackend::NativeBackend(int optLevel)
+        : optLevel_(optLevel),context_(LLVMContextCreate()),module_(nullptr),machine_(nullptr)
+    {
+    }
+
+    NativeBackend::~NativeBackend()
+    {
+        if(machine_)
+        {
+            LLVMDisposeTargetMachine(machine_);
+        }
+        if(module_)
+        {
+            LLVMDisposeModule(module_);
+        }
+        LLVMContextDispose(context_);
+    }
+
+    // bitcode or text, and the host as its target
+    bool NativeBackend::parse(const std::string &module, std::string &error)
+    {
+        LLVMInitializeNativeTarget();
+        LLVMInitializeNativeAsmPrinter();
+
+        // the buffer belongs to the parser, the bytes stay with the caller
+        auto buffer = LLVMCreateMemoryBufferWithMemoryRange(module.c_str(), module.size(), "ycc", 1);
+        char *message = nullptr;
+        if(LLVMParseIRInContext(context_, buffer, &module_, &message))
+        {
+            module_ = nullptr;
+            error = take(message);
+            return false;
+        }
+
+        std::string triple = take(LLVMGetDefaultTargetTriple());
+        LLVMTargetRef target;
+        if(LLVMGetTargetFromTriple(triple.c_str(), &target, &message))
+        {
+            error = take(message);
+            return false;
+        }
+        auto level = optLevel_ < 0 ? LLVMCodeGenLevelDefault
+                   : optLevel_ == 0 ? LLVMCodeGenLevelNone
+                   : optLevel_ == 1 ? LLVMCodeGenLevelLess
+                   : optLevel_ == 2 ? LLVMCodeGenLevelDefault : LLVMCodeGenLevelAggressive;
+        // the generic cpu as llc and clang, position independent as cc links a pie by default
+        machine_ = LLVMCreateTargetMachine(target, triple.c_str(), "", "", level, LLVMRelocPIC, LLVMCodeModelDefault);
+        LLVMSetTarget(module_, triple.c_str());
+        auto layout = LLVMCreateTargetDataLayout(machine_);
+        LLVMSetModuleDataLayout(module_, layout);
+        LLVMDisposeTargetData(layout);
+        return linkApi(module_, error);
+    }
+
+    // io.print declared, api/io.bc linked: what the module calls is inlined into it by the passes
+    bool NativeBackend::linkApi(LLVMModuleRef module, std::string &error)
+    {
+        std::set<std::string> apis;
+        for(auto function = LLVMGetFirstFunction(module); function; function = LLVMGetNextFunction(function))
+        {
+            size_t length = 0;
+            auto text = LLVMGetValueName2(function, &length);
+            std::string name(text, length);
+            auto dot = name.find('.');
+            if(LLVMIsDeclaration(function) && dot != std::string::npos
+                && access(("./api/" + name.substr(0, dot) + ".bc").c_str(), R_OK) == 0)
+            {
+                apis.insert(name.substr(0, dot));
+            }
+        }
+
+        for(auto &api : apis)
+        {
+            auto fileName = "./api/" + api + ".bc";
+            LLVMMemoryBufferRef buffer;
+            LLVMModuleRef runtime;
+            char *message = nullptr;
+            if(LLVMCreateMemoryBufferWithContentsOfFile(fileName.c_str(), &buffer, &message)
+                || LLVMParseIRInContext(LLVMGetModuleContext(module), buffer, &runtime, &message))
+            {
+                error = fileName + ": " + take(message);
+                return false;
+            }
+            LLVMSetTarget(runtime, LLVMGetTarget(module));
+            LLVMSetDataLayout(runtime, LLVMGetDataLayoutStr(module));
+
+            // exported to this module only, unused ones are removed
+            std::vector<std::string> exported;
+            for(auto function = LLVMGetFirstFunction(runtime); function; function = LLVMGetNextFunction(function))
+            {
+                if(!LLVMIsDeclaration(function) && LLVMGetLinkage(function) == LLVMExternalLinkage)
+                {
+                    size_t length = 0;
+                    auto text = LLVMGetValueName2(function, &length);
+                    exported.push_back(std::string(text, length));
+                }
+            }
+            if(LLVMLinkModules2(module, runtime))
+            {
+                error = "can not link " + fileName;
+                return false;
+            }
+            for(auto &name : exported)
+            {
+                LLVMSetLinkage(LLVMGetNamedFunction(module, name.c_str()), LLVMInternalLinkage);
+            }
+        }
+        return true;
+    }
+
+    // default<On>, the pipeline clang -On runs
+    bool NativeBackend::optimize(std::string &error)
+    {
+        if(optLevel_ < 0)
+        {
+            return true;
+        }
+        std::string passes = "default<O" + std::to_string(optLevel_ > 3 ? 3 : optLevel_) + ">";
+        auto options = LLVMCreatePassBuilderOptions();
+        auto failure = LLVMRunPasses(module_, passes.c_str(), machine_, options);
+        LLVMDisposePassBuilderOptions(options);
+        if(failure)
+        {
+            error = take(LLVMGetErrorMessage(failure));
+            return false;
+        }
+        return true;
+    }
+
+    bool NativeBackend::emit(const std::string &filename, Output output, std::string &error)
+    {
+        std::vector<char> name(filename.begin(), filename.end());
+        name.push_back('\0');
+        char *message = nullptr;
+        auto type = output == Output::OBJECT ? LLVMObjectFile : LLVMAssemblyFile;
+        if(LLVMTargetMachineEmitToFile(machine_, module_, name.data(), type, &message))
+        {
+            error = take(message);
+            return false;
+        }
+        return true;
+    }
+#else
+    static const char *unavailable = "ycc was built without LLVM, make LLVM=1 links it";
+
+    NativeBackend::NativeBackend(int optLevel)
+        : optLevel_(optLevel),context_(nullptr),module_(nullptr),machine_(nullptr)
+    {
+    }
+
+    NativeBackend::~NativeBackend()
+    {
+    }
+
+    bool NativeBackend::parse(const std::string &, std::string &error)
+    {
+        error = unavailable;
+        return false;
+    }
+
+    bool NativeBackend::optimize(std::string &error)
+    {
+        error = unavailable;
+        return false;
+    }
+
+    bool NativeBackend::emit(const std::string &, Output, std::string &error)
+    {
+        error = unavailable;
+        return false;
+    }
+
+    bool NativeBackend::linkApi(LLVMOpaqueModule *, std::string &error)
+    {
+        error = unavailable;
+        return false;
+    }
+#endif
+
+    // cc adds the C library the runtime calls into
+    bool NativeBackend::link(const std::string &object, const std::string &executable, std::string &error)
+    {
+        std::vector<std::string> args{"cc", object, "-o", executable};
+        std::vector<char *> argv;
+        for(auto &arg : args)
+        {
+            argv.push_back(const_cast<char *>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+
+        pid_t pid = fork();
+        if(pid == 0)
+        {
+            execvp(argv[0], argv.data());
+            _exit(127);
+        }
+        int status = 0;
+        if(pid < 0 || waitpid(pid, &status, 0) < 0)
+        {
+            error = "can not run cc";
+            return false;
+        }
+        if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            error = WIFEXITED(status) && WEXITSTATUS(status) == 127 ? "can not run cc" : "cc failed";
+            return false;
+        }
+        return true;
+    }
+}
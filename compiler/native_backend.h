@@ -0,0 +1,52 @@
+#ifndef NATIVE_BACKEND_H_
+#define NATIVE_BACKEND_H_
+
+#include <string>
+
+struct LLVMOpaqueContext;
+struct LLVMOpaqueModule;
+struct LLVMOpaqueTargetMachine;
+
+namespace ycc
+{
+    /*
+     * Object code without llc. The module, as IRGenerator writes it, is
+     * parsed from memory by the LLVM C API, optimized by the pass pipeline
+     * of -O<n> and compiled for the host to an object or assembly file;
+     * an executable is linked from the object by cc. Without a level no
+     * passes run, as with llc, and code generation is at -O2. The api
+     * modules the module only declares are linked from api/<name>.bc, their
+     * functions internal to it. Needs ycc built with make LLVM=1, otherwise
+     * every step fails saying so.
+     */
+    class NativeBackend
+    {
+      public:
+        enum class Output
+        {
+            OBJECT,     ASSEMBLY
+        };
+
+        explicit NativeBackend(int optLevel);
+        ~NativeBackend();
+
+        bool                parse(const std::string &module, std::string &error);
+        bool                optimize(std::string &error);
+        bool                emit(const std::string &filename, Output output, std::string &error);
+
+        static bool         linkApi(LLVMOpaqueModule *module, std::string &error);
+        static bool         link(const std::string &object, const std::string &executable, std::string &error);
+
+      private:
+        NativeBackend(const NativeBackend &) = delete;
+        NativeBackend &operator=(const NativeBackend &) = delete;
+
+      private:
+        int                         optLevel_;      // -1 without -O<n>
+        LLVMOpaqueContext *         context_;
+        LLVMOpaqueModule *          module_;
+        LLVMOpaqueTargetMachine *   machine_;
+    };
+}
+
+#endif
@@ -0,0 +1,453 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include "profile.h"
+#include "../common/compile_cache.h"
+
+namespace ycc
+{
+    Profile::Profile()
+        : table_(0),hottest_(0),profiled_(0),branchesWeighted_(0),switchesOrdered_(0),blocksMoved_(0)
+    {
+    }
+
+    // the edges out of every condbr and switch with two targets or more, and a hash of the blocks
+    Profile::Layout Profile::layout(const IRFunction &function)
+    {
+        Layout layout{0, {}, function.blocks.size()};
+        std::ostringstream shape;
+        for(size_t b = 0; b < function.blocks.size(); b++)
+        {
+            auto &block = function.blocks[b];
+            shape << block.label << ":";
+            for(auto &inst : block.insts)
+            {
+                shape << " " << int(inst.op);
+            }
+            std::vector<std::string> targets;
+            for(auto &label : block.successors())
+            {
+                shape << " %" << label;
+                if(std::find(targets.begin(), targets.end(), label) == targets.end())
+                {
+                    targets.push_back(label);
+                }
+            }
+            shape << "\n";
+            auto op = block.terminated() ? block.insts.back().op : IROp::UNREACHABLE;
+            if((op == IROp::CONDBR || op == IROp::SWITCH) && targets.size() > 1)
+            {
+                for(auto &target : targets)
+                {
+                    layout.edges.push_back(std::make_pair(b, target));
+                }
+            }
+        }
+        layout.hash = CompileCache::hash(shape.str());
+        layout.counters += layout.edges.size();
+        return layout;
+    }
+
+    void Profile::instrument(std::vector<IRFunction> &functions)
+    {
+        std::vector<Layout> layouts;
+        methods_.clear();
+        table_ = 0;
+        for(auto &function : functions)
+        {
+            layouts.push_back(layout(function));
+            methods_.push_back(Method{function.name.substr(1), layouts.back().hash, table_, layouts.back().counters});
+            table_ += layouts.back().counters;
+        }
+        for(size_t i = 0; i < functions.size(); i++)
+        {
+            instrument(functions[i], layouts[i], methods_[i].first);
+        }
+    }
+
+    /*
+     * A counter is bumped after the phis of its block, after the allocas
+     * in the entry block. An edge gets a block of its own, which the
+     * branch jumps to and the phis of the target take their value from.
+     */
+    void Profile::instrument(IRFunction &function, const Layout &layout, size_t first)
+    {
+        auto table = "[" + std::to_string(table_) + " x i64]";
+        int serial = 0;
+        auto increment = [&](size_t counter)
+        {
+            auto name = "%ycc.count." + std::to_string(serial++);
+            return std::vector<IRInst>{
+                IRInst{IROp::GEP, name, table, "",
+                       {IRValue{table + "*", "@ycc.counters"}, IRValue{"i64", "0"}, IRValue{"i64", std::to_string(counter)}}},
+                IRInst{IROp::LOAD, name + ".old", "i64", "", {IRValue{"i64*", name}}},
+                IRInst{IROp::BINARY, name + ".new", "i64", "add", {IRValue{"i64", name + ".old"}, IRValue{"i64", "1"}}},
+                IRInst{IROp::STORE, "", "void", "", {IRValue{"i64", name + ".new"}, IRValue{"i64*", name}}}};
+        };
+
+        auto &blocks = function.blocks;
+        std::map<std::string, size_t> index;
+        for(size_t b = 0; b < blocks.size(); b++)
+        {
+            index[blocks[b].label] = b;
+        }
+        std::vector<IRBlock> edges;
+        for(size_t e = 0; e < layout.edges.size(); e++)
+        {
+            auto &from = blocks[layout.edges[e].first];
+            auto &target = layout.edges[e].second;
+            IRBlock edge{"ycc.edge." + std::to_string(e), increment(first + blocks.size() + e)};
+            edge.insts.push_back(IRInst{IROp::BR, "", "void", "", {IRValue{"label", target}}});
+            for(auto &operand : from.insts.back().operands)
+            {
+                if(operand.type == "label" && operand.name == target)
+                {
+                    operand.name = edge.label;
+                }
+            }
+            for(auto &inst : blocks[index[target]].insts)
+            {
+                for(size_t i = 1; inst.op == IROp::PHI && i < inst.operands.size(); i += 2)
+                {
+                    if(inst.operands[i].name == from.label)
+                    {
+                        inst.operands[i].name = edge.label;
+                    }
+                }
+            }
+            edges.push_back(edge);
+        }
+
+        for(size_t b = 0; b < blocks.size(); b++)
+        {
+            auto &insts = blocks[b].insts;
+            auto at = std::find_if(insts.begin(), insts.end(), [](const IRInst &inst)
+            {
+                return inst.op != IROp::PHI && inst.op != IROp::ALLOCA;
+            });
+            auto counter = increment(first + b);
+            // the table is written however the program exits; a JIT runs what main registers
+            // when it deinitializes, atexit is not in the shared C library for it to find
+            if(b == 0 && function.name == "@main")
+            {
+                counter.push_back(IRInst{IROp::CALL, "%ycc.atexit", "i32", "@__cxa_atexit",
+                                         {IRValue{"void (i8*)*", "@ycc.writeProfile"}, IRValue{"i8*", "null"},
+                                          IRValue{"i8*", "@__dso_handle"}}});
+            }
+            insts.insert(at, counter.begin(), counter.end());
+        }
+        blocks.insert(blocks.end(), edges.begin(), edges.end());
+    }
+
+    // [n x i8] c"...", with what LLVM does not take as is escaped
+    static std::string bytes(const std::string &text)
+    {
+        static const char *digits = "0123456789ABCDEF";
+        std::string chars;
+        for(unsigned char c : text)
+        {
+            if(c < ' ' || c > '~' || c == '"' || c == '\\')
+            {
+                chars += '\\';
+                chars += digits[c >> 4];
+                chars += digits[c & 15];
+            }
+            else
+            {
+                chars += char(c);
+            }
+        }
+        return "[" + std::to_string(text.size() + 1) + " x i8] c\"" + chars + "\\00\"";
+    }
+
+    static std::string pointer(const std::string &global, const std::string &text)
+    {
+        auto type = bytes(text);
+        type = type.substr(0, type.find(']') + 1);
+        return "i8* getelementptr inbounds (" + type + ", " + type + "* " + global + ", i64 0, i64 0)";
+    }
+
+    std::string Profile::runtime(const std::string &fileName) const
+    {
+        if(methods_.empty())
+        {
+            return "";
+        }
+        auto table = "[" + std::to_string(table_) + " x i64]";
+        const std::string header = "ycc profile\n", method = "%s %016llx %lld", count = " %lld", end = "\n";
+        const std::string failed = "ycc: warning: can not write profile %s\n";
+        std::ostringstream out;
+        out << "\n@ycc.counters = internal global " << table << " zeroinitializer, align 8\n";
+        out << "@ycc.profileFile = private unnamed_addr constant " << bytes(fileName) << ", align 1\n";
+        out << "@ycc.profileHeader = private unnamed_addr constant " << bytes(header) << ", align 1\n";
+        out << "@ycc.profileMethod = private unnamed_addr constant " << bytes(method) << ", align 1\n";
+        out << "@ycc.profileCount = private unnamed_addr constant " << bytes(count) << ", align 1\n";
+        out << "@ycc.profileEnd = private unnamed_addr constant " << bytes(end) << ", align 1\n";
+        out << "@ycc.profileFailed = private unnamed_addr constant " << bytes(failed) << ", align 1\n";
+        for(size_t i = 0; i < methods_.size(); i++)
+        {
+            out << "@ycc.profileName." << i << " = private unnamed_addr constant "
+                << bytes(methods_[i].name) << ", align 1\n";
+        }
+        out << R"(
+@__dso_handle = external global i8
+
+declare i32 @__cxa_atexit(void (i8*)*, i8*, i8*)
+declare i32 @creat(i8*, i32)
+declare i32 @dprintf(i32, i8*, ...)
+declare i32 @close(i32)
+
+; a line of the profile: the method, the hash of its blocks and its counters from %first to %last
+define internal void @ycc.writeCounters(i32 %file, i8* %name, i64 %hash, i64 %first, i64 %last) {
+entry:
+  %n = sub i64 %last, %first
+  %printed = call i32 (i32, i8*, ...) @dprintf(i32 %file, )" << pointer("@ycc.profileMethod", method)
+            << R"(, i8* %name, i64 %hash, i64 %n)
+  br label %loop
+
+loop:
+  %i = phi i64 [ %first, %entry ], [ %next, %body ]
+  %more = icmp ult i64 %i, %last
+  br i1 %more, label %body, label %done
+
+body:
+  %counter = getelementptr inbounds )" << table << ", " << table << R"(* @ycc.counters, i64 0, i64 %i
+  %count = load i64, i64* %counter
+  %printedCount = call i32 (i32, i8*, ...) @dprintf(i32 %file, )" << pointer("@ycc.profileCount", count)
+            << R"(, i64 %count)
+  %next = add i64 %i, 1
+  br label %loop
+
+done:
+  %printedEnd = call i32 (i32, i8*, ...) @dprintf(i32 %file, )" << pointer("@ycc.profileEnd", end) << R"()
+  ret void
+}
+
+; every method, at exit
+define internal void @ycc.writeProfile(i8* %unused) {
+entry:
+  %file = call i32 @creat()" << pointer("@ycc.profileFile", fileName) << R"(, i32 420)
+  %failed = icmp slt i32 %file, 0
+  br i1 %failed, label %fail, label %write
+
+fail:
+  %printedFailed = call i32 (i32, i8*, ...) @dprintf(i32 2, )" << pointer("@ycc.profileFailed", failed)
+            << ", " << pointer("@ycc.profileFile", fileName) << R"()
+  ret void
+
+write:
+  %printed = call i32 (i32, i8*, ...) @dprintf(i32 %file, )" << pointer("@ycc.profileHeader", header) << ")\n";
+        for(size_t i = 0; i < methods_.size(); i++)
+        {
+            auto &m = methods_[i];
+            out << "  call void @ycc.writeCounters(i32 %file, "
+                << pointer("@ycc.profileName." + std::to_string(i), m.name) << ", i64 " << int64_t(m.hash)
+                << ", i64 " << m.first << ", i64 " << m.first + m.counters << ")\n";
+        }
+        out << "  %closed = call i32 @close(i32 %file)\n  ret void\n}\n";
+        return out.str();
+    }
+
+    bool Profile::load(const std::string &fileName, std::string &error)
+    {
+        std::ifstream in(fileName);
+        std::string line;
+        if(!in || !std::getline(in, line) || line != "ycc profile")
+        {
+            error = in ? fileName + " is not a ycc profile" : "can not read profile " + fileName;
+            return false;
+        }
+        for(int number = 2; std::getline(in, line); number++)
+        {
+            std::istringstream fields(line);
+            std::string name, hash;
+            size_t n = 0;
+            if(line.empty() || line == "ycc profile")
+            {
+                continue;
+            }
+            Record record{0, {}};
+            fields >> name >> hash >> n;
+            record.hash = std::strtoull(hash.c_str(), nullptr, 16);
+            for(uint64_t count; record.counts.size() < n && fields >> count; )
+            {
+                record.counts.push_back(count);
+            }
+            if(!fields || record.counts.size() != n)
+            {
+                error = fileName + ":" + std::to_string(number) + ": not a line of a method";
+                return false;
+            }
+
+            auto &known = records_["@" + name];
+            if(known.counts.empty() || known.hash != record.hash || known.counts.size() != n)
+            {
+                known = record;
+                continue;
+            }
+            for(size_t i = 0; i < n; i++)
+            {
+                known.counts[i] += record.counts[i];
+            }
+        }
+        return true;
+    }
+
+    void Profile::apply(std::vector<IRFunction> &functions)
+    {
+        for(auto &function : functions)
+        {
+            auto shape = layout(function);
+            auto record = records_.find(function.name);
+            if(record == records_.end() || record->second.hash != shape.hash
+               || record->second.counts.size() != shape.counters)
+            {
+                stale_.push_back(function.name.substr(1));
+                continue;
+            }
+            apply(function, shape, record->second.counts);
+            profiled_++;
+        }
+    }
+
+    void Profile::apply(IRFunction &function, const Layout &layout, const std::vector<uint64_t> &counts)
+    {
+        auto &blocks = function.blocks;
+        auto &known = counts_[function.name];
+        for(size_t b = 0; b < blocks.size(); b++)
+        {
+            known[blocks[b].label] = counts[b];
+            hottest_ = std::max(hottest_, counts[b]);
+        }
+
+        std::map<std::string, uint64_t> taken;
+        for(size_t e = 0; e < layout.edges.size(); )
+        {
+            auto b = layout.edges[e].first;
+            taken.clear();
+            for(; e < layout.edges.size() && layout.edges[e].first == b; e++)
+            {
+                taken[layout.edges[e].second] = counts[blocks.size() + e];
+            }
+            weigh(blocks[b].insts.back(), taken);
+        }
+
+        // what never ran after what did, the entry first
+        size_t last = 0;
+        for(size_t b = 0; b < blocks.size(); b++)
+        {
+            last = counts[b] ? b : last;
+        }
+        for(size_t b = 1; b < last; b++)
+        {
+            blocksMoved_ += counts[b] == 0;
+        }
+        std::stable_partition(blocks.begin() + 1, blocks.end(), [&](const IRBlock &block)
+        {
+            return known[block.label] != 0;
+        });
+    }
+
+    /*
+     * A case of a switch that shares its target with others gets its share
+     * of the count of the edge. The weights are scaled to fit in an i32;
+     * a branch that never ran gets none.
+     */
+    void Profile::weigh(IRInst &branch, const std::map<std::string, uint64_t> &taken)
+    {
+        auto &operands = branch.operands;
+        std::map<std::string, uint64_t> shares;
+        for(size_t i = 1; i < operands.size(); i += branch.op == IROp::SWITCH ? 2 : 1)
+        {
+            shares[operands[i].name]++;
+        }
+        auto count = [&](const std::string &label)
+        {
+            return taken.at(label) / shares[label];
+        };
+
+        if(branch.op == IROp::SWITCH)
+        {
+            std::vector<std::pair<IRValue, IRValue>> cases;
+            for(size_t i = 2; i + 1 < operands.size(); i += 2)
+            {
+                cases.push_back(std::make_pair(operands[i], operands[i + 1]));
+            }
+            auto hottest = [&](const std::pair<IRValue, IRValue> &a, const std::pair<IRValue, IRValue> &b)
+            {
+                return count(a.second.name) > count(b.second.name);
+            };
+            if(!std::is_sorted(cases.begin(), cases.end(), hottest))
+            {
+                std::stable_sort(cases.begin(), cases.end(), hottest);
+                switchesOrdered_++;
+            }
+            operands.resize(2);
+            for(auto &c : cases)
+            {
+                operands.push_back(c.first);
+                operands.push_back(c.second);
+            }
+        }
+
+        std::vector<uint64_t> weights;
+        uint64_t most = 0;
+        for(size_t i = 1; i < operands.size(); i += branch.op == IROp::SWITCH ? 2 : 1)
+        {
+            weights.push_back(count(operands[i].name));
+            most = std::max(most, weights.back());
+        }
+        branch.weights.clear();
+        if(most == 0)
+        {
+            return ;
+        }
+        uint64_t scale = most / std::numeric_limits<uint32_t>::max() + 1;
+        for(auto weight : weights)
+        {
+            branch.weights.push_back(unsigned(weight / scale + (weight % scale != 0)));
+        }
+        branchesWeighted_++;
+    }
+
+    long Profile::count(const std::string &function, const std::string &label) const
+    {
+        auto method = counts_.find(function);
+        if(method == counts_.end())
+        {
+            return -1;
+        }
+        auto block = method->second.find(label);
+        return block == method->second.end() ? -1 : long(block->second);
+    }
+
+    // at least a hundredth of the hottest block
+    bool Profile::hot(long count) const
+    {
+        return count > 0 && uint64_t(count) >= hottest_ / 100;
+    }
+
+    // the rest of the block of the call runs as often, the copy of the callee as often as the call
+    void Profile::inlined(const std::string &caller, const std::string &site, const std::string &rest,
+                          const IRFunction &callee, const std::string &suffix)
+    {
+        long calls = count(caller, site);
+        if(calls < 0)
+        {
+            return ;
+        }
+        auto &known = counts_[caller];
+        known[rest] = calls;
+        long entries = count(callee.name, callee.blocks[0].label);
+        for(auto &block : callee.blocks)
+        {
+            long runs = count(callee.name, block.label);
+            if(entries > 0 && runs >= 0)
+            {
+                known[block.label + suffix] = uint64_t(double(runs) * calls / entries);
+            }
+        }
+    }
+}
@@ -0,0 +1,124 @@
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ir.h"
+
+namespace ycc
+{
+    /*
+     * Profile guided optimization, right after the CFG is simplified, so
+     * the instrumented and the optimized build see the same IR. With
+     * --instrument every method counts in a table of the program how often
+     * each of its blocks ran, the entry block being its calls, and how
+     * often each edge out of a condbr or switch was taken, through a block
+     * of its own on the edge. main registers a writer of the table at
+     * exit, which puts a line per method into the profile file:
+     *   <method> <hash of its blocks> <n> <count> ...
+     * Profiles of several runs may be concatenated, their counts add up.
+     * With --profile-use the counts of a method whose hash still matches go
+     * back into its IR: weights on its branches and switches, the cases of
+     * a switch hottest first, the blocks that never ran after the others,
+     * and block counts the inliner asks for.
+     */
+    class Profile
+    {
+      public:
+        Profile();
+
+        // --instrument
+        void                instrument(std::vector<IRFunction> &functions);
+        std::string         runtime(const std::string &fileName) const;     // the table and its writer
+        long                counters() const;
+
+        // --profile-use
+        bool                load(const std::string &fileName, std::string &error);
+        void                apply(std::vector<IRFunction> &functions);
+        const std::vector<std::string> &stale() const;      // methods without a matching profile
+        long                profiled() const;
+        long                branchesWeighted() const;
+        long                switchesOrdered() const;
+        long                blocksMoved() const;
+
+        // the inliner
+        long                count(const std::string &function, const std::string &label) const;    // -1 if unknown
+        bool                hot(long count) const;
+        void                inlined(const std::string &caller, const std::string &site, const std::string &rest,
+                                    const IRFunction &callee, const std::string &suffix);
+
+      private:
+        struct Layout
+        {
+            uint64_t                                    hash;
+            std::vector<std::pair<size_t, std::string>> edges;      // block and target
+            size_t                                      counters;   // blocks, then edges
+        };
+
+        struct Method
+        {
+            std::string             name;       // without the @
+            uint64_t                hash;
+            size_t                  first;      // of its counters in the table
+            size_t                  counters;
+        };
+
+        struct Record
+        {
+            uint64_t                hash;
+            std::vector<uint64_t>   counts;
+        };
+
+        static Layout       layout(const IRFunction &function);
+        void                instrument(IRFunction &function, const Layout &layout, size_t first);
+        void                apply(IRFunction &function, const Layout &layout, const std::vector<uint64_t> &counts);
+        void                weigh(IRInst &branch, const std::map<std::string, uint64_t> &taken);
+
+      private:
+        std::vector<Method>                             methods_;
+        size_t                                          table_;     // counters of the program
+        std::map<std::string, Record>                   records_;   // by @name
+        std::map<std::string, std::map<std::string, uint64_t>>  counts_;   // of the blocks, by @name and label
+        uint64_t                                        hottest_;   // count of the hottest block
+        std::vector<std::string>                        stale_;
+        long                                            profiled_;
+        long                                            branchesWeighted_;
+        long                                            switchesOrdered_;
+        long                                            blocksMoved_;
+    };
+
+    inline long Profile::counters() const
+    {
+        return table_;
+    }
+
+    inline const std::vector<std::string> &Profile::stale() const
+    {
+        return stale_;
+    }
+
+    inline long Profile::profiled() const
+    {
+        return profiled_;
+    }
+
+    inline long Profile::branchesWeighted() const
+    {
+        return branchesWeighted_;
+    }
+
+    inline long Profile::switchesOrdered() const
+    {
+        return switchesOrdered_;
+    }
+
+    inline long Profile::blocksMoved() const
+    {
+        return blocksMoved_;
+    }
+}
+
+#endif
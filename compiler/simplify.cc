@@ -0,0 +1,533 @@
+#include <algorithm>
+#include <iterator>
+#include <set>
+#include <unordered_map>
+#include "simplify.h"
+
+namespace ycc
+{
+    CFGSimplifier::CFGSimplifier()
+        : blocksRemoved_(0),instructionsRemoved_(0)
+    {
+    }
+
+    void CFGSimplifier::run(std::vector<IRFunction> &functions)
+    {
+        for(auto &function : functions)
+        {
+            simplify(function);
+        }
+    }
+
+    void CFGSimplifier::simplify(IRFunction &function)
+    {
+        if(function.blocks.empty())
+        {
+            return ;
+        }
+        long blocks = function.blocks.size();
+        long size = function.size();
+        // dead code only leaves blocks that jump on, it never makes more
+        bool again = true;
+        while(again)
+        {
+            bool changed = function.blocks.size() > 1;
+            while(changed)
+            {
+                changed = foldBranches(function);
+                changed |= removeUnreachable(function);
+                changed |= foldJumps(function);
+                changed |= mergeBlocks(function);
+            }
+            again = removeDeadCode(function);
+        }
+        blocksRemoved_ += blocks - function.blocks.size();
+        instructionsRemoved_ += size - function.size();
+    }
+
+    // drop the incoming values of the phis of block that come from label
+    static void removeIncoming(IRBlock &block, const std::string &label)
+    {
+        for(auto &inst : block.insts)
+        {
+            if(inst.op != IROp::PHI)
+            {
+                break;
+            }
+            auto &ops = inst.operands;
+            for(size_t i = 0; i + 1 < ops.size(); )
+            {
+                if(ops[i + 1].name == label)
+                {
+                    ops.erase(ops.begin() + i, ops.begin() + i + 2);
+                }
+                else
+                {
+                    i += 2;
+                }
+            }
+        }
+    }
+
+    // rename the incoming label from to to in the phis of block
+    static void renameIncoming(IRBlock &block, const std::string &from, const std::string &to)
+    {
+        for(auto &inst : block.insts)
+        {
+            if(inst.op != IROp::PHI)
+            {
+                break;
+            }
+            for(size_t i = 1; i < inst.operands.size(); i += 2)
+            {
+                if(inst.operands[i].name == from)
+                {
+                    inst.operands[i].name = to;
+                }
+            }
+        }
+    }
+
+    static void replaceUses(IRFunction &function, const std::string &name, const IRValue &value)
+    {
+        for(auto &block : function.blocks)
+        {
+            for(auto &inst : block.insts)
+            {
+                for(auto &operand : inst.operands)
+                {
+                    if(operand.type != "label" && operand.name == name)
+                    {
+                        operand.name = value.name;
+                    }
+                }
+            }
+        }
+    }
+
+    // blocks by label and the predecessors of every block, one per edge
+    void CFGSimplifier::graph(const IRFunction &function)
+    {
+        index_.clear();
+        for(size_t b = 0; b < function.blocks.size(); b++)
+        {
+            index_[function.blocks[b].label] = b;
+        }
+        preds_.assign(function.blocks.size(), std::vector<size_t>());
+        for(size_t b = 0; b < function.blocks.size(); b++)
+        {
+            auto &block = function.blocks[b];
+            if(!block.terminated())
+            {
+                continue;
+            }
+            for(auto &operand : block.insts.back().operands)
+            {
+                if(operand.type == "label")
+                {
+                    preds_[index_[operand.name]].push_back(b);
+                }
+            }
+        }
+    }
+
+    // br i1 true, label %a, label %b is br label %a
+    bool CFGSimplifier::foldBranches(IRFunction &function)
+    {
+        bool changed = false;
+        for(auto &block : function.blocks)
+        {
+            if(!block.terminated() || block.insts.back().op != IROp::CONDBR)
+            {
+                continue;
+            }
+            auto &ops = block.insts.back().operands;
+            if((ops[0].name != "true" && ops[0].name != "false") || ops[1].name == ops[2].name)
+            {
+                continue;
+            }
+            auto taken = ops[0].name == "true" ? ops[1].name : ops[2].name;
+            auto skipped = ops[0].name == "true" ? ops[2].name : ops[1].name;
+            for(auto &other : function.blocks)
+            {
+                if(other.label == skipped)
+                {
+                    removeIncoming(other, block.label);
+                }
+            }
+            block.insts.back() = IRInst{IROp::BR, "", "void", "", {IRValue{"label", taken}}};
+            changed = true;
+        }
+        return changed;
+    }
+
+    // leaves the graph of what is left
+    bool CFGSimplifier::removeUnreachable(IRFunction &function)
+    {
+        graph(function);
+        std::vector<bool> reached(function.blocks.size(), false);
+        std::vector<size_t> work(1, 0);
+        reached[0] = true;
+        while(!work.empty())
+        {
+            auto &block = function.blocks[work.back()];
+            work.pop_back();
+            if(!block.terminated())
+            {
+                continue;
+            }
+            for(auto &operand : block.insts.back().operands)
+            {
+                if(operand.type != "label")
+                {
+                    continue;
+                }
+                auto next = index_[operand.name];
+                if(!reached[next])
+                {
+                    reached[next] = true;
+                    work.push_back(next);
+                }
+            }
+        }
+        if(std::find(reached.begin(), reached.end(), false) == reached.end())
+        {
+            return false;
+        }
+
+        std::vector<IRBlock> blocks;
+        for(size_t b = 0; b < function.blocks.size(); b++)
+        {
+            if(!reached[b])
+            {
+                continue;
+            }
+            // only the phis of successors of removed blocks have to be looked at
+            for(auto pred : preds_[b])
+            {
+                if(!reached[pred])
+                {
+                    removeIncoming(function.blocks[b], function.blocks[pred].label);
+                }
+            }
+            blocks.push_back(std::move(function.blocks[b]));
+        }
+        function.blocks.swap(blocks);
+        graph(function);
+        return true;
+    }
+
+    /*
+     * Predecessors of a block that holds nothing but br label %c jump to c
+     * themselves. If c has phis, a predecessor that already jumps to c
+     * would need two incoming values of its own, so then the block stays.
+     * Blocks stay where they are, the graph is kept up to date.
+     */
+    bool CFGSimplifier::foldJumps(IRFunction &function)
+    {
+        bool changed = false;
+        for(size_t b = 1; b < function.blocks.size(); b++)
+        {
+            auto &block = function.blocks[b];
+            if(block.insts.size() != 1 || block.insts[0].op != IROp::BR)
+            {
+                continue;
+            }
+            auto &target = block.insts[0].operands[0].name;
+            auto t = index_[target];
+            auto &preds = preds_[b];
+            if(t == b || preds.empty())
+            {
+                continue;
+            }
+            auto &next = function.blocks[t];
+            if(!next.insts.empty() && next.insts[0].op == IROp::PHI)
+            {
+                std::set<size_t> distinct(preds.begin(), preds.end());
+                bool clash = distinct.size() != preds.size();
+                for(auto pred : preds_[t])
+                {
+                    clash = clash || distinct.count(pred);
+                }
+                if(clash)
+                {
+                    continue;
+                }
+                for(auto &inst : next.insts)
+                {
+                    if(inst.op != IROp::PHI)
+                    {
+                        break;
+                    }
+                    std::vector<IRValue> incoming;
+                    for(size_t i = 0; i + 1 < inst.operands.size(); i += 2)
+                    {
+                        if(inst.operands[i + 1].name != block.label)
+                        {
+                            incoming.push_back(inst.operands[i]);
+                            incoming.push_back(inst.operands[i + 1]);
+                            continue;
+                        }
+                        for(auto pred : preds)
+                        {
+                            incoming.push_back(inst.operands[i]);
+                            incoming.push_back(IRValue{"label", function.blocks[pred].label});
+                        }
+                    }
+                    inst.operands.swap(incoming);
+                }
+            }
+            for(auto pred : preds)
+            {
+                for(auto &operand : function.blocks[pred].insts.back().operands)
+                {
+                    if(operand.type == "label" && operand.name == block.label)
+                    {
+                        operand.name = target;
+                    }
+                }
+            }
+            auto &targetPreds = preds_[t];
+            targetPreds.erase(std::remove(targetPreds.begin(), targetPreds.end(), b), targetPreds.end());
+            targetPreds.insert(targetPreds.end(), preds.begin(), preds.end());
+            preds.clear();
+            changed = true;
+        }
+        return changed;
+    }
+
+    // a block that jumps to a block only it jumps to takes its instructions
+    bool CFGSimplifier::mergeBlocks(IRFunction &function)
+    {
+        bool changed = false;
+        std::vector<bool> merged(function.blocks.size(), false);
+        for(size_t b = 0; b < function.blocks.size(); b++)
+        {
+            if(merged[b])
+            {
+                continue;
+            }
+            auto &block = function.blocks[b];
+            while(block.terminated() && block.insts.back().op == IROp::BR)
+            {
+                auto label = block.insts.back().operands[0].name;
+                auto next = index_[label];
+                if(next == b || next == 0 || preds_[next].size() != 1 || preds_[next][0] != b)
+                {
+                    break;
+                }
+                auto &insts = function.blocks[next].insts;
+                size_t phis = 0;
+                for(; phis < insts.size() && insts[phis].op == IROp::PHI; phis++)
+                {
+                    replaceUses(function, insts[phis].result, insts[phis].operands[0]);
+                }
+                block.insts.pop_back();
+                block.insts.insert(block.insts.end(), std::make_move_iterator(insts.begin() + phis),
+                                   std::make_move_iterator(insts.end()));
+                insts.clear();
+                merged[next] = true;
+                for(auto &operand : block.insts.back().operands)
+                {
+                    if(operand.type != "label")
+                    {
+                        continue;
+                    }
+                    auto successor = index_[operand.name];
+                    renameIncoming(function.blocks[successor], label, block.label);
+                    std::replace(preds_[successor].begin(), preds_[successor].end(), next, b);
+                }
+                changed = true;
+            }
+        }
+        if(changed)
+        {
+            std::vector<IRBlock> blocks;
+            for(size_t b = 0; b < function.blocks.size(); b++)
+            {
+                if(!merged[b])
+                {
+                    blocks.push_back(std::move(function.blocks[b]));
+                }
+            }
+            function.blocks.swap(blocks);
+        }
+        return changed;
+    }
+
+    static bool pure(const IRInst &inst)
+    {
+        switch(inst.op)
+        {
+        case IROp::ALLOCA:
+        case IROp::LOAD:
+        case IROp::BINARY:
+        case IROp::CMP:
+        case IROp::CAST:
+        case IROp::GEP:
+        case IROp::PHI:
+        case IROp::SELECT:
+            return true;
+        default:
+            break;
+        }
+        return false;
+    }
+
+    /*
+     * Values without uses and without side effects, and stack slots that
+     * are only stored to, with their stores. Whatever goes releases its
+     * operands, which are looked at again. The operands are looked up by
+     * name once, into the numbers of the values of the method.
+     */
+    bool CFGSimplifier::removeDeadCode(IRFunction &function)
+    {
+        struct NameHash
+        {
+            size_t operator()(const std::string *name) const
+            {
+                return std::hash<std::string>()(*name);
+            }
+        };
+        struct NameEqual
+        {
+            bool operator()(const std::string *a, const std::string *b) const
+            {
+                return *a == *b;
+            }
+        };
+        std::unordered_map<const std::string *, long, NameHash, NameEqual> numbers;
+        std::vector<std::pair<size_t, size_t>> values;      // places of the definitions
+        std::vector<size_t> firstInst(function.blocks.size() + 1, 0);
+        for(size_t b = 0; b < function.blocks.size(); b++)
+        {
+            auto &insts = function.blocks[b].insts;
+            firstInst[b + 1] = firstInst[b] + insts.size();
+            for(size_t i = 0; i < insts.size(); i++)
+            {
+                if(!insts[i].result.empty())
+                {
+                    numbers[&insts[i].result] = values.size();
+                    values.push_back(std::make_pair(b, i));
+                }
+            }
+        }
+
+        // operands of instruction n: ids[firstOperand[n]..firstOperand[n+1]), -1 if not a value
+        std::vector<size_t> firstOperand(1, 0);
+        std::vector<long> ids;
+        std::vector<long> uses(values.size(), 0);
+        std::vector<size_t> firstStore(values.size() + 1, 0);  // stores to slot v
+        for(auto &block : function.blocks)
+        {
+            for(auto &inst : block.insts)
+            {
+                for(auto &operand : inst.operands)
+                {
+                    long id = -1;
+                    if(operand.type != "label" && !operand.isConstant())
+                    {
+                        auto number = numbers.find(&operand.name);
+                        id = number != numbers.end() ? number->second : -1;
+                    }
+                    if(id >= 0)
+                    {
+                        uses[id]++;
+                    }
+                    ids.push_back(id);
+                }
+                firstOperand.push_back(ids.size());
+                if(inst.op == IROp::STORE && ids.back() >= 0)
+                {
+                    firstStore[ids.back() + 1]++;
+                }
+            }
+        }
+        for(size_t v = 0; v < values.size(); v++)
+        {
+            firstStore[v + 1] += firstStore[v];
+        }
+        std::vector<std::pair<size_t, size_t>> stores(firstStore.back());
+        std::vector<size_t> next(firstStore.begin(), firstStore.end() - 1);
+        for(size_t b = 0; b < function.blocks.size(); b++)
+        {
+            auto &insts = function.blocks[b].insts;
+            for(size_t i = 0; i < insts.size(); i++)
+            {
+                if(insts[i].op != IROp::STORE)
+                {
+                    continue;
+                }
+                auto slot = ids[firstOperand[firstInst[b] + i] + 1];
+                if(slot >= 0)
+                {
+                    stores[next[slot]++] = std::make_pair(b, i);
+                }
+            }
+        }
+
+        std::vector<bool> dead(firstInst.back(), false);
+        std::vector<long> work;
+        for(size_t v = values.size(); v > 0; v--)
+        {
+            work.push_back(v - 1);
+        }
+        bool changed = false;
+        auto kill = [&](size_t block, size_t index)
+        {
+            auto n = firstInst[block] + index;
+            dead[n] = true;
+            for(auto k = firstOperand[n]; k < firstOperand[n + 1]; k++)
+            {
+                if(ids[k] >= 0)
+                {
+                    uses[ids[k]]--;
+                    work.push_back(ids[k]);
+                }
+            }
+            changed = true;
+        };
+        while(!work.empty())
+        {
+            auto v = work.back();
+            work.pop_back();
+            auto &place = values[v];
+            if(dead[firstInst[place.first] + place.second])
+            {
+                continue;
+            }
+            auto &inst = function.blocks[place.first].insts[place.second];
+            if(inst.op == IROp::ALLOCA && uses[v] == (long)(firstStore[v + 1] - firstStore[v]))
+            {
+                for(auto s = firstStore[v]; s < firstStore[v + 1]; s++)
+                {
+                    kill(stores[s].first, stores[s].second);
+                }
+                kill(place.first, place.second);
+            }
+            else if(inst.op != IROp::ALLOCA && pure(inst) && uses[v] == 0)
+            {
+                kill(place.first, place.second);
+            }
+        }
+
+        for(size_t b = 0; changed && b < function.blocks.size(); b++)
+        {
+            auto &insts = function.blocks[b].insts;
+            size_t kept = 0;
+            for(size_t i = 0; i < insts.size(); i++)
+            {
+                if(!dead[firstInst[b] + i])
+                {
+                    if(kept != i)
+                    {
+                        insts[kept] = std::move(insts[i]);
+                    }
+                    kept++;
+                }
+            }
+            insts.erase(insts.begin() + kept, insts.end());
+        }
+        return changed;
+    }
+}
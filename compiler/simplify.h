@@ -0,0 +1,57 @@
+#ifndef SIMPLIFY_H_
+#define SIMPLIFY_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "ir.h"
+
+namespace ycc
+{
+    /*
+     * Simplification of the control flow graph of every method, before the
+     * inliner. The generator opens a block for whatever follows a return,
+     * break or continue and jumps to the end of an if even from a branch
+     * that returned. Until nothing changes: branches on constants
+     * become jumps, blocks the entry does not reach are removed, jumps to
+     * a block that only jumps on go straight to its target, a block that
+     * is the only successor of its only predecessor is merged into it. At
+     * last values nobody uses and stack slots that are never loaded go.
+     */
+    class CFGSimplifier
+    {
+      public:
+        CFGSimplifier();
+
+        void                run(std::vector<IRFunction> &functions);
+        long                blocksRemoved() const;
+        long                instructionsRemoved() const;
+
+      private:
+        void                simplify(IRFunction &function);
+        bool                foldBranches(IRFunction &function);
+        bool                removeUnreachable(IRFunction &function);
+        bool                foldJumps(IRFunction &function);
+        bool                mergeBlocks(IRFunction &function);
+        bool                removeDeadCode(IRFunction &function);
+        void                graph(const IRFunction &function);
+
+      private:
+        long                                            blocksRemoved_;
+        long                                            instructionsRemoved_;
+        std::map<std::string, size_t>                   index_;     // blocks by label
+        std::vector<std::vector<size_t>>                preds_;     // one per edge
+    };
+
+    inline long CFGSimplifier::blocksRemoved() const
+    {
+        return blocksRemoved_;
+    }
+
+    inline long CFGSimplifier::instructionsRemoved() const
+    {
+        return instructionsRemoved_;
+    }
+}
+
+#endif
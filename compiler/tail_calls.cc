@@ -0,0 +1,186 @@
+#include "tail_calls.h"
+
+namespace ycc
+{
+    TailCalls::TailCalls()
+        : eliminated_(0),marked_(0)
+    {
+    }
+
+    void TailCalls::eliminate(std::vector<IRFunction> &functions)
+    {
+        for(auto &function : functions)
+        {
+            eliminate(function);
+        }
+    }
+
+    void TailCalls::mark(std::vector<IRFunction> &functions)
+    {
+        std::map<std::string, const IRFunction *> callees;
+        for(auto &function : functions)
+        {
+            callees[function.name] = &function;
+        }
+        for(auto &function : functions)
+        {
+            mark(function, callees);
+        }
+    }
+
+    // a call and the return of its value, or of nothing after a void call
+    bool TailCalls::tailCall(const IRBlock &block)
+    {
+        auto &insts = block.insts;
+        if(insts.size() < 2 || insts.back().op != IROp::RET || insts[insts.size() - 2].op != IROp::CALL)
+        {
+            return false;
+        }
+        auto &call = insts[insts.size() - 2];
+        auto &ret = insts.back();
+        if(call.result.empty())
+        {
+            return ret.operands.empty();
+        }
+        return ret.operands.size() == 1 && ret.operands[0].name == call.result;
+    }
+
+    void TailCalls::eliminate(IRFunction &function)
+    {
+        std::vector<size_t> sites;
+        for(size_t b = 0; b < function.blocks.size(); b++)
+        {
+            auto &block = function.blocks[b];
+            if(tailCall(block) && block.insts[block.insts.size() - 2].opcode == function.name)
+            {
+                sites.push_back(b);
+            }
+        }
+        if(sites.empty())
+        {
+            return ;
+        }
+
+        // the entry keeps its allocas and jumps to the rest of itself
+        const std::string loop = "tailrecurse";
+        auto &entry = function.blocks[0];
+        size_t allocas = 0;
+        while(allocas < entry.insts.size() && entry.insts[allocas].op == IROp::ALLOCA)
+        {
+            allocas++;
+        }
+        IRBlock header{loop, {}};
+        header.insts.assign(std::make_move_iterator(entry.insts.begin() + allocas),
+                            std::make_move_iterator(entry.insts.end()));
+        entry.insts.erase(entry.insts.begin() + allocas, entry.insts.end());
+        entry.insts.push_back(IRInst{IROp::BR, "", "void", "", {IRValue{"label", loop}}});
+        auto entryLabel = entry.label;
+        function.blocks.insert(function.blocks.begin() + 1, std::move(header));
+        for(auto &b : sites)
+        {
+            b++;
+        }
+
+        // parameters are phis of the header, uses of them use the phis;
+        // the successors of the old entry are now reached from the header
+        std::map<std::string, std::string> renamed;
+        for(auto &param : function.params)
+        {
+            renamed[param.name] = param.name + ".tr";
+        }
+        for(auto &block : function.blocks)
+        {
+            for(auto &inst : block.insts)
+            {
+                for(auto &operand : inst.operands)
+                {
+                    auto iter = renamed.find(operand.name);
+                    if(operand.type != "label" && iter != renamed.end())
+                    {
+                        operand.name = iter->second;
+                    }
+                    else if(inst.op == IROp::PHI && operand.type == "label" && operand.name == entryLabel)
+                    {
+                        operand.name = loop;
+                    }
+                }
+            }
+        }
+        std::vector<IRInst> phis;
+        for(auto &param : function.params)
+        {
+            phis.push_back(IRInst{IROp::PHI, renamed[param.name], param.type, "",
+                                  {param, IRValue{"label", entryLabel}}});
+        }
+        for(auto b : sites)
+        {
+            auto &block = function.blocks[b];
+            auto call = std::move(block.insts[block.insts.size() - 2]);
+            block.insts.resize(block.insts.size() - 2);
+            block.insts.push_back(IRInst{IROp::BR, "", "void", "", {IRValue{"label", loop}}});
+            for(size_t i = 0; i < phis.size(); i++)
+            {
+                phis[i].operands.push_back(call.operands[i]);
+                phis[i].operands.push_back(IRValue{"label", block.label});
+            }
+            eliminated_++;
+        }
+        auto &insts = function.blocks[1].insts;
+        insts.insert(insts.begin(), std::make_move_iterator(phis.begin()), std::make_move_iterator(phis.end()));
+    }
+
+    void TailCalls::mark(IRFunction &function, const std::map<std::string, const IRFunction *> &callees)
+    {
+        // allocas and the values that may point into them
+        std::set<std::string> frame;
+        bool changed = true;
+        while(changed)
+        {
+            changed = false;
+            for(auto &block : function.blocks)
+            {
+                for(auto &inst : block.insts)
+                {
+                    bool derived = inst.op == IROp::GEP || inst.op == IROp::CAST || inst.op == IROp::PHI
+                                || inst.op == IROp::SELECT;
+                    bool points = inst.op == IROp::ALLOCA;
+                    for(size_t i = 0; derived && !points && i < inst.operands.size(); i++)
+                    {
+                        points = frame.count(inst.operands[i].name) > 0;
+                    }
+                    if(points && frame.insert(inst.result).second)
+                    {
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        for(auto &block : function.blocks)
+        {
+            if(!tailCall(block))
+            {
+                continue;
+            }
+            auto &call = block.insts[block.insts.size() - 2];
+            bool local = false;
+            for(auto &operand : call.operands)
+            {
+                local = local || frame.count(operand.name);
+            }
+            if(local)
+            {
+                continue;
+            }
+            auto callee = callees.find(call.opcode);
+            bool same = callee != callees.end() && callee->second->returnType == function.returnType
+                     && callee->second->params.size() == function.params.size();
+            for(size_t i = 0; same && i < function.params.size(); i++)
+            {
+                same = callee->second->params[i].type == function.params[i].type;
+            }
+            call.tail = same ? IRTail::MUSTTAIL : IRTail::TAIL;
+            marked_++;
+        }
+    }
+}
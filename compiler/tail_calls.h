@@ -0,0 +1,54 @@
+#ifndef TAIL_CALLS_H_
+#define TAIL_CALLS_H_
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "ir.h"
+
+namespace ycc
+{
+    /*
+     * Calls in tail position: a call whose block then returns what it
+     * returned. Before the inliner, a method that calls itself there is
+     * turned into a loop: everything of its entry block but the allocas
+     * moves to a block the tail calls jump back to, where a phi per
+     * parameter takes the arguments of the call, so deep recursion no
+     * longer takes a frame per level and the method may be inlined. After
+     * the last pass, the tail calls left are marked tail, or musttail when
+     * caller and callee have the same prototype, unless an argument points
+     * into the frame of the caller.
+     */
+    class TailCalls
+    {
+      public:
+        TailCalls();
+
+        void                eliminate(std::vector<IRFunction> &functions);
+        void                mark(std::vector<IRFunction> &functions);
+        long                eliminated() const;
+        long                marked() const;
+
+      private:
+        void                eliminate(IRFunction &function);
+        void                mark(IRFunction &function, const std::map<std::string, const IRFunction *> &callees);
+        static bool         tailCall(const IRBlock &block);
+
+      private:
+        long                eliminated_;
+        long                marked_;
+    };
+
+    inline long TailCalls::eliminated() const
+    {
+        return eliminated_;
+    }
+
+    inline long TailCalls::marked() const
+    {
+        return marked_;
+    }
+}
+
+#endif
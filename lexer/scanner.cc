@@ -8,7 +8,8 @@ namespace ycc
 
     Scanner::Scanner(const std::string &srcFileName)
         : filename_(srcFileName), line_(1), column_(0),
-            currentChar_(0), state_(State::NONE)
+            currentChar_(0), state_(State::NONE),
+            dictionary_(Dictionary::getInstance()), next_(0)
     {
         input_.open(filename_, std::ios::in);
 
@@ -136,8 +137,45 @@ namespace ycc
 
 
 
+    // lex the whole file ahead, getNextToken then replays the tokens
+    long Scanner::tokenize()
+    {
+        std::vector<std::pair<Token, TokenLocation>> tokens;
+        do
+        {
+            getNextToken();
+            tokens.push_back(std::make_pair(token_, loc_));
+        } while(token_.tag() != TokenTag::END_OF_FILE);
+
+        tokens_.swap(tokens);
+        next_ = 0;
+        return tokens_.size();
+    }
+
+    // the token after the current one, the rest of the file is lexed ahead
+    const Token & Scanner::peekToken()
+    {
+        if(tokens_.empty())
+        {
+            auto current = std::make_pair(token_, loc_);
+            tokenize();
+            token_ = current.first;
+            loc_ = current.second;
+        }
+        return tokens_[next_].first;
+    }
+
     Token Scanner::getNextToken()
     {
+        if(!tokens_.empty())
+        {
+            // the last token is EOF, it repeats
+            auto &token = tokens_[next_ + 1 < tokens_.size() ? next_++ : next_];
+            token_ = token.first;
+            loc_ = token.second;
+            return token_;
+        }
+
         bool matched = false;
 
         while(!matched)
@@ -225,7 +263,7 @@ namespace ycc
         } // end while, currentChar is the end of the identifier
 
         // keyword or not
-        auto tokenTag = dictionary_.lookup(buffer_);
+        auto tokenTag = dictionary_->lookup(buffer_);
         if(tokenTag == TokenTag::UNRESERVED)
         {
             tokenTag = TokenTag::IDENTIFIER;
@@ -560,7 +598,7 @@ namespace ycc
         while(!input_.eof())
         {
             addToBuffer(peekChar());        // add next one symbol char
-            if(!dictionary_.has(buffer_))
+            if(!dictionary_->has(buffer_))
             {
                 reduceBuffer();
                 break;
@@ -571,7 +609,7 @@ namespace ycc
             }
         } // end while, currentChar is the final char of the symbol
 
-        auto tokenTag = dictionary_.lookup(buffer_);
+        auto tokenTag = dictionary_->lookup(buffer_);
         makeToken(buffer_, tokenTag);
     }
 
@@ -3,6 +3,7 @@
 
 #include <fstream>
 #include <string>
+#include <vector>
 #include "token.h"
 #include "../common/error.h"
 
@@ -24,7 +25,9 @@ namespace ycc
         explicit        Scanner(const std::string &filename);
         const Token &   getToken() const;
         Token           getNextToken();
+        const Token &   peekToken();
         TokenLocation   getTokenLocation() const;
+        long            tokenize();
 
         static bool     getErrorFlag();
         static void     setErrorFlag(bool flag);
@@ -67,8 +70,11 @@ namespace ycc
         char            currentChar_;
         State           state_;
         Token           token_;
-        Dictionary      dictionary_;
+        const Dictionary *  dictionary_;
         std::string     buffer_;
+        // tokens lexed ahead by tokenize()
+        std::vector<std::pair<Token, TokenLocation>>    tokens_;
+        size_t          next_;
         // error flag
         static bool     errorFlag_;
         // temp value
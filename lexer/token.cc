@@ -38,6 +38,18 @@ namespace ycc
     }
 
 
+    Dictionary * Dictionary::instance_ = nullptr;
+
+    // keyword table shared by all scanners
+    const Dictionary * Dictionary::getInstance()
+    {
+        if(instance_ == nullptr)
+        {
+            instance_ = new Dictionary();
+        }
+        return instance_;
+    }
+
     Dictionary::Dictionary()
     {
         // Keyword
@@ -131,14 +131,17 @@ namespace ycc
     class Dictionary
     {
     public:
-        Dictionary();
+        static const Dictionary *   getInstance();
         TokenTag    lookup(const std::string &lexeme) const;
         bool        has(const std::string &lexeme) const;
     private:
+        Dictionary();
         void        add(std::string lexeme, TokenTag);
 
     private:
         std::map<std::string, TokenTag> dictionary_;
+
+        static Dictionary *         instance_;
     };
 
 }
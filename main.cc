@@ -3,7 +3,25 @@
 #include "./compiler/depth_vistor.h"
 #include "./compiler/compiler_vistor.h"
 #include "./compiler/IRGenerator.h"
+#include "./compiler/inliner.h"
+#include "./compiler/escape.h"
+#include "./compiler/simplify.h"
+#include "./compiler/licm.h"
+#include "./compiler/counted_loops.h"
+#include "./compiler/tail_calls.h"
+#include "./compiler/gvn.h"
+#include "./compiler/profile.h"
+#include "./compiler/native_backend.h"
+#include "./compiler/jit.h"
+#include "./common/compile_cache.h"
+#include "./common/compile_stats.h"
+#include "./common/trace.h"
+#include "./server/compile_server.h"
 #include "./main.hpp"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <dirent.h>
 
 using namespace ycc;
 
@@ -13,10 +31,107 @@ using std::cerr;
 using std::endl;
 using std::string;
 
-int main(int argc, char *argv[])
+// --time-report and --stats output
+void reportStats()
 {
-    init(argc, argv);
+    auto stats = CompileStats::getInstance();
+    if(checkOption(OpTag::TIME_REPORT))
+    {
+        stats->report(srcFileName);
+    }
+    if(checkOption(OpTag::STATS))
+    {
+        auto statsFileName = getOptionValue(OpTag::STATS);
+        if(statsFileName.empty())
+        {
+            stats->reportJson(srcFileName);
+        }
+        else
+        {
+            std::ofstream output(statsFileName);
+            stats->reportJson(srcFileName, output);
+        }
+    }
+}
+
+// the module through the LLVM backend to an object, assembly or executable
+int emitNative(const std::string &module)
+{
+    auto stats = CompileStats::getInstance();
+    NativeBackend backend(llvmOptLevel());
+    auto outputName = nativeOutputName();
+    bool link = !checkOption(OpTag::COMPILE) && !checkOption(OpTag::ASM);
+    auto fileName = link ? outputName + ".o" : outputName;
+    std::string error;
+    stats->beginPhase("LLVM parse");
+    bool ok = backend.parse(module, error);
+    stats->endPhase();
+    if(ok)
+    {
+        stats->beginPhase("LLVM optimize");
+        ok = backend.optimize(error);
+        stats->endPhase();
+    }
+    if(ok)
+    {
+        stats->beginPhase("LLVM codegen");
+        ok = backend.emit(fileName, checkOption(OpTag::ASM) ? NativeBackend::Output::ASSEMBLY
+                                                            : NativeBackend::Output::OBJECT, error);
+        stats->endPhase();
+    }
+    if(ok && link)
+    {
+        stats->beginPhase("link");
+        ok = NativeBackend::link(fileName, outputName, error);
+        stats->endPhase();
+        std::remove(fileName.c_str());
+    }
+    if(!ok)
+    {
+        cerr << "ycc: fatal error: " << error << endl;
+        return 1;
+    }
+    return 0;
+}
 
+// the module run by the JIT, the status of main is the exit status
+int runJit(const std::string &module)
+{
+    auto stats = CompileStats::getInstance();
+    Jit jit(llvmOptLevel(), getOptionValue(OpTag::JIT) == "lazy");
+    std::string error;
+    int status = 0;
+    stats->beginPhase("JIT parse");
+    bool ok = jit.add(module, error);
+    stats->endPhase();
+    if(ok)
+    {
+        // lazily only the stubs, the methods are compiled while running
+        stats->beginPhase("JIT compile");
+        ok = jit.compile(error);
+        stats->endPhase();
+    }
+    if(ok)
+    {
+        // the program writes to the same stdout
+        cout.flush();
+        stats->beginPhase("run");
+        ok = jit.run(status, error);
+        stats->endPhase();
+    }
+    stats->setCounter("methods compiled", jit.methodsCompiled());
+    stats->setCounter("JIT compile us", jit.compileMicroseconds());
+    if(!ok)
+    {
+        cerr << "ycc: fatal error: " << error << endl;
+        return 1;
+    }
+    return status;
+}
+
+// compile with the options given to init()
+int compile()
+{
     if(checkOption(OpTag::VER_INFO))
     {
         cout << APPNAME << " " << VERSION << endl;
@@ -55,12 +170,97 @@ int main(int argc, char *argv[])
         return 0;
     }
 
+    std::string irFileName = irOutputName();
+
+    auto stats = CompileStats::getInstance();
+    bool measure = checkOption(OpTag::TIME_REPORT) || checkOption(OpTag::STATS);
+    CompileStats::countAllocations(measure);
+
+    // reuse the result of an unchanged file; dumps need the real pipeline
+    StreamCapture warnings(cerr);
+    CompileCache *cache = nullptr;
+    std::string cacheKey;
+    if(checkOption(OpTag::CACHE) && !checkOption(OpTag::DUMP_AST)
+        && !checkOption(OpTag::DUMP_SYMBOL_TABLE))
+    {
+        long cacheSize = getIntOption(OpTag::CACHE_SIZE, 64, 0, LONG_MAX >> 20);
+        cache = new CompileCache(getOptionValue(OpTag::CACHE, ".ycc-cache"), cacheSize << 20);
+        cacheKey = cache->key(srcFileName, cacheSalt());
+
+        CacheEntry entry;
+        if(cache->lookup(cacheKey, entry))
+        {
+            // the report of a hit has this phase alone and counts nothing
+            stats->beginPhase("cache hit");
+            cout << "load " << srcFileName << " from cache..." << endl;
+            if(entry.status == 0 && !nativeOutput())
+            {
+                std::ofstream output(irFileName, std::ios::out | std::ios::binary);
+                output << entry.ir;
+            }
+            cout << entry.report << entry.diagnostics;
+            cerr << entry.warnings;
+            stats->endPhase();
+            if(checkOption(OpTag::CACHE_STATS))
+            {
+                cache->dumpStats();
+            }
+            int status = entry.status;
+            if(entry.status == 0 && nativeOutput())
+            {
+                status = checkOption(OpTag::JIT) ? runJit(entry.ir) : emitNative(entry.ir);
+            }
+            reportStats();
+            return status;
+        }
+    }
+
     cout << "\n  --  ycc compiler  --  \n" << endl;
     cout << "parse file " << srcFileName << " begin..." << endl;
     Scanner scanner(srcFileName);
+    if(measure)
+    {
+        // lex ahead, so lexing and parsing are measured apart
+        stats->beginPhase("lex");
+        stats->setCounter("tokens", scanner.tokenize());
+        stats->endPhase();
+    }
+    stats->beginPhase("parse");
     Parser parser(scanner);
     auto ast = parser.parse();
+    stats->endPhase();
     cout << "parse file " << srcFileName << " end..." << endl;
+    if(Scanner::getErrorFlag() || Parser::getErrorFlag())
+    {
+        // the semantic check needs a well-formed tree
+        std::ostringstream diagnostics;
+        ExceptionHandler::getInstance()->report(diagnostics);
+        cout << diagnostics.str();
+        if(cache)
+        {
+            cache->store(cacheKey, CacheEntry{1, "", diagnostics.str(), warnings.text()});
+        }
+        cout << "exit.." << endl;
+        reportStats();
+        return 1;
+    }
+
+    if(measure)
+    {
+        std::map<std::string, long> kinds;
+        DepthVistor counter(&kinds);
+        counter.visit(ast);
+        long nodes = 0;
+        for(auto &kind : kinds)
+        {
+            nodes += kind.second;
+        }
+        stats->setCounter("ast nodes", nodes);
+        for(auto &kind : kinds)
+        {
+            stats->setCounter("ast nodes." + kind.first, kind.second);
+        }
+    }
 
 
     if(checkOption(OpTag::DUMP_AST))
@@ -71,28 +271,304 @@ int main(int argc, char *argv[])
         cout << "print ast end..." << endl;
     }
 
+    int jobs = getIntOption(OpTag::JOBS, 1);
+
     cout << "semantic analyzed begin..." << endl;
     auto compilerVistor = new CompilerVistor();
-    if(compilerVistor->check(ast))
+    compilerVistor->setJobs(jobs);
+    stats->beginPhase("semantic");
+    bool failed = compilerVistor->check(ast);
+    stats->endPhase();
+    stats->setCounter("symbols", SymbolTable::getInstance()->symbolCount());
+    if(failed)
     {
-        ExceptionHandler::getInstance()->report();
+        std::ostringstream diagnostics;
+        ExceptionHandler::getInstance()->report(diagnostics);
+        cout << diagnostics.str();
+        if(cache)
+        {
+            cache->store(cacheKey, CacheEntry{1, "", diagnostics.str(), warnings.text()});
+        }
         cout << "exit.." << endl;
-        exit(1);
+        reportStats();
+        return 1;
     }
 
     cout << "semantic analyzed end..." << endl;
     cout << "generate IR begin..." << endl;
-    auto IRgenerator = new IRGenerator("ycc.ll");
-    IRgenerator->gene(ast);
+    SymbolTable::getInstance()->layoutClasses(getOptionValue(OpTag::FIELD_LAYOUT, "packed") == "hot");
+    auto IRgenerator = new IRGenerator(irFileName);
+    IRgenerator->setJobs(jobs);
+    // the backend reads bitcode faster than text
+    IRgenerator->setBitcode(checkOption(OpTag::EMIT_BC) || nativeOutput());
+    // the backend links the precompiled api modules, to inline and specialize their calls
+    IRgenerator->setLinkApi(nativeOutput());
+    stats->beginPhase("IR generation");
+    IRgenerator->generate(ast);
+    stats->endPhase();
+    // before the inliner, so the cost of a method is what is left of it
+    stats->beginPhase("simplify CFG");
+    CFGSimplifier simplifier;
+    simplifier.run(IRgenerator->functions());
+    stats->endPhase();
+    stats->setCounter("blocks removed", simplifier.blocksRemoved());
+    stats->setCounter("instructions removed", simplifier.instructionsRemoved());
+    // on the IR the inliner starts from, the same in the instrumented and the optimized build
+    Profile profile;
+    if(checkOption(OpTag::INSTRUMENT))
+    {
+        if(checkOption(OpTag::PROFILE_USE))
+        {
+            cerr << "ycc: warning: --profile-use is ignored with --instrument" << endl;
+        }
+        stats->beginPhase("instrument");
+        profile.instrument(IRgenerator->functions());
+        IRgenerator->addRuntime(profile.runtime(getOptionValue(OpTag::INSTRUMENT, "ycc.profile")));
+        stats->endPhase();
+        stats->setCounter("profile counters", profile.counters());
+    }
+    else if(checkOption(OpTag::PROFILE_USE))
+    {
+        stats->beginPhase("profile use");
+        std::string error;
+        if(profile.load(getOptionValue(OpTag::PROFILE_USE, "ycc.profile"), error))
+        {
+            profile.apply(IRgenerator->functions());
+            for(auto &method : profile.stale())
+            {
+                cerr << "ycc: warning: no matching profile of " << method << ", its counts are ignored" << endl;
+            }
+        }
+        else
+        {
+            cerr << "ycc: warning: " << error << ", compiling without it" << endl;
+        }
+        stats->endPhase();
+        stats->setCounter("profiled methods", profile.profiled());
+        stats->setCounter("branches weighted", profile.branchesWeighted());
+        stats->setCounter("switches reordered", profile.switchesOrdered());
+        stats->setCounter("cold blocks moved", profile.blocksMoved());
+    }
+    // a method that no longer calls itself may be inlined
+    stats->beginPhase("tail recursion");
+    TailCalls tailCalls;
+    tailCalls.eliminate(IRgenerator->functions());
+    stats->endPhase();
+    stats->setCounter("tail recursions eliminated", tailCalls.eliminated());
+    int threshold = getIntOption(OpTag::INLINE_THRESHOLD, 40, 0, INT_MAX / 4);
+    if(threshold > 0)
+    {
+        stats->beginPhase("inline");
+        Inliner inliner(threshold);
+        inliner.setProfile(checkOption(OpTag::PROFILE_USE) && !checkOption(OpTag::INSTRUMENT) ? &profile : nullptr);
+        inliner.run(IRgenerator->functions());
+        stats->endPhase();
+        stats->setCounter("method calls", inliner.calls());
+        stats->setCounter("calls inlined", inliner.inlined());
+        if(checkOption(OpTag::PROFILE_USE))
+        {
+            stats->setCounter("cold calls kept", inliner.coldCalls());
+        }
+    }
+    stats->beginPhase("escape analysis");
+    EscapeAnalysis escape;
+    escape.run(IRgenerator->functions());
+    stats->endPhase();
+    stats->setCounter("objects allocated", escape.allocations());
+    stats->setCounter("objects on the stack", escape.onStack());
+    // before value numbering, which then merges what the loops of a nest hoisted
+    stats->beginPhase("loop invariant code motion");
+    LoopInvariantMotion motion;
+    motion.run(IRgenerator->functions());
+    stats->endPhase();
+    stats->setCounter("preheaders added", motion.preheadersAdded());
+    stats->setCounter("instructions hoisted", motion.instructionsHoisted());
+    stats->beginPhase("counted loops");
+    CountedLoops counted(checkOption(OpTag::UNROLL) ? getIntOption(OpTag::UNROLL, 4, 0, 256) : 0);
+    counted.run(IRgenerator->functions());
+    stats->endPhase();
+    stats->setCounter("induction variables", counted.inductionVariables());
+    stats->setCounter("strength reduced", counted.reduced());
+    stats->setCounter("loops unrolled", counted.unrolled());
+    // kept for a cache hit, which does not run the passes
+    std::ostringstream report;
+    if(checkOption(OpTag::UNROLL))
+    {
+        for(auto &line : counted.report())
+        {
+            report << "counted loop " << line << "\n";
+        }
+    }
+    cout << report.str();
+    stats->beginPhase("value numbering");
+    ValueNumbering numbering;
+    numbering.run(IRgenerator->functions());
+    stats->endPhase();
+    stats->setCounter("redundant values", numbering.redundantValues());
+    stats->setCounter("redundant loads", numbering.redundantLoads());
+    // last, the inliner would put a call in tail position before a jump
+    tailCalls.mark(IRgenerator->functions());
+    stats->setCounter("tail calls marked", tailCalls.marked());
+    stats->beginPhase("dump IR");
+    std::ostringstream module;
+    if(nativeOutput())
+    {
+        IRgenerator->write(module);
+    }
+    else
+    {
+        IRgenerator->write();
+    }
+    stats->endPhase();
+    stats->setCounter("IR instructions", IRgenerator->instructions());
+    stats->setCounter("IR bytes", IRgenerator->bytes());
     cout << "generate IR end..." << endl;
 
+    std::ostringstream diagnostics;
+    ExceptionHandler::getInstance()->report(diagnostics);
+    if(cache)
+    {
+        std::ostringstream ir;
+        if(!nativeOutput())
+        {
+            std::ifstream input(irFileName, std::ios::in | std::ios::binary);
+            ir << input.rdbuf();
+        }
+        cache->store(cacheKey, CacheEntry{0, nativeOutput() ? module.str() : ir.str(),
+                                          diagnostics.str(), warnings.text(), report.str()});
+    }
+
 
     if(checkOption(OpTag::DUMP_SYMBOL_TABLE))
     {
         SymbolTable::getInstance()->dump();
     }
 
-    ExceptionHandler::getInstance()->report();
+    cout << diagnostics.str();
+    if(cache && checkOption(OpTag::CACHE_STATS))
+    {
+        cache->dumpStats();
+    }
+    int status = !nativeOutput() ? 0 : checkOption(OpTag::JIT) ? runJit(module.str()) : emitNative(module.str());
+    reportStats();
 
-    return 0;
+    return status;
+}
+
+// compile, and trace it if asked for
+int compileTraced()
+{
+    if(!checkOption(OpTag::TRACE))
+    {
+        return compile();
+    }
+    Tracer::start();
+    int status = compile();
+    auto traceFileName = getOptionValue(OpTag::TRACE, "ycc.trace.json");
+    if(!Tracer::stop(traceFileName))
+    {
+        cerr << "ycc: warning: can not write trace " << traceFileName << endl;
+    }
+    return status;
+}
+
+// one request of the compile server, in a child of the server process
+int compileRequest(const std::vector<std::string> &args)
+{
+    std::vector<char *> argv;
+    argv.push_back(const_cast<char *>(APPNAME.c_str()));
+    for(auto &arg : args)
+    {
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    resetOptions();
+    init(args.size() + 1, argv.data());
+    if(errorFlag)
+    {
+        return 1;
+    }
+    return compileTraced();
+}
+
+// warm up the state every compilation starts from: keyword table,
+// built-in types and the interface and IR of every api module in apiDir
+void warmUp(const std::string &apiDir)
+{
+    Dictionary::getInstance();
+    SymbolTable::reset();
+    SymbolTable::getInstance();
+    if(DIR *dir = opendir(apiDir.c_str()))
+    {
+        while(auto ent = readdir(dir))
+        {
+            std::string name = ent->d_name;
+            if(name.size() > 4 && name.substr(name.size() - 4) == ".ycc")
+            {
+                Parser::loadModule(name.substr(0, name.size() - 4), apiDir);
+            }
+        }
+        closedir(dir);
+    }
+}
+
+int serve()
+{
+
+    auto socketPath = getOptionValue(OpTag::SERVER, CompileServer::defaultSocketPath());
+    // the options of a request are parsed in its child, only the name of its output is needed here;
+    // a report of the compilation (--stats, --trace, --time-report) is made by a child every time
+    auto irFileName = [](const std::vector<std::string> &args)
+    {
+        bool bitcode = false;
+        for(auto &arg : args)
+        {
+            if(arg == "-c" || arg == "-S" || arg == "--asm" || arg == "-o" || arg.compare(0, 8, "--output") == 0
+                || (arg.size() == 3 && arg.compare(0, 2, "-O") == 0) || arg.compare(0, 5, "--jit") == 0
+                || arg.compare(0, 7, "--stats") == 0 || arg.compare(0, 7, "--trace") == 0 || arg == "--time-report")
+            {
+                return std::string();
+            }
+            bitcode = bitcode || arg == "--emit-bc";
+        }
+        return std::string(bitcode ? "ycc.bc" : "ycc.ll");
+    };
+    CompileServer server(socketPath, irFileName, compileRequest, warmUp);
+    return server.run();
+}
+
+int main(int argc, char *argv[])
+{
+    init(argc, argv);
+    if(errorFlag)
+    {
+        return 1;
+    }
+
+    if(checkOption(OpTag::SERVER))
+    {
+        return serve();
+    }
+    if(checkOption(OpTag::CLIENT))
+    {
+        std::vector<std::string> args;
+        for(int i = 1; i < argc; i++)
+        {
+            if(std::string(argv[i]).compare(0, 8, "--client") != 0)
+            {
+                args.push_back(argv[i]);
+            }
+        }
+        auto socketPath = getOptionValue(OpTag::CLIENT, CompileServer::defaultSocketPath());
+        int status = runClient(socketPath, args);
+        if(status >= 0)
+        {
+            return status;
+        }
+        cerr << "ycc: warning: no compile server on " << socketPath
+             << ", compile locally" << endl;
+    }
+
+    return compileTraced();
 }
@@ -3,9 +3,15 @@
 
 #include <iostream>
 #include <iomanip>
+#include <fstream>
+#include <sstream>
 #include <map>
 #include <vector>
 #include <bitset>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 
 // version info
 const std::string APPNAME = "ycc";
@@ -21,12 +27,31 @@ enum OpTag
     DUMP_AST,               // dump ast
     DUMP_IR,                // dump ir list
     DUMP_SYMBOL_TABLE,      // dump symbol table
-    OUTPUT                  // output file name
+    OUTPUT,                 // output file name
+    JOBS,                   // -j <n> worker threads for method bodies
+    CACHE,                  // --cache[=<dir>] reuse results of unchanged files
+    CACHE_SIZE,             // --cache-size=<MB> limit of the cache
+    CACHE_STATS,            // print cache statistics
+    SERVER,                 // --server[=<socket>] run as compile server
+    CLIENT,                 // --client[=<socket>] forward to compile server
+    TIME_REPORT,            // print time and memory of every phase
+    STATS,                  // --stats[=<file>] phases and counters as json
+    TRACE,                  // --trace=<file> chrome trace of phases and methods
+    INLINE_THRESHOLD,       // --inline-threshold=<n> largest method to inline
+    FIELD_LAYOUT,           // --field-layout=<packed|hot> order of the fields of objects
+    UNROLL,                 // --unroll[=<n>] unroll counted loops n times
+    EMIT_BC,                // --emit-bc write LLVM bitcode to ycc.bc
+    COMPILE,                // -c object file of the LLVM backend
+    OPT_LEVEL,              // -O<n> passes of LLVM at level n
+    JIT,                    // --jit[=lazy] run main in process
+    INSTRUMENT,             // --instrument[=<file>] count blocks and branches into a profile
+    PROFILE_USE             // --profile-use[=<file>] optimize with the counts of a profile
 };
 
 std::map<std::string, OpTag>            opMap;
 std::map<std::string, std::string>      manuals;
 std::bitset<32>                         options(0);
+std::map<OpTag, std::string>            opValues;
 std::string                             srcFileName = "";
 std::string                             dstFileName = "a.out";
 bool                                    errorFlag = false;
@@ -37,7 +62,7 @@ void manualReport()
     std::cout << "where possible options include :\n";
     for(auto elem : manuals)
     {
-        std::cout << std::left << "  " << std::setw(26) << elem.first
+        std::cout << std::left << "  " << std::setw(30) << elem.first
              << std::setw(60) << elem.second << std::endl;
     }
     std::cout << std::endl;
@@ -53,6 +78,119 @@ bool checkOption(OpTag op)
     return options.test(op);
 }
 
+std::string getOptionValue(OpTag op, const std::string &defaultValue = "")
+{
+    auto iter = opValues.find(op);
+    if(iter == opValues.end() || iter->second == "")
+    {
+        return defaultValue;
+    }
+    return iter->second;
+}
+
+void errorReport(const std::string &msg);
+
+// value of a numeric option, a value that is no number in
+// [minValue, maxValue] is a usage error and gives the default
+long getIntOption(OpTag op, long defaultValue, long minValue = 0, long maxValue = LONG_MAX)
+{
+    auto value = getOptionValue(op);
+    if(value == "")
+    {
+        return defaultValue;
+    }
+    char *end = nullptr;
+    errno = 0;
+    long number = std::strtol(value.c_str(), &end, 10);
+    if(*end != '\0' || errno == ERANGE || number < minValue || number > maxValue)
+    {
+        // the long name of the option
+        std::string name;
+        for(auto &elem : opMap)
+        {
+            if(elem.second == op && elem.first.size() > name.size())
+            {
+                name = elem.first;
+            }
+        }
+        errorReport("invalid value '" + value + "' of " + name + ", expected a number of at least "
+                    + std::to_string(minValue) + (maxValue < LONG_MAX ? " and at most " + std::to_string(maxValue) : ""));
+        return defaultValue;
+    }
+    return number;
+}
+
+// options that change the generated code, part of the cache key
+std::string cacheSalt()
+{
+    auto salient = options;
+    salient.reset(OpTag::JOBS);
+    salient.reset(OpTag::CACHE);
+    salient.reset(OpTag::CACHE_SIZE);
+    salient.reset(OpTag::CACHE_STATS);
+    salient.reset(OpTag::TIME_REPORT);
+    salient.reset(OpTag::STATS);
+    salient.reset(OpTag::TRACE);
+    // the counts of a profile change the code as the source does
+    std::ostringstream profile;
+    if(checkOption(OpTag::PROFILE_USE))
+    {
+        std::ifstream input(getOptionValue(OpTag::PROFILE_USE, "ycc.profile"), std::ios::in | std::ios::binary);
+        profile << input.rdbuf();
+    }
+    return APPNAME + " " + VERSION + " " + salient.to_string()
+         + " inline=" + getOptionValue(OpTag::INLINE_THRESHOLD)
+         + " layout=" + getOptionValue(OpTag::FIELD_LAYOUT)
+         + " unroll=" + getOptionValue(OpTag::UNROLL)
+         + " instrument=" + getOptionValue(OpTag::INSTRUMENT)
+         + " profile=" + profile.str();
+}
+
+// file the IR is written to
+std::string irOutputName()
+{
+    return checkOption(OpTag::EMIT_BC) ? "ycc.bc" : "ycc.ll";
+}
+
+// the LLVM backend instead of writing the IR: an object, assembly, executable or a run of the JIT
+bool nativeOutput()
+{
+    return checkOption(OpTag::COMPILE) || checkOption(OpTag::ASM) || checkOption(OpTag::OUTPUT)
+        || checkOption(OpTag::OPT_LEVEL) || checkOption(OpTag::JIT);
+}
+
+// -O<n>, or -1 for none
+int llvmOptLevel()
+{
+    return checkOption(OpTag::OPT_LEVEL) ? getIntOption(OpTag::OPT_LEVEL, 2) : -1;
+}
+
+// -o, or the source name with .o or .s in the current directory, or a.out
+std::string nativeOutputName()
+{
+    if(checkOption(OpTag::OUTPUT))
+    {
+        return getOptionValue(OpTag::OUTPUT, dstFileName);
+    }
+    if(!checkOption(OpTag::COMPILE) && !checkOption(OpTag::ASM))
+    {
+        return dstFileName;
+    }
+    auto base = srcFileName.substr(srcFileName.find_last_of('/') + 1);
+    base = base.substr(0, base.find_last_of('.'));
+    return base + (checkOption(OpTag::COMPILE) ? ".o" : ".s");
+}
+
+// forget the options of the previous compilation (compile server)
+void resetOptions()
+{
+    options.reset();
+    opValues.clear();
+    srcFileName = "";
+    dstFileName = "a.out";
+    errorFlag = false;
+}
+
 void errorReport(const std::string &msg)
 {
     std::cerr << "ycc: fatal error: " << msg << std::endl;
@@ -72,21 +210,37 @@ void commandHandle(int argc, char **argv)
     {
         if(argv[i][0] == '-')
         {
-            // option
-            auto iter = opMap.find(argv[i]);
+            // option, maybe with a value as --name=value
+            std::string name(argv[i]);
+            auto pos = name.find('=');
+            auto iter = opMap.find(name.substr(0, pos));
             if(iter == opMap.end())
             {
-                std::string msg(argv[i]);
-                errorReport("no such option" + msg);
+                errorReport("no such option " + name.substr(0, pos));
                 return ;
             }
             else
             {
+                if(pos != std::string::npos)
+                {
+                    opValues[iter->second] = name.substr(pos+1);
+                    name = name.substr(0, pos);
+                }
                 addOption(iter->second);
+                // check number of jobs
+                if(name == "-j" && i+1 < argc && std::isdigit(argv[i+1][0]))
+                {
+                    opValues[OpTag::JOBS] = argv[++i];
+                }
+                // check optimization level
+                if(iter->second == OpTag::OPT_LEVEL)
+                {
+                    opValues[OpTag::OPT_LEVEL] = name.substr(2);
+                }
                 // check output file name
                 if(argv[i][1] == 'o')
                 {
-                    if(argv[i+1][0] != '-')
+                    if(i+1 < argc && argv[i+1][0] != '-')
                     {
                         dstFileName = std::string(argv[++i]);
                     }
@@ -108,6 +262,14 @@ void commandHandle(int argc, char **argv)
             srcFileName = argv[i];
         }
     } // for
+
+    // numeric options are checked here, so a bad value stops before compiling
+    getIntOption(OpTag::JOBS, 1);
+    getIntOption(OpTag::CACHE_SIZE, 64, 0, LONG_MAX >> 20);
+    // hot call sites get four times the threshold
+    getIntOption(OpTag::INLINE_THRESHOLD, 40, 0, INT_MAX / 4);
+    // no unrolled body may grow past 256 instructions
+    getIntOption(OpTag::UNROLL, 4, 0, 256);
 }
 
 void init(int argc, char *argv[])
@@ -124,13 +286,53 @@ void init(int argc, char *argv[])
     opMap.insert(std::pair<std::string, OpTag>("--asm", OpTag::ASM));
     opMap.insert(std::pair<std::string, OpTag>("-v", OpTag::VER_INFO));
     opMap.insert(std::pair<std::string, OpTag>("--version", OpTag::VER_INFO));
+    opMap.insert(std::pair<std::string, OpTag>("-j", OpTag::JOBS));
+    opMap.insert(std::pair<std::string, OpTag>("--jobs", OpTag::JOBS));
+    opMap.insert(std::pair<std::string, OpTag>("--cache", OpTag::CACHE));
+    opMap.insert(std::pair<std::string, OpTag>("--cache-size", OpTag::CACHE_SIZE));
+    opMap.insert(std::pair<std::string, OpTag>("--cache-stats", OpTag::CACHE_STATS));
+    opMap.insert(std::pair<std::string, OpTag>("--server", OpTag::SERVER));
+    opMap.insert(std::pair<std::string, OpTag>("--client", OpTag::CLIENT));
+    opMap.insert(std::pair<std::string, OpTag>("--time-report", OpTag::TIME_REPORT));
+    opMap.insert(std::pair<std::string, OpTag>("--stats", OpTag::STATS));
+    opMap.insert(std::pair<std::string, OpTag>("--trace", OpTag::TRACE));
+    opMap.insert(std::pair<std::string, OpTag>("--inline-threshold", OpTag::INLINE_THRESHOLD));
+    opMap.insert(std::pair<std::string, OpTag>("--field-layout", OpTag::FIELD_LAYOUT));
+    opMap.insert(std::pair<std::string, OpTag>("--unroll", OpTag::UNROLL));
+    opMap.insert(std::pair<std::string, OpTag>("--emit-bc", OpTag::EMIT_BC));
+    opMap.insert(std::pair<std::string, OpTag>("-c", OpTag::COMPILE));
+    opMap.insert(std::pair<std::string, OpTag>("-O0", OpTag::OPT_LEVEL));
+    opMap.insert(std::pair<std::string, OpTag>("-O1", OpTag::OPT_LEVEL));
+    opMap.insert(std::pair<std::string, OpTag>("-O2", OpTag::OPT_LEVEL));
+    opMap.insert(std::pair<std::string, OpTag>("-O3", OpTag::OPT_LEVEL));
+    opMap.insert(std::pair<std::string, OpTag>("--jit", OpTag::JIT));
+    opMap.insert(std::pair<std::string, OpTag>("--instrument", OpTag::INSTRUMENT));
+    opMap.insert(std::pair<std::string, OpTag>("--profile-use", OpTag::PROFILE_USE));
     manuals.insert(std::pair<std::string, std::string>("--dump-tokens", "output token stream"));
     manuals.insert(std::pair<std::string, std::string>("--dump-ast", "output depth travelling of ast"));
     manuals.insert(std::pair<std::string, std::string>("--dump-ir", "output intermediate representations"));
     manuals.insert(std::pair<std::string, std::string>("-h, --help", "help information"));
-    manuals.insert(std::pair<std::string, std::string>("-o, --output", "output file name"));
-    manuals.insert(std::pair<std::string, std::string>("-S, --asm", "output asm code"));
+    manuals.insert(std::pair<std::string, std::string>("-o, --output", "output file name, an executable unless -c or -S"));
+    manuals.insert(std::pair<std::string, std::string>("-S, --asm", "output asm code of the host"));
+    manuals.insert(std::pair<std::string, std::string>("-c", "output an object file"));
+    manuals.insert(std::pair<std::string, std::string>("-O<n>", "run the passes of LLVM at level n (0-3) before code generation"));
     manuals.insert(std::pair<std::string, std::string>("-v, --version", "version info"));
+    manuals.insert(std::pair<std::string, std::string>("-j <n>, --jobs=<n>", "check and generate methods on n threads (0: all cores)"));
+    manuals.insert(std::pair<std::string, std::string>("--cache[=<dir>]", "reuse results of unchanged files (default .ycc-cache)"));
+    manuals.insert(std::pair<std::string, std::string>("--cache-size=<MB>", "evict least recently used results above this size"));
+    manuals.insert(std::pair<std::string, std::string>("--cache-stats", "print cache statistics"));
+    manuals.insert(std::pair<std::string, std::string>("--server[=<socket>]", "run as compile server with warm state"));
+    manuals.insert(std::pair<std::string, std::string>("--client[=<socket>]", "forward this compilation to the compile server"));
+    manuals.insert(std::pair<std::string, std::string>("--time-report", "print time, memory and counters of every phase"));
+    manuals.insert(std::pair<std::string, std::string>("--stats[=<file>]", "write phases and counters as json (default stdout)"));
+    manuals.insert(std::pair<std::string, std::string>("--trace=<file>", "write chrome trace events of phases, classes and methods"));
+    manuals.insert(std::pair<std::string, std::string>("--inline-threshold=<n>", "inline methods of at most n instructions (default 40, 0: off)"));
+    manuals.insert(std::pair<std::string, std::string>("--field-layout=<packed|hot>", "fields by alignment (default), or the most used first"));
+    manuals.insert(std::pair<std::string, std::string>("--unroll[=<n>]", "unroll small counted loops n times (default 4) and list the loops changed"));
+    manuals.insert(std::pair<std::string, std::string>("--emit-bc", "write LLVM bitcode to ycc.bc instead of text to ycc.ll"));
+    manuals.insert(std::pair<std::string, std::string>("--jit[=lazy]", "compile in memory and run main, lazy: every method when first called"));
+    manuals.insert(std::pair<std::string, std::string>("--instrument[=<file>]", "count blocks and branches, the program writes them at exit (default ycc.profile)"));
+    manuals.insert(std::pair<std::string, std::string>("--profile-use[=<file>]", "weigh branches, order blocks and inline by the counts of a profile"));
 
     commandHandle(argc, argv);
 }
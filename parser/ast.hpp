@@ -74,7 +74,7 @@ namespace ycc
         }
 
         std::string                 name;
-        StmtPtr                     body;
+        StmtPtr                     body = nullptr;
     };
 
     struct MethodDeclStmt : public Stmt
@@ -88,7 +88,7 @@ namespace ycc
         }
 
         std::string     name;
-        StmtPtr         body;
+        StmtPtr         body = nullptr;
     };
 
     struct PrimaryStmt : public Stmt
@@ -141,9 +141,9 @@ namespace ycc
             v->visit(this);
         }
 
-        ExprPtr       condition;
-        StmtPtr       thenBody;
-        StmtPtr       elseBody;
+        ExprPtr       condition = nullptr;
+        StmtPtr       thenBody = nullptr;
+        StmtPtr       elseBody = nullptr;
     };
 
     struct ForStmt : public Stmt
@@ -156,10 +156,10 @@ namespace ycc
             v->visit(this);
         }
 
-        ExprPtr     init;
-        ExprPtr     condition;
-        ExprPtr     update;
-        StmtPtr     body;
+        ExprPtr     init = nullptr;
+        ExprPtr     condition = nullptr;
+        ExprPtr     update = nullptr;
+        StmtPtr     body = nullptr;
     };
 
     struct WhileStmt : public Stmt
@@ -172,8 +172,8 @@ namespace ycc
             v->visit(this);
         }
 
-        ExprPtr         condition;
-        StmtPtr         body;
+        ExprPtr         condition = nullptr;
+        StmtPtr         body = nullptr;
     };
 
     struct DoStmt : public Stmt
@@ -186,8 +186,8 @@ namespace ycc
             v->visit(this);
         }
 
-        ExprPtr     condition;
-        StmtPtr     body;
+        ExprPtr     condition = nullptr;
+        StmtPtr     body = nullptr;
     };
 
     struct SwitchStmt : public Stmt
@@ -200,7 +200,7 @@ namespace ycc
             v->visit(this);
         }
 
-        ExprPtr                 flag;           // int
+        ExprPtr                 flag = nullptr;           // int
         VecStmtPtr              cases;
         VecStmtPtr              defaultBody;
     };
@@ -215,7 +215,7 @@ namespace ycc
             v->visit(this);
         }
 
-        ExprPtr                 label;
+        ExprPtr                 label = nullptr;
         VecStmtPtr              statements;
     };
 
@@ -253,7 +253,7 @@ namespace ycc
             v->visit(this);
         }
 
-        ExprPtr         returnValue;
+        ExprPtr         returnValue = nullptr;
     };
 
     /**************************************************
@@ -278,7 +278,7 @@ namespace ycc
         }
 
       private:
-        int         typeIndex_;
+        int         typeIndex_ = 0;
     };
 
     struct VariableDeclExpr : public Expr
@@ -292,7 +292,7 @@ namespace ycc
         }
 
         std::string         name;
-        ExprPtr             initValue;
+        ExprPtr             initValue = nullptr;
     };
 
     struct IdentifierExpr : public Expr
@@ -317,7 +317,7 @@ namespace ycc
         {
             v->visit(this);
         }
-        ExprPtr         constructor;        // call expr
+        ExprPtr         constructor = nullptr;        // call expr
     };
 
     struct IndexExpr : public Expr
@@ -330,8 +330,8 @@ namespace ycc
             v->visit(this);
         }
 
-        ExprPtr     left;
-        ExprPtr     index;
+        ExprPtr     left = nullptr;
+        ExprPtr     index = nullptr;
     };
 
     struct CallExpr : public Expr
@@ -358,8 +358,8 @@ namespace ycc
         {
             v->visit(this);
         }
-        ExprPtr         left;
-        ExprPtr         right;
+        ExprPtr         left = nullptr;
+        ExprPtr         right = nullptr;
     };
 
     struct IntExpr : public Expr
@@ -453,7 +453,7 @@ namespace ycc
 
         bool        isPrefix;
         TokenTag    op;
-        ExprPtr     expr;
+        ExprPtr     expr = nullptr;
     };
 
     struct BinaryOpExpr : public Expr
@@ -467,8 +467,8 @@ namespace ycc
         }
 
         TokenTag    op;
-        ExprPtr     left;
-        ExprPtr     right;
+        ExprPtr     left = nullptr;
+        ExprPtr     right = nullptr;
     };
 
     struct TernaryOpExpr : public Expr
@@ -481,11 +481,25 @@ namespace ycc
             v->visit(this);
         }
 
-        ExprPtr     condition;
-        ExprPtr     thenValue;
-        ExprPtr     elseValue;
+        ExprPtr     condition = nullptr;
+        ExprPtr     thenValue = nullptr;
+        ExprPtr     elseValue = nullptr;
     };
 
+    /**************************************************
+     * Work units
+     *************************************************/
+
+    // a method body and the class it is declared in, the unit of work
+    // semantic analysis and IR generation hand out to worker threads
+    struct MethodUnit
+    {
+        std::string         className;
+        MethodDeclStmt *    method;
+    };
+
+    using VecMethodUnit = std::vector <MethodUnit>;
+
 }
 
 #endif
@@ -1,5 +1,8 @@
 #include "parser.h"
+#include "../common/trace.h"
+#include <fstream>
 #include <iostream>
+#include <sstream>
 
 namespace ycc
 {
@@ -21,10 +24,7 @@ namespace ycc
             if(match(TokenTag::IDENTIFIER))
             {
                 auto apiName = token_.lexeme();
-                auto apiPath = "./api/" + apiName + ".ycc";
-                Scanner apiScanner(apiPath);
-                Parser apiParser(apiScanner);
-                apiParser.parse();
+                loadModule(apiName);
                 symbolTable_->addModuleName(apiName);
             }
             else
@@ -39,6 +39,26 @@ namespace ycc
         }
     }
 
+    // parse the interface of an api module and keep its IR, once
+    void Parser::loadModule(const std::string &apiName, const std::string &apiDir /* = "./api" */)
+    {
+        auto symbolTable = SymbolTable::getInstance();
+        if(symbolTable->hasModule(apiName))
+        {
+            return ;
+        }
+
+        TraceSpan span("module", apiName);
+        Scanner apiScanner(apiDir + "/" + apiName + ".ycc");
+        Parser apiParser(apiScanner);
+        apiParser.parse();
+
+        std::ifstream in(apiDir + "/" + apiName + ".vm");
+        std::ostringstream ir;
+        ir << in.rdbuf();
+        symbolTable->addModule(apiName, ir.str());
+    }
+
     // inner operations
     void Parser::advance()
     {
@@ -155,7 +175,7 @@ namespace ycc
     StmtPtr Parser::parseClassBody()
     {
         auto classBody = new BlockStmt(getLocation());
-        while(!match(TokenTag::RIGHT_BRACE))
+        while(!match(TokenTag::RIGHT_BRACE) && !match(TokenTag::END_OF_FILE))
         {
             // reduce empty statement
             while(match(TokenTag::SEMICOLON))
@@ -345,7 +365,7 @@ namespace ycc
             {
                 errorReport("undefine type of parameter");
                 errorFlag = true;
-                while(!match(TokenTag::RIGHT_PAREN))
+                while(!match(TokenTag::RIGHT_PAREN) && !match(TokenTag::END_OF_FILE))
                 {
                     advance();
                 }
@@ -426,9 +446,15 @@ namespace ycc
         auto node = new BlockStmt(getLocation());
         advance();
 
-        while(!match(TokenTag::RIGHT_BRACE))
+        while(!match(TokenTag::RIGHT_BRACE) && !match(TokenTag::END_OF_FILE))
         {
             auto stmt = parseStmt();
+            if(!stmt)
+            {
+                // the error is reported, skip the token that starts no statement
+                advance();
+                continue;
+            }
             node->statements.push_back(stmt);
         }
 
@@ -651,7 +677,12 @@ namespace ycc
             modifiers.set(isModifier(token_.tag()));
             advance();
         }
-        if(symbolTable_->hasType(token_.lexeme()))
+        // Type name or Type[] name, a class name may also start an expression;
+        // a primitive type can only start a declaration
+        auto next = scanner_.peekToken().tag();
+        if(symbolTable_->hasType(token_.lexeme())
+           && (token_.tag() != TokenTag::IDENTIFIER
+               || next == TokenTag::IDENTIFIER || next == TokenTag::LEFT_SQUARE))
         {
             auto type = token_.lexeme();
             advance();                      // eat type
@@ -737,10 +768,10 @@ namespace ycc
             break;
         }
 
-        // check prefix op
+        // check prefix op, they all bind tighter than any infix op
         if((!left) && (isPrefixOp(token_.tag())))
         {
-            auto p = getSymbolPrecedence(token_.tag());
+            auto p = getSymbolPrecedence(TokenTag::NOT);
             left = parseUnaryOp(nullptr, p);
         }
 
@@ -748,7 +779,13 @@ namespace ycc
         {
             if(!optional)
             {
+                // skip the token that starts no expression, so a list or a
+                // statement around it moves on
                 errorReport("left should not null");
+                if(!match(TokenTag::END_OF_FILE))
+                {
+                    advance();
+                }
             }
             return nullptr;
         }
@@ -772,6 +809,10 @@ namespace ycc
 
             if(match(TokenTag::QUESTION_MARK))
             {
+                if(p < precedence)
+                {
+                    break;
+                }
                 return parseTernaryOp(left, p);
             }
 
@@ -850,7 +891,10 @@ namespace ycc
             // eat {,expr}
             while(!match(TokenTag::RIGHT_PAREN))
             {
-                match(TokenTag::COMMA, token_.lexeme(), true);
+                if(!match(TokenTag::COMMA, token_.lexeme(), true))
+                {
+                    break;
+                }
                 node->arguments.push_back(parseExpr());
             }
         }
@@ -882,6 +926,30 @@ namespace ycc
 
         node->constructor = parseIdentifier();
 
+        // new Type[n][m] makes the types Type[] and Type[][]
+        int dims = 0;
+        auto expr = node->constructor;
+        while(auto index = dynamic_cast<IndexExpr *>(expr))
+        {
+            dims++;
+            expr = index->left;
+        }
+        auto base = dynamic_cast<IdentifierExpr *>(expr);
+        if(dims && base && symbolTable_->hasType(base->name))
+        {
+            auto type = base->name;
+            for(int i = 0; i < dims; i++)
+            {
+                int typeIndex = symbolTable_->getTypeIndex(type);
+                int wd = symbolTable_->getTypeInfo(typeIndex).getWidth();
+                type += "[]";
+                if(!symbolTable_->hasType(type))
+                {
+                    symbolTable_->addType(type, wd, typeIndex);
+                }
+            }
+        }
+
         return node;
     }
 
@@ -982,7 +1050,8 @@ namespace ycc
         node->left = left;
         node->op = token_.tag();
         advance();
-        node->right = parseExpr(false, precedence);
+        // a - b - c is (a - b) - c, only assignments group to the right
+        node->right = parseExpr(false, isAssignmentOperator(node->op) ? precedence : precedence + 1);
 
         return node;
     }
@@ -992,7 +1061,7 @@ namespace ycc
         auto node = new TernaryOpExpr(getLocation());
         node->condition = left;
         match(TokenTag::QUESTION_MARK, token_.lexeme(), true);
-        node->thenValue = parseExpr(false, precedence);
+        node->thenValue = parseExpr();
         match(TokenTag::COLON, token_.lexeme(), true);
         node->elseValue = parseExpr(false, precedence);
         return node;
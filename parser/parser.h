@@ -15,6 +15,8 @@ namespace ycc
         explicit        Parser(Scanner &scanner);
         VecNodePtr      parse();
 
+        static void     loadModule(const std::string &apiName, const std::string &apiDir = "./api");
+
         static void     setErrorFlag(bool flag);
         static bool     getErrorFlag();
 
@@ -0,0 +1,569 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <dirent.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "compile_server.h"
+#include "../common/compile_cache.h"
+
+namespace ycc
+{
+    static volatile sig_atomic_t stopFlag = 0;
+
+    static void stopHandler(int)
+    {
+        stopFlag = 1;
+    }
+
+    static bool writeAll(int fd, const std::string &data)
+    {
+        size_t done = 0;
+        while(done < data.size())
+        {
+            auto n = write(fd, data.data() + done, data.size() - done);
+            if(n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if(n <= 0)
+            {
+                return false;
+            }
+            done += n;
+        }
+        return true;
+    }
+
+    static std::string readAll(int fd)
+    {
+        std::string data;
+        char buffer[4096];
+        while(true)
+        {
+            auto n = read(fd, buffer, sizeof(buffer));
+            if(n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if(n <= 0)
+            {
+                break;
+            }
+            data.append(buffer, n);
+        }
+        return data;
+    }
+
+    // hash of the names and bytes of the api modules in a directory
+    static std::string apiFingerprint(const std::string &apiDir)
+    {
+        std::vector<std::string> names;
+        if(DIR *dir = opendir(apiDir.c_str()))
+        {
+            while(auto ent = readdir(dir))
+            {
+                std::string name = ent->d_name;
+                auto ext = name.substr(name.find_last_of('.') + 1);
+                if(ext == "ycc" || ext == "vm" || ext == "bc")
+                {
+                    names.push_back(name);
+                }
+            }
+            closedir(dir);
+        }
+        std::sort(names.begin(), names.end());
+
+        uint64_t h = CompileCache::hash("");
+        for(auto &name : names)
+        {
+            std::ifstream in(apiDir + "/" + name, std::ios::in | std::ios::binary);
+            std::ostringstream bytes;
+            bytes << in.rdbuf();
+            h = CompileCache::hash(name + "\n" + std::to_string(bytes.str().size()) + "\n" + bytes.str(), h);
+        }
+        return std::to_string(h);
+    }
+
+    static int openSocket(const std::string &path, sockaddr_un &addr)
+    {
+        if(path.size() >= sizeof(addr.sun_path))
+        {
+            return -1;
+        }
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        std::strcpy(addr.sun_path, path.c_str());
+        return socket(AF_UNIX, SOCK_STREAM, 0);
+    }
+
+    const int CompileServer::requestTimeout_;
+
+    CompileServer::CompileServer(const std::string &socketPath, IRFileFunction irFileName,
+                                 CompileFunction compile, WarmFunction warm)
+        : socketPath_(socketPath), irFileName_(irFileName), compile_(compile), warm_(warm), listenFd_(-1),
+          socketInode_(0)
+    {}
+
+    // anyone can make files in /tmp, where a socket could be someone else's;
+    // $XDG_RUNTIME_DIR and this directory only their user can enter
+    static std::string privateDirectory()
+    {
+        return "/tmp/ycc-" + std::to_string(getuid());
+    }
+
+    std::string CompileServer::defaultSocketPath()
+    {
+        auto runtime = std::getenv("XDG_RUNTIME_DIR");
+        if(runtime && runtime[0] == '/')
+        {
+            return std::string(runtime) + "/ycc.sock";
+        }
+        return privateDirectory() + "/server.sock";
+    }
+
+    // a directory of this user that nobody else may enter, made if missing
+    static bool makePrivate(const std::string &dir, std::string &error)
+    {
+        struct stat status;
+        if(mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST)
+        {
+            error = "can not create " + dir + ": " + std::strerror(errno);
+            return false;
+        }
+        if(lstat(dir.c_str(), &status) != 0 || !S_ISDIR(status.st_mode) || status.st_uid != getuid()
+           || (status.st_mode & 077) != 0)
+        {
+            error = dir + " is not a directory only this user can enter";
+            return false;
+        }
+        return true;
+    }
+
+    // a socket of this user at path, so a server of this user listens there
+    static bool ownSocket(const std::string &path, struct stat &status)
+    {
+        return lstat(path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode) && status.st_uid == getuid();
+    }
+
+    int CompileServer::run()
+    {
+        sockaddr_un addr;
+        listenFd_ = openSocket(socketPath_, addr);
+        if(listenFd_ < 0)
+        {
+            std::cerr << "ycc: fatal error: can not create socket " << socketPath_ << std::endl;
+            return 1;
+        }
+        std::string error;
+        if(socketPath_ == privateDirectory() + "/server.sock" && !makePrivate(privateDirectory(), error))
+        {
+            std::cerr << "ycc: fatal error: " << error << std::endl;
+            return 1;
+        }
+
+        // only a socket left by a server of this user is replaced, never a file
+        struct stat status;
+        if(lstat(socketPath_.c_str(), &status) == 0)
+        {
+            if(!ownSocket(socketPath_, status))
+            {
+                std::cerr << "ycc: fatal error: " << socketPath_ << " exists and is not a socket of this user"
+                          << std::endl;
+                return 1;
+            }
+            unlink(socketPath_.c_str());
+        }
+        if(bind(listenFd_, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(listenFd_, 64) != 0)
+        {
+            std::cerr << "ycc: fatal error: can not listen on " << socketPath_
+                      << ": " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+        socketInode_ = lstat(socketPath_.c_str(), &status) == 0 ? status.st_ino : 0;
+
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_handler = stopHandler;
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
+        signal(SIGPIPE, SIG_IGN);
+
+        warm_("./api");
+        warmApi_ = apiFingerprint("./api");
+
+        std::cout << "ycc server listening on " << socketPath_ << std::endl;
+
+        while(!stopFlag)
+        {
+            std::vector<pollfd> fds;
+            fds.push_back(pollfd{listenFd_, POLLIN, 0});
+            for(auto &job : jobs_)
+            {
+                fds.push_back(pollfd{job.pipe, POLLIN, 0});
+            }
+            if(poll(fds.data(), fds.size(), -1) < 0)
+            {
+                continue;   // interrupted by a signal
+            }
+
+            // collect the output of running children, finish the done ones
+            for(size_t i = jobs_.size(); i > 0; i--)
+            {
+                auto &job = jobs_[i-1];
+                if(!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                {
+                    continue;
+                }
+                char buffer[4096];
+                auto n = read(job.pipe, buffer, sizeof(buffer));
+                if(n > 0)
+                {
+                    job.result.append(buffer, n);
+                    continue;
+                }
+                finish(job);
+                jobs_.erase(jobs_.begin() + (i-1));
+            }
+
+            if(fds[0].revents & POLLIN)
+            {
+                int client = accept(listenFd_, nullptr, nullptr);
+                if(client < 0)
+                {
+                    continue;
+                }
+                Request request;
+                std::string error;
+                if(readRequest(client, request, error))
+                {
+                    dispatch(request);
+                }
+                else if(!error.empty())
+                {
+                    reply(client, 1, error);
+                }
+                else
+                {
+                    close(client);
+                }
+            }
+        }
+
+        close(listenFd_);
+        // unless another server has taken the path over since
+        if(ownSocket(socketPath_, status) && status.st_ino == socketInode_)
+        {
+            unlink(socketPath_.c_str());
+        }
+        return 0;
+    }
+
+    // false with an empty error if the client went away
+    bool CompileServer::readRequest(int client, Request &request, std::string &error)
+    {
+        std::string data;
+        char buffer[4096];
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(requestTimeout_);
+        while(true)
+        {
+            // request is complete when it has 2 + argc lines
+            std::vector<std::string> lines;
+            size_t begin = 0, end;
+            while((end = data.find('\n', begin)) != std::string::npos)
+            {
+                lines.push_back(data.substr(begin, end - begin));
+                begin = end + 1;
+            }
+            if(lines.size() >= 2)
+            {
+                auto &count = lines[1];
+                if(count.empty() || count.size() > 9 || count.find_first_not_of("0123456789") != std::string::npos
+                   || std::stoul(count) > maxArgs_)
+                {
+                    error = "ycc: fatal error: bad request, '" + count.substr(0, 32) + "' is no argument count\n";
+                    return false;
+                }
+                size_t argc = std::stoul(count);
+                if(lines.size() >= 2 + argc)
+                {
+                    request.client = client;
+                    request.cwd = lines[0];
+                    request.args.assign(lines.begin() + 2, lines.begin() + 2 + argc);
+                    request.key = requestKey(request);
+                    return true;
+                }
+            }
+            if(data.size() > maxRequestBytes_)
+            {
+                error = "ycc: fatal error: bad request, larger than "
+                      + std::to_string(maxRequestBytes_ >> 20) + "MB\n";
+                return false;
+            }
+
+            // a client that does not send its request holds up no other one for long
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            deadline - std::chrono::steady_clock::now()).count();
+            pollfd fd{client, POLLIN, 0};
+            int ready = left > 0 ? poll(&fd, 1, left) : 0;
+            if(ready < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if(ready <= 0)
+            {
+                error = ready == 0 ? "ycc: fatal error: bad request, timed out\n" : "";
+                return false;
+            }
+
+            auto n = read(client, buffer, sizeof(buffer));
+            if(n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if(n <= 0)
+            {
+                return false;
+            }
+            data.append(buffer, n);
+        }
+    }
+
+    // the working directory, the arguments and the bytes of every source
+    // file and profile named by them identify a compilation
+    std::string CompileServer::requestKey(const Request &request) const
+    {
+        std::string salt = request.cwd;
+        for(auto &arg : request.args)
+        {
+            salt += "\n" + arg;
+        }
+
+        std::string key = "";
+        std::string profileKey = "";
+        for(auto &arg : request.args)
+        {
+            if(arg == "--profile-use" || arg.compare(0, 14, "--profile-use=") == 0)
+            {
+                // the counts of a profile change the code as the source does
+                auto name = arg.size() > 14 ? arg.substr(14) : std::string("ycc.profile");
+                std::ifstream in(name[0] == '/' ? name : request.cwd + "/" + name, std::ios::in | std::ios::binary);
+                std::ostringstream profile;
+                profile << in.rdbuf();
+                profileKey = in ? "+" + std::to_string(CompileCache::hash(profile.str())) : "+none";
+                continue;
+            }
+            if(arg.empty() || arg[0] == '-')
+            {
+                continue;
+            }
+            auto path = arg[0] == '/' ? arg : request.cwd + "/" + arg;
+            std::ifstream in(path);
+            if(in)
+            {
+                // the child reads the api modules of the request's directory
+                key += CompileCache::key(path, salt, request.cwd + "/api");
+            }
+        }
+        return key.empty() ? key : key + profileKey;
+    }
+
+    void CompileServer::dispatch(Request &request)
+    {
+        auto irFileName = irFileName_(request.args);
+        if(irFileName.empty())
+        {
+            request.key.clear();
+        }
+
+        // unchanged file, answer from memory
+        auto iter = results_.find(request.key);
+        if(!request.key.empty() && iter != results_.end())
+        {
+            auto &result = iter->second;
+            if(result.status == 0)
+            {
+                std::ofstream out(request.cwd + "/" + irFileName, std::ios::out | std::ios::binary);
+                out << result.ir;
+            }
+            resultOrder_.remove(request.key);
+            resultOrder_.push_back(request.key);
+            reply(request.client, result.status, result.output);
+            return ;
+        }
+
+        // the warm state has to hold the api the request is compiled with
+        auto api = apiFingerprint(request.cwd + "/api");
+        if(api != warmApi_)
+        {
+            warm_(request.cwd + "/api");
+            warmApi_ = api;
+        }
+
+        int fds[2];
+        if(pipe(fds) != 0)
+        {
+            reply(request.client, 1, "ycc: fatal error: can not create pipe\n");
+            return ;
+        }
+
+        pid_t pid = fork();
+        if(pid == 0)
+        {
+            // child: compile from the warm state, send the result back
+            close(fds[0]);
+            close(listenFd_);
+            close(request.client);
+            signal(SIGINT, SIG_DFL);
+            signal(SIGTERM, SIG_DFL);
+
+            std::ostringstream output;
+            std::cout.rdbuf(output.rdbuf());
+            std::cerr.rdbuf(output.rdbuf());
+            int status = 1;
+            if(chdir(request.cwd.c_str()) == 0)
+            {
+                status = compile_(request.args);
+            }
+            else
+            {
+                output << "ycc: fatal error: can not enter " << request.cwd << "\n";
+            }
+
+            std::string ir;
+            if(status == 0 && !irFileName.empty())
+            {
+                std::ifstream in(irFileName, std::ios::in | std::ios::binary);
+                std::ostringstream buffer;
+                buffer << in.rdbuf();
+                ir = buffer.str();
+            }
+            std::ostringstream result;
+            result << status << " " << ir.size() << " " << output.str().size() << "\n"
+                   << ir << output.str();
+            writeAll(fds[1], result.str());
+            _exit(0);
+        }
+
+        close(fds[1]);
+        if(pid < 0)
+        {
+            close(fds[0]);
+            reply(request.client, 1, "ycc: fatal error: can not fork\n");
+            return ;
+        }
+        jobs_.push_back(Job{request, pid, fds[0], ""});
+    }
+
+    void CompileServer::finish(Job &job)
+    {
+        close(job.pipe);
+        int waitStatus = 0;
+        waitpid(job.pid, &waitStatus, 0);
+
+        Result result{1, "", ""};
+        std::istringstream header(job.result.substr(0, job.result.find('\n')));
+        size_t irSize = 0, outputSize = 0;
+        size_t begin = job.result.find('\n') + 1;
+        if((header >> result.status >> irSize >> outputSize)
+            && begin + irSize + outputSize == job.result.size())
+        {
+            result.ir = job.result.substr(begin, irSize);
+            result.output = job.result.substr(begin + irSize, outputSize);
+            if(!job.request.key.empty())
+            {
+                remember(job.request.key, result);
+            }
+        }
+        else
+        {
+            // the child died, report it like the shell would
+            int signal = WIFSIGNALED(waitStatus) ? WTERMSIG(waitStatus) : 0;
+            result.status = signal ? 128 + signal : 1;
+            result.output = "ycc: internal compiler error: compiler killed by signal "
+                          + std::to_string(signal) + "\n";
+        }
+        reply(job.request.client, result.status, result.output);
+    }
+
+    void CompileServer::reply(int client, int status, const std::string &output)
+    {
+        writeAll(client, std::to_string(status) + " " + std::to_string(output.size()) + "\n" + output);
+        close(client);
+    }
+
+    void CompileServer::remember(const std::string &key, const Result &result)
+    {
+        if(results_.find(key) == results_.end())
+        {
+            resultOrder_.push_back(key);
+        }
+        results_[key] = result;
+        while(results_.size() > maxResults_)
+        {
+            results_.erase(resultOrder_.front());
+            resultOrder_.pop_front();
+        }
+    }
+
+    int runClient(const std::string &socketPath, const std::vector<std::string> &args)
+    {
+        // the server reads the sources and writes the output, it has to be this user's
+        struct stat entry;
+        if(lstat(socketPath.c_str(), &entry) == 0 && !ownSocket(socketPath, entry))
+        {
+            std::cerr << "ycc: warning: " << socketPath << " is not a socket of this user" << std::endl;
+            return -1;
+        }
+        sockaddr_un addr;
+        int fd = openSocket(socketPath, addr);
+        if(fd < 0)
+        {
+            return -1;
+        }
+        if(connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+
+        char cwd[4096];
+        if(!getcwd(cwd, sizeof(cwd)))
+        {
+            close(fd);
+            return -1;
+        }
+        std::string request = std::string(cwd) + "\n" + std::to_string(args.size()) + "\n";
+        for(auto &arg : args)
+        {
+            request += arg + "\n";
+        }
+        writeAll(fd, request);
+
+        auto response = readAll(fd);
+        close(fd);
+
+        int status = 1;
+        size_t size = 0;
+        std::istringstream header(response.substr(0, response.find('\n')));
+        if(!(header >> status >> size))
+        {
+            std::cerr << "ycc: fatal error: bad response from server" << std::endl;
+            return 1;
+        }
+        std::cout << response.substr(response.find('\n') + 1, size);
+        std::cout.flush();
+        return status;
+    }
+}
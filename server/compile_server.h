@@ -0,0 +1,106 @@
+#ifndef COMPILE_SERVER_H_
+#define COMPILE_SERVER_H_
+
+#include <functional>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+namespace ycc
+{
+    // compiles one request (arguments without the program name) in the
+    // current process and returns its exit status
+    using CompileFunction = std::function<int(const std::vector<std::string> &)>;
+
+    // the file a request (arguments without the program name) writes its IR to;
+    // empty if it writes something else, an object of the LLVM backend, or reports
+    // on its compilation: such a result is not kept
+    using IRFileFunction = std::function<std::string(const std::vector<std::string> &)>;
+
+    // (re)loads the state every compilation starts from, with the api modules of a directory
+    using WarmFunction = std::function<void(const std::string &)>;
+
+    /*
+     * Compile server listening on a local unix socket.
+     *
+     * The server keeps the immutable state warm (keyword dictionary, built-in
+     * types, api interfaces and IR) and forks a child from that state for
+     * every request, since a compilation fills the process-wide symbol table.
+     * The state is warmed again when a request's api directory holds other
+     * files than the one it was loaded from. Results of unchanged files and
+     * api modules are kept in memory and answered without a child at all.
+     *
+     * request:  <cwd>\n <argc>\n {<arg>\n}
+     * response: <status> <output size>\n <output>
+     */
+    class CompileServer
+    {
+      public:
+        CompileServer(const std::string &socketPath, IRFileFunction irFileName,
+                      CompileFunction compile, WarmFunction warm);
+
+        int                 run();
+
+        // in $XDG_RUNTIME_DIR, else in a directory of this user's own under /tmp
+        static std::string  defaultSocketPath();
+
+      private:
+        struct Request
+        {
+            int                         client;
+            std::string                 cwd;
+            std::vector<std::string>    args;
+            std::string                 key;
+        };
+
+        struct Job
+        {
+            Request                     request;
+            pid_t                       pid;
+            int                         pipe;
+            std::string                 result;
+        };
+
+        struct Result
+        {
+            int                         status;
+            std::string                 ir;
+            std::string                 output;
+        };
+
+        bool                readRequest(int client, Request &request, std::string &error);
+        std::string         requestKey(const Request &request) const;
+        void                dispatch(Request &request);
+        void                finish(Job &job);
+        void                reply(int client, int status, const std::string &output);
+        void                remember(const std::string &key, const Result &result);
+
+      private:
+        std::string                             socketPath_;
+        IRFileFunction                          irFileName_;
+        CompileFunction                         compile_;
+        WarmFunction                            warm_;
+        std::string                             warmApi_;       // hash of the api files of the warm state
+        int                                     listenFd_;
+        ino_t                                   socketInode_;   // of the socket this server made
+        std::vector<Job>                        jobs_;
+
+        // results of unchanged files, least recently used first
+        std::list<std::string>                  resultOrder_;
+        std::map<std::string, Result>           results_;
+        static const size_t                     maxResults_ = 512;
+
+        // the accept loop waits for a request this long at most
+        static const int                        requestTimeout_ = 5000;     // ms
+        static const size_t                     maxRequestBytes_ = 1 << 20;
+        static const size_t                     maxArgs_ = 4096;
+    };
+
+    // forward a compile request to the server, print its output and return
+    // its status, or -1 if no server of this user is listening
+    int runClient(const std::string &socketPath, const std::vector<std::string> &args);
+}
+
+#endif
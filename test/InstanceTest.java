@@ -0,0 +1,36 @@
+import io;
+public class InstanceTest
+{
+    int v;
+    long total;
+    void add(int x)
+    {
+        v = v + x;
+        total += x;
+        twice();
+    }
+    void twice()
+    {
+        v = v * 2;
+    }
+    int get()
+    {
+        int v = 7;
+        return v + this_v();
+    }
+    int this_v()
+    {
+        return v;
+    }
+    public static void main(String [] args)
+    {
+        InstanceTest r = new InstanceTest();
+        InstanceTest s = new InstanceTest();
+        r.add(3);
+        s.add(1);
+        r.add(s.get());
+        io.printInt(r.v);
+        io.printInt(s.v);
+        io.printInt(r.get());
+    }
+}
@@ -0,0 +1,187 @@
+#include <iostream>
+#include <string>
+#include "interpreter.h"
+#include "ycc_driver.h"
+
+/*
+ * Checks which bounds checks of a[i] are dropped: only in the body of
+ * for(i = c; i < a.length; i++) where the body assigns neither i nor a.
+ * Then runs the programs, whose last accesses are out of bounds.
+ *   clang++ -std=c++11 test/compiler/bounds_test.cc -o bounds_test
+ *   ./bounds_test --ycc=/bin/ycc        from the directory that holds api/
+ */
+
+using namespace ycc;
+using std::cout;
+using std::endl;
+
+static const char *source = R"(import io;
+public class bounds
+{
+    static int sum(int[] a)
+    {
+        int s = 0;
+        int i;
+        for(i = 0; i < a.length; i++)
+        {
+            s += a[i];
+        }
+        return s;
+    }
+    static int tail(int[] a)
+    {
+        int s = 0;
+        int i;
+        for(i = 2; i < a.length; i += 1)
+        {
+            s += a[i];
+        }
+        return s;
+    }
+    static int skip(int[] a)
+    {
+        int s = 0;
+        int i;
+        for(i = 0; i < a.length; i++)
+        {
+            s += a[i];
+            i = i + 1;
+        }
+        return s;
+    }
+    static int swap(int[] a, int[] b)
+    {
+        int s = 0;
+        int i;
+        for(i = 0; i < a.length; i++)
+        {
+            s += a[i];
+            a = b;
+        }
+        return s;
+    }
+    static int other(int[] a, int[] b)
+    {
+        int s = 0;
+        int i;
+        for(i = 0; i < a.length; i++)
+        {
+            s += b[i];
+        }
+        return s;
+    }
+    static int previous(int[] a)
+    {
+        int s = 0;
+        int i;
+        for(i = 1; i < a.length; i++)
+        {
+            s += a[i - 1];
+        }
+        return s;
+    }
+    static int increment(int[] a)
+    {
+        int s = 0;
+        int i;
+        for(i = 0; i < a.length; i++)
+        {
+            s += a[i++];
+        }
+        return s;
+    }
+    static int through(int[] a)
+    {
+        int s = 0;
+        int i;
+        for(i = 0; i <= a.length; i++)
+        {
+            s += a[i];
+        }
+        return s;
+    }
+    public static void main(String [] args)
+    {
+        int[] a = new int[5];
+        int[] b = new int[3];
+        int i;
+        for(i = 0; i < a.length; i++)
+        {
+            a[i] = i + 1;
+        }
+        b[0] = 100;
+        io.printInt(sum(a));
+        io.print("");
+        io.printInt(tail(a));
+        io.print("");
+        io.printInt(skip(a));
+        io.print("");
+        io.printInt(swap(a, b));
+        io.print("");
+        io.printInt(previous(a));
+        io.print("");
+        io.printInt(increment(a));
+        io.print("");
+        io.printInt(through(a));
+        io.print("");
+    }
+}
+)";
+
+// one unsigned compare catches a negative index too
+static const char *negative = R"(import io;
+public class negative
+{
+    public static void main(String [] args)
+    {
+        int[] a = new int[5];
+        int k = 2 - 3;
+        a[k] = 1;
+        io.printInt(a[0]);
+    }
+}
+)";
+
+static int checks(const std::string &ir, const std::string &method)
+{
+    return Driver::count(Driver::method(ir, method), "call void @ycc.outOfBounds");
+}
+
+int main(int argc, char *argv[])
+{
+    Driver driver(argc, argv);
+    auto ir = driver.compile("bounds", source, "--inline-threshold=0");
+    if(ir.empty())
+    {
+        return 1;
+    }
+
+    check(checks(ir, "@bounds.sum") == 0, "a[i] in for(i = 0; i < a.length; i++) is not checked");
+    check(checks(ir, "@bounds.tail") == 0, "a[i] in for(i = 2; i < a.length; i += 1) is not checked");
+    check(checks(ir, "@bounds.skip") == 1, "a[i] is checked when the body assigns i");
+    check(checks(ir, "@bounds.swap") == 1, "a[i] is checked when the body assigns a");
+    check(checks(ir, "@bounds.other") == 1, "b[i] is checked in a loop over a");
+    check(checks(ir, "@bounds.previous") == 1, "a[i - 1] is checked");
+    check(checks(ir, "@bounds.increment") == 1, "a[i++] is checked, it assigns i");
+    check(checks(ir, "@bounds.through") == 1, "a[i] is checked in for(i = 0; i <= a.length; i++)");
+    check(checks(ir, "@main") == 1, "main only checks b[0], a[i] is in a loop over a.length");
+
+    // swap reads a[0], then b[1] and b[2]; through fails at a[5]
+    int status;
+    auto output = driver.execute("bounds", status);
+    check(status == 1, "an index out of bounds exits with status 1, not " + std::to_string(status));
+    check(output == "15\n12\n9\n1\n10\n9\n"
+                    "java.lang.ArrayIndexOutOfBoundsException: Index 5 out of bounds for length 5\n",
+          "the output of bounds is\n" + output);
+
+    if(driver.compile("negative", negative).empty())
+    {
+        return 1;
+    }
+    output = driver.execute("negative", status);
+    check(status == 1 && output == "java.lang.ArrayIndexOutOfBoundsException: Index -1 out of bounds for length 5\n",
+          "a[-1] fails, with status " + std::to_string(status) + " and output\n" + output);
+
+    cout << failures << " failed" << endl;
+    return failures == 0 ? 0 : 1;
+}
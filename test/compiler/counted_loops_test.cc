@@ -0,0 +1,189 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../../compiler/ir.h"
+#include "../../compiler/ir.cc"
+#include "../../compiler/dominators.h"
+#include "../../compiler/dominators.cc"
+#include "../../compiler/counted_loops.h"
+#include "../../compiler/counted_loops.cc"
+#include "interpreter.h"
+
+/*
+ * Turns the counters of hand-built loops into phis, reduces the products
+ * of them and unrolls the loops four times, then checks every method
+ * computes what it did before for trip counts that are a multiple of
+ * four and that are not:
+ *   clang++ -std=c++11 test/compiler/counted_loops_test.cc -o counted_loops_test
+ *   ./counted_loops_test
+ */
+
+using namespace ycc;
+using std::cout;
+using std::endl;
+
+static void add(IRBuilder &builder, const IRValue &sum, const IRValue &value)
+{
+    builder.store(builder.binary("add", builder.load("i32", sum), value), sum);
+}
+
+// for(i = 0; i < n; i += step) sum += i * k + (i << 2) + i * 3
+static IRFunction products(const std::string &name, int step)
+{
+    IRFunction function{name, "i32", {n, k}, {}};
+    IRBuilder builder(&function);
+    auto sum = builder.allocate("i32", "sum");
+    auto i = builder.allocate("i32", "i");
+    builder.store(zero, sum);
+    builder.store(zero, i);
+    auto cond = builder.newLabel("for.cond");
+    auto body = builder.newLabel("for.body");
+    auto end = builder.newLabel("for.end");
+    builder.setBlock(cond);
+    builder.condBr(builder.cmp("icmp slt", builder.load("i32", i), n), body, end);
+    builder.setBlock(body);
+    add(builder, sum, builder.binary("mul", builder.load("i32", i), k));
+    add(builder, sum, builder.binary("shl", builder.load("i32", i), IRValue{"i32", "2"}));
+    add(builder, sum, builder.binary("mul", IRValue{"i32", "3"}, builder.load("i32", i)));
+    builder.store(builder.binary("add", builder.load("i32", i), IRValue{"i32", std::to_string(step)}), i);
+    builder.br(cond);
+    builder.setBlock(end);
+    builder.ret(builder.binary("add", builder.load("i32", sum), builder.load("i32", i)));
+    return function;
+}
+
+// for(i = n; i > 0; i--) sum += i: a counter, but counting down
+static IRFunction down()
+{
+    IRFunction function{"@T.down", "i32", {n}, {}};
+    IRBuilder builder(&function);
+    auto sum = builder.allocate("i32", "sum");
+    auto i = builder.allocate("i32", "i");
+    builder.store(zero, sum);
+    builder.store(n, i);
+    auto cond = builder.newLabel("for.cond");
+    auto body = builder.newLabel("for.body");
+    auto end = builder.newLabel("for.end");
+    builder.setBlock(cond);
+    builder.condBr(builder.cmp("icmp sgt", builder.load("i32", i), zero), body, end);
+    builder.setBlock(body);
+    add(builder, sum, builder.load("i32", i));
+    builder.store(builder.binary("sub", builder.load("i32", i), IRValue{"i32", "1"}), i);
+    builder.br(cond);
+    builder.setBlock(end);
+    builder.ret(builder.load("i32", sum));
+    return function;
+}
+
+// for(i = 0; i < n; i++) { if(i == k) continue; sum += i; }: more than one block
+static IRFunction branches()
+{
+    IRFunction function{"@T.branches", "i32", {n, k}, {}};
+    IRBuilder builder(&function);
+    auto sum = builder.allocate("i32", "sum");
+    auto i = builder.allocate("i32", "i");
+    builder.store(zero, sum);
+    builder.store(zero, i);
+    auto cond = builder.newLabel("for.cond");
+    auto body = builder.newLabel("for.body");
+    auto then = builder.newLabel("if.end");
+    auto inc = builder.newLabel("for.inc");
+    auto end = builder.newLabel("for.end");
+    builder.setBlock(cond);
+    builder.condBr(builder.cmp("icmp slt", builder.load("i32", i), n), body, end);
+    builder.setBlock(body);
+    builder.condBr(builder.cmp("icmp eq", builder.load("i32", i), k), inc, then);
+    builder.setBlock(then);
+    add(builder, sum, builder.load("i32", i));
+    builder.setBlock(inc);
+    builder.store(builder.binary("add", builder.load("i32", i), IRValue{"i32", "1"}), i);
+    builder.br(cond);
+    builder.setBlock(end);
+    builder.ret(builder.load("i32", sum));
+    return function;
+}
+
+static std::vector<IRFunction> program()
+{
+    return {products("@T.products", 1), products("@T.stride", 3), down(), branches()};
+}
+
+// instructions of the loops with the opcode what, or loads from what
+static int inLoop(const IRFunction &function, const std::string &what)
+{
+    int count = 0;
+    DominatorTree tree(function);
+    std::vector<bool> body(function.blocks.size(), false);
+    for(auto &loop : tree.loops())
+    {
+        for(auto b : loop.blocks)
+        {
+            body[b] = true;
+        }
+    }
+    for(size_t b = 0; b < function.blocks.size(); b++)
+    {
+        for(auto &inst : function.blocks[b].insts)
+        {
+            count += body[b] && (inst.opcode == what || (inst.op == IROp::LOAD && inst.operands[0].name == what));
+        }
+    }
+    return count;
+}
+
+int main()
+{
+    auto original = program();
+    auto promoted = program();
+    CountedLoops counted(0);
+    counted.run(promoted);
+
+    check(counted.inductionVariables() == 4, std::to_string(counted.inductionVariables()) + " induction variables");
+    check(counted.reduced() == 6, std::to_string(counted.reduced()) + " strength reduced");
+    check(counted.unrolled() == 0, "a factor of 0 unrolls nothing");
+    for(auto name : {"@T.products", "@T.stride", "@T.down", "@T.branches"})
+    {
+        check(inLoop(method(promoted, name), "%i.addr") == 0, std::string(name) + ": the loads of i go");
+    }
+    auto &products = method(promoted, "@T.products");
+    check(inLoop(products, "mul") == 0 && inLoop(products, "shl") == 0,
+          "i * k, i << 2 and 3 * i become phis the latch adds to");
+    const std::vector<std::string> report = {
+        "@T.products for.cond.0: %i.addr, 3 strength reduced", "@T.stride for.cond.0: %i.addr, 3 strength reduced",
+        "@T.down for.cond.0: %i.addr", "@T.branches for.cond.0: %i.addr",
+    };
+    check(counted.report() == report, "one report line per loop, the first is " + counted.report()[0]);
+
+    auto unrolled = program();
+    CountedLoops four(4);
+    four.run(unrolled);
+    check(four.unrolled() == 2, std::to_string(four.unrolled()) + " loops unrolled, a counter that goes down "
+                                "or a body of more than one block is not");
+    check(four.report()[0] == "@T.products for.cond.0: %i.addr, 3 strength reduced, unrolled 4 times",
+          "the report of an unrolled loop is " + four.report()[0]);
+
+    for(auto name : {"@T.products", "@T.stride", "@T.down", "@T.branches"})
+    {
+        for(long long trips = 0; trips < 10; trips++)
+        {
+            Interpreter before(original);
+            Interpreter reduced(promoted);
+            Interpreter after(unrolled);
+            auto want = before.call(name, {trips, 5});
+            auto got = reduced.call(name, {trips, 5});
+            auto last = after.call(name, {trips, 5});
+            check(got == want && last == want, std::string(name) + "(" + std::to_string(trips) + ") is "
+                                               + std::to_string(got) + " and " + std::to_string(last)
+                                               + " unrolled, expected " + std::to_string(want));
+        }
+    }
+    Interpreter before(original);
+    Interpreter after(unrolled);
+    before.call("@T.products", {100, 5});
+    after.call("@T.products", {100, 5});
+    check(after.steps() < before.steps(), "the unrolled loop runs fewer instructions, "
+                                          + std::to_string(after.steps()) + " of " + std::to_string(before.steps()));
+
+    cout << failures << " failed" << endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,268 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+#include "../../compiler/ir.h"
+#include "../../compiler/ir.cc"
+#include "../../compiler/divide.h"
+#include "../../compiler/divide.cc"
+
+/*
+ * Lowers x / d and x % d for many divisors, runs the instructions on many
+ * dividends and compares with java's truncating division:
+ *   clang++ -std=c++11 -O2 test/compiler/divide_test.cc -o divide_test
+ *   ./divide_test           every divisor up to 4096 and the edges
+ *   ./divide_test --full    also every int dividend for a few divisors
+ */
+
+using namespace ycc;
+using std::cout;
+using std::endl;
+
+typedef __int128 Wide;
+
+// the lowered instructions, with their operands as indices into the values
+enum class Opcode
+{
+    ADD, SUB, MUL, AND, ASHR, LSHR, SEXT, TRUNC
+};
+
+struct Step
+{
+    Opcode          opcode;
+    int             bits;
+    int             lhs;
+    int             rhs;
+    int             result;
+};
+
+struct Program
+{
+    std::vector<Wide>   values;     // 0 is the dividend, then constants and results
+    std::vector<Step>   steps;
+    int                 result;
+};
+
+static Wide truncate(Wide value, int bits)
+{
+    if(bits >= 128)
+    {
+        return value;
+    }
+    int unused = 128 - bits;
+    return (Wide)((unsigned __int128)value << unused) >> unused;
+}
+
+static Program compile(bool remainder, int bits, long long divisor)
+{
+    IRFunction function{"@test", "void", {}, {}};
+    IRBuilder builder(&function);
+    auto type = bits == 32 ? "i32" : "i64";
+    IRValue dividend{type, "%x"};
+    IRValue result;
+    if(!divideByConstant(builder, remainder, dividend, divisor, result))
+    {
+        cout << "not lowered: " << divisor << endl;
+        std::exit(1);
+    }
+
+    Program program{{0}, {}, 0};
+    std::map<std::string, int> names{{"%x", 0}};
+    auto operand = [&](const IRValue &value)
+    {
+        if(!value.isConstant())
+        {
+            return names.at(value.name);
+        }
+        program.values.push_back((Wide)std::strtoll(value.name.c_str(), nullptr, 10));
+        return (int)program.values.size() - 1;
+    };
+    const std::map<std::string, Opcode> opcodes{
+        {"add", Opcode::ADD}, {"sub", Opcode::SUB}, {"mul", Opcode::MUL}, {"and", Opcode::AND},
+        {"ashr", Opcode::ASHR}, {"lshr", Opcode::LSHR}, {"sext", Opcode::SEXT}, {"trunc", Opcode::TRUNC}};
+    for(auto &inst : function.blocks[0].insts)
+    {
+        if(!opcodes.count(inst.opcode))
+        {
+            cout << "unknown opcode " << inst.opcode << endl;
+            std::exit(1);
+        }
+        Step step{opcodes.at(inst.opcode), std::atoi(inst.type.c_str() + 1), operand(inst.operands[0]), -1, 0};
+        if(inst.operands.size() > 1)
+        {
+            step.rhs = operand(inst.operands[1]);
+        }
+        program.values.push_back(0);
+        step.result = (int)program.values.size() - 1;
+        names[inst.result] = step.result;
+        program.steps.push_back(step);
+    }
+    program.result = result.isConstant() ? operand(result) : names.at(result.name);
+    return program;
+}
+
+static long long run(Program &program, long long x, int bits)
+{
+    auto &values = program.values;
+    values[0] = x;
+    for(auto &step : program.steps)
+    {
+        Wide a = values[step.lhs];
+        Wide b = step.rhs >= 0 ? values[step.rhs] : 0;
+        unsigned __int128 mask = step.bits >= 128 ? ~(unsigned __int128)0
+                                                  : (((unsigned __int128)1 << step.bits) - 1);
+        Wide value = a;
+        switch(step.opcode)
+        {
+        case Opcode::ADD:   value = a + b;          break;
+        case Opcode::SUB:   value = a - b;          break;
+        case Opcode::MUL:   value = (Wide)((unsigned __int128)a * (unsigned __int128)b);    break;
+        case Opcode::AND:   value = a & b;          break;
+        case Opcode::ASHR:  value = a >> (int)b;    break;
+        case Opcode::LSHR:  value = (Wide)(((unsigned __int128)a & mask) >> (int)b);       break;
+        case Opcode::SEXT:
+        case Opcode::TRUNC:
+            break;
+        }
+        // sext keeps the value, everything else wraps to the bits of its type
+        values[step.result] = truncate(value, step.bits);
+    }
+    return (long long)truncate(values[program.result], bits);
+}
+
+static long long failures = 0;
+
+// java: the quotient rounds toward zero, the smallest value divided by -1 is itself
+static void check(Program &quotient, Program &remainder, int bits, long long x, long long d)
+{
+    long long q, r;
+    long long smallest = bits == 32 ? INT32_MIN : INT64_MIN;
+    if(x == smallest && d == -1)
+    {
+        q = x;
+        r = 0;
+    }
+    else
+    {
+        q = x / d;
+        r = x % d;
+    }
+    auto gotQ = run(quotient, x, bits);
+    auto gotR = run(remainder, x, bits);
+    if((gotQ != q || gotR != r) && failures++ < 20)
+    {
+        cout << "i" << bits << " " << x << " / " << d << ": " << gotQ << " " << gotR
+             << ", expected " << q << " " << r << endl;
+    }
+}
+
+static std::vector<long long> divisors(int bits)
+{
+    long long largest = bits == 32 ? INT32_MAX : INT64_MAX;
+    std::vector<long long> all;
+    for(long long d = -4096; d <= 4096; d++)
+    {
+        if(d != 0)
+        {
+            all.push_back(d);
+        }
+    }
+    for(int k = 12; k < bits - 1; k++)
+    {
+        for(long long near = -2; near <= 2; near++)
+        {
+            all.push_back((1LL << k) + near);
+            all.push_back(-(1LL << k) - near);
+        }
+    }
+    all.push_back(largest);
+    all.push_back(-largest);
+    all.push_back(-largest - 1);
+    std::mt19937_64 random(42);
+    for(int i = 0; i < 2000; i++)
+    {
+        long long d = (long long)random();
+        d = bits == 32 ? (int)d : d;
+        if(d != 0)
+        {
+            all.push_back(d);
+        }
+    }
+    return all;
+}
+
+static std::vector<long long> dividends(int bits, long long d)
+{
+    Wide largest = bits == 32 ? INT32_MAX : INT64_MAX;
+    Wide smallest = -largest - 1;
+    std::vector<Wide> all;
+    for(Wide x = -300; x <= 300; x++)
+    {
+        all.push_back(x);
+        all.push_back(largest - 300 - x);
+        all.push_back(smallest + 300 + x);
+    }
+    // on both sides of multiples of the divisor, where the quotient steps
+    Wide ad = d < 0 ? -(Wide)d : (Wide)d;
+    for(Wide n = 1; n < 64; n++)
+    {
+        for(Wide near = -1; near <= 1; near++)
+        {
+            all.push_back(ad * n + near);
+            all.push_back(-ad * n + near);
+            all.push_back(largest / ad * ad - n + near);
+            all.push_back(smallest / ad * ad + n + near);
+        }
+    }
+    std::mt19937_64 random(d);
+    for(int i = 0; i < 200; i++)
+    {
+        long long x = (long long)random();
+        all.push_back(bits == 32 ? (int)x : x);
+    }
+    std::vector<long long> inRange;
+    for(auto x : all)
+    {
+        if(x >= smallest && x <= largest)
+        {
+            inRange.push_back((long long)x);
+        }
+    }
+    return inRange;
+}
+
+int main(int argc, char *argv[])
+{
+    bool full = argc > 1 && std::strcmp(argv[1], "--full") == 0;
+    long long divisions = 0;
+    for(int bits : {32, 64})
+    {
+        for(auto d : divisors(bits))
+        {
+            auto quotient = compile(false, bits, d);
+            auto remainder = compile(true, bits, d);
+            for(auto x : dividends(bits, d))
+            {
+                check(quotient, remainder, bits, x, d);
+                divisions++;
+            }
+        }
+    }
+    if(full)
+    {
+        for(long long d : {7LL, -10LL, 641LL, -(1LL << 12), (long long)INT32_MIN})
+        {
+            auto quotient = compile(false, 32, d);
+            auto remainder = compile(true, 32, d);
+            for(long long x = INT32_MIN; x <= INT32_MAX; x++)
+            {
+                check(quotient, remainder, 32, x, d);
+                divisions++;
+            }
+        }
+    }
+    cout << divisions << " divisions, " << failures << " wrong" << endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,235 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../../compiler/ir.h"
+#include "../../compiler/ir.cc"
+#include "../../compiler/escape.h"
+#include "../../compiler/escape.cc"
+#include "interpreter.h"
+
+/*
+ * Runs escape analysis on hand-built methods that make objects with
+ * new, checks which objects move to the stack and that every method
+ * computes what it did before:
+ *   clang++ -std=c++11 test/compiler/escape_test.cc -o escape_test
+ *   ./escape_test
+ */
+
+using namespace ycc;
+using std::cout;
+using std::endl;
+
+// new P(): { i32 x, i32 y }, or new Q(): { P *p }
+static IRValue allocate(IRBuilder &builder, const std::string &type)
+{
+    auto memory = builder.call("i8*", "@ycc.alloc", {IRValue{"i64", "8"}});
+    return builder.cast("bitcast", memory, type + "*");
+}
+
+static IRValue field(IRBuilder &builder, const IRValue &object, int index)
+{
+    auto type = object.type.substr(0, object.type.size() - 1);
+    auto fieldType = type == "%class.Q" ? "%class.P**" : "i32*";
+    return builder.gep(type, object, {zero, IRValue{"i32", std::to_string(index)}}, fieldType);
+}
+
+// p.x += 1
+static IRFunction use()
+{
+    IRFunction function{"@T.use", "void", {IRValue{"%class.P*", "%p"}}, {}};
+    IRBuilder builder(&function);
+    auto x = field(builder, IRValue{"%class.P*", "%p"}, 0);
+    builder.store(builder.binary("add", builder.load("i32", x), IRValue{"i32", "1"}), x);
+    builder.retVoid();
+    return function;
+}
+
+// p.x * p.y of a p nobody else sees
+static IRFunction local()
+{
+    IRFunction function{"@T.local", "i32", {n}, {}};
+    IRBuilder builder(&function);
+    auto p = allocate(builder, "%class.P");
+    builder.store(n, field(builder, p, 0));
+    builder.store(IRValue{"i32", "3"}, field(builder, p, 1));
+    auto x = builder.load("i32", field(builder, p, 0));
+    builder.ret(builder.binary("mul", x, builder.load("i32", field(builder, p, 1))));
+    return function;
+}
+
+static IRFunction passed()
+{
+    IRFunction function{"@T.passed", "i32", {n}, {}};
+    IRBuilder builder(&function);
+    auto p = allocate(builder, "%class.P");
+    builder.store(n, field(builder, p, 0));
+    builder.call("void", "@T.use", {p});
+    builder.ret(builder.load("i32", field(builder, p, 0)));
+    return function;
+}
+
+static IRFunction returned()
+{
+    IRFunction function{"@T.returned", "%class.P*", {}, {}};
+    IRBuilder builder(&function);
+    builder.ret(allocate(builder, "%class.P"));
+    return function;
+}
+
+// q.p = p: q stays local, p is stored into memory that is not a stack slot
+static IRFunction stored()
+{
+    IRFunction function{"@T.stored", "i32", {n}, {}};
+    IRBuilder builder(&function);
+    auto q = allocate(builder, "%class.Q");
+    auto p = allocate(builder, "%class.P");
+    builder.store(n, field(builder, p, 0));
+    builder.store(p, field(builder, q, 0));
+    auto back = builder.load("%class.P*", field(builder, q, 0));
+    builder.ret(builder.load("i32", field(builder, back, 0)));
+    return function;
+}
+
+// P s = new P(); use(s): the call sees the object through the slot of s
+static IRFunction slot()
+{
+    IRFunction function{"@T.slot", "i32", {n}, {}};
+    IRBuilder builder(&function);
+    auto s = builder.allocate("%class.P*", "s");
+    builder.store(allocate(builder, "%class.P"), s);
+    auto p = builder.load("%class.P*", s);
+    builder.store(n, field(builder, p, 0));
+    builder.call("void", "@T.use", {builder.load("%class.P*", s)});
+    builder.ret(builder.load("i32", field(builder, builder.load("%class.P*", s), 0)));
+    return function;
+}
+
+/*
+ * for(i = 0; i < n; i++) { p = new P(); p.x += i; sum += p.x; } with the
+ * object dead before the next one; or chained = true, where each object
+ * reads the one before: last = new P(); for(...) { p = new P();
+ * p.x = last.x + 1; last = p; } return last.x
+ */
+static IRFunction loop(const std::string &name, bool chained)
+{
+    IRFunction function{name, "i32", {n}, {}};
+    IRBuilder builder(&function);
+    auto i = builder.allocate("i32", "i");
+    auto sum = builder.allocate("i32", "sum");
+    auto last = builder.allocate("%class.P*", "last");
+    builder.store(zero, i);
+    builder.store(zero, sum);
+    builder.store(allocate(builder, "%class.P"), last);
+    auto cond = builder.newLabel("for.cond");
+    auto body = builder.newLabel("for.body");
+    auto end = builder.newLabel("for.end");
+    builder.setBlock(cond);
+    builder.condBr(builder.cmp("icmp slt", builder.load("i32", i), n), body, end);
+    builder.setBlock(body);
+    auto p = allocate(builder, "%class.P");
+    auto x = field(builder, p, 0);
+    if(chained)
+    {
+        auto before = builder.load("i32", field(builder, builder.load("%class.P*", last), 0));
+        builder.store(builder.binary("add", before, IRValue{"i32", "1"}), x);
+        builder.store(p, last);
+    }
+    else
+    {
+        // the new object starts at zero whether or not it reuses a slot
+        builder.store(builder.binary("add", builder.load("i32", x), builder.load("i32", i)), x);
+        builder.store(builder.binary("add", builder.load("i32", sum), builder.load("i32", x)), sum);
+    }
+    builder.store(builder.binary("add", builder.load("i32", i), IRValue{"i32", "1"}), i);
+    builder.br(cond);
+    builder.setBlock(end);
+    if(chained)
+    {
+        builder.ret(builder.load("i32", field(builder, builder.load("%class.P*", last), 0)));
+    }
+    else
+    {
+        builder.ret(builder.load("i32", sum));
+    }
+    return function;
+}
+
+static std::vector<IRFunction> program()
+{
+    return {use(), local(), passed(), returned(), stored(), slot(), loop("@T.fresh", false),
+            loop("@T.chained", true)};
+}
+
+static int allocations(const IRFunction &function)
+{
+    int count = 0;
+    for(auto &block : function.blocks)
+    {
+        for(auto &inst : block.insts)
+        {
+            count += inst.op == IROp::CALL && inst.opcode == "@ycc.alloc";
+        }
+    }
+    return count;
+}
+
+// allocas of objects, at the head of the entry block
+static int onStack(const IRFunction &function)
+{
+    int count = 0;
+    for(auto &inst : function.blocks[0].insts)
+    {
+        count += inst.op == IROp::ALLOCA && inst.type.compare(0, 7, "%class.") == 0 && inst.type.back() != '*';
+    }
+    return count;
+}
+
+int main()
+{
+    auto original = program();
+    auto functions = program();
+    EscapeAnalysis escape;
+    escape.run(functions);
+
+    struct Expected
+    {
+        const char *    name;
+        int             heap;
+        int             stack;
+        const char *    why;
+    };
+    const Expected expected[] = {
+        {"@T.local", 0, 1, "an object only its method reads"},
+        {"@T.passed", 1, 0, "an object passed to a call"},
+        {"@T.returned", 1, 0, "a returned object"},
+        {"@T.stored", 1, 1, "an object stored in a field; the object holding it"},
+        {"@T.slot", 1, 0, "an object a call reads from a local"},
+        {"@T.fresh", 0, 2, "a new in a loop whose object is dead at the next one, and the one before the loop"},
+        {"@T.chained", 1, 1, "a new in a loop that reads the object before; the first object"},
+    };
+    for(auto &entry : expected)
+    {
+        auto &function = method(functions, entry.name);
+        check(allocations(function) == entry.heap && onStack(function) == entry.stack,
+              std::string(entry.name) + ": " + entry.why + ", " + std::to_string(allocations(function))
+              + " on the heap and " + std::to_string(onStack(function)) + " on the stack");
+    }
+    check(escape.allocations() == 10 && escape.onStack() == 5,
+          std::to_string(escape.onStack()) + " of " + std::to_string(escape.allocations()) + " on the stack");
+
+    for(auto name : {"@T.local", "@T.passed", "@T.stored", "@T.slot", "@T.fresh", "@T.chained"})
+    {
+        for(long long x : {0LL, 1LL, 5LL})
+        {
+            Interpreter before(original);
+            Interpreter after(functions);
+            auto want = before.call(name, {x});
+            auto got = after.call(name, {x});
+            check(got == want, std::string(name) + "(" + std::to_string(x) + ") is " + std::to_string(got)
+                               + ", expected " + std::to_string(want));
+        }
+    }
+
+    cout << failures << " failed" << endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,207 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../../compiler/ir.h"
+#include "../../compiler/ir.cc"
+#include "../../compiler/dominators.h"
+#include "../../compiler/dominators.cc"
+#include "../../compiler/gvn.h"
+#include "../../compiler/gvn.cc"
+#include "interpreter.h"
+
+/*
+ * Numbers the values of hand-built methods, checks which values and
+ * loads are found redundant and that every method computes what it did
+ * before, with pointers that are the same and that are not:
+ *   clang++ -std=c++11 test/compiler/gvn_test.cc -o gvn_test
+ *   ./gvn_test
+ */
+
+using namespace ycc;
+using std::cout;
+using std::endl;
+
+static const IRValue q{"double*", "%q"};
+static const IRValue r{"i32*", "%r"};
+
+// (n + m) * (m + n) + (n - m) * (m - n): m + n is n + m, m - n is not n - m
+static IRFunction commute()
+{
+    IRFunction function{"@T.commute", "i32", {n, m}, {}};
+    IRBuilder builder(&function);
+    auto x = builder.binary("add", n, m);
+    auto y = builder.binary("add", m, n);
+    auto d = builder.binary("sub", n, m);
+    auto e = builder.binary("sub", m, n);
+    builder.ret(builder.binary("add", builder.binary("mul", x, y), builder.binary("mul", d, e)));
+    return function;
+}
+
+/*
+ * a = n * 3 in the entry; if.then computes n * 3 and n + 7, if.else
+ * computes n + 7 too and join n * 3 again: the ones below the entry are
+ * a, the n + 7 of if.else is not the one of its sibling
+ */
+static IRFunction dominance()
+{
+    IRFunction function{"@T.dominance", "i32", {n}, {}};
+    IRBuilder builder(&function);
+    auto three = IRValue{"i32", "3"};
+    auto seven = IRValue{"i32", "7"};
+    auto a = builder.binary("mul", n, three);
+    auto then = builder.newLabel("if.then");
+    auto otherwise = builder.newLabel("if.else");
+    auto join = builder.newLabel("join");
+    builder.condBr(builder.cmp("icmp sgt", n, zero), then, otherwise);
+    builder.setBlock(then);
+    auto t = builder.binary("add", builder.binary("mul", n, three), builder.binary("add", n, seven));
+    builder.br(join);
+    builder.setBlock(otherwise);
+    auto e = builder.binary("add", a, builder.binary("add", n, seven));
+    builder.br(join);
+    builder.setBlock(join);
+    auto phi = builder.phi("i32", {t, IRValue{"label", then}, e, IRValue{"label", otherwise}});
+    builder.ret(builder.binary("sub", phi, builder.binary("mul", n, three)));
+    return function;
+}
+
+// *p = 9
+static IRFunction poke()
+{
+    IRFunction function{"@T.poke", "void", {p}, {}};
+    IRBuilder builder(&function);
+    builder.store(IRValue{"i32", "9"}, p);
+    builder.retVoid();
+    return function;
+}
+
+// s = n; poke(...); return s: the call can not see the slot
+static IRFunction slot()
+{
+    IRFunction function{"@T.slot", "i32", {n, p}, {}};
+    IRBuilder builder(&function);
+    auto s = builder.allocate("i32", "s");
+    builder.store(n, s);
+    builder.call("void", "@T.poke", {p});
+    builder.ret(builder.load("i32", s));
+    return function;
+}
+
+/*
+ * x = *p; *q = 1.0; y = *p; *r = 5; z = *p; poke(p); w = *p: a store of a
+ * double keeps what p holds, a store of an i32 and a call do not
+ */
+static IRFunction memory()
+{
+    IRFunction function{"@T.memory", "i32", {p, q, r}, {}};
+    IRBuilder builder(&function);
+    auto x = builder.load("i32", p);
+    builder.store(IRValue{"double", "1.0"}, q);
+    auto y = builder.load("i32", p);
+    builder.store(IRValue{"i32", "5"}, r);
+    auto z = builder.load("i32", p);
+    builder.call("void", "@T.poke", {p});
+    auto w = builder.load("i32", p);
+    auto sum = builder.binary("add", builder.binary("add", x, y), builder.binary("mul", z, IRValue{"i32", "10"}));
+    builder.ret(builder.binary("add", sum, builder.binary("mul", w, IRValue{"i32", "100"})));
+    return function;
+}
+
+// x = *p; if(n > 0) y = *p; else *p = 7; z = *p at the join
+static IRFunction join()
+{
+    IRFunction function{"@T.join", "i32", {p, n}, {}};
+    IRBuilder builder(&function);
+    auto x = builder.load("i32", p);
+    auto then = builder.newLabel("if.then");
+    auto otherwise = builder.newLabel("if.else");
+    auto end = builder.newLabel("if.end");
+    builder.condBr(builder.cmp("icmp sgt", n, zero), then, otherwise);
+    builder.setBlock(then);
+    auto y = builder.load("i32", p);
+    builder.br(end);
+    builder.setBlock(otherwise);
+    builder.store(IRValue{"i32", "7"}, p);
+    builder.br(end);
+    builder.setBlock(end);
+    auto phi = builder.phi("i32", {y, IRValue{"label", then}, zero, IRValue{"label", otherwise}});
+    auto z = builder.load("i32", p);
+    builder.ret(builder.binary("add", builder.binary("add", x, phi), builder.binary("mul", z, IRValue{"i32", "10"})));
+    return function;
+}
+
+static std::vector<IRFunction> program()
+{
+    return {commute(), dominance(), poke(), slot(), memory(), join()};
+}
+
+static int count(const IRFunction &function, IROp op)
+{
+    int count = 0;
+    for(auto &block : function.blocks)
+    {
+        for(auto &inst : block.insts)
+        {
+            count += inst.op == op;
+        }
+    }
+    return count;
+}
+
+int main()
+{
+    auto original = program();
+    auto functions = program();
+    ValueNumbering gvn;
+    gvn.run(functions);
+
+    struct Expected
+    {
+        const char *    name;
+        IROp            op;
+        int             left;
+        const char *    why;
+    };
+    const Expected expected[] = {
+        {"@T.commute", IROp::BINARY, 6, "m + n is n + m, m - n stays"},
+        {"@T.dominance", IROp::BINARY, 6, "n * 3 below the entry is a, n + 7 of the sibling stays"},
+        {"@T.slot", IROp::LOAD, 0, "the load of a slot a call can not see is the value stored"},
+        {"@T.memory", IROp::LOAD, 3, "a store of a double keeps *p, an i32 store and a call forget it"},
+        {"@T.join", IROp::LOAD, 2, "if.then has the load of the entry, the join does not"},
+    };
+    for(auto &entry : expected)
+    {
+        auto left = count(method(functions, entry.name), entry.op);
+        check(left == entry.left, std::string(entry.name) + ": " + entry.why + ", " + std::to_string(left) + " left");
+    }
+    check(gvn.redundantValues() == 3, std::to_string(gvn.redundantValues()) + " redundant values");
+    check(gvn.redundantLoads() == 3, std::to_string(gvn.redundantLoads()) + " redundant loads");
+
+    const std::vector<std::pair<const char *, std::vector<long long>>> calls = {
+        {"@T.commute", {3, 5}},
+        {"@T.commute", {-2, 7}},
+        {"@T.dominance", {4}},
+        {"@T.dominance", {-4}},
+        {"@T.slot", {6, 100}},
+        {"@T.memory", {100, 200, 300}},
+        {"@T.memory", {100, 200, 100}},
+        {"@T.join", {100, 1}},
+        {"@T.join", {100, 0}},
+    };
+    for(auto &call : calls)
+    {
+        Interpreter before(original);
+        Interpreter after(functions);
+        for(auto *interpreter : {&before, &after})
+        {
+            interpreter->store(100, 2);
+        }
+        auto want = before.call(call.first, call.second);
+        auto got = after.call(call.first, call.second);
+        check(got == want, std::string(call.first) + " with " + std::to_string(call.second[0]) + " is "
+                           + std::to_string(got) + ", expected " + std::to_string(want));
+    }
+
+    cout << failures << " failed" << endl;
+    return failures == 0 ? 0 : 1;
+}
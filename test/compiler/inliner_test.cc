@@ -0,0 +1,226 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../../compiler/ir.h"
+#include "../../compiler/ir.cc"
+#include "../../common/compile_cache.h"
+#include "../../common/compile_cache.cc"
+#include "../../compiler/profile.h"
+#include "../../compiler/profile.cc"
+#include "../../compiler/inliner.h"
+#include "../../compiler/inliner.cc"
+#include "interpreter.h"
+
+/*
+ * Inlines small methods of a hand-built program and checks which calls
+ * are expanded and that the program computes what it did before:
+ *   clang++ -std=c++11 test/compiler/inliner_test.cc -o inliner_test
+ *   ./inliner_test
+ */
+
+using namespace ycc;
+using std::cout;
+using std::endl;
+
+// x * x, through the stack slot the generator gives every parameter
+static IRFunction square()
+{
+    IRFunction function{"@C.square", "i32", {IRValue{"i32", "%x"}}, {}};
+    IRBuilder builder(&function);
+    auto slot = builder.allocate("i32", "x");
+    builder.store(IRValue{"i32", "%x"}, slot);
+    auto x = builder.load("i32", slot);
+    builder.ret(builder.binary("mul", x, x));
+    return function;
+}
+
+// two returns, the expansion joins them with a phi
+static IRFunction absolute()
+{
+    IRFunction function{"@C.abs", "i32", {IRValue{"i32", "%x"}}, {}};
+    IRBuilder builder(&function);
+    IRValue x{"i32", "%x"};
+    auto negative = builder.newLabel("if.then");
+    auto positive = builder.newLabel("if.else");
+    builder.condBr(builder.cmp("icmp slt", x, IRValue{"i32", "0"}), negative, positive);
+    builder.setBlock(negative);
+    builder.ret(builder.binary("sub", IRValue{"i32", "0"}, x));
+    builder.setBlock(positive);
+    builder.ret(x);
+    return function;
+}
+
+static IRFunction quad()
+{
+    IRFunction function{"@C.quad", "i32", {IRValue{"i32", "%x"}}, {}};
+    IRBuilder builder(&function);
+    auto twice = builder.call("i32", "@C.square", {IRValue{"i32", "%x"}});
+    builder.ret(builder.call("i32", "@C.square", {twice}));
+    return function;
+}
+
+// recursive, never expanded
+static IRFunction fact()
+{
+    IRFunction function{"@C.fact", "i32", {IRValue{"i32", "%x"}}, {}};
+    IRBuilder builder(&function);
+    IRValue x{"i32", "%x"};
+    auto done = builder.newLabel("if.then");
+    auto more = builder.newLabel("if.else");
+    builder.condBr(builder.cmp("icmp sle", x, IRValue{"i32", "1"}), done, more);
+    builder.setBlock(done);
+    builder.ret(IRValue{"i32", "1"});
+    builder.setBlock(more);
+    auto rest = builder.call("i32", "@C.fact", {builder.binary("sub", x, IRValue{"i32", "1"})});
+    builder.ret(builder.binary("mul", x, rest));
+    return function;
+}
+
+// more instructions than the threshold of the test
+static IRFunction big()
+{
+    IRFunction function{"@C.big", "i32", {IRValue{"i32", "%x"}}, {}};
+    IRBuilder builder(&function);
+    IRValue value{"i32", "%x"};
+    for(int i = 0; i < 30; i++)
+    {
+        value = builder.binary(i % 2 ? "xor" : "add", value, IRValue{"i32", std::to_string(i + 1)});
+    }
+    builder.ret(value);
+    return function;
+}
+
+// never returns, a call of it is kept
+static IRFunction failing()
+{
+    IRFunction function{"@C.fail", "void", {}, {}};
+    IRBuilder builder(&function);
+    builder.call("void", "@io.printInt", {IRValue{"i32", "-1"}});
+    builder.unreachable();
+    return function;
+}
+
+/*
+ * n > 100 fails, else square(n) + abs(n - 10) + quad(n) + fact(n % 8) +
+ * big(n); the call of square is in a block whose successor has a phi, so
+ * the expansion has to rename its incoming block.
+ */
+static IRFunction top()
+{
+    IRFunction function{"@C.main", "i32", {n}, {}};
+    IRBuilder builder(&function);
+    auto bad = builder.newLabel("if.then");
+    auto good = builder.newLabel("if.end");
+    builder.condBr(builder.cmp("icmp sgt", n, IRValue{"i32", "100"}), bad, good);
+    builder.setBlock(bad);
+    builder.call("void", "@C.fail", {});
+    builder.unreachable();
+    builder.setBlock(good);
+    auto small = builder.newLabel("if.then");
+    auto join = builder.newLabel("if.end");
+    auto entry = builder.currentLabel();
+    builder.condBr(builder.cmp("icmp slt", n, IRValue{"i32", "50"}), small, join);
+    builder.setBlock(small);
+    auto squared = builder.call("i32", "@C.square", {n});
+    auto smallEnd = builder.currentLabel();
+    builder.br(join);
+    builder.setBlock(join);
+    auto sum = builder.phi("i32", {squared, IRValue{"label", smallEnd}, IRValue{"i32", "7"}, IRValue{"label", entry}});
+    sum = builder.binary("add", sum, builder.call("i32", "@C.abs", {builder.binary("sub", n, IRValue{"i32", "10"})}));
+    sum = builder.binary("add", sum, builder.call("i32", "@C.quad", {n}));
+    sum = builder.binary("add", sum, builder.call("i32", "@C.fact", {builder.binary("srem", n, IRValue{"i32", "8"})}));
+    sum = builder.binary("add", sum, builder.call("i32", "@C.big", {n}));
+    builder.ret(sum);
+    return function;
+}
+
+static std::vector<IRFunction> program()
+{
+    return {square(), absolute(), quad(), fact(), big(), failing(), top()};
+}
+
+static int calls(const IRFunction &function, const std::string &callee)
+{
+    int count = 0;
+    for(auto &block : function.blocks)
+    {
+        for(auto &inst : block.insts)
+        {
+            count += inst.op == IROp::CALL && inst.opcode == callee;
+        }
+    }
+    return count;
+}
+
+// every alloca at the head of the entry block
+static bool allocasInEntry(const IRFunction &function)
+{
+    for(size_t b = 0; b < function.blocks.size(); b++)
+    {
+        bool head = b == 0;
+        for(auto &inst : function.blocks[b].insts)
+        {
+            if(inst.op == IROp::ALLOCA && !head)
+            {
+                return false;
+            }
+            head = head && inst.op == IROp::ALLOCA;
+        }
+    }
+    return true;
+}
+
+static void sameResults(const std::vector<IRFunction> &before, const std::vector<IRFunction> &after,
+                        const std::string &what)
+{
+    for(long long x : {-20LL, 0LL, 3LL, 10LL, 49LL, 50LL, 77LL, 100LL})
+    {
+        Interpreter original(before);
+        Interpreter inlined(after);
+        auto expected = original.call("@C.main", {x});
+        auto got = inlined.call("@C.main", {x});
+        check(got == expected, what + ": main(" + std::to_string(x) + ") is " + std::to_string(got)
+                               + ", expected " + std::to_string(expected));
+    }
+}
+
+int main()
+{
+    auto original = program();
+
+    auto functions = program();
+    Inliner inliner(20);
+    inliner.run(functions);
+    auto &caller = method(functions, "@C.main");
+    check(calls(caller, "@C.square") == 0, "square is inlined");
+    check(calls(caller, "@C.abs") == 0, "abs, with two returns, is inlined");
+    check(calls(caller, "@C.quad") == 0, "quad is inlined after the squares it calls");
+    check(calls(method(functions, "@C.quad"), "@C.square") == 0, "quad has its squares inlined");
+    check(calls(caller, "@C.fact") == 1, "recursive fact keeps its call");
+    check(calls(method(functions, "@C.fact"), "@C.fact") == 1, "fact still calls itself");
+    check(calls(caller, "@C.big") == 1, "big is over the threshold");
+    check(calls(caller, "@C.fail") == 1, "a method that never returns keeps its call");
+    check(allocasInEntry(caller), "the allocas of the callees move to the entry block");
+    check(inliner.inlined() == 5, "two squares in quad, square, abs and quad in main: "
+                                  + std::to_string(inliner.inlined()));
+    check(Inliner::cost(square()) == 4, "the cost of square leaves out its alloca");
+    sameResults(original, functions, "threshold 20");
+
+    // a threshold of zero expands nothing
+    auto untouched = program();
+    Inliner none(0);
+    none.run(untouched);
+    check(none.inlined() == 0, "nothing is inlined at threshold 0");
+    check(calls(method(untouched, "@C.main"), "@C.square") == 1, "square is kept at threshold 0");
+
+    // big fits a larger threshold; the calls of recursive methods are still kept
+    auto all = program();
+    Inliner large(1000);
+    large.run(all);
+    check(calls(method(all, "@C.main"), "@C.big") == 0, "big is inlined at threshold 1000");
+    check(calls(method(all, "@C.main"), "@C.fact") == 1, "fact is never inlined");
+    sameResults(original, all, "threshold 1000");
+
+    cout << failures << " failed" << endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,372 @@
+#ifndef TEST_INTERPRETER_H_
+#define TEST_INTERPRETER_H_
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "../../compiler/ir.h"
+
+/*
+ * Runs the IR of the pass tests, so a test can compare what a method
+ * computes before and after a pass. Integers are kept as long long and
+ * wrapped to the width of their type. Memory is cells, not bytes: a
+ * pointer is the number of a cell, every alloca, @ycc.alloc and static
+ * gets cells of its own and a gep adds its first index times a region
+ * and the others as they are, which is enough for a field or an element
+ * of { i32, [0 x T] }; a store of zeroinitializer clears the cells of an
+ * object. @io.printInt is recorded, other calls out of the program
+ * return 0.
+ */
+namespace ycc
+{
+    class Interpreter
+    {
+      public:
+        explicit Interpreter(const std::vector<IRFunction> &functions)
+            : functions_(functions),next_(region_),steps_(0)
+        {
+        }
+
+        long long           call(const std::string &name, const std::vector<long long> &args);
+        long long           steps() const { return steps_; }    // instructions run
+        const std::vector<long long> &  printed() const { return printed_; }
+
+        long long           load(long long cell) { return memory_[cell]; }
+        void                store(long long cell, long long value) { memory_[cell] = value; }
+        long long           allocate() { next_ += region_; return next_; }
+
+      private:
+        static const long long          region_ = 1 << 20;
+
+        const IRFunction &  function(const std::string &name) const;
+        long long           value(const IRValue &value, const std::map<std::string, long long> &values);
+        long long           run(const IRFunction &function, const std::vector<long long> &args);
+        static long long    wrap(long long value, const std::string &type);
+        static void         fail(const std::string &what);
+
+      private:
+        const std::vector<IRFunction> &         functions_;
+        std::map<long long, long long>          memory_;
+        std::map<std::string, long long>        statics_;
+        std::vector<long long>                  printed_;
+        long long                               next_;
+        long long                               steps_;
+    };
+
+    inline void Interpreter::fail(const std::string &what)
+    {
+        std::cout << "interpreter: " << what << std::endl;
+        std::exit(1);
+    }
+
+    inline long long Interpreter::wrap(long long value, const std::string &type)
+    {
+        if(type.size() < 2 || type[0] != 'i' || type.back() == '*')
+        {
+            return value;
+        }
+        int bits = std::atoi(type.c_str() + 1);
+        if(bits <= 0 || bits >= 64)
+        {
+            return value;
+        }
+        unsigned long long mask = (1ULL << bits) - 1;
+        unsigned long long wrapped = (unsigned long long)value & mask;
+        if(bits > 1 && (wrapped >> (bits - 1)))
+        {
+            wrapped |= ~mask;
+        }
+        return (long long)wrapped;
+    }
+
+    inline const IRFunction & Interpreter::function(const std::string &name) const
+    {
+        for(auto &function : functions_)
+        {
+            if(function.name == name)
+            {
+                return function;
+            }
+        }
+        fail("no method " + name);
+        return functions_[0];
+    }
+
+    inline long long Interpreter::value(const IRValue &value, const std::map<std::string, long long> &values)
+    {
+        auto &name = value.name;
+        if(name == "true")
+        {
+            return 1;
+        }
+        if(name == "false" || name == "null" || name == "zeroinitializer" || name == "undef")
+        {
+            return 0;
+        }
+        if(name[0] == '@')
+        {
+            auto iter = statics_.find(name);
+            if(iter == statics_.end())
+            {
+                iter = statics_.insert(std::make_pair(name, allocate())).first;
+            }
+            return iter->second;
+        }
+        if(name[0] == '%')
+        {
+            auto iter = values.find(name);
+            if(iter == values.end())
+            {
+                fail("use of " + name + " before its definition");
+            }
+            return iter->second;
+        }
+        return std::strtoll(name.c_str(), nullptr, 10);
+    }
+
+    inline long long Interpreter::call(const std::string &name, const std::vector<long long> &args)
+    {
+        return run(function(name), args);
+    }
+
+    inline long long Interpreter::run(const IRFunction &function, const std::vector<long long> &args)
+    {
+        std::map<std::string, long long> values;
+        for(size_t i = 0; i < function.params.size() && i < args.size(); i++)
+        {
+            values[function.params[i].name] = wrap(args[i], function.params[i].type);
+        }
+        std::map<std::string, size_t> labels;
+        for(size_t b = 0; b < function.blocks.size(); b++)
+        {
+            labels[function.blocks[b].label] = b;
+        }
+
+        size_t block = 0;
+        std::string from;
+        while(true)
+        {
+            auto &insts = function.blocks[block].insts;
+            // the phis of a block read their values together, on the edge taken
+            std::vector<std::pair<std::string, long long>> phis;
+            for(auto &inst : insts)
+            {
+                if(inst.op != IROp::PHI)
+                {
+                    break;
+                }
+                bool found = false;
+                for(size_t i = 0; i + 1 < inst.operands.size() && !found; i += 2)
+                {
+                    if(inst.operands[i + 1].name == from)
+                    {
+                        phis.push_back(std::make_pair(inst.result, value(inst.operands[i], values)));
+                        found = true;
+                    }
+                }
+                if(!found)
+                {
+                    fail("phi " + inst.result + " has no value from " + from);
+                }
+                steps_++;
+            }
+            for(auto &phi : phis)
+            {
+                values[phi.first] = phi.second;
+            }
+
+            std::string next;
+            for(size_t i = phis.size(); i < insts.size() && next.empty(); i++)
+            {
+                auto &inst = insts[i];
+                auto &ops = inst.operands;
+                long long result = 0;
+                steps_++;
+                switch(inst.op)
+                {
+                case IROp::ALLOCA:
+                    result = allocate();
+                    break;
+                case IROp::LOAD:
+                    result = memory_[value(ops[0], values)];
+                    break;
+                case IROp::STORE:
+                    if(ops[0].name == "zeroinitializer")
+                    {
+                        // every field of an object
+                        auto cell = value(ops[1], values);
+                        memory_.erase(memory_.lower_bound(cell), memory_.lower_bound(cell + region_));
+                        break;
+                    }
+                    memory_[value(ops[1], values)] = value(ops[0], values);
+                    break;
+                case IROp::BINARY:
+                {
+                    long long a = value(ops[0], values);
+                    long long b = value(ops[1], values);
+                    unsigned long long ua = (unsigned long long)a;
+                    if((inst.opcode == "sdiv" || inst.opcode == "srem") && b == 0)
+                    {
+                        fail("division by zero");
+                    }
+                    if(inst.opcode == "add")            result = (long long)(ua + (unsigned long long)b);
+                    else if(inst.opcode == "sub")       result = (long long)(ua - (unsigned long long)b);
+                    else if(inst.opcode == "mul")       result = (long long)(ua * (unsigned long long)b);
+                    else if(inst.opcode == "sdiv")      result = a / b;
+                    else if(inst.opcode == "srem")      result = a % b;
+                    else if(inst.opcode == "shl")       result = (long long)(ua << b);
+                    else if(inst.opcode == "ashr")      result = a >> b;
+                    else if(inst.opcode == "and")       result = a & b;
+                    else if(inst.opcode == "or")        result = a | b;
+                    else if(inst.opcode == "xor")       result = a ^ b;
+                    else fail("unknown opcode " + inst.opcode);
+                    break;
+                }
+                case IROp::CMP:
+                {
+                    long long a = value(ops[0], values);
+                    long long b = value(ops[1], values);
+                    // unsigned compares of the width of the operands
+                    int bits = ops[0].type[0] == 'i' ? std::atoi(ops[0].type.c_str() + 1) : 64;
+                    unsigned long long mask = bits > 0 && bits < 64 ? (1ULL << bits) - 1 : ~0ULL;
+                    unsigned long long ua = (unsigned long long)a & mask, ub = (unsigned long long)b & mask;
+                    if(inst.opcode == "icmp eq")        result = a == b;
+                    else if(inst.opcode == "icmp ne")   result = a != b;
+                    else if(inst.opcode == "icmp slt")  result = a < b;
+                    else if(inst.opcode == "icmp sle")  result = a <= b;
+                    else if(inst.opcode == "icmp sgt")  result = a > b;
+                    else if(inst.opcode == "icmp sge")  result = a >= b;
+                    else if(inst.opcode == "icmp ult")  result = ua < ub;
+                    else if(inst.opcode == "icmp ule")  result = ua <= ub;
+                    else if(inst.opcode == "icmp ugt")  result = ua > ub;
+                    else if(inst.opcode == "icmp uge")  result = ua >= ub;
+                    else fail("unknown compare " + inst.opcode);
+                    break;
+                }
+                case IROp::CAST:
+                {
+                    result = value(ops[0], values);
+                    if(inst.opcode == "zext" && ops[0].type[0] == 'i')
+                    {
+                        int bits = std::atoi(ops[0].type.c_str() + 1);
+                        result = bits > 0 && bits < 64 ? (long long)((unsigned long long)result & ((1ULL << bits) - 1))
+                                                       : result;
+                    }
+                    break;
+                }
+                case IROp::GEP:
+                    result = value(ops[0], values) + value(ops[1], values) * region_;
+                    for(size_t k = 2; k < ops.size(); k++)
+                    {
+                        result += value(ops[k], values);
+                    }
+                    break;
+                case IROp::SELECT:
+                    result = value(ops[0], values) ? value(ops[1], values) : value(ops[2], values);
+                    break;
+                case IROp::CALL:
+                {
+                    std::vector<long long> args;
+                    for(auto &operand : ops)
+                    {
+                        args.push_back(value(operand, values));
+                    }
+                    if(inst.opcode == "@io.printInt")
+                    {
+                        printed_.push_back(args[0]);
+                    }
+                    else if(inst.opcode == "@ycc.alloc")
+                    {
+                        result = allocate();
+                    }
+                    else if(inst.opcode.compare(0, 4, "@io.") != 0 && inst.opcode.compare(0, 5, "@ycc.") != 0)
+                    {
+                        result = call(inst.opcode, args);
+                    }
+                    break;
+                }
+                case IROp::BR:
+                    next = ops[0].name;
+                    break;
+                case IROp::CONDBR:
+                    next = value(ops[0], values) ? ops[1].name : ops[2].name;
+                    break;
+                case IROp::SWITCH:
+                {
+                    long long on = value(ops[0], values);
+                    next = ops[1].name;
+                    for(size_t k = 2; k + 1 < ops.size(); k += 2)
+                    {
+                        if(value(ops[k], values) == on)
+                        {
+                            next = ops[k + 1].name;
+                            break;
+                        }
+                    }
+                    break;
+                }
+                case IROp::RET:
+                    return ops.empty() ? 0 : value(ops[0], values);
+                case IROp::UNREACHABLE:
+                    fail("unreachable in " + function.name);
+                    break;
+                case IROp::PHI:
+                    fail("phi " + inst.result + " after the head of its block");
+                    break;
+                }
+                if(!inst.result.empty())
+                {
+                    values[inst.result] = wrap(result, inst.type);
+                }
+            }
+            if(next.empty())
+            {
+                fail("block " + function.blocks[block].label + " of " + function.name + " falls through");
+            }
+            if(!labels.count(next))
+            {
+                fail("no block " + next + " in " + function.name);
+            }
+            from = function.blocks[block].label;
+            block = labels[next];
+        }
+    }
+}
+
+// what every test counts its failures with
+static int failures = 0;
+
+static void check(bool ok, const std::string &what)
+{
+    if(!ok)
+    {
+        std::cout << "failed: " << what << std::endl;
+        failures++;
+    }
+}
+
+// parameters and constants the hand-built methods are made of
+static const ycc::IRValue n{"i32", "%n"};
+static const ycc::IRValue m{"i32", "%m"};
+static const ycc::IRValue k{"i32", "%k"};
+static const ycc::IRValue p{"i32*", "%p"};
+static const ycc::IRValue zero{"i32", "0"};
+static const ycc::IRValue one{"i32", "1"};
+static const ycc::IRValue two{"i32", "2"};
+
+// the method of that name, or the first one
+inline const ycc::IRFunction & method(const std::vector<ycc::IRFunction> &functions, const std::string &name)
+{
+    for(auto &function : functions)
+    {
+        if(function.name == name)
+        {
+            return function;
+        }
+    }
+    return functions[0];
+}
+
+#endif
@@ -0,0 +1,105 @@
+#include <iostream>
+#include <string>
+#include "interpreter.h"
+#include "ycc_driver.h"
+
+/*
+ * Checks the order of the fields of a class: packed puts them by
+ * alignment, largest first, with ties in the order of their names; hot
+ * puts the fields used most in loops first. Both layouts must run alike.
+ *   clang++ -std=c++11 test/compiler/layout_test.cc -o layout_test
+ *   ./layout_test --ycc=/bin/ycc        from the directory that holds api/
+ */
+
+using namespace ycc;
+using std::cout;
+using std::endl;
+
+// c is used twice in two loops, flag once in one loop and once outside,
+// i three times, d and next twice, l once
+static const char *source = R"(import io;
+public class R
+{
+    boolean flag;
+    double d;
+    int i;
+    char c;
+    long l;
+    R next;
+}
+public class layout
+{
+    public static void main(String [] args)
+    {
+        R r = new R();
+        r.next = new R();
+        r.i = 7;
+        r.d = 2.5;
+        r.l = 5;
+        int k;
+        int j;
+        int total = 0;
+        for(k = 0; k < 10; k++)
+        {
+            r.flag = k < 5;
+            for(j = 0; j < 10; j++)
+            {
+                r.c = 'a';
+                total = total + r.c;
+            }
+        }
+        if(r.flag)
+        {
+            total = total + 1000;
+        }
+        io.printInt(total + r.i + r.next.i);
+        io.print("");
+        io.printDouble(r.d);
+        io.print("");
+    }
+}
+)";
+
+static std::string type(const std::string &ir)
+{
+    auto begin = ir.find("%class.R = type ");
+    if(begin == std::string::npos)
+    {
+        return "";
+    }
+    return ir.substr(begin, ir.find('\n', begin) - begin);
+}
+
+int main(int argc, char *argv[])
+{
+    Driver driver(argc, argv);
+    struct Layout
+    {
+        const char *    flag;
+        const char *    type;
+        const char *    why;
+    };
+    const Layout layouts[] = {
+        {"--field-layout=packed", "%class.R = type { double, i64, %class.R*, i32, i16, i1 }",
+         "packed: 8 byte fields by name, then i32, i16 and i1"},
+        {"--field-layout=hot", "%class.R = type { i16, i1, i32, double, %class.R*, i64 }",
+         "hot: c and flag of the loops first, then by use and alignment"},
+    };
+    for(auto &layout : layouts)
+    {
+        auto ir = driver.compile("layout", source, layout.flag);
+        if(ir.empty())
+        {
+            return 1;
+        }
+        check(type(ir) == layout.type, std::string(layout.why) + ", not " + type(ir));
+
+        int status;
+        auto output = driver.execute("layout", status);
+        check(status == 0 && output == "9707\n2.500000\n",
+              std::string(layout.flag) + " runs, with status " + std::to_string(status) + " and output\n" + output);
+    }
+
+    cout << failures << " failed" << endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,325 @@
+#include <functional>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+#include "../../compiler/ir.h"
+#include "../../compiler/ir.cc"
+#include "../../compiler/dominators.h"
+#include "../../compiler/dominators.cc"
+#include "../../compiler/licm.h"
+#include "../../compiler/licm.cc"
+#include "interpreter.h"
+
+/*
+ * Hoists what hand-built loops do not change, checks what left the loops
+ * and what had to stay, and that every method computes what it did
+ * before:
+ *   clang++ -std=c++11 test/compiler/licm_test.cc -o licm_test
+ *   ./licm_test
+ */
+
+using namespace ycc;
+using std::cout;
+using std::endl;
+
+/*
+ * for(i = 0; i < bound(); i++) body(i), with i in a slot; the entry jumps
+ * to the loop, or with a guard branches to it or past it
+ */
+static void loop(IRBuilder &builder, const IRValue *guard, std::function<IRValue()> bound,
+                 std::function<void(const IRValue &)> body)
+{
+    auto i = builder.allocate("i32", "i");
+    builder.store(zero, i);
+    auto cond = builder.newLabel("for.cond");
+    auto block = builder.newLabel("for.body");
+    auto end = builder.newLabel("for.end");
+    if(guard)
+    {
+        builder.condBr(*guard, cond, end);
+    }
+    builder.setBlock(cond);
+    builder.condBr(builder.cmp("icmp slt", builder.load("i32", i), bound()), block, end);
+    builder.setBlock(block);
+    body(builder.load("i32", i));
+    builder.store(builder.binary("add", builder.load("i32", i), one), i);
+    builder.br(cond);
+    builder.setBlock(end);
+}
+
+static void add(IRBuilder &builder, const IRValue &sum, const IRValue &value)
+{
+    builder.store(builder.binary("add", builder.load("i32", sum), value), sum);
+}
+
+static IRValue start(IRBuilder &builder)
+{
+    auto sum = builder.allocate("i32", "sum");
+    builder.store(zero, sum);
+    return sum;
+}
+
+// sum += k * 3 + i, behind a guard k > 0 or not; or sum += i alone
+static IRFunction invariant(const std::string &name, bool guarded, bool hoistable)
+{
+    IRFunction function{name, "i32", {n, k}, {}};
+    IRBuilder builder(&function);
+    auto sum = start(builder);
+    auto guard = builder.cmp("icmp sgt", k, zero);
+    loop(builder, guarded ? &guard : nullptr, [&]() { return n; }, [&](const IRValue &i)
+    {
+        add(builder, sum, hoistable ? builder.binary("add", builder.binary("mul", k, IRValue{"i32", "3"}), i) : i);
+    });
+    builder.ret(builder.load("i32", sum));
+    return function;
+}
+
+// sum += 100 / k + k % -1 + k / 4: only the last can not trap
+static IRFunction divide()
+{
+    IRFunction function{"@T.divide", "i32", {n, k}, {}};
+    IRBuilder builder(&function);
+    auto sum = start(builder);
+    loop(builder, nullptr, [&]() { return n; }, [&](const IRValue &)
+    {
+        add(builder, sum, builder.binary("sdiv", IRValue{"i32", "100"}, k));
+        add(builder, sum, builder.binary("srem", k, IRValue{"i32", "-1"}));
+        add(builder, sum, builder.binary("sdiv", k, IRValue{"i32", "4"}));
+    });
+    builder.ret(builder.load("i32", sum));
+    return function;
+}
+
+// t = k before the loop, sum += t in it: t is not stored in the loop, sum is
+static IRFunction slot()
+{
+    IRFunction function{"@T.slot", "i32", {n, k}, {}};
+    IRBuilder builder(&function);
+    auto sum = start(builder);
+    auto t = builder.allocate("i32", "t");
+    builder.store(k, t);
+    loop(builder, nullptr, [&]() { return n; }, [&](const IRValue &)
+    {
+        add(builder, sum, builder.load("i32", t));
+    });
+    builder.ret(builder.load("i32", sum));
+    return function;
+}
+
+// @T.s += 1
+static IRFunction bump()
+{
+    IRFunction function{"@T.bump", "void", {}, {}};
+    IRBuilder builder(&function);
+    IRValue s{"i32*", "@T.s"};
+    builder.store(builder.binary("add", builder.load("i32", s), one), s);
+    builder.retVoid();
+    return function;
+}
+
+// sum += @T.s; callee(): bump may store the static, io.printInt may not
+static IRFunction statics(const std::string &name, const std::string &callee)
+{
+    IRFunction function{name, "i32", {n}, {}};
+    IRBuilder builder(&function);
+    auto sum = start(builder);
+    loop(builder, nullptr, [&]() { return n; }, [&](const IRValue &i)
+    {
+        add(builder, sum, builder.load("i32", IRValue{"i32*", "@T.s"}));
+        builder.call("void", callee, callee == "@T.bump" ? std::vector<IRValue>() : std::vector<IRValue>{i});
+    });
+    builder.ret(builder.load("i32", sum));
+    return function;
+}
+
+// for(i = 0; i < a.length; i++) a[i] = i; return a[a.length - 1]
+static IRFunction length()
+{
+    const std::string array = "{ i32, [0 x i32] }";
+    IRValue a{array + "*", "%a"};
+    IRFunction function{"@T.length", "i32", {a}, {}};
+    IRBuilder builder(&function);
+    auto size = [&]()
+    {
+        return builder.load("i32", builder.gep(array, a, {zero, zero}, "i32*"));
+    };
+    loop(builder, nullptr, size, [&](const IRValue &i)
+    {
+        builder.store(i, builder.gep(array, a, {zero, one, i}, "i32*"));
+    });
+    auto last = builder.binary("sub", size(), one);
+    builder.ret(builder.load("i32", builder.gep(array, a, {zero, one, last}, "i32*")));
+    return function;
+}
+
+// if(i == 5) sum += *p: p may be null when the loop runs fewer times
+static IRFunction conditional()
+{
+    IRFunction function{"@T.conditional", "i32", {n, p}, {}};
+    IRBuilder builder(&function);
+    auto sum = start(builder);
+    loop(builder, nullptr, [&]() { return n; }, [&](const IRValue &i)
+    {
+        auto then = builder.newLabel("if.then");
+        auto end = builder.newLabel("if.end");
+        builder.condBr(builder.cmp("icmp eq", i, IRValue{"i32", "5"}), then, end);
+        builder.setBlock(then);
+        add(builder, sum, builder.load("i32", p));
+        builder.setBlock(end);
+    });
+    builder.ret(builder.load("i32", sum));
+    return function;
+}
+
+static std::vector<IRFunction> program()
+{
+    return {invariant("@T.invariant", false, true), invariant("@T.guarded", true, true),
+            invariant("@T.empty", true, false), divide(), slot(), bump(), statics("@T.called", "@T.bump"),
+            statics("@T.printed", "@io.printInt"), length(), conditional()};
+}
+
+// blocks that reach themselves again through their successors
+static std::vector<bool> cyclic(const IRFunction &function)
+{
+    std::vector<bool> body(function.blocks.size(), false);
+    for(size_t b = 0; b < function.blocks.size(); b++)
+    {
+        auto work = function.blocks[b].successors();
+        std::set<std::string> seen;
+        while(!work.empty() && !body[b])
+        {
+            auto label = work.back();
+            work.pop_back();
+            body[b] = label == function.blocks[b].label;
+            for(auto &block : function.blocks)
+            {
+                if(block.label == label && seen.insert(label).second)
+                {
+                    for(auto &next : block.successors())
+                    {
+                        work.push_back(next);
+                    }
+                }
+            }
+        }
+    }
+    return body;
+}
+
+// instructions of the loops that are what
+static int inLoop(const IRFunction &function, std::function<bool(const IRInst &)> what)
+{
+    int count = 0;
+    auto body = cyclic(function);
+    for(size_t b = 0; b < function.blocks.size(); b++)
+    {
+        for(auto &inst : function.blocks[b].insts)
+        {
+            count += body[b] && what(inst);
+        }
+    }
+    return count;
+}
+
+// with the opcode what, or a load from what
+static int inLoop(const IRFunction &function, const std::string &what)
+{
+    return inLoop(function, [&](const IRInst &inst)
+    {
+        return inst.opcode == what || (inst.op == IROp::LOAD && inst.operands[0].name == what);
+    });
+}
+
+// a.length is at a, 0, 0; a[i] at a, 0, 1, i
+static int geps(const IRFunction &function, size_t indices)
+{
+    return inLoop(function, [&](const IRInst &inst)
+    {
+        return inst.op == IROp::GEP && inst.operands.size() == indices + 1;
+    });
+}
+
+static bool hasBlock(const IRFunction &function, const std::string &suffix)
+{
+    for(auto &block : function.blocks)
+    {
+        if(block.label.size() >= suffix.size()
+           && block.label.compare(block.label.size() - suffix.size(), suffix.size(), suffix) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main()
+{
+    auto original = program();
+    auto functions = program();
+    LoopInvariantMotion licm;
+    licm.run(functions);
+
+    auto &invariant = method(functions, "@T.invariant");
+    check(inLoop(invariant, "mul") == 0 && invariant.blocks[0].insts.size() == method(original, "@T.invariant")
+                                                                              .blocks[0].insts.size() + 1,
+          "k * 3 moves to the entry, which jumps to the loop");
+    auto &guarded = method(functions, "@T.guarded");
+    check(inLoop(guarded, "mul") == 0 && hasBlock(guarded, ".preheader"),
+          "the entry branches to the loop, k * 3 moves to a new preheader");
+    auto &empty = method(functions, "@T.empty");
+    check(!hasBlock(empty, ".preheader") && empty.blocks.size() == method(original, "@T.empty").blocks.size(),
+          "a preheader nothing moved to is taken out again");
+    check(licm.preheadersAdded() == 1, std::to_string(licm.preheadersAdded()) + " preheaders added");
+
+    auto &divide = method(functions, "@T.divide");
+    check(inLoop(divide, "sdiv") == 1 && inLoop(divide, "srem") == 1,
+          "100 / k and k % -1 may trap and stay, k / 4 moves");
+    auto &slot = method(functions, "@T.slot");
+    check(inLoop(slot, "%t.addr") == 0 && inLoop(slot, "%sum.addr") == 1,
+          "a slot the loop does not store is read before it, sum is not");
+    check(inLoop(method(functions, "@T.called"), "@T.s") == 1, "a static stays when the loop calls a method");
+    check(inLoop(method(functions, "@T.printed"), "@T.s") == 0, "a static moves when the loop only calls io");
+    auto &length = method(functions, "@T.length");
+    check(geps(length, 2) == 0 && geps(length, 3) == 1, "a.length moves, the stores go to the elements");
+    check(inLoop(method(functions, "@T.conditional"), "%p") == 1,
+          "*p is only read when i == 5, p may not be valid before");
+
+    struct Call
+    {
+        const char *                name;
+        std::vector<long long>      args;
+    };
+    const Call calls[] = {
+        {"@T.invariant", {0, 2}}, {"@T.invariant", {4, 2}}, {"@T.guarded", {4, 2}}, {"@T.guarded", {4, -2}},
+        {"@T.empty", {4, 2}}, {"@T.divide", {6, 7}}, {"@T.divide", {0, 0}}, {"@T.slot", {5, 3}},
+        {"@T.called", {4}}, {"@T.printed", {4}}, {"@T.conditional", {8, 100}}, {"@T.conditional", {3, 0}},
+    };
+    for(auto &call : calls)
+    {
+        Interpreter before(original);
+        Interpreter after(functions);
+        before.store(100, 7);
+        after.store(100, 7);
+        auto want = before.call(call.name, call.args);
+        auto got = after.call(call.name, call.args);
+        check(got == want && after.printed() == before.printed(),
+              std::string(call.name) + "(" + std::to_string(call.args[0]) + ") is " + std::to_string(got)
+              + ", expected " + std::to_string(want));
+    }
+    for(long long size : {1LL, 6LL})
+    {
+        Interpreter before(original);
+        Interpreter after(functions);
+        auto a = before.allocate();
+        before.store(a, size);
+        after.store(after.allocate(), size);
+        auto want = before.call("@T.length", {a});
+        auto got = after.call("@T.length", {a});
+        check(got == want && want == size - 1, "a[a.length - 1] of " + std::to_string(size) + " elements is "
+                                                + std::to_string(got) + ", expected " + std::to_string(want));
+    }
+
+    cout << failures << " failed" << endl;
+    return failures == 0 ? 0 : 1;
+}
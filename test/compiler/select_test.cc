@@ -0,0 +1,135 @@
+#include <iostream>
+#include <string>
+#include "interpreter.h"
+#include "ycc_driver.h"
+
+/*
+ * Checks how ?: && and || are generated: sides without effects become a
+ * select or an and/or of both, sides that may call, divide by zero or
+ * read through a null reference only run when java says they do.
+ *   clang++ -std=c++11 test/compiler/select_test.cc -o select_test
+ *   ./select_test --ycc=/bin/ycc        from the directory that holds api/
+ */
+
+using namespace ycc;
+using std::cout;
+using std::endl;
+
+static const char *source = R"(import io;
+public class P
+{
+    int x;
+}
+public class select
+{
+    static int calls;
+
+    static int min(int a, int b)
+    {
+        return a < b ? a : b;
+    }
+    static boolean both(int a, int b)
+    {
+        return a > 0 && b > 0;
+    }
+    static int half(int n)
+    {
+        return n < 0 ? n / 2 : n;
+    }
+    static int quotient(int n, int d)
+    {
+        return d != 0 ? n / d : 0;
+    }
+    static int length(int[] a)
+    {
+        return a == null ? -1 : a.length;
+    }
+    static boolean positive(P p)
+    {
+        boolean b = p != null && p.x > 0;
+        return b;
+    }
+    static boolean count(boolean b)
+    {
+        calls = calls + 1;
+        return b;
+    }
+    static boolean either(boolean a, boolean b)
+    {
+        boolean c = a || count(b);
+        return c;
+    }
+    static int pick(boolean a)
+    {
+        return a ? 1 : (count(true) ? 2 : 3);
+    }
+    public static void main(String [] args)
+    {
+        io.printInt(min(3, -4));
+        io.print("");
+        io.printInt(both(1, 0) ? 1 : 0);
+        io.print("");
+        io.printInt(half(-9) + half(9));
+        io.print("");
+        io.printInt(quotient(7, 0) + quotient(9, 3));
+        io.print("");
+        int[] none = null;
+        io.printInt(length(none) + length(new int[5]));
+        io.print("");
+        P p = null;
+        io.printInt(positive(p) ? 1 : 0);
+        io.print("");
+        calls = 0;
+        io.printInt(either(true, true) ? 1 : 0);
+        io.printInt(calls);
+        io.printInt(either(false, true) ? 1 : 0);
+        io.printInt(calls);
+        io.print("");
+        io.printInt(pick(true));
+        io.printInt(calls);
+        io.printInt(pick(false));
+        io.printInt(calls);
+        io.print("");
+    }
+}
+)";
+
+int main(int argc, char *argv[])
+{
+    Driver driver(argc, argv);
+    auto ir = driver.compile("select", source);
+    if(ir.empty())
+    {
+        return 1;
+    }
+
+    // without effects: no branch at all
+    auto min = Driver::method(ir, "@select.min");
+    check(Driver::count(min, "select i1") == 1 && Driver::count(min, "br ") == 0, "a < b ? a : b is a select");
+    auto both = Driver::method(ir, "@select.both");
+    check(Driver::count(both, "and i1") == 1 && Driver::count(both, "br ") == 0, "a > 0 && b > 0 is an and");
+    auto half = Driver::method(ir, "@select.half");
+    check(Driver::count(half, "select i1") == 1, "n / 2 can not trap, so it is evaluated anyway");
+
+    // sides that may trap or call are branched around
+    auto quotient = Driver::method(ir, "@select.quotient");
+    check(Driver::count(quotient, "select i1") == 0 && Driver::count(quotient, "br i1") == 1,
+          "n / d only runs when d != 0");
+    auto length = Driver::method(ir, "@select.length");
+    check(Driver::count(length, "select i1") == 0 && Driver::count(length, "br i1") == 1,
+          "a.length only runs when a != null");
+    auto positive = Driver::method(ir, "@select.positive");
+    check(Driver::count(positive, "and i1") == 0 && Driver::count(positive, "br i1") == 2,
+          "p.x only runs when p != null");
+    auto either = Driver::method(ir, "@select.either");
+    check(Driver::count(either, "or i1") == 0 && Driver::count(either, "br i1") >= 1,
+          "a || count(b) only calls when a is false");
+
+    int status;
+    auto output = driver.execute("select", status);
+    check(status == 0, "select runs, exit status " + std::to_string(status));
+    check(output == "-4\n0\n5\n3\n4\n0\n1011\n1122\n", "the output of select is\n" + output);
+
+    cout << failures << " failed" << endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,230 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../../compiler/ir.h"
+#include "../../compiler/ir.cc"
+#include "../../compiler/simplify.h"
+#include "../../compiler/simplify.cc"
+#include "interpreter.h"
+
+/*
+ * Simplifies hand-built methods shaped like what the generator leaves,
+ * checks the blocks and instructions that are left and that every method
+ * computes what it did before:
+ *   clang++ -std=c++11 test/compiler/simplify_test.cc -o simplify_test
+ *   ./simplify_test
+ */
+
+using namespace ycc;
+using std::cout;
+using std::endl;
+
+// if(true) return n; else return 0;
+static IRFunction constant()
+{
+    IRFunction function{"@T.constant", "i32", {n}, {}};
+    IRBuilder builder(&function);
+    auto then = builder.newLabel("if.then");
+    auto otherwise = builder.newLabel("if.else");
+    builder.condBr(IRValue{"i1", "true"}, then, otherwise);
+    builder.setBlock(then);
+    builder.ret(n);
+    builder.setBlock(otherwise);
+    builder.ret(zero);
+    return function;
+}
+
+// if(n > 0) { return 1; } x = 2; return x; with the dead block after the
+// return and the jump to if.end the generator makes
+static IRFunction returned()
+{
+    IRFunction function{"@T.returned", "i32", {n}, {}};
+    IRBuilder builder(&function);
+    auto then = builder.newLabel("if.then");
+    auto otherwise = builder.newLabel("if.else");
+    auto end = builder.newLabel("if.end");
+    builder.condBr(builder.cmp("icmp sgt", n, zero), then, otherwise);
+    builder.setBlock(then);
+    builder.ret(one);
+    builder.br(end);
+    builder.setBlock(otherwise);
+    builder.br(end);
+    builder.setBlock(end);
+    builder.ret(builder.binary("add", n, two));
+    return function;
+}
+
+// n > 0 ? 1 : 2 with the phi reached from the entry and from a block that
+// only jumps on, which can not be folded: the entry would come in twice
+static IRFunction clash()
+{
+    IRFunction function{"@T.clash", "i32", {n}, {}};
+    IRBuilder builder(&function);
+    auto mid = builder.newLabel("mid");
+    auto join = builder.newLabel("join");
+    builder.condBr(builder.cmp("icmp sgt", n, zero), join, mid);
+    builder.setBlock(mid);
+    builder.br(join);
+    builder.setBlock(join);
+    builder.ret(builder.phi("i32", {one, IRValue{"label", "entry"}, two, IRValue{"label", mid}}));
+    return function;
+}
+
+// the same with each side computing a value, the jump through mid folds
+static IRFunction fold()
+{
+    IRFunction function{"@T.fold", "i32", {n}, {}};
+    IRBuilder builder(&function);
+    auto then = builder.newLabel("if.then");
+    auto mid = builder.newLabel("mid");
+    auto otherwise = builder.newLabel("if.else");
+    auto join = builder.newLabel("join");
+    builder.condBr(builder.cmp("icmp sgt", n, zero), then, otherwise);
+    builder.setBlock(then);
+    auto x = builder.binary("add", n, one);
+    builder.br(mid);
+    builder.setBlock(mid);
+    builder.br(join);
+    builder.setBlock(otherwise);
+    auto y = builder.binary("mul", n, two);
+    builder.br(join);
+    builder.setBlock(join);
+    builder.ret(builder.phi("i32", {x, IRValue{"label", mid}, y, IRValue{"label", otherwise}}));
+    return function;
+}
+
+// a chain of blocks, each the only successor of the one before
+static IRFunction chain()
+{
+    IRFunction function{"@T.chain", "i32", {n}, {}};
+    IRBuilder builder(&function);
+    auto x = builder.binary("add", n, one);
+    auto first = builder.newLabel("first");
+    auto second = builder.newLabel("second");
+    builder.setBlock(first);
+    auto y = builder.binary("mul", x, two);
+    builder.setBlock(second);
+    auto z = builder.phi("i32", {y, IRValue{"label", first}});
+    builder.ret(builder.binary("sub", z, n));
+    return function;
+}
+
+// a slot only stored to and a sum nobody uses go, a call and a slot that
+// is loaded stay
+static IRFunction dead()
+{
+    IRFunction function{"@T.dead", "i32", {n}, {}};
+    IRBuilder builder(&function);
+    auto unused = builder.allocate("i32", "unused");
+    auto used = builder.allocate("i32", "used");
+    builder.store(n, unused);
+    builder.store(builder.binary("add", n, one), used);
+    builder.binary("mul", n, n);
+    builder.call("i32", "@T.constant", {n});
+    builder.ret(builder.load("i32", used));
+    return function;
+}
+
+static std::vector<IRFunction> program()
+{
+    return {constant(), returned(), clash(), fold(), chain(), dead()};
+}
+
+static int count(const IRFunction &function, IROp op)
+{
+    int count = 0;
+    for(auto &block : function.blocks)
+    {
+        for(auto &inst : block.insts)
+        {
+            count += inst.op == op;
+        }
+    }
+    return count;
+}
+
+// every label a branch or a phi names is a block of the function
+static bool labelled(const IRFunction &function)
+{
+    for(auto &block : function.blocks)
+    {
+        for(auto &inst : block.insts)
+        {
+            for(auto &operand : inst.operands)
+            {
+                bool found = operand.type != "label";
+                for(auto &other : function.blocks)
+                {
+                    found = found || other.label == operand.name;
+                }
+                if(!found)
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    auto original = program();
+    auto functions = program();
+    CFGSimplifier simplifier;
+    simplifier.run(functions);
+
+    struct Expected
+    {
+        const char *    name;
+        size_t          blocks;
+        const char *    why;
+    };
+    const Expected expected[] = {
+        {"@T.constant", 1, "a branch on true becomes a jump, if.else goes, if.then is merged"},
+        {"@T.returned", 3, "the dead block goes, the entry branches to if.then and if.end"},
+        {"@T.clash", 3, "mid stays, the phi would get two values from the entry"},
+        {"@T.fold", 4, "if.then jumps to join itself, mid goes"},
+        {"@T.chain", 1, "first and second are merged into the entry"},
+        {"@T.dead", 1, "one block"},
+    };
+    for(auto &entry : expected)
+    {
+        auto &function = method(functions, entry.name);
+        check(function.blocks.size() == entry.blocks,
+              std::string(entry.name) + ": " + entry.why + ", " + std::to_string(function.blocks.size()) + " blocks");
+        check(labelled(function), std::string(entry.name) + " only names blocks it has");
+    }
+    check(simplifier.blocksRemoved() == 7, std::to_string(simplifier.blocksRemoved()) + " blocks removed");
+
+    auto &fold = method(functions, "@T.fold");
+    check(fold.blocks.back().insts[0].operands[1].name == "if.then.0", "the phi of join comes from if.then");
+    check(count(method(functions, "@T.chain"), IROp::PHI) == 0, "a phi with one value is replaced by it");
+    auto &dead = method(functions, "@T.dead");
+    check(count(dead, IROp::ALLOCA) == 1 && count(dead, IROp::STORE) == 1, "the slot only stored to goes");
+    check(count(dead, IROp::BINARY) == 1 && count(dead, IROp::CALL) == 1,
+          "n * n goes, n + 1 is stored to a slot that is loaded and the call stays");
+    long removed = 0;
+    for(size_t i = 0; i < functions.size(); i++)
+    {
+        removed += original[i].size() - functions[i].size();
+    }
+    check(simplifier.instructionsRemoved() == removed && removed > 0,
+          std::to_string(simplifier.instructionsRemoved()) + " instructions removed, not " + std::to_string(removed));
+
+    for(auto name : {"@T.constant", "@T.returned", "@T.clash", "@T.fold", "@T.chain", "@T.dead"})
+    {
+        for(long long x : {-3LL, 0LL, 5LL})
+        {
+            Interpreter before(original);
+            Interpreter after(functions);
+            auto want = before.call(name, {x});
+            auto got = after.call(name, {x});
+            check(got == want, std::string(name) + "(" + std::to_string(x) + ") is " + std::to_string(got)
+                               + ", expected " + std::to_string(want));
+        }
+    }
+
+    cout << failures << " failed" << endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,247 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../../compiler/ir.h"
+#include "../../compiler/ir.cc"
+#include "../../compiler/tail_calls.h"
+#include "../../compiler/tail_calls.cc"
+#include "interpreter.h"
+
+/*
+ * Turns hand-built methods that call themselves in tail position into
+ * loops, checks they compute what they did before, and checks which
+ * calls are marked tail or musttail:
+ *   clang++ -std=c++11 test/compiler/tail_calls_test.cc -o tail_calls_test
+ *   ./tail_calls_test
+ */
+
+using namespace ycc;
+using std::cout;
+using std::endl;
+
+static const IRValue acc{"i32", "%acc"};
+
+// if(n == 0) return acc; return sum(n - 1, acc + n);
+static IRFunction sum()
+{
+    IRFunction function{"@T.sum", "i32", {n, acc}, {}};
+    IRBuilder builder(&function);
+    auto done = builder.newLabel("if.then");
+    auto again = builder.newLabel("if.else");
+    builder.condBr(builder.cmp("icmp eq", n, zero), done, again);
+    builder.setBlock(done);
+    builder.ret(acc);
+    builder.setBlock(again);
+    auto args = std::vector<IRValue>{builder.binary("sub", n, one), builder.binary("add", acc, n)};
+    builder.ret(builder.call("i32", "@T.sum", args));
+    return function;
+}
+
+/*
+ * int v = n > 0 ? n + 10 : 0; if(v > 0) return entry(n - 1, acc + v);
+ * return acc; the phi of v has a value from the entry, which is no
+ * longer a predecessor once the entry jumps to the loop
+ */
+static IRFunction entry()
+{
+    IRFunction function{"@T.entry", "i32", {n, acc}, {}};
+    IRBuilder builder(&function);
+    auto positive = builder.newLabel("cond.true");
+    auto join = builder.newLabel("cond.end");
+    auto again = builder.newLabel("if.then");
+    auto done = builder.newLabel("if.end");
+    builder.condBr(builder.cmp("icmp sgt", n, zero), positive, join);
+    builder.setBlock(positive);
+    auto x = builder.binary("add", n, IRValue{"i32", "10"});
+    builder.setBlock(join);
+    auto v = builder.phi("i32", {zero, IRValue{"label", "entry"}, x, IRValue{"label", positive}});
+    builder.condBr(builder.cmp("icmp sgt", v, zero), again, done);
+    builder.setBlock(again);
+    auto args = std::vector<IRValue>{builder.binary("sub", n, one), builder.binary("add", acc, v)};
+    builder.ret(builder.call("i32", "@T.entry", args));
+    builder.setBlock(done);
+    builder.ret(acc);
+    return function;
+}
+
+// if(n == 0) return; io.printInt(n); count(n - 1);
+static IRFunction count()
+{
+    IRFunction function{"@T.count", "void", {n}, {}};
+    IRBuilder builder(&function);
+    auto done = builder.newLabel("if.then");
+    auto again = builder.newLabel("if.end");
+    builder.condBr(builder.cmp("icmp eq", n, zero), done, again);
+    builder.setBlock(done);
+    builder.retVoid();
+    builder.setBlock(again);
+    builder.call("void", "@io.printInt", {n});
+    builder.call("void", "@T.count", {builder.binary("sub", n, one)});
+    builder.retVoid();
+    return function;
+}
+
+// if(n <= 1) return 1; return n * fact(n - 1);
+static IRFunction fact()
+{
+    IRFunction function{"@T.fact", "i32", {n}, {}};
+    IRBuilder builder(&function);
+    auto done = builder.newLabel("if.then");
+    auto again = builder.newLabel("if.end");
+    builder.condBr(builder.cmp("icmp sle", n, one), done, again);
+    builder.setBlock(done);
+    builder.ret(one);
+    builder.setBlock(again);
+    builder.ret(builder.binary("mul", n, builder.call("i32", "@T.fact", {builder.binary("sub", n, one)})));
+    return function;
+}
+
+// return fact(n), from a method of the prototype of fact or not
+static IRFunction caller(const std::string &name, const std::vector<IRValue> &params)
+{
+    IRFunction function{name, "i32", params, {}};
+    IRBuilder builder(&function);
+    builder.ret(builder.call("i32", "@T.fact", {n}));
+    return function;
+}
+
+static IRFunction read()
+{
+    IRValue p{"i32*", "%p"};
+    IRFunction function{"@T.read", "i32", {p}, {}};
+    IRBuilder builder(&function);
+    builder.ret(builder.load("i32", p));
+    return function;
+}
+
+// return read(&s), or read(&s.y) with s a struct on the stack
+static IRFunction local(const std::string &name, bool field)
+{
+    IRFunction function{name, "i32", {n}, {}};
+    IRBuilder builder(&function);
+    IRValue pointer;
+    if(field)
+    {
+        auto s = builder.allocate("{ i32, i32 }", "s");
+        pointer = builder.gep("{ i32, i32 }", s, {zero, one}, "i32*");
+    }
+    else
+    {
+        pointer = builder.allocate("i32", "s");
+    }
+    builder.store(n, pointer);
+    builder.ret(builder.call("i32", "@T.read", {pointer}));
+    return function;
+}
+
+// io.printInt(n); return;
+static IRFunction print()
+{
+    IRFunction function{"@T.print", "void", {n}, {}};
+    IRBuilder builder(&function);
+    builder.call("void", "@io.printInt", {n});
+    builder.retVoid();
+    return function;
+}
+
+static std::vector<IRFunction> program()
+{
+    return {sum(), entry(), count(), fact(), caller("@T.caller", {n}), caller("@T.widen", {n, m}), read(),
+            local("@T.local", false), local("@T.field", true), print()};
+}
+
+static const IRInst * call(const IRFunction &function, const std::string &callee)
+{
+    for(auto &block : function.blocks)
+    {
+        for(auto &inst : block.insts)
+        {
+            if(inst.op == IROp::CALL && inst.opcode == callee)
+            {
+                return &inst;
+            }
+        }
+    }
+    return nullptr;
+}
+
+// every label a phi names is a block that jumps to the block of the phi
+static bool predecessors(const IRFunction &function)
+{
+    for(auto &block : function.blocks)
+    {
+        for(auto &inst : block.insts)
+        {
+            for(size_t i = 1; inst.op == IROp::PHI && i < inst.operands.size(); i += 2)
+            {
+                bool found = false;
+                for(auto &pred : function.blocks)
+                {
+                    for(auto &label : pred.successors())
+                    {
+                        found = found || (pred.label == inst.operands[i].name && label == block.label);
+                    }
+                }
+                if(!found)
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    auto original = program();
+    auto functions = program();
+    TailCalls tailCalls;
+    tailCalls.eliminate(functions);
+
+    check(tailCalls.eliminated() == 3, std::to_string(tailCalls.eliminated()) + " tail recursions eliminated");
+    for(auto name : {"@T.sum", "@T.entry", "@T.count"})
+    {
+        auto &function = method(functions, name);
+        check(!call(function, name), std::string(name) + " no longer calls itself");
+        check(predecessors(function), std::string(name) + ": the phis only name predecessors");
+    }
+    check(call(method(functions, "@T.fact"), "@T.fact") != nullptr, "n * fact(n - 1) is not a tail call");
+
+    for(long long x : {0LL, 1LL, 7LL})
+    {
+        for(auto name : {"@T.sum", "@T.entry", "@T.fact"})
+        {
+            Interpreter before(original);
+            Interpreter after(functions);
+            auto want = before.call(name, {x, 3});
+            auto got = after.call(name, {x, 3});
+            check(got == want, std::string(name) + "(" + std::to_string(x) + ") is " + std::to_string(got)
+                               + ", expected " + std::to_string(want));
+        }
+        Interpreter before(original);
+        Interpreter after(functions);
+        before.call("@T.count", {x});
+        after.call("@T.count", {x});
+        check(after.printed() == before.printed(), "count(" + std::to_string(x) + ") prints the same");
+    }
+    // deeper than the interpreter could recurse
+    Interpreter deep(functions);
+    check(deep.call("@T.sum", {60000, 0}) == 60000LL * 60001 / 2, "sum(60000, 0) runs as a loop");
+
+    tailCalls.mark(functions);
+    check(call(method(functions, "@T.caller"), "@T.fact")->tail == IRTail::MUSTTAIL,
+          "a call of a method of the same prototype is musttail");
+    check(call(method(functions, "@T.widen"), "@T.fact")->tail == IRTail::TAIL,
+          "a call of a method of another prototype is tail");
+    check(call(method(functions, "@T.fact"), "@T.fact")->tail == IRTail::NONE, "a call not in tail position");
+    check(call(method(functions, "@T.local"), "@T.read")->tail == IRTail::NONE,
+          "a call that gets a pointer to a slot of the caller is not marked");
+    check(call(method(functions, "@T.field"), "@T.read")->tail == IRTail::NONE,
+          "a call that gets a pointer into a struct on the stack of the caller is not marked");
+    check(call(method(functions, "@T.print"), "@io.printInt")->tail == IRTail::TAIL, "io.printInt(n); return; is tail");
+    check(tailCalls.marked() == 3, std::to_string(tailCalls.marked()) + " tail calls marked");
+
+    cout << failures << " failed" << endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+#ifndef TEST_YCC_DRIVER_H_
+#define TEST_YCC_DRIVER_H_
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+/*
+ * Compiles java sources of the code generation tests with ycc and runs
+ * them, like bench/run_bench does for the kernels. The tests take
+ * --ycc=<path>, --llc=<path>, --cc=<path> and --work=<dir> and are run
+ * from the directory that holds api/. Programs are built with llc -O0,
+ * so what the generated IR does is what runs.
+ */
+namespace ycc
+{
+    class Driver
+    {
+      public:
+        Driver(int argc, char *argv[])
+            : ycc_("ycc"),llc_("llc"),cc_("cc"),work_("test/compiler/out")
+        {
+            for(int i = 1; i < argc; i++)
+            {
+                if(std::strncmp(argv[i], "--ycc=", 6) == 0)        ycc_ = argv[i] + 6;
+                else if(std::strncmp(argv[i], "--llc=", 6) == 0)   llc_ = argv[i] + 6;
+                else if(std::strncmp(argv[i], "--cc=", 5) == 0)    cc_ = argv[i] + 5;
+                else if(std::strncmp(argv[i], "--work=", 7) == 0)  work_ = argv[i] + 7;
+            }
+            mkdir(work_.c_str(), 0755);
+        }
+
+        // the IR of a program, empty if ycc fails; the class is named as the file
+        std::string compile(const std::string &name, const std::string &source,
+                            const std::string &flags = "")
+        {
+            auto prefix = work_ + "/" + name;
+            std::ofstream(prefix + ".java") << source;
+            // ycc writes ycc.ll into the working directory
+            std::remove("ycc.ll");
+            if(!run(ycc_ + " " + flags + " " + prefix + ".java > " + prefix + ".log 2>&1 < /dev/null")
+               || std::rename("ycc.ll", (prefix + ".ll").c_str()) != 0)
+            {
+                std::cout << "ycc failed on " << prefix << ".java, see " << prefix << ".log" << std::endl;
+                return "";
+            }
+            return read(prefix + ".ll");
+        }
+
+        // the output of the program compiled last as name, and its exit status
+        std::string execute(const std::string &name, int &status)
+        {
+            auto prefix = work_ + "/" + name;
+            auto log = " > " + prefix + ".log 2>&1";
+            status = -1;
+            if(!run(llc_ + " -O0 -relocation-model=pic -filetype=obj " + prefix + ".ll -o " + prefix + ".o" + log)
+               || !run(cc_ + " " + prefix + ".o -o " + prefix + log))
+            {
+                std::cout << "llc or cc failed on " << prefix << ".ll, see " << prefix << ".log" << std::endl;
+                return "";
+            }
+            int code = std::system((prefix + " > " + prefix + ".out 2>&1").c_str());
+            status = WIFEXITED(code) ? WEXITSTATUS(code) : 128 + WTERMSIG(code);
+            return read(prefix + ".out");
+        }
+
+        // the text of define ... @name(...) { ... } in ir
+        static std::string method(const std::string &ir, const std::string &name)
+        {
+            auto begin = ir.find(" " + name + "(");
+            begin = begin == std::string::npos ? begin : ir.rfind("define ", begin);
+            if(begin == std::string::npos)
+            {
+                return "";
+            }
+            return ir.substr(begin, ir.find("\n}", begin) + 2 - begin);
+        }
+
+        static int count(const std::string &text, const std::string &what)
+        {
+            int count = 0;
+            for(auto at = text.find(what); at != std::string::npos; at = text.find(what, at + what.size()))
+            {
+                count++;
+            }
+            return count;
+        }
+
+      private:
+        static bool run(const std::string &command)
+        {
+            return std::system(command.c_str()) == 0;
+        }
+
+        static std::string read(const std::string &fileName)
+        {
+            std::ifstream in(fileName, std::ios::in | std::ios::binary);
+            return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        }
+
+      private:
+        std::string         ycc_;
+        std::string         llc_;
+        std::string         cc_;
+        std::string         work_;
+    };
+}
+
+#endif
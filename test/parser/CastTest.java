@@ -0,0 +1,16 @@
+// casts are not supported: each bad statement or argument is reported
+// and skipped, ycc stops after parsing with status 1
+import io;
+public class CastTest
+{
+    public static void main(String [] args)
+    {
+        int x = (int) 3;
+        long y;
+        y = (long) x;
+        ) ;
+        x = 1;
+        io.printInt((int)(y));
+        io.printInt(x, (int) y);
+    }
+}